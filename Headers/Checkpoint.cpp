@@ -0,0 +1,417 @@
+#include <cstdio>
+#include <algorithm>
+#include <utility>
+#include "Checkpoint.hpp"
+#include "InterruptHandling.hpp"
+#include "ParallelHelpers.hpp"
+
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+namespace {
+	const uint64_t CheckpointAlignment = 64;
+
+	inline uint64_t alignCheckpointOffset(uint64_t Offset) {
+		return (Offset + CheckpointAlignment - 1) / CheckpointAlignment * CheckpointAlignment;
+	}
+
+	inline uint64_t mixHash(uint64_t Hash, uint64_t Word) {
+		Hash ^= Word * 0x87C37B91114253D5ULL;
+		Hash = (Hash << 31) | (Hash >> 33);
+		return Hash * 0x4CF5AD432745937FULL + 0x52DCE729ULL;
+	}
+
+	void hashChunks(const std::vector<CheckpointArray> &Arrays, size_t ChunkSize,
+	                std::vector<size_t> &ChunkBounds, std::vector<uint64_t> &ChunkHashes) {
+		// ChunkBounds[i] is the index of the first chunk of Arrays[i] in
+		// ChunkHashes (ChunkBounds has an entry past the end)
+		ChunkBounds.resize(Arrays.size() + 1);
+		ChunkBounds[0] = 0;
+		for (size_t i = 0; i < Arrays.size(); ++i)
+			ChunkBounds[i + 1] = ChunkBounds[i] + (Arrays[i].NBytes + ChunkSize - 1) / ChunkSize;
+		ChunkHashes.resize(ChunkBounds.back());
+
+		ParallelFor(0, ChunkBounds.back(), 4, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			size_t ArrayIndex = std::upper_bound(ChunkBounds.begin(), ChunkBounds.end(), ChunkBeg) - ChunkBounds.begin() - 1;
+			for (size_t c = ChunkBeg; c < ChunkEnd; ++c) {
+				while (c >= ChunkBounds[ArrayIndex + 1])
+					++ArrayIndex;
+				size_t ByteBeg = (c - ChunkBounds[ArrayIndex]) * ChunkSize;
+				size_t NBytes = std::min(ChunkSize, Arrays[ArrayIndex].NBytes - ByteBeg);
+				ChunkHashes[c] = Checkpointer::hashBytes(Arrays[ArrayIndex].Beg + ByteBeg, NBytes);
+			}
+		});
+	}
+
+	bool seekFile(FILE* File, uint64_t Offset) {
+	#ifdef _WIN32
+		return _fseeki64(File, __int64(Offset), SEEK_SET) == 0;
+	#else
+		return fseeko(File, off_t(Offset), SEEK_SET) == 0;
+	#endif
+	}
+
+	bool syncFile(FILE* File) {
+	#ifdef _WIN32
+		return std::fflush(File) == 0 && _commit(_fileno(File)) == 0;
+	#else
+		return std::fflush(File) == 0 && fsync(fileno(File)) == 0;
+	#endif
+	}
+
+	bool writeAt(FILE* File, uint64_t Offset, const void* Beg, size_t NBytes) {
+		return seekFile(File, Offset) && std::fwrite(Beg, 1, NBytes, File) == NBytes;
+	}
+}
+
+uint64_t Checkpointer::hashBytes(const char* Beg, size_t NBytes) {
+	// A simple 64 bit word-wise hash (not cryptographic). It only needs to
+	// detect modified chunks and corrupt files.
+	uint64_t Hash = 0x9E3779B97F4A7C15ULL ^ uint64_t(NBytes);
+	size_t NWords = NBytes / sizeof(uint64_t);
+	for (size_t i = 0; i < NWords; ++i) {
+		uint64_t Word;
+		std::memcpy(&Word, Beg + i * sizeof(uint64_t), sizeof(uint64_t));
+		Hash = mixHash(Hash, Word);
+	}
+	uint64_t TailWord = 0;
+	std::memcpy(&TailWord, Beg + NWords * sizeof(uint64_t), NBytes - NWords * sizeof(uint64_t));
+	Hash = mixHash(Hash, TailWord);
+
+	Hash ^= Hash >> 33;
+	Hash *= 0xFF51AFD7ED558CCDULL;
+	Hash ^= Hash >> 33;
+	return Hash;
+}
+
+Checkpointer::Checkpointer(const std::string &BasePath, double IntervalSeconds_, size_t ChunkSize_) :
+	Generation(0),
+	ChunkSize(alignCheckpointOffset(std::max<size_t>(ChunkSize_, 1))),
+	IntervalSeconds(IntervalSeconds_),
+	LastCheckpointTime(std::chrono::steady_clock::now()),
+	LastWrittenBytes(0) {
+	Slots[0].FilePath = BasePath + ".ckpt0";
+	Slots[1].FilePath = BasePath + ".ckpt1";
+}
+
+Checkpointer::~Checkpointer() {
+	// Errors cannot be reported from a destructor, the slot being written
+	// is then simply left invalid
+	if (Writer.joinable())
+		Writer.join();
+}
+
+void Checkpointer::registerStateObject(const std::string &Name, CheckpointState* State) {
+	std::unique_ptr<CheckpointState> StatePtr(State);
+	if (Name.empty() || Name.size() >= sizeof(CheckpointObjectEntry::Name)
+	    || std::find(Names.begin(), Names.end(), Name) != Names.end()) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+		               "The checkpointed object name '%s' is either empty, longer than 31 characters or already registered",
+		               Name.c_str());
+	}
+	Names.push_back(Name);
+	States.push_back(std::move(StatePtr));
+}
+
+/////////////////////////////////////////////////
+// CHECKPOINTING FUNCTIONS   ////////////////////
+/////////////////////////////////////////////////
+
+void Checkpointer::checkpoint() {
+	wait();
+
+	uint64_t NewGeneration = Generation + 1;
+	SlotState &Slot = Slots[NewGeneration % 2];
+
+	// Describing the objects
+	uint32_t NObjects = uint32_t(States.size());
+	std::vector<CheckpointObjectEntry> Entries(NObjects);
+	std::vector<CheckpointArray> Arrays;
+	for (uint32_t i = 0; i < NObjects; ++i) {
+		std::memset(&Entries[i], 0, sizeof(CheckpointObjectEntry));
+		States[i]->describe(Entries[i], Arrays);
+		std::memcpy(Entries[i].Name, Names[i].c_str(), Names[i].size());
+	}
+	uint32_t NArrays = uint32_t(Arrays.size());
+
+	// Laying out the file afresh if an array has outgrown its region (or the
+	// contents of the slot are unknown). Every chunk is then dirty.
+	uint64_t TablesSize = sizeof(CheckpointHeader) + uint64_t(NObjects) * sizeof(CheckpointObjectEntry)
+	                      + uint64_t(NArrays) * sizeof(CheckpointArrayEntry);
+	bool isLayoutValid = Slot.Layout.size() == NArrays;
+	for (uint32_t i = 0; i < NArrays && isLayoutValid; ++i)
+		isLayoutValid = Arrays[i].NBytes <= Slot.Layout[i].Capacity;
+	if (!isLayoutValid) {
+		Slot.Layout.resize(NArrays);
+		Slot.ChunkHashes.assign(NArrays, std::vector<uint64_t>());
+		uint64_t CurrOffset = alignCheckpointOffset(TablesSize);
+		for (uint32_t i = 0; i < NArrays; ++i) {
+			Slot.Layout[i].Offset = CurrOffset;
+			Slot.Layout[i].Capacity = alignCheckpointOffset(Arrays[i].NBytes + Arrays[i].NBytes / 4);
+			CurrOffset += Slot.Layout[i].Capacity;
+		}
+	}
+
+	// Finding the dirty chunks
+	std::vector<size_t> ChunkBounds;
+	std::vector<uint64_t> NewHashes;
+	hashChunks(Arrays, ChunkSize, ChunkBounds, NewHashes);
+
+	WriteJob Job;
+	std::vector<const char*> ChunkSources;
+	size_t NDirtyBytes = 0;
+	for (uint32_t i = 0; i < NArrays; ++i) {
+		std::vector<uint64_t> &OldHashes = Slot.ChunkHashes[i];
+		for (size_t c = ChunkBounds[i]; c < ChunkBounds[i + 1]; ++c) {
+			size_t ChunkIndex = c - ChunkBounds[i];
+			if (ChunkIndex < OldHashes.size() && OldHashes[ChunkIndex] == NewHashes[c])
+				continue;
+			size_t ByteBeg = ChunkIndex * ChunkSize;
+			ChunkWrite Chunk = { Slot.Layout[i].Offset + ByteBeg, NDirtyBytes, std::min(ChunkSize, Arrays[i].NBytes - ByteBeg) };
+			Job.Chunks.push_back(Chunk);
+			ChunkSources.push_back(Arrays[i].Beg + ByteBeg);
+			NDirtyBytes += Chunk.NBytes;
+		}
+	}
+
+	// Staging the dirty chunks (this is the snapshot, the computation may
+	// modify the objects once this returns)
+	Job.Buffer.resize(NDirtyBytes);
+	ParallelFor(0, Job.Chunks.size(), 4, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t d = ChunkBeg; d < ChunkEnd; ++d)
+			std::memcpy(Job.Buffer.data() + Job.Chunks[d].BufferOffset, ChunkSources[d], Job.Chunks[d].NBytes);
+	});
+
+	// Updating the slot and building the tables
+	uint64_t FileSize = TablesSize;
+	for (uint32_t i = 0; i < NArrays; ++i) {
+		Slot.ChunkHashes[i].assign(NewHashes.begin() + ChunkBounds[i], NewHashes.begin() + ChunkBounds[i + 1]);
+		Slot.Layout[i].NBytes = Arrays[i].NBytes;
+		Slot.Layout[i].Hash = hashBytes(reinterpret_cast<const char*>(Slot.ChunkHashes[i].data()),
+		                                Slot.ChunkHashes[i].size() * sizeof(uint64_t));
+		FileSize = std::max<uint64_t>(FileSize, Slot.Layout[i].Offset + Slot.Layout[i].NBytes);
+	}
+
+	Job.Tables.resize(size_t(TablesSize));
+	char* TableBeg = Job.Tables.data() + sizeof(CheckpointHeader);
+	if (NObjects > 0)
+		std::memcpy(TableBeg, Entries.data(), NObjects * sizeof(CheckpointObjectEntry));
+	if (NArrays > 0)
+		std::memcpy(TableBeg + NObjects * sizeof(CheckpointObjectEntry), Slot.Layout.data(), NArrays * sizeof(CheckpointArrayEntry));
+
+	CheckpointHeader Header;
+	std::memset(&Header, 0, sizeof(CheckpointHeader));
+	std::memcpy(Header.Magic, CheckpointMagic, sizeof(CheckpointMagic));
+	Header.Version    = CheckpointVersion;
+	Header.HeaderSize = sizeof(CheckpointHeader);
+	Header.NObjects   = NObjects;
+	Header.NArrays    = NArrays;
+	Header.Generation = NewGeneration;
+	Header.TableHash  = hashBytes(TableBeg, size_t(TablesSize - sizeof(CheckpointHeader)));
+	Header.FileSize   = FileSize;
+	Header.ChunkSize  = ChunkSize;
+	std::memcpy(Job.Tables.data(), &Header, sizeof(CheckpointHeader));
+
+	Job.FilePath = Slot.FilePath;
+	Job.FileSize = FileSize;
+
+	// Starting the background write
+	Generation = NewGeneration;
+	LastCheckpointTime = std::chrono::steady_clock::now();
+	LastWrittenBytes = Job.Buffer.size() + Job.Tables.size();
+	PendingJob = std::move(Job);
+	Writer = std::thread([this]() {
+		writeCheckpointFile(PendingJob, WriteError);
+	});
+}
+
+void Checkpointer::writeCheckpointFile(const WriteJob &Job, std::string &Error) {
+	/*
+	   Runs on the background thread (no mx* calls). The header is first
+	   overwritten with one of generation 0 (invalidating the file), then the
+	   chunks are written, and finally the header and tables, each step being
+	   synced to disk before the next.
+	*/
+	FILE* File = std::fopen(Job.FilePath.c_str(), "r+b");
+	if (File == NULL)
+		File = std::fopen(Job.FilePath.c_str(), "w+b");
+	if (File == NULL) {
+		Error = "Could not open the checkpoint file '" + Job.FilePath + "' for writing";
+		return;
+	}
+
+	CheckpointHeader InvalidHeader;
+	std::memcpy(&InvalidHeader, Job.Tables.data(), sizeof(CheckpointHeader));
+	InvalidHeader.Generation = 0;
+	bool isWriteOK = writeAt(File, 0, &InvalidHeader, sizeof(CheckpointHeader)) && syncFile(File);
+
+	for (size_t d = 0; d < Job.Chunks.size() && isWriteOK; ++d)
+		isWriteOK = writeAt(File, Job.Chunks[d].FileOffset, Job.Buffer.data() + Job.Chunks[d].BufferOffset, Job.Chunks[d].NBytes);
+	isWriteOK = isWriteOK && syncFile(File);
+
+	isWriteOK = isWriteOK && writeAt(File, 0, Job.Tables.data(), Job.Tables.size()) && syncFile(File);
+	isWriteOK = (std::fclose(File) == 0) && isWriteOK;
+
+	if (!isWriteOK)
+		Error = "Error writing the checkpoint file '" + Job.FilePath + "'";
+}
+
+void Checkpointer::wait() {
+	if (Writer.joinable())
+		Writer.join();
+	PendingJob = WriteJob();
+
+	if (!WriteError.empty()) {
+		// The slot that failed is invalid. Its contents are unknown and it is
+		// retried by the next checkpoint (so that the previous checkpoint, in
+		// the other slot, is kept).
+		SlotState &Slot = Slots[Generation % 2];
+		Slot.Layout.clear();
+		Slot.ChunkHashes.clear();
+		Generation -= 1;
+		LastWrittenBytes = 0;
+
+		std::string Error;
+		Error.swap(WriteError);
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "%s", Error.c_str());
+	}
+}
+
+bool Checkpointer::update() {
+	if (IsProgramInterrupted()) {
+		checkpoint();
+		wait();
+		return true;
+	}
+	std::chrono::duration<double> Elapsed = std::chrono::steady_clock::now() - LastCheckpointTime;
+	if (Elapsed.count() >= IntervalSeconds)
+		checkpoint();
+	return false;
+}
+
+/////////////////////////////////////////////////
+// RESTORING FUNCTIONS       ////////////////////
+/////////////////////////////////////////////////
+
+bool Checkpointer::validateSlot(uint32_t SlotIndex, MemoryMappedFile &File, std::vector<uint64_t> &ChunkHashes) {
+	// Maps the file of the slot if it holds a complete checkpoint (with
+	// valid tables and array hashes), returning the hashes of its chunks.
+	// (a missing slot file is not an error, so the file is not open()ed)
+	if (!File.tryOpen(Slots[SlotIndex].FilePath) || File.size() < sizeof(CheckpointHeader))
+		return false;
+
+	const char* FileBeg = File.data();
+	uint64_t FileSize = File.size();
+	const CheckpointHeader* Header = reinterpret_cast<const CheckpointHeader*>(FileBeg);
+
+	if (std::memcmp(Header->Magic, CheckpointMagic, sizeof(CheckpointMagic)) != 0 || Header->Version != CheckpointVersion
+	    || Header->HeaderSize != sizeof(CheckpointHeader) || Header->Generation == 0 || Header->ChunkSize == 0
+	    || Header->FileSize > FileSize)
+		return false;
+	uint64_t TablesSize = sizeof(CheckpointHeader) + uint64_t(Header->NObjects) * sizeof(CheckpointObjectEntry)
+	                      + uint64_t(Header->NArrays) * sizeof(CheckpointArrayEntry);
+	if (TablesSize > FileSize
+	    || hashBytes(FileBeg + sizeof(CheckpointHeader), size_t(TablesSize - sizeof(CheckpointHeader))) != Header->TableHash)
+		return false;
+
+	const CheckpointObjectEntry* Entries = reinterpret_cast<const CheckpointObjectEntry*>(FileBeg + sizeof(CheckpointHeader));
+	const CheckpointArrayEntry* ArrayEntries = reinterpret_cast<const CheckpointArrayEntry*>(Entries + Header->NObjects);
+	uint64_t NArraysTotal = 0;
+	for (uint32_t i = 0; i < Header->NObjects; ++i) {
+		if (Entries[i].Name[sizeof(CheckpointObjectEntry::Name) - 1] != '\0')
+			return false;
+		NArraysTotal += Entries[i].NArrays;
+	}
+	if (NArraysTotal != Header->NArrays)
+		return false;
+
+	std::vector<CheckpointArray> Arrays(Header->NArrays);
+	for (uint32_t i = 0; i < Header->NArrays; ++i) {
+		if (ArrayEntries[i].Offset > FileSize || ArrayEntries[i].NBytes > FileSize - ArrayEntries[i].Offset)
+			return false;
+		Arrays[i].Beg = FileBeg + ArrayEntries[i].Offset;
+		Arrays[i].NBytes = size_t(ArrayEntries[i].NBytes);
+	}
+
+	std::vector<size_t> ChunkBounds;
+	hashChunks(Arrays, size_t(Header->ChunkSize), ChunkBounds, ChunkHashes);
+	for (uint32_t i = 0; i < Header->NArrays; ++i) {
+		const char* HashesBeg = reinterpret_cast<const char*>(ChunkHashes.data() + ChunkBounds[i]);
+		if (hashBytes(HashesBeg, (ChunkBounds[i + 1] - ChunkBounds[i]) * sizeof(uint64_t)) != ArrayEntries[i].Hash)
+			return false;
+	}
+	return true;
+}
+
+bool Checkpointer::restore() {
+	wait();
+
+	MemoryMappedFile SlotFiles[2];
+	std::vector<uint64_t> SlotChunkHashes[2];
+	int BestSlot = -1;
+	for (uint32_t s = 0; s < 2; ++s) {
+		if (!validateSlot(s, SlotFiles[s], SlotChunkHashes[s]))
+			continue;
+		uint64_t SlotGeneration = reinterpret_cast<const CheckpointHeader*>(SlotFiles[s].data())->Generation;
+		if (BestSlot < 0 || SlotGeneration > reinterpret_cast<const CheckpointHeader*>(SlotFiles[BestSlot].data())->Generation)
+			BestSlot = int(s);
+	}
+	if (BestSlot < 0)
+		return false;
+
+	const char* FileBeg = SlotFiles[BestSlot].data();
+	const CheckpointHeader* Header = reinterpret_cast<const CheckpointHeader*>(FileBeg);
+	const CheckpointObjectEntry* Entries = reinterpret_cast<const CheckpointObjectEntry*>(FileBeg + sizeof(CheckpointHeader));
+	const CheckpointArrayEntry* ArrayEntries = reinterpret_cast<const CheckpointArrayEntry*>(Entries + Header->NObjects);
+
+	std::vector<size_t> EntryArrayBeg(Header->NObjects + 1, 0);
+	for (uint32_t j = 0; j < Header->NObjects; ++j)
+		EntryArrayBeg[j + 1] = EntryArrayBeg[j] + Entries[j].NArrays;
+
+	// Restoring every registered object (by name). The objects already
+	// restored remain so if a later one fails.
+	bool isSameOrder = Header->NObjects == States.size();
+	for (uint32_t i = 0; i < States.size(); ++i) {
+		uint32_t j = 0;
+		while (j < Header->NObjects && Names[i] != Entries[j].Name)
+			++j;
+		if (j == Header->NObjects) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+			               "The checkpoint '%s' does not contain the registered object '%s'",
+			               Slots[BestSlot].FilePath.c_str(), Names[i].c_str());
+		}
+		isSameOrder = isSameOrder && (i == j);
+
+		std::vector<CheckpointArray> Arrays;
+		for (size_t a = EntryArrayBeg[j]; a < EntryArrayBeg[j + 1]; ++a) {
+			CheckpointArray Array = { FileBeg + ArrayEntries[a].Offset, size_t(ArrayEntries[a].NBytes) };
+			Arrays.push_back(Array);
+		}
+		States[i]->restore(Entries[j], Arrays);
+	}
+
+	// The restored slot holds the current state, so its chunk hashes carry
+	// over if its objects are in the registration order (else it is laid
+	// out afresh). The other slot is older and is rewritten in full.
+	Generation = Header->Generation;
+	LastCheckpointTime = std::chrono::steady_clock::now();
+	for (uint32_t s = 0; s < 2; ++s) {
+		Slots[s].Layout.clear();
+		Slots[s].ChunkHashes.clear();
+	}
+	if (isSameOrder && Header->ChunkSize == ChunkSize) {
+		SlotState &Slot = Slots[BestSlot];
+		std::vector<size_t> ChunkBounds(1, 0);
+		Slot.Layout.assign(ArrayEntries, ArrayEntries + Header->NArrays);
+		for (uint32_t a = 0; a < Header->NArrays; ++a) {
+			size_t NChunks = size_t((ArrayEntries[a].NBytes + ChunkSize - 1) / ChunkSize);
+			Slot.ChunkHashes.push_back(std::vector<uint64_t>(SlotChunkHashes[BestSlot].begin() + ChunkBounds.back(),
+			                                                 SlotChunkHashes[BestSlot].begin() + ChunkBounds.back() + NChunks));
+			ChunkBounds.push_back(ChunkBounds.back() + NChunks);
+		}
+	}
+	return true;
+}
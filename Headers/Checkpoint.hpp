@@ -0,0 +1,349 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <type_traits>
+
+#include "MexMem.hpp"
+#include "GenericMexIO.hpp"
+#include "MemoryMappedFile.hpp"
+#include "FlatVectTree/FlatVectTree.hpp"
+
+/*
+   Checkpoint file format, version 1
+
+   Offset  Size          Contents
+   0       64            CheckpointHeader
+   64      64*NObjects   CheckpointObjectEntry of each registered object
+   ...     32*NArrays    CheckpointArrayEntry of each array of the objects
+                         (in the order of the objects)
+   ...                   The arrays, each at its Offset (64 byte aligned)
+                         followed by unused capacity
+
+   Every array keeps a region of Capacity bytes so that it can grow a
+   little without moving the others (a checkpoint in which an array
+   outgrows its region lays the file out afresh). Hash is the hash of the
+   hashes of the ChunkSize byte chunks of an array (see
+   Checkpointer::hashBytes) and TableHash a hash of the object and array
+   tables, both of which are verified on restore.
+*/
+
+const char     CheckpointMagic[8] = { 'M', 'E', 'X', 'C', 'K', 'P', 'T', '\0' };
+const uint32_t CheckpointVersion  = 1;
+
+enum CheckpointObjectKind {
+	CKPT_VECTOR         = 0,
+	CKPT_MATRIX         = 1,
+	CKPT_FLAT_VECT_TREE = 2
+};
+
+struct CheckpointHeader {
+	char     Magic[8];
+	uint32_t Version;
+	uint32_t HeaderSize; // sizeof(CheckpointHeader)
+	uint32_t NObjects;
+	uint32_t NArrays;
+	uint64_t Generation; // 0 while the file is being written
+	uint64_t TableHash;
+	uint64_t FileSize;   // The end of the last array's contents
+	uint64_t ChunkSize;  // The chunk size with which the Hashes were computed
+	uint8_t  Reserved[8];
+};
+
+struct CheckpointObjectEntry {
+	char     Name[32];   // Null terminated
+	uint32_t Kind;       // CheckpointObjectKind
+	uint32_t ElemSize;
+	uint32_t IndexSize;  // sizeof the PartitionIndex elements (FlatVectTree)
+	uint32_t NArrays;    // 1, or Depth+1 for a FlatVectTree
+	uint64_t Shape[2];   // [NElems, 0], [NRows, NCols] or [Depth, 0]
+};
+
+struct CheckpointArrayEntry {
+	uint64_t Offset;
+	uint64_t NBytes;
+	uint64_t Capacity;
+	uint64_t Hash;
+};
+
+static_assert(sizeof(CheckpointHeader) == 64, "CheckpointHeader must be 64 bytes");
+static_assert(sizeof(CheckpointObjectEntry) == 64, "CheckpointObjectEntry must be 64 bytes");
+static_assert(sizeof(CheckpointArrayEntry) == 32, "CheckpointArrayEntry must be 32 bytes");
+
+struct CheckpointArray {
+	const char* Beg;
+	size_t NBytes;
+};
+
+/////////////////////////////////////////////////
+// CHECKPOINTED STATE OBJECTS ///////////////////
+/////////////////////////////////////////////////
+
+class CheckpointState {
+	/*
+	   The interface through which the Checkpointer reads and restores a
+	   registered object. describe() fills in the entry (except the Name) and
+	   the arrays holding the object's contents. restore() replaces the
+	   object with the given arrays of a checkpoint, after validating them
+	   against its type.
+	*/
+public:
+	virtual ~CheckpointState() {}
+	virtual void describe(CheckpointObjectEntry &Entry, std::vector<CheckpointArray> &Arrays) const = 0;
+	virtual void restore(const CheckpointObjectEntry &Entry, const std::vector<CheckpointArray> &Arrays) = 0;
+
+protected:
+	static inline void validateEntry(const CheckpointObjectEntry &Entry, const std::vector<CheckpointArray> &Arrays,
+	                                 uint32_t Kind, uint32_t ElemSize, uint32_t IndexSize) {
+		bool isValid = Entry.Kind == Kind && Entry.ElemSize == ElemSize && Entry.IndexSize == IndexSize
+		               && Arrays.size() == Entry.NArrays && Arrays.size() >= 1;
+		for (size_t i = 0; i + 1 < Arrays.size() && isValid; ++i)
+			isValid = Arrays[i].NBytes % IndexSize == 0;
+		isValid = isValid && Arrays.back().NBytes % ElemSize == 0;
+		if (!isValid) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+			               "The checkpointed object '%s' does not match the type of the registered object", Entry.Name);
+		}
+	}
+};
+
+template <typename T, class Al>
+class CheckpointVectorState : public CheckpointState {
+	static_assert(std::is_arithmetic<T>::value, "Only MexVectors of arithmetic types can be checkpointed");
+	MexVector<T, Al> &Vect;
+
+public:
+	inline explicit CheckpointVectorState(MexVector<T, Al> &Vect_) : Vect(Vect_) {}
+
+	inline void describe(CheckpointObjectEntry &Entry, std::vector<CheckpointArray> &Arrays) const override {
+		Entry.Kind = CKPT_VECTOR;
+		Entry.ElemSize = sizeof(T);
+		Entry.IndexSize = 0;
+		Entry.NArrays = 1;
+		Entry.Shape[0] = Vect.size();
+		Entry.Shape[1] = 0;
+		CheckpointArray DataArray = { reinterpret_cast<const char*>(Vect.begin()), Vect.size() * sizeof(T) };
+		Arrays.push_back(DataArray);
+	}
+	inline void restore(const CheckpointObjectEntry &Entry, const std::vector<CheckpointArray> &Arrays) override {
+		validateEntry(Entry, Arrays, CKPT_VECTOR, sizeof(T), 0);
+		MexVector<T, Al> NewVect(Arrays[0].NBytes / sizeof(T));
+		if (Arrays[0].NBytes > 0)
+			std::memcpy(NewVect.begin(), Arrays[0].Beg, Arrays[0].NBytes);
+		Vect.swap(NewVect);
+	}
+};
+
+template <typename T, class Al>
+class CheckpointMatrixState : public CheckpointState {
+	static_assert(std::is_arithmetic<T>::value, "Only MexMatrices of arithmetic types can be checkpointed");
+	MexMatrix<T, Al> &Matrix;
+
+public:
+	inline explicit CheckpointMatrixState(MexMatrix<T, Al> &Matrix_) : Matrix(Matrix_) {}
+
+	inline void describe(CheckpointObjectEntry &Entry, std::vector<CheckpointArray> &Arrays) const override {
+		Entry.Kind = CKPT_MATRIX;
+		Entry.ElemSize = sizeof(T);
+		Entry.IndexSize = 0;
+		Entry.NArrays = 1;
+		Entry.Shape[0] = Matrix.nrows();
+		Entry.Shape[1] = Matrix.ncols();
+		CheckpointArray DataArray = { reinterpret_cast<const char*>(Matrix.begin()), Matrix.nrows() * Matrix.ncols() * sizeof(T) };
+		Arrays.push_back(DataArray);
+	}
+	inline void restore(const CheckpointObjectEntry &Entry, const std::vector<CheckpointArray> &Arrays) override {
+		validateEntry(Entry, Arrays, CKPT_MATRIX, sizeof(T), 0);
+		if (Entry.Shape[0] * Entry.Shape[1] * sizeof(T) != Arrays[0].NBytes) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The shape of the checkpointed matrix '%s' does not match its size", Entry.Name);
+		}
+		MexMatrix<T, Al> NewMatrix(size_t(Entry.Shape[0]), size_t(Entry.Shape[1]));
+		if (Arrays[0].NBytes > 0)
+			std::memcpy(NewMatrix.begin(), Arrays[0].Beg, Arrays[0].NBytes);
+		Matrix.swap(NewMatrix);
+	}
+};
+
+template <typename T, class Al, typename IndexT>
+class CheckpointFVTState : public CheckpointState {
+	FlatVectTree<T, Al, IndexT> &Tree;
+
+public:
+	inline explicit CheckpointFVTState(FlatVectTree<T, Al, IndexT> &Tree_) : Tree(Tree_) {}
+
+	inline void describe(CheckpointObjectEntry &Entry, std::vector<CheckpointArray> &Arrays) const override {
+		uint32_t Depth = Tree.depth();
+		Entry.Kind = CKPT_FLAT_VECT_TREE;
+		Entry.ElemSize = sizeof(T);
+		Entry.IndexSize = sizeof(IndexT);
+		Entry.NArrays = Depth + 1;
+		Entry.Shape[0] = Depth;
+		Entry.Shape[1] = 0;
+		for (uint32_t l = 0; l < Depth; ++l) {
+			MexVectorView<IndexT> Level = Tree.getPartitionIndex(l);
+			CheckpointArray LevelArray = { reinterpret_cast<const char*>(Level.begin()), Level.size() * sizeof(IndexT) };
+			Arrays.push_back(LevelArray);
+		}
+		MexVectorView<T> Data = Tree.getData();
+		CheckpointArray DataArray = { reinterpret_cast<const char*>(Data.begin()), Data.size() * sizeof(T) };
+		Arrays.push_back(DataArray);
+	}
+	inline void restore(const CheckpointObjectEntry &Entry, const std::vector<CheckpointArray> &Arrays) override {
+		validateEntry(Entry, Arrays, CKPT_FLAT_VECT_TREE, sizeof(T), sizeof(IndexT));
+		uint32_t Depth = Entry.NArrays - 1;
+		MexVector<MexVector<IndexT, Al>, Al> NewPartitionIndex(Depth);
+		for (uint32_t l = 0; l < Depth; ++l) {
+			MexVector<IndexT, Al> NewLevel(Arrays[l].NBytes / sizeof(IndexT));
+			if (Arrays[l].NBytes > 0)
+				std::memcpy(NewLevel.begin(), Arrays[l].Beg, Arrays[l].NBytes);
+			NewPartitionIndex[l].swap(NewLevel);
+		}
+		MexVector<T, Al> NewData(Arrays[Depth].NBytes / sizeof(T));
+		if (Arrays[Depth].NBytes > 0)
+			std::memcpy(NewData.begin(), Arrays[Depth].Beg, Arrays[Depth].NBytes);
+
+		// Validates the tree (FV_INVALID_APPEND if invalid)
+		Tree.assign(std::move(NewPartitionIndex), std::move(NewData));
+	}
+};
+
+/////////////////////////////////////////////////
+// CHECKPOINTER              ////////////////////
+/////////////////////////////////////////////////
+
+class Checkpointer {
+	/*
+	   Checkpointer periodically snapshots a set of registered MexVector,
+	   MexMatrix and FlatVectTree objects (the state of a long running
+	   computation) to disk, and restores them on restart. Typical use:
+
+	       Checkpointer Ckpt("/scratch/Sim", 600);  // every 10 minutes
+	       Ckpt.registerState("Weights", Weights);
+	       Ckpt.registerState("Iter", IterVect);    // e.g. a 1 element MexVector
+	       Ckpt.restore();                          // false on a fresh start
+
+	       EnableInterruptHandling();
+	       for (...) {
+	           ... // one iteration, modifying the registered objects
+	           if (Ckpt.update())
+	               break;  // Ctrl-C: final checkpoint written, return the
+	                       // partial results
+	       }
+	       Ckpt.checkpoint();
+	       Ckpt.wait();
+
+	   A checkpoint is taken only when called (checkpoint() / update()) so
+	   that the state is consistent, e.g. at the end of an iteration. The
+	   contents are split into chunks of ChunkSize bytes. The call hashes the
+	   chunks (in parallel), copies the ones that changed since they were last
+	   written into a staging buffer and returns; the computation may then
+	   continue while a background thread writes the staged chunks. Only the
+	   changed chunks are thus copied and written.
+
+	   The checkpoints alternate between the two files BasePath.ckpt0 and
+	   BasePath.ckpt1, each of which is invalidated while being written and
+	   committed (fsync'd header and tables) at the end. A crash or kill at
+	   any point therefore leaves at least the previous checkpoint intact, and
+	   restore() picks the latest valid one. Write errors are reported by the
+	   next checkpoint() / wait() call on the calling thread.
+
+	   The registered objects must outlive the Checkpointer, and must not be
+	   modified during checkpoint() / update() / restore() (they may be
+	   while the background write proceeds). The Checkpointer must only be
+	   used from one thread.
+	*/
+
+	struct SlotState {
+		std::string FilePath;
+		// The layout of the file and the hashes of the chunks it holds (empty
+		// if the contents of the file are unknown)
+		std::vector<CheckpointArrayEntry> Layout;
+		std::vector<std::vector<uint64_t> > ChunkHashes;
+	};
+
+	struct ChunkWrite {
+		uint64_t FileOffset;
+		size_t BufferOffset;
+		size_t NBytes;
+	};
+
+	struct WriteJob {
+		std::string FilePath;
+		std::vector<char> Tables;  // Header and tables
+		std::vector<char> Buffer;  // Staged chunks
+		std::vector<ChunkWrite> Chunks;
+		uint64_t FileSize;
+	};
+
+	std::vector<std::string> Names;
+	std::vector<std::unique_ptr<CheckpointState> > States;
+	SlotState Slots[2];
+	uint64_t Generation;
+	size_t ChunkSize;
+	double IntervalSeconds;
+	std::chrono::steady_clock::time_point LastCheckpointTime;
+
+	// The pending background write (at most one at a time)
+	std::thread Writer;
+	WriteJob PendingJob;
+	std::string WriteError;
+	uint64_t LastWrittenBytes;
+
+	Checkpointer(const Checkpointer &) = delete;
+	Checkpointer & operator = (const Checkpointer &) = delete;
+
+	void registerStateObject(const std::string &Name, CheckpointState* State);
+	static void writeCheckpointFile(const WriteJob &Job, std::string &Error);
+	bool validateSlot(uint32_t SlotIndex, MemoryMappedFile &File, std::vector<uint64_t> &ChunkHashes);
+
+public:
+	explicit Checkpointer(const std::string &BasePath, double IntervalSeconds_ = 600.0, size_t ChunkSize_ = size_t(1) << 20);
+	~Checkpointer();
+
+	// Registration (before restore / the first checkpoint). Names must be
+	// unique and shorter than 32 characters.
+	template <typename T, class Al>
+	inline void registerState(const std::string &Name, MexVector<T, Al> &Vect) {
+		registerStateObject(Name, new CheckpointVectorState<T, Al>(Vect));
+	}
+	template <typename T, class Al>
+	inline void registerState(const std::string &Name, MexMatrix<T, Al> &Matrix) {
+		registerStateObject(Name, new CheckpointMatrixState<T, Al>(Matrix));
+	}
+	template <typename T, class Al, typename IndexT>
+	inline void registerState(const std::string &Name, FlatVectTree<T, Al, IndexT> &Tree) {
+		registerStateObject(Name, new CheckpointFVTState<T, Al, IndexT>(Tree));
+	}
+
+	// Restores the registered objects from the latest valid checkpoint.
+	// Returns false (leaving them unchanged) if there is none.
+	bool restore();
+
+	// Stages a checkpoint of the current state and writes it in the
+	// background (after waiting for the previous one)
+	void checkpoint();
+
+	// To be called at consistent points of the computation. If the program
+	// was interrupted (IsProgramInterrupted) writes a final checkpoint,
+	// waits for it and returns true. Otherwise starts a checkpoint if
+	// IntervalSeconds have elapsed since the last one and returns false.
+	bool update();
+
+	// Waits for the pending background write
+	void wait();
+
+	// Property Access
+	inline uint64_t generation() const       { return Generation; }
+	inline uint64_t lastWrittenBytes() const { return LastWrittenBytes; }
+	inline size_t   chunkSize() const        { return ChunkSize; }
+
+	static uint64_t hashBytes(const char* Beg, size_t NBytes);
+};
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef CSR_GRAPH_VIEW_HPP
+#define CSR_GRAPH_VIEW_HPP
+
+#include <stdint.h>
+#include <cmath>
+#include <limits>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+#include "FlatVectTree.hpp"
+
+struct CSRDegreeStats {
+	size_t MinDegree;
+	size_t MaxDegree;
+	double MeanDegree;
+	double StdDegree;
+	size_t NIsolated;   // Number of vertices with degree 0
+};
+
+template <typename VertexT = uint32_t, typename IndexT = uint32_t>
+class CSRGraphView {
+	/*
+	   CSRGraphView views a depth 1 FlatVectTree as the adjacency of a directed
+	   graph in CSR form: vertex i has the out-edges i -> Tree.Data[j] for j in
+	   [PartitionIndex[0][i], PartitionIndex[0][i+1]). The vertex indices in
+	   Data are 0-start. Edge weights (when required) are given as a separate
+	   vector of the size of Data.
+
+	   The view does not copy the tree, which must outlive it. The column
+	   indices are validated (in parallel) on construction so that none of the
+	   kernels need to check them.
+
+	   All the kernels run on getParallelNumThreads() threads. The work is
+	   split by the number of edges (see ParallelForSegments), and the
+	   results do not depend on the number of threads.
+	*/
+
+	static_assert(std::is_integral<VertexT>::value, "The vertex indices of a CSRGraphView must be of integral type");
+
+	MexVectorView<IndexT> RowPtr;
+	MexVectorView<VertexT> ColInds;
+	size_t NCols;
+
+	// (the negativity check is only compiled for a signed VertexT, as it is
+	// always false otherwise and would trigger -Wtype-limits)
+	static inline bool isNegativeVertex(VertexT Vertex, std::true_type) {
+		return Vertex < 0;
+	}
+	static inline bool isNegativeVertex(VertexT, std::false_type) {
+		return false;
+	}
+
+	template <typename W, class AlW>
+	inline void validateWeights(const MexVector<W, AlW> &Weights) const {
+		if (Weights.size() != ColInds.size()) {
+			WriteException(
+				ExOps::EXCEPTION_INVALID_INPUT,
+				"The number of weights (%llu) must equal the number of edges (%llu)",
+				(unsigned long long)Weights.size(), (unsigned long long)ColInds.size()
+			);
+		}
+	}
+
+public:
+	static const uint32_t Unreached = uint32_t(-1);
+
+	template <class Al>
+	inline explicit CSRGraphView(const FlatVectTree<VertexT, Al, IndexT> &Tree, size_t NCols_ = size_t(-1)) {
+		/*
+		   NCols_ is the number of target vertices (by default the number of
+		   rows i.e. a square adjacency). The transpose has NCols_ rows.
+		*/
+		if (Tree.depth() != 1) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "A CSRGraphView requires a FlatVectTree of depth 1 (given depth %d)", Tree.depth());
+		}
+		RowPtr = Tree.getPartitionIndex(0);
+		ColInds = Tree.getData();
+		NCols = (NCols_ == size_t(-1)) ? RowPtr.size() - 1 : NCols_;
+
+		std::atomic<bool> isOutofRange(false);
+		ParallelFor(0, ColInds.size(), 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			bool isChunkOutofRange = false;
+			for (size_t j = ChunkBeg; j < ChunkEnd; ++j)
+				isChunkOutofRange |= isNegativeVertex(ColInds[j], std::is_signed<VertexT>()) || size_t(ColInds[j]) >= NCols;
+			if (isChunkOutofRange)
+				isOutofRange = true;
+		});
+		if (isOutofRange) {
+			WriteException(
+				ExOps::EXCEPTION_INVALID_INPUT,
+				"The vertex indices of the graph must lie in [0, %llu)",
+				(unsigned long long)NCols
+			);
+		}
+	}
+
+	// Property Access Functions
+	inline size_t nVertices() const {
+		return RowPtr.size() - 1;
+	}
+	inline size_t nCols() const {
+		return NCols;
+	}
+	inline size_t nEdges() const {
+		return ColInds.size();
+	}
+	inline size_t degree(size_t Vertex) const {
+		return RowPtr[Vertex + 1] - RowPtr[Vertex];
+	}
+	inline MexVectorView<VertexT> neighbors(size_t Vertex) const {
+		return MexVectorView<VertexT>(degree(Vertex), ColInds.begin() + RowPtr[Vertex]);
+	}
+
+	/////// DEGREES ///////
+
+	template <class Al>
+	inline void outDegrees(MexVector<IndexT, Al> &DegreesOut) const {
+		MexVector<IndexT, Al> Degrees(nVertices());
+		ParallelFor(0, nVertices(), 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			for (size_t i = ChunkBeg; i < ChunkEnd; ++i)
+				Degrees[i] = IndexT(RowPtr[i + 1] - RowPtr[i]);
+		});
+		DegreesOut.swap(Degrees);
+	}
+
+	inline CSRDegreeStats degreeStats() const {
+		// Statistics of the out-degrees (the in-degrees are those of transpose)
+		size_t NVertices = nVertices();
+		size_t NChunks = getParallelNumChunks(NVertices, 1 << 16);
+		std::vector<CSRDegreeStats> ChunkStats(NChunks);
+		ParallelForChunks(NChunks, [&](size_t ChunkIndex) {
+			size_t ChunkBeg = (NVertices * ChunkIndex) / NChunks;
+			size_t ChunkEnd = (NVertices * (ChunkIndex + 1)) / NChunks;
+			CSRDegreeStats CurrStats = {std::numeric_limits<size_t>::max(), 0, 0.0, 0.0, 0};
+			for (size_t i = ChunkBeg; i < ChunkEnd; ++i) {
+				size_t CurrDegree = RowPtr[i + 1] - RowPtr[i];
+				CurrStats.MinDegree = std::min(CurrStats.MinDegree, CurrDegree);
+				CurrStats.MaxDegree = std::max(CurrStats.MaxDegree, CurrDegree);
+				CurrStats.StdDegree += double(CurrDegree) * double(CurrDegree);  // (sum of squares)
+				CurrStats.NIsolated += (CurrDegree == 0);
+			}
+			ChunkStats[ChunkIndex] = CurrStats;
+		});
+
+		CSRDegreeStats Stats = {(NVertices > 0) ? std::numeric_limits<size_t>::max() : 0, 0, 0.0, 0.0, 0};
+		double SumSquares = 0.0;
+		for (auto &CurrStats : ChunkStats) {
+			Stats.MinDegree = std::min(Stats.MinDegree, CurrStats.MinDegree);
+			Stats.MaxDegree = std::max(Stats.MaxDegree, CurrStats.MaxDegree);
+			Stats.NIsolated += CurrStats.NIsolated;
+			SumSquares += CurrStats.StdDegree;
+		}
+		if (NVertices > 0) {
+			Stats.MeanDegree = double(nEdges()) / double(NVertices);
+			double Variance = SumSquares / double(NVertices) - Stats.MeanDegree * Stats.MeanDegree;
+			Stats.StdDegree = std::sqrt(std::max(Variance, 0.0));
+		}
+		return Stats;
+	}
+
+	/////// TRANSPOSE ///////
+
+	template <class Al, typename W, class AlW, class AlWOut>
+	inline void transpose(FlatVectTree<VertexT, Al, IndexT> &TransposeOut, const MexVector<W, AlW> *Weights, MexVector<W, AlWOut> *WeightsOut) const {
+		/*
+		   Assigns to TransposeOut the reverse graph (nCols() rows), and if
+		   Weights is not NULL, to *WeightsOut the weights permuted to the
+		   edges of the transpose. This is a parallel counting sort of the
+		   edges by target: each chunk of rows counts its targets, the
+		   per-(target, chunk) offsets are scanned, and each chunk scatters
+		   its edges. The sources within every row of the transpose are in
+		   ascending order (as in a serial counting sort).
+		*/
+		if (Weights != NULL)
+			validateWeights(*Weights);
+
+		size_t NRows = nVertices();
+		// (the chunks are limited so that ChunkCounts is no larger than the
+		// graph itself)
+		size_t NChunks = getParallelNumChunks(nEdges() + NRows, 1 << 16);
+		NChunks = std::min(NChunks, 1 + nEdges() / std::max<size_t>(NCols, 1));
+		auto getChunkRowBeg = [&](size_t ChunkIndex) { return (NRows * ChunkIndex) / NChunks; };
+
+		// ChunkCounts[c*NCols + t] is the number of edges to t from chunk c
+		MexVector<size_t, CAllocator> ChunkCounts(NChunks * NCols, size_t(0));
+		ParallelForChunks(NChunks, [&](size_t ChunkIndex) {
+			size_t* CurrCounts = ChunkCounts.begin() + ChunkIndex * NCols;
+			for (size_t j = RowPtr[getChunkRowBeg(ChunkIndex)]; j < RowPtr[getChunkRowBeg(ChunkIndex + 1)]; ++j)
+				++CurrCounts[size_t(ColInds[j])];
+		});
+
+		// Offsets in target-major order, in parallel over targets
+		MexVector<size_t, CAllocator> TargetCounts(NCols);
+		ParallelFor(0, NCols, 1 << 14, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			for (size_t t = ChunkBeg; t < ChunkEnd; ++t) {
+				size_t CurrCount = 0;
+				for (size_t c = 0; c < NChunks; ++c)
+					CurrCount += ChunkCounts[c * NCols + t];
+				TargetCounts[t] = CurrCount;
+			}
+		});
+		MexVector<IndexT, Al> TRowPtr(NCols + 1);
+		size_t NEdges = ParallelExclusiveScan(TargetCounts.begin(), NCols, TRowPtr.begin(), IndexT(0), 1 << 16);
+		TRowPtr[NCols] = IndexT(NEdges);
+		ParallelFor(0, NCols, 1 << 14, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			for (size_t t = ChunkBeg; t < ChunkEnd; ++t) {
+				size_t CurrOffset = TRowPtr[t];
+				for (size_t c = 0; c < NChunks; ++c) {
+					size_t CurrCount = ChunkCounts[c * NCols + t];
+					ChunkCounts[c * NCols + t] = CurrOffset;
+					CurrOffset += CurrCount;
+				}
+			}
+		});
+
+		// Scattering
+		MexVector<VertexT, Al> TColInds(NEdges);
+		MexVector<W, AlWOut> TWeights((Weights != NULL) ? NEdges : 0);
+		ParallelForChunks(NChunks, [&](size_t ChunkIndex) {
+			size_t* CurrOffsets = ChunkCounts.begin() + ChunkIndex * NCols;
+			for (size_t i = getChunkRowBeg(ChunkIndex); i < getChunkRowBeg(ChunkIndex + 1); ++i) {
+				for (size_t j = RowPtr[i]; j < RowPtr[i + 1]; ++j) {
+					size_t Pos = CurrOffsets[size_t(ColInds[j])]++;
+					TColInds[Pos] = VertexT(i);
+					if (Weights != NULL)
+						TWeights[Pos] = (*Weights)[j];
+				}
+			}
+		});
+
+		MexVector<MexVector<IndexT, Al>, Al> TPartitionIndex(1);
+		TPartitionIndex[0].swap(TRowPtr);
+		TransposeOut.assign(std::move(TPartitionIndex), std::move(TColInds), true);
+		if (WeightsOut != NULL)
+			WeightsOut->swap(TWeights);
+	}
+	template <class Al>
+	inline void transpose(FlatVectTree<VertexT, Al, IndexT> &TransposeOut) const {
+		transpose(TransposeOut, (const MexVector<float, CAllocator>*)NULL, (MexVector<float, CAllocator>*)NULL);
+	}
+
+	/////// SPMV ///////
+
+	template <typename W, class AlW, typename X, class AlX, typename Y, class AlY>
+	inline void spmv(const MexVector<W, AlW> &Weights, const MexVector<X, AlX> &XIn, MexVector<Y, AlY> &YOut) const {
+		/*
+		   YOut[i] = sum over the edges i -> t of Weights[edge] * XIn[t]
+		   (YOut = A*XIn where A is the weighted adjacency). Each row is summed
+		   by one thread in edge order.
+		*/
+		validateWeights(Weights);
+		if (XIn.size() != NCols) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The size of the input vector (%llu) must equal nCols() (%llu)",
+			               (unsigned long long)XIn.size(), (unsigned long long)NCols);
+		}
+		MexVector<Y, AlY> YNew(nVertices());
+		ParallelForSegments(RowPtr.begin(), nVertices(), 1 << 14, [&](size_t SegBeg, size_t SegEnd) {
+			for (size_t i = SegBeg; i < SegEnd; ++i) {
+				Y RowSum = Y(0);
+				for (size_t j = RowPtr[i]; j < RowPtr[i + 1]; ++j)
+					RowSum += Y(Weights[j]) * Y(XIn[size_t(ColInds[j])]);
+				YNew[i] = RowSum;
+			}
+		});
+		YOut.swap(YNew);
+	}
+	template <typename X, class AlX, typename Y, class AlY>
+	inline void spmv(const MexVector<X, AlX> &XIn, MexVector<Y, AlY> &YOut) const {
+		// Unweighted version (all weights 1)
+		if (XIn.size() != NCols) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The size of the input vector (%llu) must equal nCols() (%llu)",
+			               (unsigned long long)XIn.size(), (unsigned long long)NCols);
+		}
+		MexVector<Y, AlY> YNew(nVertices());
+		ParallelForSegments(RowPtr.begin(), nVertices(), 1 << 14, [&](size_t SegBeg, size_t SegEnd) {
+			for (size_t i = SegBeg; i < SegEnd; ++i) {
+				Y RowSum = Y(0);
+				for (size_t j = RowPtr[i]; j < RowPtr[i + 1]; ++j)
+					RowSum += Y(XIn[size_t(ColInds[j])]);
+				YNew[i] = RowSum;
+			}
+		});
+		YOut.swap(YNew);
+	}
+
+	/////// BFS ///////
+
+	template <class Al>
+	inline void bfs(size_t Source, MexVector<uint32_t, Al> &DistOut) const {
+		/*
+		   DistOut[v] is the number of edges on the shortest path Source -> v
+		   (Unreached if there is none). The graph must be square.
+
+		   Frontier-based: every level, the frontier is split into chunks of
+		   roughly equal total degree, each thread claims the unvisited
+		   targets of its chunk (atomically, so each vertex is claimed once)
+		   into a local buffer, and the buffers are concatenated into the
+		   next frontier. The order within a frontier may vary between runs,
+		   the distances do not.
+		*/
+		size_t NVertices = nVertices();
+		if (NCols != NVertices || Source >= NVertices) {
+			WriteException(
+				ExOps::EXCEPTION_INVALID_INPUT,
+				"BFS requires a square graph and a source vertex in [0, %llu)",
+				(unsigned long long)NVertices
+			);
+		}
+
+		std::vector<std::atomic<uint32_t> > Dist(NVertices);
+		ParallelFor(0, NVertices, 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			for (size_t i = ChunkBeg; i < ChunkEnd; ++i)
+				Dist[i].store(Unreached, std::memory_order_relaxed);
+		});
+		Dist[Source].store(0, std::memory_order_relaxed);
+
+		MexVector<VertexT, CAllocator> Frontier(1, VertexT(Source)), NextFrontier(NVertices);
+		MexVector<size_t, CAllocator> FrontierBounds;
+		for (uint32_t CurrDist = 1; Frontier.size() > 0; ++CurrDist) {
+			// Edge-count bounds of the frontier vertices (for balancing)
+			size_t NFrontier = Frontier.size();
+			FrontierBounds.resize(NFrontier + 1);
+			ParallelFor(0, NFrontier, 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+				for (size_t k = ChunkBeg; k < ChunkEnd; ++k)
+					FrontierBounds[k] = degree(size_t(Frontier[k]));
+			});
+			FrontierBounds[NFrontier] = ParallelExclusiveScan(FrontierBounds.begin(), NFrontier, FrontierBounds.begin(), size_t(0), 1 << 16);
+
+			std::atomic<size_t> NextSize(0);
+			ParallelForSegments(FrontierBounds.begin(), NFrontier, 1 << 12, [&](size_t SegBeg, size_t SegEnd) {
+				MexVector<VertexT, CAllocator> Claimed;
+				for (size_t k = SegBeg; k < SegEnd; ++k) {
+					size_t CurrVertex = size_t(Frontier[k]);
+					for (size_t j = RowPtr[CurrVertex]; j < RowPtr[CurrVertex + 1]; ++j) {
+						size_t Target = size_t(ColInds[j]);
+						uint32_t Expected = Unreached;
+						if (Dist[Target].load(std::memory_order_relaxed) == Unreached
+						    && Dist[Target].compare_exchange_strong(Expected, CurrDist, std::memory_order_relaxed))
+							Claimed.push_back(VertexT(Target));
+					}
+				}
+				size_t ClaimedBeg = NextSize.fetch_add(Claimed.size());
+				std::copy(Claimed.begin(), Claimed.end(), NextFrontier.begin() + ClaimedBeg);
+			});
+
+			Frontier.resize(NextSize.load());
+			std::copy(NextFrontier.begin(), NextFrontier.begin() + Frontier.size(), Frontier.begin());
+		}
+
+		MexVector<uint32_t, Al> DistVect(NVertices);
+		ParallelFor(0, NVertices, 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			for (size_t i = ChunkBeg; i < ChunkEnd; ++i)
+				DistVect[i] = Dist[i].load(std::memory_order_relaxed);
+		});
+		DistOut.swap(DistVect);
+	}
+};
+
+template <typename VertexT, typename IndexT>
+const uint32_t CSRGraphView<VertexT, IndexT>::Unreached;
+
+#endif
@@ -0,0 +1,485 @@
+#ifndef COMPRESSED_FLAT_VECT_TREE_HPP
+#define COMPRESSED_FLAT_VECT_TREE_HPP
+
+#include <stdint.h>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
+
+#include "FlatVectTree.hpp"
+
+template <typename T, class Al = mxAllocator>
+class CompressedFVTArray {
+	/*
+	   CompressedFVTArray stores an array of T in blocks of BlockSize
+	   elements. Within a block, the differences between consecutive elements
+	   are bit-packed using the least bit width that fits all of them (i.e.
+	   frame-of-reference coding of the deltas). Monotone blocks (e.g. the
+	   levels of a PartitionIndex or the Data of sorted leaves) store the
+	   differences as they are, other blocks store them zigzag encoded so
+	   that small negative differences remain small.
+
+	   The first element of each block and the offset of its packed bytes are
+	   stored uncompressed (the skip pointers). Thus every block is decoded
+	   independently, element / range access decode only the blocks involved
+	   and the conversions to and from the plain form are parallel over
+	   blocks. Floating point elements are encoded through their bit pattern,
+	   which is monotone for sorted non-negative values.
+	*/
+
+	static_assert(std::is_arithmetic<T>::value, "CompressedFVTArray can only hold arithmetic types");
+
+public:
+	static const size_t BlockSize = 128;
+	static_assert(BlockSize % 8 == 0, "The BlockSize of CompressedFVTArray must be a multiple of 8");
+
+private:
+	typedef typename FVTCodeWord<sizeof(T)>::type WordT;
+	static const uint8_t ZigZagFlag = 0x80;
+	static const size_t MinBlocksPerChunk = 64;
+	static const size_t PackedPadding = 8*sizeof(WordT) + 8; // Zero bytes after the last block (see unpackBits)
+
+	size_t NElems;
+	MexVector<WordT, Al>    BlockFirst;   // First element of each block
+	MexVector<uint8_t, Al>  BlockBits;    // Bit width of the block's differences (| ZigZagFlag)
+	MexVector<uint64_t, Al> BlockOffsets; // Offset of each block in Packed (NBlocks + 1 entries)
+	MexVector<uint8_t, Al>  Packed;
+
+	static inline WordT toWord(T Val) {
+		WordT Word;
+		std::memcpy(&Word, &Val, sizeof(T));
+		return Word;
+	}
+	static inline T fromWord(WordT Word) {
+		T Val;
+		std::memcpy(&Val, &Word, sizeof(T));
+		return Val;
+	}
+	static inline size_t getPackedSize(size_t NValues, uint32_t Bits) {
+		return (NValues * Bits + 7) / 8;
+	}
+
+	static inline uint8_t getBlockDiffs(const T* BlockIn, size_t NBlockElems, WordT* DiffsOut);
+	static inline void packBits(const WordT* ValsIn, size_t NVals, uint32_t Bits, uint8_t* BytesOut);
+	static inline uint64_t loadWord64(const uint8_t* BytesIn);
+	template <uint32_t Bits, uint32_t ValIndex>
+	static inline void unpackGroup(const uint8_t* BytesIn, WordT* ValsOut, std::integral_constant<uint32_t, ValIndex>);
+	template <uint32_t Bits>
+	static inline void unpackGroup(const uint8_t*, WordT*, std::integral_constant<uint32_t, 8>) {}
+	template <uint32_t Bits>
+	static inline void unpackBitsFixed(const uint8_t* BytesIn, size_t NVals, WordT* ValsOut);
+	static inline void unpackBits(const uint8_t* BytesIn, size_t NVals, uint32_t Bits, WordT* ValsOut);
+
+	typedef void (*UnpackKernel)(const uint8_t*, size_t, WordT*);
+	struct UnpackKernelTable {
+		// Kernels[Bits] is unpackBitsFixed<Bits> for Bits in [0, 8*sizeof(WordT)]
+		UnpackKernel Kernels[8*sizeof(WordT) + 1];
+		inline UnpackKernelTable() {
+			fillKernels(std::integral_constant<uint32_t, 8*sizeof(WordT)>());
+		}
+		template <uint32_t Bits>
+		inline void fillKernels(std::integral_constant<uint32_t, Bits>) {
+			Kernels[Bits] = &unpackBitsFixed<Bits>;
+			fillKernels(std::integral_constant<uint32_t, Bits - 1>());
+		}
+		inline void fillKernels(std::integral_constant<uint32_t, 0>) {
+			Kernels[0] = &unpackBitsFixed<0>;
+		}
+	};
+
+	inline void decodeBlock(size_t BlockIndex, size_t NDecode, T* Out) const;
+
+public:
+	inline CompressedFVTArray() : NElems(0), BlockFirst(), BlockBits(), BlockOffsets(1, uint64_t(0)), Packed() {}
+
+	// Conversion from / to the plain form
+	inline void compress(const T* ArrayIn, size_t NElemsIn);
+	template <class AlIn>
+	inline void compress(const MexVector<T, AlIn> &ArrayIn) {
+		compress(ArrayIn.begin(), ArrayIn.size());
+	}
+	inline void decompress(T* ArrayOut) const;
+	template <class AlOut>
+	inline void decompress(MexVector<T, AlOut> &ArrayOut) const {
+		MexVector<T, AlOut> Decompressed(NElems);
+		decompress(Decompressed.begin());
+		ArrayOut.swap(Decompressed);
+	}
+
+	// Random Access (decodes only the blocks overlapping [Beg, End))
+	inline void decompressRange(size_t Beg, size_t End, T* ArrayOut) const;
+	inline T operator[] (size_t Index) const {
+		T Val;
+		decompressRange(Index, Index + 1, &Val);
+		return Val;
+	}
+
+	// Property Access
+	inline size_t size() const    { return NElems; }
+	inline bool   isempty() const { return NElems == 0; }
+	inline size_t memSize() const {
+		// Number of bytes used by the compressed representation
+		return BlockFirst.size()*sizeof(WordT) + BlockBits.size() + BlockOffsets.size()*sizeof(uint64_t) + Packed.size();
+	}
+};
+
+template <typename T, class Al> const size_t  CompressedFVTArray<T, Al>::BlockSize;
+template <typename T, class Al> const uint8_t CompressedFVTArray<T, Al>::ZigZagFlag;
+template <typename T, class Al> const size_t  CompressedFVTArray<T, Al>::MinBlocksPerChunk;
+template <typename T, class Al> const size_t  CompressedFVTArray<T, Al>::PackedPadding;
+
+template <typename T, class Al>
+inline uint8_t CompressedFVTArray<T, Al>::getBlockDiffs(const T* BlockIn, size_t NBlockElems, WordT* DiffsOut) {
+	/*
+	   Writes the NBlockElems-1 differences between consecutive elements of
+	   the block into DiffsOut (zigzag encoded unless the block is monotone)
+	   and returns the bit width required to pack them (| ZigZagFlag).
+	*/
+
+	const uint32_t WordBits = 8 * sizeof(WordT);
+	bool isMonotone = true;
+	for (size_t j = 1; j < NBlockElems; ++j) {
+		WordT Prev = toWord(BlockIn[j - 1]);
+		WordT Curr = toWord(BlockIn[j]);
+		isMonotone = isMonotone && (Curr >= Prev);
+		DiffsOut[j - 1] = WordT(Curr - Prev);
+	}
+
+	WordT MaxDiff = 0;
+	if (isMonotone) {
+		for (size_t j = 0; j + 1 < NBlockElems; ++j)
+			MaxDiff = std::max(MaxDiff, DiffsOut[j]);
+	}
+	else {
+		for (size_t j = 0; j + 1 < NBlockElems; ++j) {
+			WordT Diff = DiffsOut[j];
+			DiffsOut[j] = WordT(WordT(Diff << 1) ^ WordT(WordT(0) - WordT(Diff >> (WordBits - 1))));
+			MaxDiff = std::max(MaxDiff, DiffsOut[j]);
+		}
+	}
+
+	uint8_t Bits = 0;
+	while (Bits < WordBits && (uint64_t(MaxDiff) >> Bits))
+		++Bits;
+	return isMonotone ? Bits : uint8_t(Bits | ZigZagFlag);
+}
+
+template <typename T, class Al>
+inline void CompressedFVTArray<T, Al>::packBits(const WordT* ValsIn, size_t NVals, uint32_t Bits, uint8_t* BytesOut) {
+	// Writes NVals values of Bits bits each, least significant bit first.
+	// Each value must fit in Bits bits.
+
+	uint64_t Acc = 0;
+	uint32_t NAccBits = 0; // always < 8 at the start of an iteration
+	for (size_t i = 0; i < NVals; ++i) {
+		uint64_t Val = ValsIn[i];
+		uint64_t Spill = NAccBits ? (Val >> (64 - NAccBits)) : 0; // the bits that overflow Acc
+		Acc |= Val << NAccBits;
+		NAccBits += Bits;
+		if (NAccBits >= 64) {
+			for (uint32_t k = 0; k < 8; ++k)
+				*(BytesOut++) = uint8_t(Acc >> (8 * k));
+			Acc = Spill;
+			NAccBits -= 64;
+		}
+		while (NAccBits >= 8) {
+			*(BytesOut++) = uint8_t(Acc);
+			Acc >>= 8;
+			NAccBits -= 8;
+		}
+	}
+	if (NAccBits > 0)
+		*BytesOut = uint8_t(Acc);
+}
+
+template <typename T, class Al>
+inline uint64_t CompressedFVTArray<T, Al>::loadWord64(const uint8_t* BytesIn) {
+	// Reads 8 bytes as a little endian word (the byte order of packBits),
+	// which compiles to a single load on little endian machines
+
+	return uint64_t(BytesIn[0])       | uint64_t(BytesIn[1]) << 8  | uint64_t(BytesIn[2]) << 16 | uint64_t(BytesIn[3]) << 24
+	     | uint64_t(BytesIn[4]) << 32 | uint64_t(BytesIn[5]) << 40 | uint64_t(BytesIn[6]) << 48 | uint64_t(BytesIn[7]) << 56;
+}
+
+template <typename T, class Al>
+template <uint32_t Bits, uint32_t ValIndex>
+inline void CompressedFVTArray<T, Al>::unpackGroup(const uint8_t* BytesIn, WordT* ValsOut, std::integral_constant<uint32_t, ValIndex>) {
+	// Unpacks the values ValIndex..7 of a group of 8 values of Bits bits
+	// (starting at BytesIn). The recursion unrolls the group, so that the
+	// byte offset and shift of every value are compile time constants.
+
+	const uint64_t Mask = (Bits == 64) ? ~uint64_t(0) : ((uint64_t(1) << (Bits % 64)) - 1);
+	const uint32_t ByteBeg = (ValIndex * Bits) / 8;
+	const uint32_t Shift = (ValIndex * Bits) % 8;
+
+	uint64_t Val = loadWord64(BytesIn + ByteBeg) >> Shift;
+	if (Shift + Bits > 64) {
+		// The value straddles the 64 bit word (only for Bits > 56)
+		Val |= uint64_t(BytesIn[ByteBeg + 8]) << ((64 - Shift) % 64);
+	}
+	ValsOut[ValIndex] = WordT(Val & Mask);
+
+	unpackGroup<Bits>(BytesIn, ValsOut, std::integral_constant<uint32_t, ValIndex + 1>());
+}
+
+template <typename T, class Al>
+template <uint32_t Bits>
+inline void CompressedFVTArray<T, Al>::unpackBitsFixed(const uint8_t* BytesIn, size_t NVals, WordT* ValsOut) {
+	// unpackBits for a bit width known at compile time. 8 values of Bits
+	// bits take exactly Bits bytes, so the values are unpacked a group of 8
+	// at a time, the last group being completed with whatever bits follow.
+
+	if (Bits == 0) {
+		std::fill(ValsOut, ValsOut + NVals, WordT(0));
+		return;
+	}
+	size_t NGroups = (NVals + 7) / 8;
+	for (size_t g = 0; g < NGroups; ++g)
+		unpackGroup<Bits>(BytesIn + g*Bits, ValsOut + 8*g, std::integral_constant<uint32_t, 0>());
+}
+
+template <typename T, class Al>
+inline void CompressedFVTArray<T, Al>::unpackBits(const uint8_t* BytesIn, size_t NVals, uint32_t Bits, WordT* ValsOut) {
+	/*
+	   Inverse of packBits, dispatching to the kernel unrolled for the given
+	   bit width (unpackBitsFixed<Bits>).
+
+	   The kernels work on whole groups of 8 values and read up to 8 bytes
+	   at a time. Thus ValsOut must have room for NVals rounded up to a
+	   multiple of 8, and up to PackedPadding bytes past the packed values
+	   may be read. The latter is ensured by the zero padding at the end of
+	   Packed.
+	*/
+
+	static const UnpackKernelTable KernelTable;
+	KernelTable.Kernels[Bits](BytesIn, NVals, ValsOut);
+}
+
+template <typename T, class Al>
+inline void CompressedFVTArray<T, Al>::decodeBlock(size_t BlockIndex, size_t NDecode, T* Out) const {
+	// Decodes the first NDecode elements of the given block into Out
+
+	if (NDecode == 0)
+		return;
+
+	uint8_t BitsInfo = BlockBits[BlockIndex];
+	uint32_t Bits = BitsInfo & ~ZigZagFlag;
+
+	WordT Diffs[BlockSize]; // (BlockSize is a multiple of 8, see unpackBits)
+	unpackBits(Packed.begin() + BlockOffsets[BlockIndex], NDecode - 1, Bits, Diffs);
+	if (BitsInfo & ZigZagFlag) {
+		for (size_t j = 0; j + 1 < NDecode; ++j)
+			Diffs[j] = WordT((Diffs[j] >> 1) ^ WordT(WordT(0) - WordT(Diffs[j] & 1)));
+	}
+
+	WordT Curr = BlockFirst[BlockIndex];
+	Out[0] = fromWord(Curr);
+	for (size_t j = 0; j + 1 < NDecode; ++j) {
+		Curr = WordT(Curr + Diffs[j]);
+		Out[j + 1] = fromWord(Curr);
+	}
+}
+
+template <typename T, class Al>
+inline void CompressedFVTArray<T, Al>::compress(const T* ArrayIn, size_t NElemsIn) {
+
+	size_t NBlocks = (NElemsIn + BlockSize - 1) / BlockSize;
+	MexVector<WordT, Al>    NewBlockFirst(NBlocks);
+	MexVector<uint8_t, Al>  NewBlockBits(NBlocks);
+	MexVector<uint64_t, Al> NewBlockOffsets(NBlocks + 1);
+
+	// Finding the bit width, and thereby the packed size, of each block
+	ParallelFor(0, NBlocks, MinBlocksPerChunk, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		WordT Diffs[BlockSize];
+		for (size_t b = ChunkBeg; b < ChunkEnd; ++b) {
+			const T* BlockIn = ArrayIn + b*BlockSize;
+			size_t NBlockElems = std::min(BlockSize, NElemsIn - b*BlockSize);
+			NewBlockFirst[b] = toWord(BlockIn[0]);
+			NewBlockBits[b] = getBlockDiffs(BlockIn, NBlockElems, Diffs);
+			NewBlockOffsets[b] = getPackedSize(NBlockElems - 1, NewBlockBits[b] & ~ZigZagFlag);
+		}
+	});
+	uint64_t NPackedBytes = ParallelExclusiveScan(NewBlockOffsets.begin(), NBlocks, NewBlockOffsets.begin(), uint64_t(0), MinBlocksPerChunk);
+	NewBlockOffsets[NBlocks] = NPackedBytes;
+
+	// Packing the blocks (the differences are recomputed rather than stored)
+	MexVector<uint8_t, Al> NewPacked(NPackedBytes + PackedPadding);
+	std::fill(NewPacked.begin() + NPackedBytes, NewPacked.end(), uint8_t(0));
+	ParallelFor(0, NBlocks, MinBlocksPerChunk, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		WordT Diffs[BlockSize];
+		for (size_t b = ChunkBeg; b < ChunkEnd; ++b) {
+			const T* BlockIn = ArrayIn + b*BlockSize;
+			size_t NBlockElems = std::min(BlockSize, NElemsIn - b*BlockSize);
+			uint8_t BitsInfo = getBlockDiffs(BlockIn, NBlockElems, Diffs);
+			packBits(Diffs, NBlockElems - 1, BitsInfo & ~ZigZagFlag, NewPacked.begin() + NewBlockOffsets[b]);
+		}
+	});
+
+	NElems = NElemsIn;
+	BlockFirst.swap(NewBlockFirst);
+	BlockBits.swap(NewBlockBits);
+	BlockOffsets.swap(NewBlockOffsets);
+	Packed.swap(NewPacked);
+}
+
+template <typename T, class Al>
+inline void CompressedFVTArray<T, Al>::decompress(T* ArrayOut) const {
+	size_t NBlocks = BlockFirst.size();
+	ParallelFor(0, NBlocks, MinBlocksPerChunk, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t b = ChunkBeg; b < ChunkEnd; ++b)
+			decodeBlock(b, std::min(BlockSize, NElems - b*BlockSize), ArrayOut + b*BlockSize);
+	});
+}
+
+template <typename T, class Al>
+inline void CompressedFVTArray<T, Al>::decompressRange(size_t Beg, size_t End, T* ArrayOut) const {
+
+	if (Beg > End || End > NElems) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+		               "The range [%llu, %llu) is invalid for a compressed array of size %llu",
+		               (unsigned long long)Beg, (unsigned long long)End, (unsigned long long)NElems);
+	}
+
+	T BlockBuffer[BlockSize];
+	size_t CurrPos = Beg;
+	while (CurrPos < End) {
+		size_t BlockIndex = CurrPos / BlockSize;
+		size_t BlockBeg = BlockIndex*BlockSize;
+		size_t BlockEnd = std::min(BlockBeg + BlockSize, NElems);
+		size_t CopyEnd = std::min(BlockEnd, End);
+
+		if (CurrPos == BlockBeg && CopyEnd == BlockEnd) {
+			// Whole blocks are decoded directly into the output
+			decodeBlock(BlockIndex, BlockEnd - BlockBeg, ArrayOut + (CurrPos - Beg));
+		}
+		else {
+			decodeBlock(BlockIndex, CopyEnd - BlockBeg, BlockBuffer);
+			std::copy(BlockBuffer + (CurrPos - BlockBeg), BlockBuffer + (CopyEnd - BlockBeg), ArrayOut + (CurrPos - Beg));
+		}
+		CurrPos = CopyEnd;
+	}
+}
+
+template <typename T, class FVT_Al = mxAllocator, typename IndexT = uint32_t>
+class CompressedFlatVectTree {
+	/*
+	   CompressedFlatVectTree is the compressed (read-only) form of a
+	   FlatVectTree<T, FVT_Al, IndexT>. Each level of the PartitionIndex and
+	   the Data are held as CompressedFVTArray's. Since the levels are
+	   monotone, they typically compress to a few bits per entry.
+
+	   The tree is converted from / to the plain form with compress and
+	   decompress. Without decompressing, single entries and leaves can be
+	   read (getPartitionIndex, getLeaf), and all the leaves can be streamed
+	   through a function in batches (forEachLeaf).
+	*/
+
+	MexVector<CompressedFVTArray<IndexT, FVT_Al>, FVT_Al> PartitionIndex;
+	CompressedFVTArray<T, FVT_Al> Data;
+
+public:
+	typedef IndexT IndexType;
+
+	inline CompressedFlatVectTree() : PartitionIndex(), Data() {}
+	template <class Al>
+	inline explicit CompressedFlatVectTree(const FlatVectTree<T, Al, IndexT> &FlatVectTreeIn) : PartitionIndex(), Data() {
+		compress(FlatVectTreeIn);
+	}
+
+	// Conversion from / to the plain form
+	template <class Al>
+	inline void compress(const FlatVectTree<T, Al, IndexT> &FlatVectTreeIn) {
+		uint32_t TreeDepth = FlatVectTreeIn.depth();
+		MexVector<CompressedFVTArray<IndexT, FVT_Al>, FVT_Al> NewPartitionIndex(TreeDepth);
+		for (uint32_t i = 0; i < TreeDepth; ++i) {
+			auto Level = FlatVectTreeIn.getPartitionIndex(i);
+			NewPartitionIndex[i].compress(Level.begin(), Level.size());
+		}
+		auto DataIn = FlatVectTreeIn.getData();
+		Data.compress(DataIn.begin(), DataIn.size());
+		PartitionIndex.swap(NewPartitionIndex);
+	}
+	template <class Al>
+	inline void decompress(FlatVectTree<T, Al, IndexT> &FlatVectTreeOut) const {
+		uint32_t TreeDepth = this->depth();
+		MexVector<MexVector<IndexT, Al>, Al> PartitionIndexOut(TreeDepth);
+		MexVector<T, Al> DataOut;
+		for (uint32_t i = 0; i < TreeDepth; ++i)
+			PartitionIndex[i].decompress(PartitionIndexOut[i]);
+		Data.decompress(DataOut);
+
+		// The tree was valid when compressed
+		FlatVectTreeOut.assign(std::move(PartitionIndexOut), std::move(DataOut), true);
+	}
+
+	// Property Access
+	inline uint32_t depth() const {
+		return PartitionIndex.size();
+	}
+	inline IndexT LevelSize(uint32_t LevelIndex) const {
+		return PartitionIndex[LevelIndex].size() - 1;
+	}
+	inline size_t NLeaves() const {
+		return (this->depth() > 0) ? size_t(LevelSize(this->depth() - 1)) : 0;
+	}
+	inline size_t memSize() const {
+		// Number of bytes used by the compressed representation
+		size_t MemSize = Data.memSize();
+		for (auto &Level : PartitionIndex)
+			MemSize += Level.memSize();
+		return MemSize;
+	}
+
+	// Random Access
+	inline IndexT getPartitionIndex(uint32_t Level, size_t Index) const {
+		return PartitionIndex[Level][Index];
+	}
+	template <class Al>
+	inline void getLeaf(size_t LeafIndex, MexVector<T, Al> &LeafOut) const {
+		// Decodes the LeafIndex'th vector in Data (in depth-first order)
+		if (LeafIndex >= NLeaves()) {
+			WriteException(FV_ExCodes::FV_INVALID_FETCH,
+			               "The leaf index (%llu) exceeds the number of leaves (%llu)",
+			               (unsigned long long)LeafIndex, (unsigned long long)NLeaves());
+		}
+		IndexT LeafRange[2];
+		PartitionIndex[this->depth() - 1].decompressRange(LeafIndex, LeafIndex + 2, LeafRange);
+		MexVector<T, Al> Leaf(LeafRange[1] - LeafRange[0]);
+		Data.decompressRange(LeafRange[0], LeafRange[1], Leaf.begin());
+		LeafOut.swap(Leaf);
+	}
+
+	// Streaming
+	template <typename FuncT>
+	inline void forEachLeaf(const FuncT &Func, size_t LeavesPerBatch = 4096) const {
+		/*
+		   Calls Func(LeafIndex, Leaf) for every leaf in depth-first order,
+		   where Leaf is a MexVectorView<T> valid only during the call. The
+		   leaves are decoded LeavesPerBatch at a time, so that only one
+		   batch is held uncompressed.
+		*/
+
+		size_t NTotalLeaves = NLeaves();
+		LeavesPerBatch = (LeavesPerBatch > 0) ? LeavesPerBatch : 1;
+		MexVector<IndexT, CAllocator> BatchPartInds;
+		MexVector<T, CAllocator> BatchData;
+
+		for (size_t BatchBeg = 0; BatchBeg < NTotalLeaves; BatchBeg += LeavesPerBatch) {
+			size_t BatchEnd = std::min(BatchBeg + LeavesPerBatch, NTotalLeaves);
+			BatchPartInds.resize(BatchEnd - BatchBeg + 1);
+			PartitionIndex[this->depth() - 1].decompressRange(BatchBeg, BatchEnd + 1, BatchPartInds.begin());
+
+			size_t DataBeg = BatchPartInds[0];
+			BatchData.resize(BatchPartInds.last() - DataBeg);
+			Data.decompressRange(DataBeg, BatchPartInds.last(), BatchData.begin());
+
+			for (size_t i = BatchBeg; i < BatchEnd; ++i) {
+				size_t LeafBeg = BatchPartInds[i - BatchBeg] - DataBeg;
+				size_t LeafEnd = BatchPartInds[i - BatchBeg + 1] - DataBeg;
+				Func(i, MexVectorView<T>(LeafEnd - LeafBeg, BatchData.begin() + LeafBeg));
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef FVT_NODE_VIEW_HPP
+#define FVT_NODE_VIEW_HPP
+
+#include <iterator>
+#include "../MexMem.hpp"
+
+// This header is included by FlatVectTree.hpp and is not meant to be
+// included on its own.
+
+template <typename T, typename IndexT>
+class FVTLeafIterator {
+	/*
+	   Iterates over consecutive leaves (the vectors in Data) of a FlatVectTree.
+	   Since the leaves are stored in depth-first order, this only bumps a
+	   pointer into the deepest level of the PartitionIndex. Dereferencing
+	   gives the leaf as a MexVectorView into Data.
+	*/
+
+	const IndexT* CurrPartInd;
+	const T* DataBeg;
+
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef MexVectorView<T>          value_type;
+	typedef ptrdiff_t                 difference_type;
+	typedef const MexVectorView<T>*   pointer;
+	typedef MexVectorView<T>          reference;
+
+	inline FVTLeafIterator() : CurrPartInd(NULL), DataBeg(NULL) {}
+	inline FVTLeafIterator(const IndexT* CurrPartInd_, const T* DataBeg_) :
+		CurrPartInd(CurrPartInd_), DataBeg(DataBeg_) {}
+
+	inline MexVectorView<T> operator*() const {
+		return MexVectorView<T>(CurrPartInd[1] - CurrPartInd[0], DataBeg + CurrPartInd[0]);
+	}
+	inline FVTLeafIterator &operator++() {
+		++CurrPartInd;
+		return *this;
+	}
+	inline FVTLeafIterator operator++(int) {
+		FVTLeafIterator Temp = *this;
+		++CurrPartInd;
+		return Temp;
+	}
+	inline bool operator==(const FVTLeafIterator &Other) const {
+		return CurrPartInd == Other.CurrPartInd;
+	}
+	inline bool operator!=(const FVTLeafIterator &Other) const {
+		return CurrPartInd != Other.CurrPartInd;
+	}
+};
+
+template <typename T, typename IndexT>
+class FVTLeafRange {
+	// The range of leaves [Beg, End) for use in range-based for loops
+	FVTLeafIterator<T, IndexT> Beg, End;
+	size_t NLeaves;
+
+public:
+	inline FVTLeafRange() : Beg(), End(), NLeaves(0) {}
+	inline FVTLeafRange(const IndexT* PartIndBeg, size_t NLeaves_, const T* DataBeg) :
+		Beg(PartIndBeg, DataBeg), End(PartIndBeg + NLeaves_, DataBeg), NLeaves(NLeaves_) {}
+
+	inline FVTLeafIterator<T, IndexT> begin() const { return Beg; }
+	inline FVTLeafIterator<T, IndexT> end()   const { return End; }
+	inline size_t size()    const { return NLeaves; }
+	inline bool   isempty() const { return NLeaves == 0; }
+};
+
+template <typename T, class FVT_Al, typename IndexT>
+class FVTNodeView {
+	/*
+	   FVTNodeView is a non-owning, read-only view of a node of a FlatVectTree.
+	   A node is either the root (the whole tree, see FlatVectTree::root()), a
+	   cell at some level, or a leaf (a vector in Data). Its children are the
+	   entries [ChildBeg, ChildEnd) of level ChildLevel (of Data if ChildLevel
+	   is the depth of the tree, in which case the node is a leaf).
+
+	   Creating, indexing and iterating views make no allocations or copies.
+	   The views are invalidated by any modification of the tree.
+
+	     for (auto Cell : Tree[i])           // children of i'th top level cell
+	         for (auto Leaf : Cell.leaves()) // leaves below each, depth-first
+	             ...                         // Leaf is a MexVectorView<T>
+	*/
+
+	typedef FlatVectTree<T, FVT_Al, IndexT> FVTType;
+
+	const FVTType* Tree;
+	const IndexT* SelfPartInd; // Entry of the node in level ChildLevel-1 (NULL for root)
+	uint32_t ChildLevel;
+	size_t ChildBeg, ChildEnd;
+
+public:
+	class ChildIterator {
+		const FVTNodeView* Parent;
+		size_t Index;
+	public:
+		inline ChildIterator(const FVTNodeView* Parent_, size_t Index_) : Parent(Parent_), Index(Index_) {}
+		inline FVTNodeView operator*() const { return (*Parent)[Index]; }
+		inline ChildIterator &operator++() { ++Index; return *this; }
+		inline bool operator==(const ChildIterator &Other) const { return Index == Other.Index; }
+		inline bool operator!=(const ChildIterator &Other) const { return Index != Other.Index; }
+	};
+
+	inline FVTNodeView(const FVTType &Tree_) :
+		Tree(&Tree_), SelfPartInd(NULL), ChildLevel(0), ChildBeg(0),
+		ChildEnd(Tree_.depth() ? Tree_.LevelSize(0) : Tree_.getData().size()) {}
+	inline FVTNodeView(const FVTType &Tree_, const IndexT* SelfPartInd_, uint32_t ChildLevel_) :
+		Tree(&Tree_), SelfPartInd(SelfPartInd_), ChildLevel(ChildLevel_),
+		ChildBeg(SelfPartInd_[0]), ChildEnd(SelfPartInd_[1]) {}
+
+	// Property Access
+	inline size_t   size()    const { return ChildEnd - ChildBeg; }
+	inline bool     isempty() const { return ChildEnd == ChildBeg; }
+	inline bool     isleaf()  const { return ChildLevel == Tree->depth(); }
+	inline uint32_t level()   const { return ChildLevel; }
+
+	// Child Access (valid only for non-leaf nodes)
+	inline FVTNodeView operator[] (size_t Index) const {
+		return FVTNodeView(*Tree, Tree->getPartitionIndex(ChildLevel).begin() + ChildBeg + Index, ChildLevel + 1);
+	}
+	inline ChildIterator begin() const { return ChildIterator(this, 0); }
+	inline ChildIterator end()   const { return ChildIterator(this, this->size()); }
+
+	// Leaf Access
+	inline MexVectorView<T> leaf() const {
+		if (!this->isleaf())
+			WriteException(FV_ExCodes::FV_INVALID_FETCH, "The node at level %d is not a leaf", ChildLevel);
+		return MexVectorView<T>(ChildEnd - ChildBeg, Tree->getData().begin() + ChildBeg);
+	}
+	inline FVTLeafRange<T, IndexT> leaves() const {
+
+		// All the leaves below this node in depth-first order. These are a
+		// contiguous range of the deepest level, found by descending the
+		// begin and end indices through the levels.
+
+		uint32_t TreeDepth = Tree->depth();
+		if (TreeDepth == 0)
+			return FVTLeafRange<T, IndexT>();
+		if (this->isleaf())
+			return (SelfPartInd != NULL) ? FVTLeafRange<T, IndexT>(SelfPartInd, 1, Tree->getData().begin()) : FVTLeafRange<T, IndexT>();
+
+		size_t LeafBeg = ChildBeg, LeafEnd = ChildEnd;
+		for (uint32_t CurrLevel = ChildLevel; CurrLevel + 1 < TreeDepth; ++CurrLevel) {
+			const IndexT* CurrPartInds = Tree->getPartitionIndex(CurrLevel).begin();
+			LeafBeg = CurrPartInds[LeafBeg];
+			LeafEnd = CurrPartInds[LeafEnd];
+		}
+		return FVTLeafRange<T, IndexT>(Tree->getPartitionIndex(TreeDepth - 1).begin() + LeafBeg, LeafEnd - LeafBeg, Tree->getData().begin());
+	}
+};
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef FIXED_DEPTH_FLAT_VECT_TREE_HPP
+#define FIXED_DEPTH_FLAT_VECT_TREE_HPP
+
+#include <stdint.h>
+#include <limits>
+#include <algorithm>
+
+#include "FlatVectTree.hpp"
+
+template <typename T, uint32_t Depth, class FVT_Al = mxAllocator, typename IndexT = uint32_t>
+class FixedDepthFlatVectTree {
+	/*
+	   FixedDepthFlatVectTree is a FlatVectTree whose depth is a template
+	   parameter. The levels are held in a fixed size array, and all the
+	   traversals are templated on the level so that they are unrolled at
+	   compile time. The depth of the nested MexVectors appended / fetched
+	   (with any allocator at each level, e.g. the CAllocator vectors of
+	   MEX_EXE and worker thread code) is checked at compile time (via
+	   getTreeInfo) instead of at runtime.
+
+	   leaf(i0, ..., iDepth-1) is the hot fetch path: Depth dependent loads
+	   with no validation. It is convertible to and from FlatVectTree (the
+	   conversion from a FlatVectTree validates its runtime depth).
+	*/
+
+	static_assert(Depth >= 1, "The depth of a FixedDepthFlatVectTree must be at least 1");
+	static_assert(std::is_arithmetic<T>::value, "FixedDepthFlatVectTree can only hold arithmetic types");
+
+	MexVector<IndexT, FVT_Al> PartitionIndex[Depth];
+	MexVector<T, FVT_Al> Data;
+
+	// Counting the elements appended per level (for pre-sizing)
+	template <uint32_t Level, class Al>
+	static inline void countAppendElems(const MexVector<T, Al> &VectIn, size_t* LevelCounts) {
+		LevelCounts[Level] += VectIn.size();
+	}
+	template <uint32_t Level, typename SubElemT, class AlSub, class Al>
+	static inline void countAppendElems(const MexVector<MexVector<SubElemT, AlSub>, Al> &VectTreeIn, size_t* LevelCounts) {
+		LevelCounts[Level] += VectTreeIn.size();
+		for (auto &SubTree : VectTreeIn)
+			countAppendElems<Level + 1>(SubTree, LevelCounts);
+	}
+
+	// Appending the entries of VectTreeIn to Level (and the levels below)
+	template <uint32_t Level, class Al>
+	inline void appendFast(const MexVector<T, Al> &VectIn) {
+		static_assert(Level == Depth, "The leaves of the appended tree must be at the depth of the FixedDepthFlatVectTree");
+		size_t OldSize = Data.size();
+		Data.push_size(VectIn.size());
+		std::copy(VectIn.begin(), VectIn.end(), Data.begin() + OldSize);
+	}
+	template <uint32_t Level, typename SubElemT, class AlSub, class Al>
+	inline void appendFast(const MexVector<MexVector<SubElemT, AlSub>, Al> &VectTreeIn) {
+		static_assert(Level < Depth, "The appended tree is deeper than the FixedDepthFlatVectTree");
+		for (auto &SubTree : VectTreeIn) {
+			appendFast<Level + 1>(SubTree);
+			PartitionIndex[Level].push_back(IndexT(PartitionIndex[Level].last() + SubTree.size()));
+		}
+	}
+
+	// Fetches the entry Index of Level-1 (whose children lie at Level) into
+	// Out, recursing down to Data
+	template <uint32_t Level, class Al>
+	inline void getChild(MexVector<T, Al> &VectOut, size_t Index) const {
+		static_assert(Level == Depth, "The requested tree must have its leaves at the depth of the FixedDepthFlatVectTree");
+		size_t DataBeg = PartitionIndex[Level - 1][Index];
+		size_t DataEnd = PartitionIndex[Level - 1][Index + 1];
+		VectOut.resize(DataEnd - DataBeg);
+		std::copy(Data.begin() + DataBeg, Data.begin() + DataEnd, VectOut.begin());
+	}
+	template <uint32_t Level, typename SubElemT, class AlSub, class Al>
+	inline void getChild(MexVector<MexVector<SubElemT, AlSub>, Al> &VectTreeOut, size_t Index) const {
+		static_assert(Level < Depth, "The requested tree is deeper than the FixedDepthFlatVectTree");
+		size_t ChildBeg = PartitionIndex[Level - 1][Index];
+		size_t ChildEnd = PartitionIndex[Level - 1][Index + 1];
+		VectTreeOut.resize(ChildEnd - ChildBeg);
+		for (size_t i = ChildBeg; i < ChildEnd; ++i)
+			getChild<Level + 1>(VectTreeOut[i - ChildBeg], i);
+	}
+
+	// Checks that the sizes of the levels 1..Depth-1 and Data remain within
+	// the range of IndexT after appending LevelCounts[l] entries to each
+	// level l (and LevelCounts[Depth] elements to Data). Called before
+	// anything is appended, so that the tree is unchanged on failure.
+	inline void validateIndexRange(const size_t* LevelCounts) const {
+		size_t MaxIndexVal = size_t(std::numeric_limits<IndexT>::max());
+		bool isOutofRange = Data.size() > MaxIndexVal || LevelCounts[Depth] > MaxIndexVal - Data.size();
+		for (uint32_t l = 1; l < Depth; ++l) {
+			size_t CurrLevelSize = PartitionIndex[l].size() - 1;
+			isOutofRange = isOutofRange || CurrLevelSize > MaxIndexVal || LevelCounts[l] > MaxIndexVal - CurrLevelSize;
+		}
+		if (isOutofRange) {
+			WriteException(
+				FV_ExCodes::FV_INVALID_APPEND,
+				"The size of the FixedDepthFlatVectTree exceeds the range of its index type (max %llu)",
+				(unsigned long long)MaxIndexVal
+			);
+		}
+	}
+
+public:
+	typedef IndexT IndexType;
+	static constexpr uint32_t depth() { return Depth; }
+
+	// Constructors
+	inline FixedDepthFlatVectTree() : Data() {
+		for (uint32_t l = 0; l < Depth; ++l)
+			PartitionIndex[l].resize(1, IndexT(0));
+	}
+	template <class Al>
+	inline explicit FixedDepthFlatVectTree(const FlatVectTree<T, Al, IndexT> &TreeIn) : FixedDepthFlatVectTree() {
+		assign(TreeIn);
+	}
+
+	// Conversion from / to FlatVectTree
+	template <class Al>
+	inline void assign(const FlatVectTree<T, Al, IndexT> &TreeIn) {
+		if (TreeIn.depth() != Depth) {
+			WriteException(
+				FV_ExCodes::FV_INVALID_APPEND,
+				"The depth of the FlatVectTree (%d) does not match that of the FixedDepthFlatVectTree (%d)",
+				TreeIn.depth(), Depth
+			);
+		}
+		for (uint32_t l = 0; l < Depth; ++l) {
+			auto LevelIn = TreeIn.getPartitionIndex(l);
+			MexVector<IndexT, FVT_Al> NewLevel(LevelIn.size());
+			std::copy(LevelIn.begin(), LevelIn.end(), NewLevel.begin());
+			PartitionIndex[l].swap(NewLevel);
+		}
+		auto DataIn = TreeIn.getData();
+		MexVector<T, FVT_Al> NewData(DataIn.size());
+		std::copy(DataIn.begin(), DataIn.end(), NewData.begin());
+		Data.swap(NewData);
+	}
+	template <class Al>
+	inline void toFlatVectTree(FlatVectTree<T, Al, IndexT> &TreeOut) const {
+		MexVector<MexVector<IndexT, Al>, Al> PartitionIndexOut(Depth);
+		for (uint32_t l = 0; l < Depth; ++l) {
+			MexVector<IndexT, Al> LevelOut(PartitionIndex[l].size());
+			std::copy(PartitionIndex[l].begin(), PartitionIndex[l].end(), LevelOut.begin());
+			PartitionIndexOut[l].swap(LevelOut);
+		}
+		MexVector<T, Al> DataOut(Data.size());
+		std::copy(Data.begin(), Data.end(), DataOut.begin());
+
+		// This tree is valid by construction
+		TreeOut.assign(std::move(PartitionIndexOut), std::move(DataOut), true);
+	}
+
+	// Appending Functions. append concatenates the top level entries of a
+	// nested MexVector of depth Depth (e.g. a cell array of vectors for Depth
+	// 1), push_back appends one top level entry (of depth Depth-1)
+	template <typename SubElemT, class Al>
+	inline void append(const MexVector<SubElemT, Al> &VectTreeIn) {
+		static_assert(getTreeInfo<MexVector<SubElemT, Al> >::depth == Depth,
+		              "The depth of the appended tree must equal the depth of the FixedDepthFlatVectTree");
+		size_t LevelCounts[Depth + 1] = {};
+		countAppendElems<0>(VectTreeIn, LevelCounts);
+		validateIndexRange(LevelCounts);
+		for (uint32_t l = 0; l < Depth; ++l)
+			reserveFVTVector(PartitionIndex[l], LevelCounts[l]);
+		reserveFVTVector(Data, LevelCounts[Depth]);
+
+		appendFast<0>(VectTreeIn);
+	}
+	template <typename SubElemT, class Al>
+	inline void push_back(const MexVector<SubElemT, Al> &VectTreeIn) {
+		static_assert(getTreeInfo<MexVector<SubElemT, Al> >::depth + 1 == Depth,
+		              "The depth of the pushed tree must be one less than the depth of the FixedDepthFlatVectTree");
+		size_t LevelCounts[Depth + 1] = {};
+		LevelCounts[0] = 1;
+		countAppendElems<1>(VectTreeIn, LevelCounts);
+		validateIndexRange(LevelCounts);
+		for (uint32_t l = 0; l < Depth; ++l)
+			reserveFVTVector(PartitionIndex[l], LevelCounts[l]);
+		reserveFVTVector(Data, LevelCounts[Depth]);
+
+		appendFast<1>(VectTreeIn);
+		PartitionIndex[0].push_back(IndexT(PartitionIndex[0].last() + VectTreeIn.size()));
+	}
+
+	// Fetch Functions
+	template <typename... IdxTs>
+	inline MexVectorView<T> leaf(IdxTs... Indices) const {
+		/*
+		   The leaf Tree{i0+1}{i1+1}...{iDepth-1+1} (in MATLAB terms) as a view
+		   of Data. The indices (0-start, each relative to its parent) are NOT
+		   validated.
+		*/
+		static_assert(sizeof...(IdxTs) == Depth, "leaf requires exactly Depth indices");
+		const size_t LevelInds[Depth] = {size_t(Indices)...};
+		size_t Pos = LevelInds[0];
+		for (uint32_t l = 1; l < Depth; ++l)
+			Pos = PartitionIndex[l - 1][Pos] + LevelInds[l];
+		size_t LeafBeg = PartitionIndex[Depth - 1][Pos];
+		size_t LeafEnd = PartitionIndex[Depth - 1][Pos + 1];
+		return MexVectorView<T>(LeafEnd - LeafBeg, Data.begin() + LeafBeg);
+	}
+	template <typename SubElemT, class Al>
+	inline void getVectTree(MexVector<SubElemT, Al> &VectTreeOut) const {
+		// The entire tree as nested MexVectors (of depth Depth)
+		static_assert(getTreeInfo<MexVector<SubElemT, Al> >::depth == Depth,
+		              "The depth of the requested tree must equal the depth of the FixedDepthFlatVectTree");
+		size_t NEntries = PartitionIndex[0].size() - 1;
+		VectTreeOut.resize(NEntries);
+		for (size_t i = 0; i < NEntries; ++i)
+			getChild<1>(VectTreeOut[i], i);
+	}
+
+	// Property Access Functions
+	inline IndexT LevelSize(uint32_t Level) const {
+		return IndexT(PartitionIndex[Level].size() - 1);
+	}
+	inline bool isempty() const {
+		return PartitionIndex[0].size() == 1;
+	}
+	inline MexVectorView<IndexT> getPartitionIndex(uint32_t Level) const {
+		return MexVectorView<IndexT>(PartitionIndex[Level]);
+	}
+	inline MexVectorView<T> getData() const {
+		return MexVectorView<T>(Data);
+	}
+};
+
+#endif
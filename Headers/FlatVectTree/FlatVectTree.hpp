@@ -2,32 +2,70 @@
 #define FLAT_VECT_TREE_HPP
 
 #include <type_traits>
+#include <limits>
+#include <atomic>
 #include <stdint.h>
 
 #include "VectTreeInfo.hpp"
 #include "../MexMem.hpp"
 #include "../GenericMexIO.hpp"
 #include "../MexTypeTraits.hpp"
+#include "../ParallelHelpers.hpp"
 
 enum FV_ExCodes {
     FV_INVALID_APPEND = 0x01,
-	FV_INVALID_FETCH  = 0x02
+	FV_INVALID_FETCH  = 0x02,
+	FV_INVALID_FILTER = 0x04,
+	FV_INVALID_FILE   = 0x08
 };
 
-template<typename T, class FVT_Al = mxAllocator, class B = typename std::enable_if< std::is_arithmetic<T>::value >::type>
+// The unsigned integer type of the same size as an element. Used where the
+// elements are handled through their bit pattern (compression, radix sort)
+template <size_t Size> struct FVTCodeWord;
+template <> struct FVTCodeWord<1> { typedef uint8_t  type; };
+template <> struct FVTCodeWord<2> { typedef uint16_t type; };
+template <> struct FVTCodeWord<4> { typedef uint32_t type; };
+template <> struct FVTCodeWord<8> { typedef uint64_t type; };
+
+template <typename T, class FVT_Al, typename IndexT> class FVTNodeView;
+template <typename T, class FVT_Al, typename IndexT> class FlatVectTreeBuilder;
+
+template<typename T, class FVT_Al = mxAllocator, typename IndexT = uint32_t, class B = typename std::enable_if< std::is_arithmetic<T>::value >::type>
 class FlatVectTree {
 
-	MexVector<MexVector<uint32_t, FVT_Al>, FVT_Al> PartitionIndex;
+	// IndexT is the type of the elements of PartitionIndex. uint32_t (the
+	// default) limits the size of each level (and Data) to 2^32-1 elements,
+	// use uint64_t for larger trees.
+	static_assert(std::is_integral<IndexT>::value && std::is_unsigned<IndexT>::value, "The IndexT of a FlatVectTree must be an unsigned integer type");
+
+	MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> PartitionIndex;
 	MexVector<T, FVT_Al> Data;
 
 	uint32_t getActualInsertDepth(uint32_t InsertDepth, uint32_t GivenDepth) const;
 	uint32_t getAppendInsertDepth(uint32_t GivenInsertDepth, uint32_t AppendTreeDepth) const;
+	inline void validateIndexRange() const;
+	inline void filterMask(uint32_t Level, const bool* KeepMask);
+	template<class Al2, typename IndexT2>
+	static inline void gatherRanges(
+		const FlatVectTree<T, Al2, IndexT2> &Src, uint32_t Level,
+		MexVector<size_t, CAllocator> &RangeBeg, MexVector<size_t, CAllocator> &RangeEnd,
+		MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> &NewPartInds, MexVector<T, FVT_Al> &NewData);
+
+	template<typename IdxT, class AlPaths>
+	inline void resolvePaths(const MexMatrix<IdxT, AlPaths> &IndexPaths, MexVector<size_t, CAllocator> &NodeInds) const;
 
 	template<class Al>
-	inline void getVectTreeFromInds(MexVector<T, Al> &VectTreeOut, uint32_t Level, uint32_t LevelIndex);
+	inline void getVectTreeFromInds(MexVector<T, Al> &VectTreeOut, uint32_t Level, IndexT LevelIndex) const;
 	template<typename SubElemT, class AlSub, class Al>
-	inline void getVectTreeFromInds(MexVector<MexVector<SubElemT, AlSub>, Al> &VectTreeOut, uint32_t Level, uint32_t LevelIndex);
+	inline void getVectTreeFromInds(MexVector<MexVector<SubElemT, AlSub>, Al> &VectTreeOut, uint32_t Level, IndexT LevelIndex) const;
 	
+	template<class Al>
+	static inline void countAppendElems(const MexVector<T, Al> &VectIn, size_t* LevelCounts);
+	template<typename SubElemT, class AlSub, class Al>
+	static inline void countAppendElems(const MexVector<MexVector<SubElemT, AlSub>, Al > &VectTreeIn, size_t* LevelCounts);
+	template<typename SubElemT, class Al>
+	inline void reserveAppend(const MexVector<SubElemT, Al> &VectTreeIn);
+
 	template<class Al>
 	inline void appendFast(const MexVector<T, Al> &VectIn);
 	template<typename SubElemT, class AlSub, class Al>
@@ -38,32 +76,42 @@ class FlatVectTree {
 	template<typename SubElemT, class AlSub, class Al>
 	inline void appendFast(MexVector<MexVector<SubElemT, AlSub>, Al > &&VectTreeIn);
 
-	template<typename, class, class>
+	template<typename, class, typename, class>
 	friend class FlatVectTree;
+	template<typename, class, typename>
+	friend class FlatVectTreeBuilder;
 
 public:
-	
+	typedef IndexT IndexType;
+
 
 	// Constructors
 	inline FlatVectTree() : PartitionIndex(), Data() {}
-	inline FlatVectTree(int Depth) : PartitionIndex(Depth, MexVector<uint32_t>(1, uint32_t(0))), Data() {}
+	inline FlatVectTree(int Depth) : PartitionIndex(Depth, MexVector<IndexT, FVT_Al>(1, IndexT(0))), Data() {}
 
 	// Property Reassignment Functions
 	inline bool setDepth(uint32_t NewDepth);
 	inline void clear();
 	inline void empty();
 
-	// Assignment Functions
+	// Assignment Functions. If isTrusted, the input is only checked with
+	// isValidFVTShape (i.e. it is known to be valid)
 	template<class AlSub, class Al, class AlData>
-	inline void assign(const MexVector<MexVector<uint32_t, AlSub>, Al> &PartitionIndexIn, const MexVector<T, AlData> & DataIn, bool ActualCopy = true);
+	inline void assign(const MexVector<MexVector<IndexT, AlSub>, Al> &PartitionIndexIn, const MexVector<T, AlData> & DataIn, bool ActualCopy = true, bool isTrusted = false);
 	template<class FVT_Al2>
-	inline void assign(const FlatVectTree<T, FVT_Al2> &FlatVectTreeIn, bool ActualCopy = true);
+	inline void assign(const FlatVectTree<T, FVT_Al2, IndexT> &FlatVectTreeIn, bool ActualCopy = true);
+	inline void assign(MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> &&PartitionIndexIn, MexVector<T, FVT_Al> &&DataIn, bool isTrusted = false);
 
 	// Appending Functions
 	template<typename SubElemT, class Al>
 	inline void append(const MexVector<SubElemT, Al> &SubElemTree, uint32_t InsertDepth = uint32_t(-1));
-	template <class Al>
-	inline void append(const FlatVectTree<T, Al> &SubElemTree, uint32_t InsertDepth = uint32_t(-1));
+	template <class Al, typename IndexT2>
+	inline void append(const FlatVectTree<T, Al, IndexT2> &SubElemTree, uint32_t InsertDepth = uint32_t(-1));
+
+	// Batch-Appending Functions. Appends the selected top level entries of
+	// SrcTree (in the given order) as a single tree, see appendBatch
+	template <class Al, typename IndexT2, typename IdxT, class AlSel>
+	inline void appendBatch(const FlatVectTree<T, Al, IndexT2> &SrcTree, const MexVector<IdxT, AlSel> &Selection, uint32_t InsertDepth = uint32_t(-1));
 
 	// Move-Appending functions
 	template<typename SubElemT, class Al>
@@ -72,27 +120,43 @@ public:
 	// Push-Back Functions
 	template<typename SubElemT, class Al>
 	inline void push_back(const MexVector<SubElemT, Al> &MexVectIn);
-	template <class Al>
-	void push_back(FlatVectTree<T, Al> &VectTreeIn);
+	template <class Al, typename IndexT2>
+	void push_back(FlatVectTree<T, Al, IndexT2> &VectTreeIn);
 
 	// Move-Push-Back Functions
 	template<typename SubElemT, class Al>
 	inline void push_back(MexVector<SubElemT, Al> &&MexVectIn);
 
-	// Get Vector Tree
+	// Filter Functions
+	template<class Al>
+	inline void filter(uint32_t Level, const MexVector<bool, Al> &KeepMask);
+	template<typename IdxT, class Al>
+	inline void filter(uint32_t Level, const MexVector<IdxT, Al> &KeepIndices);
+
+	// Get Vector Tree. The variadic version reads each of its NIndices
+	// indices as an unsigned int (so int / uint32_t arguments are fine,
+	// whatever IndexT is). Indices that do not fit into 32 bits must be
+	// given in the MexVector version.
 	template<typename SubElemT, class Al, class AlInds>
-	inline void getVectTree(MexVector<SubElemT, Al> &VectTreeOut, const MexVector<uint32_t, AlInds> &Indices = MexVector<uint32_t>(0));
+	inline void getVectTree(MexVector<SubElemT, Al> &VectTreeOut, const MexVector<IndexT, AlInds> &Indices = MexVector<IndexT>(0)) const;
 	template<typename SubElemT, class Al>
-	inline void getVectTree(MexVector<SubElemT, Al> &VectTreeOut, uint32_t NIndices = 0, ...);
+	inline void getVectTree(MexVector<SubElemT, Al> &VectTreeOut, uint32_t NIndices = 0, ...) const;
+
+	// Batched Gather Functions. Each row of IndexPaths is the path of
+	// (0-start) indices of a node, see getVectTreeBatch
+	template<class AlOut, typename IdxT, class AlPaths>
+	inline void getVectTreeBatch(FlatVectTree<T, AlOut, IndexT> &TreeOut, const MexMatrix<IdxT, AlPaths> &IndexPaths) const;
+	template<typename IdxT, class AlPaths, class AlSpans>
+	inline void getDataSpans(const MexMatrix<IdxT, AlPaths> &IndexPaths, MexVector<IndexT, AlSpans> &SpanBeg, MexVector<IndexT, AlSpans> &SpanEnd) const;
 
 	// Release-Memory Functions
-	inline void releaseMem(MexVector<MexVector<uint32_t, FVT_Al>, FVT_Al> &ReleasedPartInds, MexVector<T, FVT_Al> &ReleasedData);
+	inline void releaseMem(MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> &ReleasedPartInds, MexVector<T, FVT_Al> &ReleasedData);
 
     // Property Access Functions
     inline uint32_t depth() const                  {
         return PartitionIndex.size();
     }
-	inline uint32_t LevelSize(uint32_t LevelIndex) {
+	inline IndexT   LevelSize(uint32_t LevelIndex) const {
 		return PartitionIndex[LevelIndex].size() - 1;
 	}
 	inline bool     isempty() const                {
@@ -101,17 +165,35 @@ public:
 	inline bool     istrulyempty() const           {
 		return (this->depth() == 0);
 	}
+	// Read-only views of the underlying arrays
+	inline MexVectorView<IndexT>   getPartitionIndex(uint32_t Level) const {
+		return MexVectorView<IndexT>(PartitionIndex[Level]);
+	}
+	inline MexVectorView<T>        getData() const {
+		return MexVectorView<T>(Data);
+	}
+	// Zero-copy hierarchical access (see FVTNodeView.hpp). Tree[i] is the
+	// i'th cell of the top level
+	inline FVTNodeView<T, FVT_Al, IndexT> root() const {
+		return FVTNodeView<T, FVT_Al, IndexT>(*this);
+	}
+	inline FVTNodeView<T, FVT_Al, IndexT> operator[] (size_t Index) const {
+		return FVTNodeView<T, FVT_Al, IndexT>(*this, PartitionIndex[0].begin() + Index, 1);
+	}
 	// Static Functions
 	template<class AlSub, class Al, class AlData>
-	static inline bool isValidFVT(const MexVector<MexVector<uint32_t, AlSub>, Al>& PartitionInds, const MexVector<T, AlData>& Data);
+	static inline bool isValidFVT(const MexVector<MexVector<IndexT, AlSub>, Al>& PartitionInds, const MexVector<T, AlData>& Data);
+	template<class AlSub, class Al, class AlData>
+	static inline bool isValidFVTShape(const MexVector<MexVector<IndexT, AlSub>, Al>& PartitionInds, const MexVector<T, AlData>& Data);
 };
 
 template <typename T, class Enable = void>
 struct isFlatVectTree { static constexpr bool value = false; };
-template <typename T, class Al>
-struct isFlatVectTree<FlatVectTree<T, Al>, typename std::enable_if<std::is_arithmetic<T>::value>::type> { 
+template <typename T, class Al, typename IndexT>
+struct isFlatVectTree<FlatVectTree<T, Al, IndexT>, typename std::enable_if<std::is_arithmetic<T>::value>::type> { 
 	static constexpr bool value = true; 
 	typedef T type;
+	typedef IndexT indexType;
 };
 
 template <typename T>
@@ -120,19 +202,27 @@ struct FieldInfo<T, typename std::enable_if<isFlatVectTree<T>::value>::type> {
 	static inline uint32_t getSize(const mxArray* InputmxArray);
 	static inline uint32_t getDepth(const mxArray* InputmxArray);
 	static inline void moveIntoVectors(const mxArray* InputmxArray, 
-		MexVector<MexVector<uint32_t> >   &PartitionIndexIn, 
+		MexVector<MexVector<typename isFlatVectTree<T>::indexType> > &PartitionIndexIn, 
 		MexVector<typename isFlatVectTree<T>::type> &Data);
 };
 
-template <typename T> inline mxArrayPtr assignmxArray(FlatVectTree<T> &FlatVectTreeOut);
-template <typename T, class Al> static void getInputfrommxArray(const mxArray *InputArray, FlatVectTree<T, Al> &FlatVectTreeIn);
+inline bool getPartitionIndexClass(const mxArray* PartitionIndexmxArr, mxClassID &IndexClass);
+inline bool hasMatchingValidationToken(const mxArray* InputmxArray);
+template <typename T, class Al, typename IndexT> inline mxArrayPtr createValidationToken(const FlatVectTree<T, Al, IndexT> &FlatVectTreeIn);
+template <typename T, typename IndexT> inline mxArrayPtr assignmxArray(FlatVectTree<T, mxAllocator, IndexT> &FlatVectTreeOut);
+template <typename T, typename IndexT> inline mxArrayPtr assignmxArray(FlatVectTree<T, mxAllocator, IndexT> &FlatVectTreeOut, mxClassID IndexClassOut);
+template <typename T, class Al, typename IndexT> inline mxArrayPtr Convert2CellArray(const FlatVectTree<T, Al, IndexT> &FlatVectTreeIn, uint32_t Level = 0, size_t BegIndex = 0, size_t EndIndex = size_t(-1));
+template <typename T, class Al, typename IndexT> inline void FlattenCellArray(const mxArray *InputCellArray, FlatVectTree<T, Al, IndexT> &FlatVectTreeOut, uint32_t RequiredDepth = uint32_t(-1));
+template <typename T, class Al, typename IndexT> static void getInputfrommxArray(const mxArray *InputArray, FlatVectTree<T, Al, IndexT> &FlatVectTreeIn, bool isValidated = false);
 template <
 	typename TSpec,
 	typename T,
 	typename B=typename std::enable_if<std::is_same<T,TSpec>::value>::type,
-	class Al>
-static int getInputfromStruct(const mxArray *InputStruct, const char* FieldName, FlatVectTree<T, Al> &FlatVectTreeIn, uint32_t RequiredDepth, MexMemInputOps InputOps = MexMemInputOps());
+	class Al,
+	typename IndexT>
+static int getInputfromStruct(const mxArray *InputStruct, const char* FieldName, FlatVectTree<T, Al, IndexT> &FlatVectTreeIn, uint32_t RequiredDepth, MexMemInputOps InputOps = MexMemInputOps());
 
+#include "FVTNodeView.hpp"
 #include "FlatVectTree.inl"
 #include "FlatVectTreeIO.inl"
 #endif
@@ -1,4 +1,5 @@
 #include <utility>
+#include <algorithm>
 #include "FlatVectTree.hpp"
 
 typedef uint32_t T;
@@ -8,8 +9,8 @@ typedef std::enable_if< std::is_arithmetic<T>::value >::type B;
 // PRIVATE HELPER FUNCTIONS  ////////////////////
 /////////////////////////////////////////////////
 
-template<typename T, class FVT_Al, class B>
-uint32_t FlatVectTree<T, FVT_Al, B>::getAppendInsertDepth(uint32_t GivenInsertDepth, uint32_t AppendTreeDepth) const {
+template<typename T, class FVT_Al, typename IndexT, class B>
+uint32_t FlatVectTree<T, FVT_Al, IndexT, B>::getAppendInsertDepth(uint32_t GivenInsertDepth, uint32_t AppendTreeDepth) const {
 	// This function does the following:
 	//
 	// 1. Validates GivenInsertDepth in the context of AppendTreeDepth and CurrDepth.
@@ -54,8 +55,8 @@ uint32_t FlatVectTree<T, FVT_Al, B>::getAppendInsertDepth(uint32_t GivenInsertDe
 	return GivenInsertDepth;
 };
 
-template<typename T, class FVT_Al, class B>
-uint32_t FlatVectTree<T, FVT_Al, B>::getActualInsertDepth(uint32_t InsertDepth, uint32_t GivenDepth) const {
+template<typename T, class FVT_Al, typename IndexT, class B>
+uint32_t FlatVectTree<T, FVT_Al, IndexT, B>::getActualInsertDepth(uint32_t InsertDepth, uint32_t GivenDepth) const {
 
 	uint32_t CurrDepth = this->depth();
 
@@ -82,14 +83,37 @@ uint32_t FlatVectTree<T, FVT_Al, B>::getActualInsertDepth(uint32_t InsertDepth,
 	return ActualInsertDepth;
 }
 
+template<typename T, class FVT_Al, typename IndexT, class B>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::validateIndexRange() const {
+
+	// Throws if the size of any level (or of Data) can no longer be
+	// represented by IndexT. This is called at the end of the appends as
+	// these are the only operations that grow the tree (the tree is invalid
+	// if it throws).
+
+	const size_t MaxIndexVal = std::numeric_limits<IndexT>::max();
+	bool isOverflow = (Data.size() > MaxIndexVal);
+	for (uint32_t i = 0; i < this->depth(); ++i)
+		isOverflow = isOverflow || (PartitionIndex[i].size() - 1 > MaxIndexVal);
+
+	if (isOverflow)
+		WriteException(
+			FV_ExCodes::FV_INVALID_APPEND,
+			"The size of the FlatVectTree exceeds the range of its index type (max %llu)",
+			(unsigned long long)MaxIndexVal
+		);
+}
+
 /////////////////////////////////////////////////
 // ASSIGNMENT FUNCTIONS      ////////////////////
 /////////////////////////////////////////////////
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<class AlSub, class Al, class AlData>
-inline void FlatVectTree<T, FVT_Al, B>::assign(const MexVector<MexVector<uint32_t, AlSub>, Al> &PartitionIndexIn, const MexVector<T, AlData> & DataIn, bool ActualCopy)
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::assign(const MexVector<MexVector<IndexT, AlSub>, Al> &PartitionIndexIn, const MexVector<T, AlData> & DataIn, bool ActualCopy, bool isTrusted)
 {
-	if (FlatVectTree<T>::isValidFVT(PartitionIndexIn, DataIn)) {
+	bool isValid = isTrusted ? FlatVectTree::isValidFVTShape(PartitionIndexIn, DataIn)
+	                         : FlatVectTree::isValidFVT(PartitionIndexIn, DataIn);
+	if (isValid) {
 		if (ActualCopy) {
 			PartitionIndex = PartitionIndexIn;
 			Data = DataIn;
@@ -112,9 +136,9 @@ inline void FlatVectTree<T, FVT_Al, B>::assign(const MexVector<MexVector<uint32_
 
 }
 
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<class FVT_Al2>
-inline void FlatVectTree<T, FVT_Al, B>::assign(const FlatVectTree<T, FVT_Al2> &FlatVectTreeIn, bool ActualCopy)
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::assign(const FlatVectTree<T, FVT_Al2, IndexT> &FlatVectTreeIn, bool ActualCopy)
 {
 	if (ActualCopy) {
 		PartitionIndex = FlatVectTreeIn.PartitionIndex;
@@ -130,32 +154,102 @@ inline void FlatVectTree<T, FVT_Al, B>::assign(const FlatVectTree<T, FVT_Al2> &F
 	}
 }
 
+template<typename T, class FVT_Al, typename IndexT, class B>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::assign(MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> &&PartitionIndexIn, MexVector<T, FVT_Al> &&DataIn, bool isTrusted)
+{
+	// Takes over the memory of PartitionIndexIn and DataIn (no copies are
+	// made). As with MexVector::assign(&&), the moved-from vectors must not
+	// be used after the call.
+	bool isValid = isTrusted ? FlatVectTree::isValidFVTShape(PartitionIndexIn, DataIn)
+	                         : FlatVectTree::isValidFVT(PartitionIndexIn, DataIn);
+	if (isValid) {
+		PartitionIndex.assign(std::move(PartitionIndexIn));
+		Data.assign(std::move(DataIn));
+	}
+	else {
+		WriteException(
+			FV_ExCodes::FV_INVALID_APPEND,
+			"The Given PartialIndexIn, DataIn do not represent a valid FlatVectTree"
+			);
+	}
+}
+
 /////////////////////////////////////////////////
 // APPEND FUNCTIONS          ////////////////////
 /////////////////////////////////////////////////
 
+// Pre-Sizing Functions
+// ====================
+
+template<typename ElemT, class Al>
+inline void reserveFVTVector(MexVector<ElemT, Al> &Vect, size_t NExtraElems) {
+	// Reserves space for NExtraElems more elements in Vect. The capacity is
+	// grown geometrically (as in push_size) so that repeated appends remain
+	// amortized linear
+	size_t CurrCapacity = Vect.capacity();
+	size_t RequiredCapacity = Vect.size() + NExtraElems;
+	if (RequiredCapacity > CurrCapacity)
+		Vect.reserve(std::max(RequiredCapacity, CurrCapacity + (CurrCapacity >> 1) + 1));
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<class Al>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::countAppendElems(const MexVector<T, Al> &VectIn, size_t* LevelCounts) {
+	LevelCounts[0] += VectIn.size();
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<typename SubElemT, class AlSub, class Al>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::countAppendElems(const MexVector<MexVector<SubElemT, AlSub>, Al > &VectTreeIn, size_t* LevelCounts) {
+	// Adds the number of elements of VectTreeIn at each of its levels
+	// (LevelCounts[0] being the top level) to LevelCounts
+	LevelCounts[0] += VectTreeIn.size();
+	for (auto &SubTree : VectTreeIn)
+		countAppendElems(SubTree, LevelCounts + 1);
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<typename SubElemT, class Al>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::reserveAppend(const MexVector<SubElemT, Al> &VectTreeIn) {
+	/*
+	   Reserves (once per level) the space required by appendFast(VectTreeIn)
+	   so that the appends into each level and Data make no reallocations.
+	   The tree must already have the depth required by appendFast.
+	*/
+
+	const uint32_t GivenDepth = getTreeInfo<MexVector<SubElemT, Al> >::depth;
+	uint32_t InsertDepth = this->depth() - GivenDepth;
+
+	size_t LevelCounts[GivenDepth + 1] = {};
+	countAppendElems(VectTreeIn, LevelCounts);
+
+	for (uint32_t i = 0; i < GivenDepth; ++i)
+		reserveFVTVector(PartitionIndex[InsertDepth + i], LevelCounts[i]);
+	reserveFVTVector(Data, LevelCounts[GivenDepth]);
+}
+
 // Fast Append Functions
 // =====================
 
 // ## Copy Versions ##
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<class Al>
-inline void FlatVectTree<T, FVT_Al, B>::appendFast(const MexVector<T, Al> &VectIn) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::appendFast(const MexVector<T, Al> &VectIn) {
 
 	/*
 	    Template specialization (recursion termination step) for appendFast
 	*/
 
-	uint32_t OldSize = this->Data.size();
-	uint32_t NElems = VectIn.size();
+	size_t OldSize = this->Data.size();
+	size_t NElems = VectIn.size();
 	this->Data.push_size(NElems);
-	this->Data.copyArray(OldSize, VectIn.begin(), NElems);
+	std::copy(VectIn.begin(), VectIn.end(), this->Data.begin() + OldSize);
 
 }
 
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<typename SubElemT, class AlSub, class Al>
-inline void FlatVectTree<T, FVT_Al, B>::appendFast(const MexVector<MexVector<SubElemT, AlSub>, Al > &VectTreeIn) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::appendFast(const MexVector<MexVector<SubElemT, AlSub>, Al > &VectTreeIn) {
 	/*
 	   AppendFast simply appends the given Tree to its required height without
 	   doing any for of validations, default calculations. it also does not edit 
@@ -166,34 +260,34 @@ inline void FlatVectTree<T, FVT_Al, B>::appendFast(const MexVector<MexVector<Sub
 	*/
 
 	uint32_t InsertDepth = this->depth() - getTreeInfo<decltype(VectTreeIn)>::depth;
-	uint32_t NElems      = VectTreeIn.size();
+	size_t NElems      = VectTreeIn.size();
 	
-	for (uint32_t i = 0; i < NElems; ++i) {
-		uint32_t NSubElems = VectTreeIn[i].size();
+	for (size_t i = 0; i < NElems; ++i) {
+		IndexT NSubElems = VectTreeIn[i].size();
 		appendFast(VectTreeIn[i]);
 		PartitionIndex[InsertDepth].push_back(PartitionIndex[InsertDepth].last() + NSubElems);
 	}
 }
 
 // ## Move Versions ##
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<class Al>
-inline void FlatVectTree<T, FVT_Al, B>::appendFast(MexVector<T, Al> &&VectIn) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::appendFast(MexVector<T, Al> &&VectIn) {
 	/*
 	   Template specialization (recursion termination step) for appendFast move version
 	*/
 
-	uint32_t OldSize = this->Data.size();
-	uint32_t NElems = VectIn.size();
+	size_t OldSize = this->Data.size();
+	size_t NElems = VectIn.size();
 	this->Data.push_size(NElems);
-	this->Data.copyArray(OldSize, VectIn.begin(), NElems);
+	std::copy(VectIn.begin(), VectIn.end(), this->Data.begin() + OldSize);
 	VectIn.clear();
 	VectIn.trim();
 }
 
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<typename SubElemT, class AlSub, class Al>
-inline void FlatVectTree<T, FVT_Al, B>::appendFast(MexVector<MexVector<SubElemT, AlSub>, Al > &&VectTreeIn) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::appendFast(MexVector<MexVector<SubElemT, AlSub>, Al > &&VectTreeIn) {
 	/*
 	AppendFast simply appends the given Tree to its required height without
 	doing any for of validations, default calculations. it also does not edit
@@ -204,10 +298,10 @@ inline void FlatVectTree<T, FVT_Al, B>::appendFast(MexVector<MexVector<SubElemT,
 	*/
 
 	uint32_t InsertDepth = this->depth() - getTreeInfo<decltype(VectTreeIn)>::depth;
-	uint32_t NElems = VectTreeIn.size();
+	size_t NElems = VectTreeIn.size();
 
-	for (uint32_t i = 0; i < NElems; ++i) {
-		uint32_t NSubElems = VectTreeIn[i].size();
+	for (size_t i = 0; i < NElems; ++i) {
+		IndexT NSubElems = VectTreeIn[i].size();
 		appendFast(VectTreeIn[i]);
 		PartitionIndex[InsertDepth].push_back(PartitionIndex[InsertDepth].last() + NSubElems);
 	}
@@ -219,9 +313,9 @@ inline void FlatVectTree<T, FVT_Al, B>::appendFast(MexVector<MexVector<SubElemT,
 
 // Actual Append Functions
 // =======================
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<typename SubElemT, class Al>
-inline void FlatVectTree<T, FVT_Al, B>::append(const MexVector<SubElemT, Al> &VectTreeIn, uint32_t InsertDepth) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::append(const MexVector<SubElemT, Al> &VectTreeIn, uint32_t InsertDepth) {
 	/* 
 	   This function appends the given MexVectIn at the specified InsertDepth
 	   
@@ -305,7 +399,8 @@ inline void FlatVectTree<T, FVT_Al, B>::append(const MexVector<SubElemT, Al> &Ve
 		this->setDepth(InsertDepth + GivenDepth);
 	}
 
-	// Perform Fast Append
+	// Perform Fast Append (after pre-sizing all the levels involved)
+	reserveAppend(VectTreeIn);
 	appendFast(VectTreeIn);
 
 	// If The vector is inserted on a Level higher than CurrDepth - GivenDepth
@@ -329,11 +424,12 @@ inline void FlatVectTree<T, FVT_Al, B>::append(const MexVector<SubElemT, Al> &Ve
 	else if (ActualInsertDepth > 0 && ActualInsertDepth == CurrDepth) {
 		PartitionIndex[ActualInsertDepth - 1].last() = Data.size();
 	}
+	validateIndexRange();
 }
 
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<typename SubElemT, class Al>
-inline void FlatVectTree<T, FVT_Al, B>::append(MexVector<SubElemT, Al> &&VectTreeIn, uint32_t InsertDepth) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::append(MexVector<SubElemT, Al> &&VectTreeIn, uint32_t InsertDepth) {
 	/* 
 	   This function appends the given MexVectIn at the specified InsertDepth
 	   
@@ -417,7 +513,8 @@ inline void FlatVectTree<T, FVT_Al, B>::append(MexVector<SubElemT, Al> &&VectTre
 		this->setDepth(InsertDepth + GivenDepth);
 	}
 
-	// Perform Fast Append
+	// Perform Fast Append (after pre-sizing all the levels involved)
+	reserveAppend(VectTreeIn);
 	appendFast(std::move(VectTreeIn));
 
 	// If The vector is inserted on a Level higher than CurrDepth - GivenDepth
@@ -441,11 +538,12 @@ inline void FlatVectTree<T, FVT_Al, B>::append(MexVector<SubElemT, Al> &&VectTre
 	else if (ActualInsertDepth > 0 && ActualInsertDepth == CurrDepth) {
 		PartitionIndex[ActualInsertDepth - 1].last() = Data.size();
 	}
+	validateIndexRange();
 }
 
-template<typename T, class FVT_Al, class B>
-template<class Al>
-inline void FlatVectTree<T, FVT_Al, B>::append(const FlatVectTree<T, Al> &VectTreeIn, uint32_t InsertDepth) {
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<class Al, typename IndexT2>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::append(const FlatVectTree<T, Al, IndexT2> &VectTreeIn, uint32_t InsertDepth) {
 	/*
 	 * This function is used to append a FlatVectTree instead of a VectVect.
 	 * The semantics of this operation are identical to the other append functions
@@ -464,18 +562,31 @@ inline void FlatVectTree<T, FVT_Al, B>::append(const FlatVectTree<T, Al> &VectTr
 		CurrDepth = InsertDepth + GivenDepth;
 	}
 
-	// Perform Fast Append
+	// Perform Fast Append. Each level is grown once and the appended
+	// PartitionIndex entries are offset by the current BTE element of the level
 	for(uint32_t i=0; i<GivenDepth; ++i) {
 		auto &CurrentFVTPartition = PartitionIndex[CurrDepth - GivenDepth + i];
 		auto &AppendFVTPartition = VectTreeIn.PartitionIndex[i];
-		auto CurrPartitionLastIndex = PartitionIndex[CurrDepth - GivenDepth + i].last();
-		// Ignore the first element of AppendFVTPartition as hat corresponds to
-		// the BLE of CurrentFVTPartition
-		for(uint32_t j=1; j < AppendFVTPartition.size(); ++j) {
-			CurrentFVTPartition.push_back(CurrPartitionLastIndex + AppendFVTPartition[j]);
-		}
+		size_t CurrPartitionSize = CurrentFVTPartition.size();
+		size_t NAppendEntries = AppendFVTPartition.size() - 1;
+		IndexT CurrPartitionLastIndex = CurrentFVTPartition.last();
+
+		CurrentFVTPartition.push_size(NAppendEntries);
+
+		// Ignore the first element of AppendFVTPartition as that corresponds to
+		// the BTE of CurrentFVTPartition. (The pointers are taken after
+		// push_size as VectTreeIn may be this tree)
+		IndexT* PartIndsOut = CurrentFVTPartition.begin() + CurrPartitionSize;
+		const IndexT2* PartIndsIn = AppendFVTPartition.begin() + 1;
+		ParallelFor(0, NAppendEntries, 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			for (size_t j = ChunkBeg; j < ChunkEnd; ++j)
+				PartIndsOut[j] = IndexT(CurrPartitionLastIndex + PartIndsIn[j]);
+		});
 	}
-	Data.insert(Data.size(), VectTreeIn.Data);
+	size_t CurrDataSize = Data.size();
+	size_t NAppendData = VectTreeIn.Data.size();
+	Data.push_size(NAppendData);
+	std::copy(VectTreeIn.Data.begin(), VectTreeIn.Data.begin() + NAppendData, Data.begin() + CurrDataSize);
 
 	// If The vector is inserted on a Level higher than CurrDepth - GivenDepth
 	// then an additional entry needs to be made for all the levels from the
@@ -498,15 +609,64 @@ inline void FlatVectTree<T, FVT_Al, B>::append(const FlatVectTree<T, Al> &VectTr
 	else if (ActualInsertDepth > 0 && ActualInsertDepth == CurrDepth) {
 		PartitionIndex[ActualInsertDepth - 1].last() = Data.size();
 	}
+	validateIndexRange();
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<class Al, typename IndexT2, typename IdxT, class AlSel>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::appendBatch(const FlatVectTree<T, Al, IndexT2> &SrcTree, const MexVector<IdxT, AlSel> &Selection, uint32_t InsertDepth) {
+	/*
+	   Appends the top level entries SrcTree[Selection[0]], SrcTree[Selection[1]],
+	   ... (0-start indices, in that order, repetitions allowed) as a single
+	   tree of depth SrcTree.depth(). i.e. this is equivalent to
+	   append(<SrcTree filtered by Selection>, InsertDepth) except that the
+	   order and repetitions in Selection are retained.
+
+	   Instead of appending the selected subtrees one at a time, their total
+	   size at every level is computed first and all of them are gathered
+	   (in parallel) into exactly sized levels before being appended in bulk.
+	*/
+
+	static_assert(std::is_integral<IdxT>::value, "The Selection given to appendBatch must be of integral type");
+
+	if (SrcTree.depth() == 0) {
+		WriteException(FV_ExCodes::FV_INVALID_APPEND, "Cannot select entries from a truly empty tree in appendBatch");
+	}
+	size_t NSrcEntries = SrcTree.LevelSize(0);
+	size_t NSelected = Selection.size();
+
+	MexVector<size_t, CAllocator> RangeBeg(NSelected), RangeEnd(NSelected);
+	bool isOutofRange = false;
+	for (size_t k = 0; k < NSelected; ++k) {
+		IdxT SelIndex = Selection[k];
+		isOutofRange = isOutofRange || SelIndex < 0 || size_t(SelIndex) >= NSrcEntries;
+		RangeBeg[k] = size_t(SelIndex);
+		RangeEnd[k] = size_t(SelIndex) + 1;
+	}
+	if (isOutofRange) {
+		WriteException(
+			FV_ExCodes::FV_INVALID_APPEND,
+			"The Selection must lie in [0, %llu) (the number of top level entries of the tree to append from)",
+			(unsigned long long)NSrcEntries
+		);
+	}
+
+	MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> SelectedPartInds;
+	MexVector<T, FVT_Al> SelectedData;
+	gatherRanges(SrcTree, 0, RangeBeg, RangeEnd, SelectedPartInds, SelectedData);
+
+	FlatVectTree<T, FVT_Al, IndexT> SelectedTree;
+	SelectedTree.assign(std::move(SelectedPartInds), std::move(SelectedData), true);
+	append(SelectedTree, InsertDepth);
 }
 
 /////////////////////////////////////////////////
 // PUSH_BACK FUNCTIONS       ////////////////////
 /////////////////////////////////////////////////
 
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<typename SubElemT, class Al>
-inline void FlatVectTree<T, FVT_Al, B>::push_back(const MexVector<SubElemT, Al> &VectTreeIn) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::push_back(const MexVector<SubElemT, Al> &VectTreeIn) {
 	/*
 	   push_back is like append except that the default calculated InsertDepth is one higher
 	   than append. The InsertDepth is not taken as argument as it is expected that the user
@@ -549,9 +709,9 @@ inline void FlatVectTree<T, FVT_Al, B>::push_back(const MexVector<SubElemT, Al>
 	append(VectTreeIn, InsertDepth);
 }
 
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<typename SubElemT, class Al>
-inline void FlatVectTree<T, FVT_Al, B>::push_back(MexVector<SubElemT, Al> &&VectTreeIn) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::push_back(MexVector<SubElemT, Al> &&VectTreeIn) {
 	/* 
 	   This performs push_back and deallocates memory in VectTreeIn
 	*/
@@ -577,9 +737,9 @@ inline void FlatVectTree<T, FVT_Al, B>::push_back(MexVector<SubElemT, Al> &&Vect
 	append(std::move(VectTreeIn), InsertDepth);
 }
 
-template<typename T, class FVT_Al, class B>
-template<class Al>
-inline void FlatVectTree<T, FVT_Al, B>::push_back(FlatVectTree<T, Al> &VectTreeIn) {
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<class Al, typename IndexT2>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::push_back(FlatVectTree<T, Al, IndexT2> &VectTreeIn) {
 	/*
 	   This performs push_back and deallocates memory in VectTreeIn
 	*/
@@ -605,13 +765,228 @@ inline void FlatVectTree<T, FVT_Al, B>::push_back(FlatVectTree<T, Al> &VectTreeI
 	append(VectTreeIn, InsertDepth);
 }
 
+/////////////////////////////////////////////////
+// FILTER FUNCTIONS          ////////////////////
+/////////////////////////////////////////////////
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<class Al2, typename IndexT2>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::gatherRanges(
+	const FlatVectTree<T, Al2, IndexT2> &Src, uint32_t Level,
+	MexVector<size_t, CAllocator> &RangeBeg, MexVector<size_t, CAllocator> &RangeEnd,
+	MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> &NewPartInds, MexVector<T, FVT_Al> &NewData) {
+	/*
+	   Gathers the ranges of entries [RangeBeg[k], RangeEnd[k]) of Level of
+	   Src (of Src.Data if Level == Src.depth()), along with everything below
+	   them, into NewPartInds (the levels Level to Src.depth()-1) and
+	   NewData. The ranges are placed one after the other in the given order
+	   and may repeat. RangeBeg and RangeEnd are overwritten.
+
+	   The entries below a range form one contiguous range at every deeper
+	   level. Thus each level is built from the ranges using parallel
+	   exclusive scans (for the offsets of each range in the new level) and
+	   gathers, while descending the ranges to the next level. Every level
+	   is sized exactly once.
+	*/
+
+	const size_t MinChunkSize = 1 << 14;
+	uint32_t TreeDepth = Src.depth();
+	size_t NRanges = RangeBeg.size();
+
+	auto validateLevelSize = [](size_t LevelSize) {
+		if (LevelSize > size_t(std::numeric_limits<IndexT>::max())) {
+			WriteException(
+				FV_ExCodes::FV_INVALID_APPEND,
+				"The gathered level size (%llu) exceeds the limit (%llu) of the PartitionIndex type",
+				(unsigned long long)LevelSize, (unsigned long long)std::numeric_limits<IndexT>::max()
+			);
+		}
+	};
+
+	// Offsets of each range in the current level
+	MexVector<size_t, CAllocator> RangeOffsets(NRanges), ChildOffsets(NRanges);
+	ParallelFor(0, NRanges, MinChunkSize, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t k = ChunkBeg; k < ChunkEnd; ++k)
+			RangeOffsets[k] = RangeEnd[k] - RangeBeg[k];
+	});
+	size_t NewLevelSize = ParallelExclusiveScan(RangeOffsets.begin(), NRanges, RangeOffsets.begin(), size_t(0), MinChunkSize);
+	validateLevelSize(NewLevelSize);
+
+	NewPartInds.resize(TreeDepth - Level, MexVector<IndexT, FVT_Al>());
+	for (uint32_t CurrLevel = Level; CurrLevel < TreeDepth; ++CurrLevel) {
+		const IndexT2* CurrPartInds = Src.PartitionIndex[CurrLevel].begin();
+
+		// Offsets of the children of each range in the next level
+		ParallelFor(0, NRanges, MinChunkSize, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			for (size_t k = ChunkBeg; k < ChunkEnd; ++k)
+				ChildOffsets[k] = CurrPartInds[RangeEnd[k]] - CurrPartInds[RangeBeg[k]];
+		});
+		size_t NChildren = ParallelExclusiveScan(ChildOffsets.begin(), NRanges, ChildOffsets.begin(), size_t(0), MinChunkSize);
+		validateLevelSize(NChildren);
+
+		// Building the level, and descending the ranges to the next level
+		MexVector<IndexT, FVT_Al> NewLevel(NewLevelSize + 1);
+		ParallelFor(0, NRanges, MinChunkSize, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			for (size_t k = ChunkBeg; k < ChunkEnd; ++k) {
+				size_t CurrRangeBeg = RangeBeg[k];
+				size_t CurrRangeEnd = RangeEnd[k];
+				size_t ChildShift = ChildOffsets[k] - CurrPartInds[CurrRangeBeg];
+				IndexT* NewLevelOut = NewLevel.begin() + RangeOffsets[k];
+				for (size_t j = CurrRangeBeg; j < CurrRangeEnd; ++j)
+					*(NewLevelOut++) = IndexT(CurrPartInds[j] + ChildShift);
+
+				RangeBeg[k] = CurrPartInds[CurrRangeBeg];
+				RangeEnd[k] = CurrPartInds[CurrRangeEnd];
+			}
+		});
+		NewLevel.last() = IndexT(NChildren);
+
+		NewPartInds[CurrLevel - Level].swap(NewLevel);
+		RangeOffsets.swap(ChildOffsets);
+		NewLevelSize = NChildren;
+	}
+
+	// Gathering Data
+	MexVector<T, FVT_Al> GatheredData(NewLevelSize);
+	const T* SrcData = Src.Data.begin();
+	ParallelFor(0, NRanges, MinChunkSize, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t k = ChunkBeg; k < ChunkEnd; ++k)
+			std::copy(SrcData + RangeBeg[k], SrcData + RangeEnd[k], GatheredData.begin() + RangeOffsets[k]);
+	});
+	NewData.swap(GatheredData);
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::filterMask(uint32_t Level, const bool* KeepMask) {
+	/*
+	   Keeps only the entries i of Level (of Data if Level == depth()) for
+	   which KeepMask[i] is true, along with everything below them. The
+	   PartitionIndex of the level above is updated so that each of its cells
+	   contains the kept entries among its previous contents.
+
+	   The levels from Level onwards are rebuilt by gathering the kept
+	   entries (see gatherRanges). Only the levels from Level-1 onwards are
+	   replaced, the remaining ones are untouched (which keeps them valid
+	   even if they alias external memory).
+	*/
+
+	const size_t MinChunkSize = 1 << 14;
+	uint32_t TreeDepth = this->depth();
+	size_t NEntries = (Level < TreeDepth) ? this->LevelSize(Level) : Data.size();
+
+	// KeepPos[i] is the position of entry i in the filtered level
+	MexVector<size_t, CAllocator> KeepPos(NEntries + 1);
+	size_t NKept = ParallelExclusiveScan(KeepMask, NEntries, KeepPos.begin(), size_t(0), MinChunkSize);
+	KeepPos[NEntries] = NKept;
+
+	// Updating the level above
+	if (Level > 0) {
+		const MexVector<IndexT, FVT_Al> &ParentPartInds = PartitionIndex[Level - 1];
+		MexVector<IndexT, FVT_Al> NewParentPartInds(ParentPartInds.size());
+		ParallelFor(0, ParentPartInds.size(), MinChunkSize, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			for (size_t i = ChunkBeg; i < ChunkEnd; ++i)
+				NewParentPartInds[i] = IndexT(KeepPos[ParentPartInds[i]]);
+		});
+		PartitionIndex[Level - 1].swap(NewParentPartInds);
+	}
+
+	// The range [RangeBeg[k], RangeEnd[k]) of Level kept as the k'th entry
+	MexVector<size_t, CAllocator> RangeBeg(NKept), RangeEnd(NKept);
+	ParallelFor(0, NEntries, MinChunkSize, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t i = ChunkBeg; i < ChunkEnd; ++i) {
+			if (KeepMask[i]) {
+				size_t k = KeepPos[i];
+				RangeBeg[k] = i;
+				RangeEnd[k] = i + 1;
+			}
+		}
+	});
+	KeepPos.clear();
+	KeepPos.trim();
+
+	MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> NewPartInds;
+	MexVector<T, FVT_Al> NewData;
+	gatherRanges(*this, Level, RangeBeg, RangeEnd, NewPartInds, NewData);
+
+	for (uint32_t CurrLevel = Level; CurrLevel < TreeDepth; ++CurrLevel)
+		PartitionIndex[CurrLevel].swap(NewPartInds[CurrLevel - Level]);
+	Data.swap(NewData);
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<class Al>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::filter(uint32_t Level, const MexVector<bool, Al> &KeepMask) {
+	/*
+	   Filters the given Level (0-start, Level == depth() filters Data) to
+	   contain only the entries i for which KeepMask[i] is true (see
+	   filterMask). KeepMask must have one element per entry of Level.
+	*/
+
+	uint32_t TreeDepth = this->depth();
+	if (Level > TreeDepth) {
+		WriteException(
+			FV_ExCodes::FV_INVALID_FILTER,
+			"The Level to filter (%d) must not exceed the depth of the tree (%d)",
+			Level, TreeDepth
+		);
+	}
+	size_t NEntries = (Level < TreeDepth) ? this->LevelSize(Level) : Data.size();
+	if (KeepMask.size() != NEntries) {
+		WriteException(
+			FV_ExCodes::FV_INVALID_FILTER,
+			"The size of KeepMask (%llu) must equal the number of entries in level %d (%llu)",
+			(unsigned long long)KeepMask.size(), Level, (unsigned long long)NEntries
+		);
+	}
+	filterMask(Level, KeepMask.begin());
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<typename IdxT, class Al>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::filter(uint32_t Level, const MexVector<IdxT, Al> &KeepIndices) {
+	/*
+	   Filters the given Level (0-start, Level == depth() filters Data) to
+	   contain only the entries indexed (0-start) by KeepIndices. The order
+	   and repetitions in KeepIndices are ignored i.e. the kept entries
+	   retain their relative order (as in MATLAB's filter).
+	*/
+
+	static_assert(std::is_integral<IdxT>::value, "The KeepIndices given to filter must be of integral type");
+
+	uint32_t TreeDepth = this->depth();
+	if (Level > TreeDepth) {
+		WriteException(
+			FV_ExCodes::FV_INVALID_FILTER,
+			"The Level to filter (%d) must not exceed the depth of the tree (%d)",
+			Level, TreeDepth
+		);
+	}
+	size_t NEntries = (Level < TreeDepth) ? this->LevelSize(Level) : Data.size();
+
+	MexVector<bool, CAllocator> KeepMask(NEntries, false);
+	bool isOutofRange = false;
+	for (auto KeepIndex : KeepIndices) {
+		isOutofRange = isOutofRange || KeepIndex < 0 || size_t(KeepIndex) >= NEntries;
+		if (!isOutofRange)
+			KeepMask[KeepIndex] = true;
+	}
+	if (isOutofRange) {
+		WriteException(
+			FV_ExCodes::FV_INVALID_FILTER,
+			"The KeepIndices must lie in [0, %llu) (the number of entries in level %d)",
+			(unsigned long long)NEntries, Level
+		);
+	}
+	filterMask(Level, KeepMask.begin());
+}
+
 /////////////////////////////////////////////////
 // GET VECTOR TREE FUNCTIONS ////////////////////
 /////////////////////////////////////////////////
 
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<class Al>
-inline void FlatVectTree<T, FVT_Al, B>::getVectTreeFromInds(MexVector<T, Al> &VectTreeOut, uint32_t Level, uint32_t LevelIndex) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::getVectTreeFromInds(MexVector<T, Al> &VectTreeOut, uint32_t Level, IndexT LevelIndex) const {
 
 	// Validate compatibility of depth
 	uint32_t OutDepth = 0;
@@ -634,14 +1009,14 @@ inline void FlatVectTree<T, FVT_Al, B>::getVectTreeFromInds(MexVector<T, Al> &Ve
 	}
 
 	// Returning Cell Array
-	uint32_t VectSize = PartitionIndex[Level][LevelIndex + 1] - PartitionIndex[Level][LevelIndex];
+	IndexT VectSize = PartitionIndex[Level][LevelIndex + 1] - PartitionIndex[Level][LevelIndex];
 	VectTreeOut.resize(VectSize);
 	VectTreeOut.copyArray(0, Data.begin() + PartitionIndex[Level][LevelIndex], VectSize);
 }
 
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<typename SubElemT, class AlSub, class Al>
-inline void FlatVectTree<T, FVT_Al, B>::getVectTreeFromInds(MexVector<MexVector<SubElemT, AlSub>, Al> &VectTreeOut, uint32_t Level, uint32_t LevelIndex) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::getVectTreeFromInds(MexVector<MexVector<SubElemT, AlSub>, Al> &VectTreeOut, uint32_t Level, IndexT LevelIndex) const {
 	
 	// Validate compatibility of depth
 	uint32_t OutDepth = getTreeInfo<decltype(VectTreeOut)>::depth;
@@ -663,19 +1038,19 @@ inline void FlatVectTree<T, FVT_Al, B>::getVectTreeFromInds(MexVector<MexVector<
 			);
 	}
 
-	uint32_t NElems = PartitionIndex[Level][LevelIndex + 1] - PartitionIndex[Level][LevelIndex];
+	IndexT NElems = PartitionIndex[Level][LevelIndex + 1] - PartitionIndex[Level][LevelIndex];
 	VectTreeOut.resize(NElems);
 
-	for (uint32_t i = 0; i < NElems; ++i) {
-		uint32_t CurrElemIndex = PartitionIndex[Level][LevelIndex] + i;
+	for (IndexT i = 0; i < NElems; ++i) {
+		IndexT CurrElemIndex = PartitionIndex[Level][LevelIndex] + i;
 		getVectTreeFromInds(VectTreeOut[i], Level + 1, CurrElemIndex);
 	}
 }
 
 // Get Vector Tree
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<typename SubElemT, class Al, class AlInds>
-inline void FlatVectTree<T, FVT_Al, B>::getVectTree(MexVector<SubElemT, Al> &VectTreeOut, const MexVector<uint32_t, AlInds> &Indices) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::getVectTree(MexVector<SubElemT, Al> &VectTreeOut, const MexVector<IndexT, AlInds> &Indices) const {
 
 	// Validate Indices.
 	if (Indices.size() > this->depth()) {
@@ -702,9 +1077,9 @@ inline void FlatVectTree<T, FVT_Al, B>::getVectTree(MexVector<SubElemT, Al> &Vec
 				);
 		}
 		else {
-			uint32_t NElems = PartitionIndex[0].size() - 1;
+			IndexT NElems = PartitionIndex[0].size() - 1;
 			VectTreeOut.resize(NElems);
-			for (uint32_t i = 0; i < NElems; ++i) {
+			for (IndexT i = 0; i < NElems; ++i) {
 				getVectTreeFromInds(VectTreeOut[i], 0, i);
 			}
 		}
@@ -712,10 +1087,10 @@ inline void FlatVectTree<T, FVT_Al, B>::getVectTree(MexVector<SubElemT, Al> &Vec
 	// If Not, then Finding LevelIndex and Level and call getVectTreeFromInds
 	else {
 		uint32_t Level = 0;
-		uint32_t LevelIndex = 0;
+		IndexT LevelIndex = 0;
 
 		for (uint32_t i = 0; i < IndicesSize; ++i, ++Level) {
-			uint32_t CurrentLevelSize = PartitionIndex[Level].size() - 1;
+			IndexT CurrentLevelSize = PartitionIndex[Level].size() - 1;
 			if (Indices[Level] < CurrentLevelSize) {
 				LevelIndex = PartitionIndex[Level][LevelIndex + Indices[Level]];
 			}
@@ -732,28 +1107,179 @@ inline void FlatVectTree<T, FVT_Al, B>::getVectTree(MexVector<SubElemT, Al> &Vec
 	}
 }
 
-template<typename T, class FVT_Al, class B>
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<typename SubElemT, class Al>
-inline void FlatVectTree<T, FVT_Al, B>::getVectTree(MexVector<SubElemT, Al> &VectTreeOut, uint32_t NIndices, ...) {
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::getVectTree(MexVector<SubElemT, Al> &VectTreeOut, uint32_t NIndices, ...) const {
 
-	// Converting Indices into vector
-	MexVector<uint32_t> Indices(NIndices);
+	// Converting Indices into vector (the arguments are read as unsigned
+	// int irrespective of IndexT, reading them as IndexT = uint64_t would
+	// be undefined for int / uint32_t arguments)
+	MexVector<IndexT> Indices(NIndices);
 	std::va_list Args;
 	va_start(Args, NIndices);
 	for (uint32_t i = 0; i < NIndices; ++i) {
-		Indices[i] = va_arg(Args, uint32_t);
+		Indices[i] = IndexT(va_arg(Args, unsigned int));
 	}
 	va_end(Args);
 
 	getVectTree(VectTreeOut, Indices);
 }
 
+/////////////////////////////////////////////////
+// BATCHED GATHER FUNCTIONS  ////////////////////
+/////////////////////////////////////////////////
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<typename IdxT, class AlPaths>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::resolvePaths(const MexMatrix<IdxT, AlPaths> &IndexPaths, MexVector<size_t, CAllocator> &NodeInds) const {
+	/*
+	   Resolves each row [i0, i1, ..., iL-1] of IndexPaths (L = ncols) to the
+	   position in PartitionIndex[L-1] of the node Tree{i0+1}{i1+1}...{iL-1+1}
+	   (in MATLAB terms). Every index is relative to its parent node and is
+	   validated against the number of children of the parent.
+
+	   All the paths are resolved one level at a time, so that each pass is a
+	   parallel loop over the paths reading a single level. A failing path
+	   only sets an atomic marker in the workers, the exception is raised on
+	   the calling thread for the first invalid path. The node of a failed
+	   path is set to InvalidNode so that it is not descended into (its
+	   parent entries may not exist).
+	*/
+
+	static_assert(std::is_integral<IdxT>::value, "The IndexPaths must be of integral type");
+
+	size_t NPaths = IndexPaths.nrows();
+	size_t PathLength = IndexPaths.ncols();
+	if (PathLength == 0 || PathLength > this->depth()) {
+		WriteException(
+			FV_ExCodes::FV_INVALID_FETCH,
+			"The length of the index paths (%llu) must lie in [1, %d] (the depth of the FlatVectTree)",
+			(unsigned long long)PathLength, this->depth()
+		);
+	}
+
+	const size_t MinChunkSize = 1 << 14;
+	const IdxT* Paths = IndexPaths.begin();
+	MexVector<size_t, CAllocator> CurrInds(NPaths);
+	const size_t InvalidNode = size_t(-1);
+	std::atomic<size_t> FirstInvalidPath(NPaths);
+	auto markInvalid = [&](size_t PathIndex) {
+		size_t CurrFirst = FirstInvalidPath.load();
+		while (PathIndex < CurrFirst && !FirstInvalidPath.compare_exchange_weak(CurrFirst, PathIndex));
+	};
+
+	// Level 0 (the parent is the whole tree)
+	size_t TopLevelSize = this->LevelSize(0);
+	ParallelFor(0, NPaths, MinChunkSize, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t k = ChunkBeg; k < ChunkEnd; ++k) {
+			IdxT CurrIndex = Paths[k*PathLength];
+			if (CurrIndex < 0 || size_t(CurrIndex) >= TopLevelSize) {
+				markInvalid(k);
+				CurrInds[k] = InvalidNode;
+			}
+			else
+				CurrInds[k] = size_t(CurrIndex);
+		}
+	});
+
+	// Descending one level per pass
+	for (size_t l = 1; l < PathLength; ++l) {
+		const IndexT* ParentLevel = PartitionIndex[l - 1].begin();
+		ParallelFor(0, NPaths, MinChunkSize, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			for (size_t k = ChunkBeg; k < ChunkEnd; ++k) {
+				if (CurrInds[k] == InvalidNode)
+					continue;
+				size_t ChildBeg = ParentLevel[CurrInds[k]];
+				size_t NChildren = ParentLevel[CurrInds[k] + 1] - ChildBeg;
+				IdxT CurrIndex = Paths[k*PathLength + l];
+				if (CurrIndex < 0 || size_t(CurrIndex) >= NChildren) {
+					markInvalid(k);
+					CurrInds[k] = InvalidNode;
+				}
+				else
+					CurrInds[k] = ChildBeg + size_t(CurrIndex);
+			}
+		});
+	}
+
+	if (FirstInvalidPath.load() < NPaths) {
+		WriteException(
+			FV_ExCodes::FV_INVALID_FETCH,
+			"The index path in row %llu (0-start) does not exist in the FlatVectTree",
+			(unsigned long long)FirstInvalidPath.load()
+		);
+	}
+	NodeInds.swap(CurrInds);
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<class AlOut, typename IdxT, class AlPaths>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::getVectTreeBatch(FlatVectTree<T, AlOut, IndexT> &TreeOut, const MexMatrix<IdxT, AlPaths> &IndexPaths) const {
+	/*
+	   Gathers the nodes given by the rows of IndexPaths (NPaths x L, one path
+	   per row as in resolvePaths) into TreeOut, a compact tree of depth
+	   depth()-L+1 whose top level entry k is (a copy of) the node of row k.
+	   i.e. TreeOut{k} is the result of getVectTree for the k'th path. Paths
+	   may repeat.
+
+	   This replaces NPaths calls of getVectTree: the paths are resolved in
+	   L parallel passes and the nodes are gathered with every level of
+	   TreeOut sized exactly once (see gatherRanges).
+	*/
+
+	MexVector<size_t, CAllocator> RangeBeg, RangeEnd(IndexPaths.nrows());
+	resolvePaths(IndexPaths, RangeBeg);
+	ParallelFor(0, RangeBeg.size(), 1 << 14, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t k = ChunkBeg; k < ChunkEnd; ++k)
+			RangeEnd[k] = RangeBeg[k] + 1;
+	});
+
+	MexVector<MexVector<IndexT, AlOut>, AlOut> GatheredPartInds;
+	MexVector<T, AlOut> GatheredData;
+	FlatVectTree<T, AlOut, IndexT>::gatherRanges(*this, uint32_t(IndexPaths.ncols() - 1), RangeBeg, RangeEnd, GatheredPartInds, GatheredData);
+
+	TreeOut.assign(std::move(GatheredPartInds), std::move(GatheredData), true);
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<typename IdxT, class AlPaths, class AlSpans>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::getDataSpans(const MexMatrix<IdxT, AlPaths> &IndexPaths, MexVector<IndexT, AlSpans> &SpanBeg, MexVector<IndexT, AlSpans> &SpanEnd) const {
+	/*
+	   Gives, without copying any data, the range [SpanBeg[k], SpanEnd[k]) of
+	   Data under the node of each row k of IndexPaths (as in resolvePaths).
+	   For paths of length depth() (leaves) these are the leaf vectors
+	   themselves, e.g. getData().begin() + SpanBeg[k].
+	*/
+
+	MexVector<size_t, CAllocator> NodeInds;
+	resolvePaths(IndexPaths, NodeInds);
+
+	uint32_t NodeLevel = uint32_t(IndexPaths.ncols() - 1);
+	uint32_t TreeDepth = this->depth();
+	size_t NPaths = NodeInds.size();
+	MexVector<IndexT, AlSpans> SpanBegOut(NPaths), SpanEndOut(NPaths);
+	ParallelFor(0, NPaths, 1 << 14, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t k = ChunkBeg; k < ChunkEnd; ++k) {
+			IndexT CurrBeg = PartitionIndex[NodeLevel][NodeInds[k]];
+			IndexT CurrEnd = PartitionIndex[NodeLevel][NodeInds[k] + 1];
+			for (uint32_t l = NodeLevel + 1; l < TreeDepth; ++l) {
+				CurrBeg = PartitionIndex[l][CurrBeg];
+				CurrEnd = PartitionIndex[l][CurrEnd];
+			}
+			SpanBegOut[k] = CurrBeg;
+			SpanEndOut[k] = CurrEnd;
+		}
+	});
+	SpanBeg.swap(SpanBegOut);
+	SpanEnd.swap(SpanEndOut);
+}
+
 /////////////////////////////////////////////////
 // PROPERTY ASSIGNMENT FUNCTIONS ////////////////
 /////////////////////////////////////////////////
 
-template<typename T, class FVT_Al, class B>
-inline bool FlatVectTree<T, FVT_Al, B>::setDepth(uint32_t NewDepth)
+template<typename T, class FVT_Al, typename IndexT, class B>
+inline bool FlatVectTree<T, FVT_Al, IndexT, B>::setDepth(uint32_t NewDepth)
 {
 	/*
 	   This function sets the depth of the FlatTreeVect to NewDepth given 
@@ -786,12 +1312,12 @@ inline bool FlatVectTree<T, FVT_Al, B>::setDepth(uint32_t NewDepth)
 
 	uint32_t OldDepth = this->depth();
 	if (OldDepth == 0) {
-		PartitionIndex.resize(NewDepth, MexVector<uint32_t>(1, (uint32_t)0));
+		PartitionIndex.resize(NewDepth, MexVector<IndexT, FVT_Al>(1, (IndexT)0));
 		// it is assumed that given that OldDepth == 0, Data is Empty
 		return true;
 	}
 	else if (OldDepth < NewDepth) {
-		MexVector<MexVector<uint32_t> > NewPartitionIndex(NewDepth, MexVector<uint32_t>(1, (uint32_t)0));
+		MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> NewPartitionIndex(NewDepth, MexVector<IndexT, FVT_Al>(1, (IndexT)0));
 
 		if (!this->isempty()) {
 			for (uint32_t i = 0; i < NewDepth - OldDepth - 1; ++i) {
@@ -827,7 +1353,7 @@ inline bool FlatVectTree<T, FVT_Al, B>::setDepth(uint32_t NewDepth)
 				}
 
 			if (isValid) {
-				MexVector<MexVector<uint32_t> > NewPartitionIndex(NewDepth);
+				MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> NewPartitionIndex(NewDepth);
 				for (uint32_t i = 0; i < NewDepth; ++i)
 					NewPartitionIndex[i].swap(PartitionIndex[i + OldDepth - NewDepth]);
 				PartitionIndex.swap(NewPartitionIndex);
@@ -843,8 +1369,8 @@ inline bool FlatVectTree<T, FVT_Al, B>::setDepth(uint32_t NewDepth)
 	}
 }
 
-template<typename T, class FVT_Al, class B>
-inline void FlatVectTree<T, FVT_Al, B>::clear()
+template<typename T, class FVT_Al, typename IndexT, class B>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::clear()
 {
 	uint32_t CurrDepth = this->depth();
 	for (uint32_t i = 0; i < CurrDepth; ++i) {
@@ -854,8 +1380,8 @@ inline void FlatVectTree<T, FVT_Al, B>::clear()
 	Data.clear();
 }
 
-template<typename T, class FVT_Al, class B>
-inline void FlatVectTree<T, FVT_Al, B>::empty()
+template<typename T, class FVT_Al, typename IndexT, class B>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::empty()
 {
 	this->clear();
 	this->setDepth(0);
@@ -867,19 +1393,34 @@ inline void FlatVectTree<T, FVT_Al, B>::empty()
 // MEMORY RELEASE FUNCTIONS /////////////////////
 /////////////////////////////////////////////////
 
-template<typename T, class FVT_Al, class B>
-inline void FlatVectTree<T, FVT_Al, B>::releaseMem(MexVector<MexVector<uint32_t, FVT_Al>, FVT_Al> &ReleasedPartInds, MexVector<T, FVT_Al> &ReleasedData)
+template<typename ElemT, class Al>
+inline void releaseFVTVector(MexVector<ElemT, Al> &Src, MexVector<ElemT, Al> &Released) {
+	// Moves the array of Src into Released leaving Src empty. If Src holds
+	// external memory (e.g. a tree assigned with ActualCopy = false),
+	// Released is given the same external memory instead, as it cannot be
+	// released.
+	if (Src.ismemext()) {
+		Released.assign(Src.size(), Src.begin(), false);
+		MexVector<ElemT, Al> EmptyVect;
+		Src.swap(EmptyVect);
+	}
+	else {
+		size_t NElems = Src.size();
+		Released.assign(NElems, Src.releaseArray());
+	}
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
+inline void FlatVectTree<T, FVT_Al, IndexT, B>::releaseMem(MexVector<MexVector<IndexT, FVT_Al>, FVT_Al> &ReleasedPartInds, MexVector<T, FVT_Al> &ReleasedData)
 {
 	uint32_t TreeDepth = this->depth();
 
 	// Relinquishing PartitionIndex and Data arrays 
 	ReleasedPartInds.resize(TreeDepth);
 	for (uint32_t i = 0; i < TreeDepth; ++i) {
-		uint32_t NElemsinCurrLevel = PartitionIndex[i].size();
-		ReleasedPartInds[i].assign(NElemsinCurrLevel, PartitionIndex[i].releaseArray());
+		releaseFVTVector(PartitionIndex[i], ReleasedPartInds[i]);
 	}
-	uint32_t NElemsData = Data.size();
-	ReleasedData.assign(NElemsData, Data.releaseArray());
+	releaseFVTVector(Data, ReleasedData);
 
 	// Reinitializing PartitionInds and Data
 	for (uint32_t i = 0; i < TreeDepth; ++i) {
@@ -892,62 +1433,59 @@ inline void FlatVectTree<T, FVT_Al, B>::releaseMem(MexVector<MexVector<uint32_t,
 // STATIC FUNCTIONS         /////////////////////
 /////////////////////////////////////////////////
 
-template<typename T, class FVT_Al, class B>
+template<typename IndexT>
+inline bool isSortedPartitionLevel(const IndexT* PartInds, size_t NElems) {
+	// Checks (in parallel chunks) that PartInds is sorted. The inner loop is
+	// a branchless reduction so that it can be vectorized.
+	if (NElems < 2)
+		return true;
+
+	std::atomic<bool> isUnsorted(false);
+	ParallelFor(0, NElems - 1, 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		bool isChunkUnsorted = false;
+		for (size_t j = ChunkBeg; j < ChunkEnd; ++j)
+			isChunkUnsorted |= (PartInds[j] > PartInds[j + 1]);
+		if (isChunkUnsorted)
+			isUnsorted = true;
+	});
+	return !isUnsorted;
+}
+
+template<typename T, class FVT_Al, typename IndexT, class B>
 template<class AlSub, class Al, class AlData>
-inline bool FlatVectTree<T, FVT_Al, B>::isValidFVT(const MexVector<MexVector<uint32_t, AlSub>, Al>& PartitionInds, const MexVector<T, AlData>& Data)
+inline bool FlatVectTree<T, FVT_Al, IndexT, B>::isValidFVTShape(const MexVector<MexVector<IndexT, AlSub>, Al>& PartitionInds, const MexVector<T, AlData>& Data)
 {
-	bool isValid = true;
-	
-	size_t NLevels = PartitionInds.size();
+	// Performs the O(depth) part of the validation i.e. checks that each
+	// level is non-empty, starts with 0 and ends with the BTE element equal
+	// to the size of the level below (or Data). Only the sortedness of the
+	// levels remains to be checked for the tree to be valid.
 
-	if (PartitionInds.size() > 0) {
+	size_t NLevels = PartitionInds.size();
+	if (NLevels == 0)
+		return Data.size() == 0;
 
-		// Checking if sizes > 0
-		for (uint32_t i = 0; i < NLevels && isValid; ++i) {
-			size_t NElemsatCurrLevel = PartitionInds[i].size();
-			if (PartitionInds[i].size() == 0) {
-				isValid = false;
-				break;
-			}
-		}
+	bool isValid = true;
+	for (size_t i = 0; i < NLevels && isValid; ++i) {
+		size_t NextLevelSize = (i + 1 < NLevels) ? PartitionInds[i + 1].size() - 1 : Data.size();
+		isValid = PartitionInds[i].size() > 0
+		          && PartitionInds[i][0] == 0
+		          && PartitionInds[i].last() == NextLevelSize;
+	}
+	return isValid;
+}
 
-		// Checking sorted
-		if(isValid)
-		for (uint32_t i = 0; i < NLevels && isValid; ++i) {
-			size_t NElemsatCurrLevel = PartitionInds[i].size();
-			for (uint32_t j = 0; j < NElemsatCurrLevel - 1; ++j) {
-				if (PartitionInds[i][j] > PartitionInds[i][j + 1]) {
-					isValid = false;
-					break;
-				}
-			}
-		}
+template<typename T, class FVT_Al, typename IndexT, class B>
+template<class AlSub, class Al, class AlData>
+inline bool FlatVectTree<T, FVT_Al, IndexT, B>::isValidFVT(const MexVector<MexVector<IndexT, AlSub>, Al>& PartitionInds, const MexVector<T, AlData>& Data)
+{
+	// The shape is validated first as it is cheap. After this, each level
+	// is scanned exactly once (for sortedness).
 
-		// Chacking validity of first elements (must be 0)
-		if (isValid)
-		for (uint32_t i = 0; i < NLevels && isValid; ++i) {
-			if (PartitionInds[i][0] != 0) {
-				isValid = false;
-				break;
-			}
-		}
+	bool isValid = isValidFVTShape(PartitionInds, Data);
 
-		// Checking validity of BTE Elems
-		if (isValid)
-		for (uint32_t i = 0; i < NLevels - 1 && isValid; ++i) {
-			if (PartitionInds[i].last() != PartitionInds[i + 1].size() - 1) {
-				isValid = false;
-				break;
-			}
-		}
-		if (isValid)
-		if (PartitionInds.last().last() != Data.size())
-			isValid = false;
-	}
-	else {
-		if (Data.size() > 0)
-			isValid = false;
-	}
+	size_t NLevels = PartitionInds.size();
+	for (size_t i = 0; i < NLevels && isValid; ++i)
+		isValid = isSortedPartitionLevel(PartitionInds[i].begin(), PartitionInds[i].size());
 
 	return isValid;
 }
@@ -0,0 +1,156 @@
+#ifndef FLAT_VECT_TREE_BUILDER_HPP
+#define FLAT_VECT_TREE_BUILDER_HPP
+
+#include <limits>
+#include <stdint.h>
+
+#include "FlatVectTree.hpp"
+
+template <typename T, class FVT_Al = mxAllocator, typename IndexT = uint32_t>
+class FlatVectTreeBuilder {
+	/*
+	   FlatVectTreeBuilder appends to a FlatVectTree in a streaming fashion
+	   i.e. without materializing the subtrees as nested MexVectors. The
+	   builder keeps a cursor of open nodes (one per level). open() starts a
+	   new node (cell) inside the innermost open node, push() appends values
+	   to the innermost node (which must then be a leaf i.e. the number of
+	   open nodes must equal the depth of the tree) and close() closes it.
+
+	   For a tree of depth 2 (a cell array of cell arrays of vectors)
+
+	       FlatVectTreeBuilder<float> Builder(Tree);
+	       Builder.open();           // Tree{end+1}
+	       Builder.open();           // Tree{end}{1}
+	       Builder.push(1.0f);       // Tree{end}{1} = [1]
+	       Builder.push(2.0f);       // Tree{end}{1} = [1 2]
+	       Builder.close();
+	       Builder.pushLeaf(V, N);   // Tree{end}{2} = V(1:N)
+	       Builder.close();
+
+	   Every operation is O(1) (amortized) and writes directly into the
+	   PartitionIndex and Data of the tree. The beyond-the-end entries of the
+	   levels are kept up to date on every operation, so the tree is valid
+	   at all times (the open nodes are just its last entries), and close()
+	   only moves the cursor.
+
+	   The tree must not be modified other than through the builder while
+	   the builder is in use.
+	*/
+
+	typedef FlatVectTree<T, FVT_Al, IndexT> FVTType;
+
+	FVTType* Tree;
+	uint32_t TreeDepth;
+	uint32_t NOpenNodes;
+
+	inline void incrementLast(MexVector<IndexT, FVT_Al> &Level, size_t Increment) {
+		// Increments the BTE element of Level, validating the range of IndexT
+		IndexT &LastElem = Level.last();
+		if (size_t(std::numeric_limits<IndexT>::max() - LastElem) < Increment) {
+			WriteException(
+				FV_ExCodes::FV_INVALID_APPEND,
+				"The size of the FlatVectTree exceeds the range of its index type (max %llu)",
+				(unsigned long long)std::numeric_limits<IndexT>::max()
+			);
+		}
+		LastElem = IndexT(LastElem + Increment);
+	}
+	inline void validateLeafOpen() const {
+		if (NOpenNodes != TreeDepth) {
+			WriteException(
+				FV_ExCodes::FV_INVALID_APPEND,
+				"Values can be pushed only into an open leaf (%d nodes open in a tree of depth %d)",
+				NOpenNodes, TreeDepth
+			);
+		}
+	}
+
+public:
+	inline explicit FlatVectTreeBuilder(FVTType &TreeOut) : Tree(&TreeOut), TreeDepth(TreeOut.depth()), NOpenNodes(0) {
+		if (TreeDepth == 0) {
+			WriteException(FV_ExCodes::FV_INVALID_APPEND, "The FlatVectTree to be built must have a depth of at least 1 (construct it with its depth)");
+		}
+	}
+
+	// Cursor Operations
+	inline void open() {
+		/*
+		   Opens a new node inside the innermost open node (at the top level
+		   if none are open). The node is an entry of PartitionIndex[Level]
+		   where Level is the number of nodes open before the call.
+		*/
+		if (NOpenNodes == TreeDepth) {
+			WriteException(
+				FV_ExCodes::FV_INVALID_APPEND,
+				"Cannot open a node inside a leaf (%d nodes are already open in a tree of depth %d)",
+				NOpenNodes, TreeDepth
+			);
+		}
+		auto &CurrLevel = Tree->PartitionIndex[NOpenNodes];
+		if (NOpenNodes > 0)
+			incrementLast(Tree->PartitionIndex[NOpenNodes - 1], 1);
+		IndexT NewEntryBeg = CurrLevel.last(); // (copied as push_back may reallocate)
+		CurrLevel.push_back(NewEntryBeg);
+		++NOpenNodes;
+	}
+	inline void open(uint32_t Level) {
+		// Closes the open nodes down to Level, and opens a new node at Level
+		if (Level > NOpenNodes) {
+			WriteException(
+				FV_ExCodes::FV_INVALID_APPEND,
+				"Cannot open a node at level %d when only %d nodes are open",
+				Level, NOpenNodes
+			);
+		}
+		NOpenNodes = Level;
+		open();
+	}
+	inline void close() {
+		if (NOpenNodes == 0) {
+			WriteException(FV_ExCodes::FV_INVALID_APPEND, "There are no open nodes to close");
+		}
+		--NOpenNodes;
+	}
+	inline void closeAll() {
+		NOpenNodes = 0;
+	}
+
+	// Data Operations (valid only when a leaf is open)
+	inline void push(const T &Value) {
+		validateLeafOpen();
+		incrementLast(Tree->PartitionIndex[TreeDepth - 1], 1);
+		Tree->Data.push_back(Value);
+	}
+	inline void push(const T* Values, size_t NValues) {
+		validateLeafOpen();
+		incrementLast(Tree->PartitionIndex[TreeDepth - 1], NValues);
+		size_t OldSize = Tree->Data.size();
+		Tree->Data.push_size(NValues);
+		std::copy(Values, Values + NValues, Tree->Data.begin() + OldSize);
+	}
+	inline void pushLeaf(const T* Values, size_t NValues) {
+		// Opens a leaf (the innermost open node must be at level depth-1),
+		// fills it with the given values and closes it
+		open();
+		push(Values, NValues);
+		close();
+	}
+
+	// Pre-Sizing (for when the final sizes are known)
+	inline void reserve(uint32_t Level, size_t NEntries) {
+		Tree->PartitionIndex[Level].reserve(Tree->PartitionIndex[Level].size() + NEntries);
+	}
+	inline void reserveData(size_t NValues) {
+		Tree->Data.reserve(Tree->Data.size() + NValues);
+	}
+
+	// Property Access
+	inline uint32_t nOpenNodes() const {
+		return NOpenNodes;
+	}
+	inline const FVTType &tree() const {
+		return *Tree;
+	}
+};
+
+#endif
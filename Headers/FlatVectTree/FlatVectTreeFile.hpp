@@ -0,0 +1,394 @@
+#ifndef FLAT_VECT_TREE_FILE_HPP
+#define FLAT_VECT_TREE_FILE_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "FlatVectTree.hpp"
+#include "../MexTypeTraits.hpp"
+#include "../MemoryMappedFile.hpp"
+
+/*
+   Binary file format for FlatVectTree (and MexVector, MexMatrix), version 1
+
+   Offset  Size         Contents
+   0       64           FVTFileHeader
+   64      16*Depth     FVTFileArrayEntry of each PartitionIndex level
+   ...     16           FVTFileArrayEntry of Data
+   ...                  The arrays, each starting at a multiple of
+                        FVTFileAlignment bytes (zero padded)
+
+   The integers and arrays are stored in the native (little endian) byte
+   order. A MexVector is stored as a tree of depth 0 i.e. only Data, a
+   MexMatrix likewise with Kind = FVT_FILE_MATRIX and its shape in the
+   header (Data holds the elements in the order of MexMatrix).
+
+   The files are read by mapping them into memory (MappedFlatVectTree,
+   MappedMexVector, MappedMexMatrix) so that the Data is never read on
+   opening and its pages are read in on demand (and shared between the
+   processes mapping it). Opening is O(1), except that the PartitionIndex
+   of a FlatVectTree is validated unless the file is trusted (see
+   MappedFlatVectTree).
+*/
+
+const char     FVTFileMagic[8]  = { 'F', 'V', 'T', 'R', 'E', 'E', '\0', '\0' };
+const uint32_t FVTFileVersion   = 1;
+const uint64_t FVTFileAlignment = 64;
+
+enum FVTFileKind {
+	FVT_FILE_TREE   = 0, // FlatVectTree (or MexVector if Depth is 0)
+	FVT_FILE_MATRIX = 1  // MexMatrix (Depth is 0)
+};
+
+enum FVTFileElemKind {
+	FVT_ELEM_UNSIGNED = 0,
+	FVT_ELEM_SIGNED   = 1,
+	FVT_ELEM_FLOAT    = 2,
+	FVT_ELEM_BOOL     = 3
+};
+
+template <typename T> inline uint32_t getFVTFileElemKind() {
+	return std::is_same<T, bool>::value       ? FVT_ELEM_BOOL
+	     : std::is_floating_point<T>::value   ? FVT_ELEM_FLOAT
+	     : std::is_signed<T>::value           ? FVT_ELEM_SIGNED
+	     :                                      FVT_ELEM_UNSIGNED;
+}
+
+struct FVTFileHeader {
+	char     Magic[8];
+	uint32_t Version;
+	uint32_t HeaderSize; // sizeof(FVTFileHeader)
+	uint32_t ElemKind;   // FVTFileElemKind of the Data
+	uint32_t ElemSize;   // sizeof an element of Data
+	uint32_t IndexSize;  // sizeof an element of PartitionIndex
+	uint32_t Depth;
+	uint64_t FileSize;
+	uint32_t ClassID;    // mxClassID of Data (GetMexType), mxUNKNOWN_CLASS if it has none
+	uint32_t Kind;       // FVTFileKind
+	uint64_t NRows;      // The shape if Kind is FVT_FILE_MATRIX (0 otherwise)
+	uint64_t NCols;
+};
+
+struct FVTFileArrayEntry {
+	uint64_t Offset; // Byte offset of the array in the file
+	uint64_t NElems;
+};
+
+static_assert(sizeof(FVTFileHeader) == 64, "FVTFileHeader must be 64 bytes");
+static_assert(sizeof(FVTFileArrayEntry) == 16, "FVTFileArrayEntry must be 16 bytes");
+
+/////////////////////////////////////////////////
+// WRITING FUNCTIONS         ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T, typename IndexT>
+inline void writeFVTFileArrays(const std::string &FilePath, const std::vector<MexVectorView<IndexT> > &Levels, const MexVectorView<T> &DataIn,
+                               uint32_t Kind = FVT_FILE_TREE, uint64_t NRows = 0, uint64_t NCols = 0) {
+
+	// Writes the given levels and data in the above format. The layout is
+	// computed first so that the header can be written in one go.
+
+	uint32_t Depth = Levels.size();
+	std::vector<FVTFileArrayEntry> ArrayEntries(Depth + 1);
+
+	uint64_t CurrOffset = sizeof(FVTFileHeader) + (Depth + 1)*sizeof(FVTFileArrayEntry);
+	for (uint32_t i = 0; i <= Depth; ++i) {
+		uint64_t NElems   = (i < Depth) ? Levels[i].size() : DataIn.size();
+		uint64_t ElemSize = (i < Depth) ? sizeof(IndexT) : sizeof(T);
+		CurrOffset = (CurrOffset + FVTFileAlignment - 1) / FVTFileAlignment * FVTFileAlignment;
+		ArrayEntries[i].Offset = CurrOffset;
+		ArrayEntries[i].NElems = NElems;
+		CurrOffset += NElems*ElemSize;
+	}
+
+	FVTFileHeader Header;
+	std::memset(&Header, 0, sizeof(FVTFileHeader));
+	std::memcpy(Header.Magic, FVTFileMagic, sizeof(FVTFileMagic));
+	Header.Version    = FVTFileVersion;
+	Header.HeaderSize = sizeof(FVTFileHeader);
+	Header.ElemKind   = getFVTFileElemKind<T>();
+	Header.ElemSize   = sizeof(T);
+	Header.IndexSize  = sizeof(IndexT);
+	Header.Depth      = Depth;
+	Header.FileSize   = CurrOffset;
+	Header.ClassID    = uint32_t(GetMexType<T>::typeVal);
+	Header.Kind       = Kind;
+	Header.NRows      = NRows;
+	Header.NCols      = NCols;
+
+	FILE* File = std::fopen(FilePath.c_str(), "wb");
+	if (File == NULL) {
+		WriteException(FV_ExCodes::FV_INVALID_FILE, "Could not open the file '%s' for writing", FilePath.c_str());
+	}
+
+	const char Padding[FVTFileAlignment] = {};
+	uint64_t WrittenBytes = 0;
+	bool isWriteOK = std::fwrite(&Header, sizeof(FVTFileHeader), 1, File) == 1
+	              && std::fwrite(ArrayEntries.data(), sizeof(FVTFileArrayEntry), Depth + 1, File) == Depth + 1;
+	WrittenBytes = sizeof(FVTFileHeader) + (Depth + 1)*sizeof(FVTFileArrayEntry);
+
+	for (uint32_t i = 0; i <= Depth && isWriteOK; ++i) {
+		const void* ArrayBeg = (i < Depth) ? (const void*)Levels[i].begin() : (const void*)DataIn.begin();
+		size_t ElemSize = (i < Depth) ? sizeof(IndexT) : sizeof(T);
+		size_t NElems = ArrayEntries[i].NElems;
+
+		size_t NPadding = ArrayEntries[i].Offset - WrittenBytes;
+		isWriteOK = std::fwrite(Padding, 1, NPadding, File) == NPadding
+		         && (NElems == 0 || std::fwrite(ArrayBeg, ElemSize, NElems, File) == NElems);
+		WrittenBytes = ArrayEntries[i].Offset + NElems*ElemSize;
+	}
+	isWriteOK = (std::fclose(File) == 0) && isWriteOK;
+
+	if (!isWriteOK) {
+		WriteException(FV_ExCodes::FV_INVALID_FILE, "Error writing the file '%s'", FilePath.c_str());
+	}
+}
+
+template <typename T, class Al, typename IndexT>
+inline void writeFlatVectTreeFile(const std::string &FilePath, const FlatVectTree<T, Al, IndexT> &TreeIn) {
+	std::vector<MexVectorView<IndexT> > Levels(TreeIn.depth());
+	for (uint32_t i = 0; i < TreeIn.depth(); ++i)
+		Levels[i] = TreeIn.getPartitionIndex(i);
+	writeFVTFileArrays<T, IndexT>(FilePath, Levels, TreeIn.getData());
+}
+
+template <typename T, class Al>
+inline void writeMexVectorFile(const std::string &FilePath, const MexVector<T, Al> &VectIn) {
+	writeFVTFileArrays<T, uint32_t>(FilePath, std::vector<MexVectorView<uint32_t> >(), MexVectorView<T>(VectIn));
+}
+
+template <typename T, class Al>
+inline void writeMexMatrixFile(const std::string &FilePath, const MexMatrix<T, Al> &MatrixIn) {
+	writeFVTFileArrays<T, uint32_t>(FilePath, std::vector<MexVectorView<uint32_t> >(), MexVectorView<T>(MatrixIn.nrows()*MatrixIn.ncols(), MatrixIn.begin()),
+	                                FVT_FILE_MATRIX, MatrixIn.nrows(), MatrixIn.ncols());
+}
+
+/////////////////////////////////////////////////
+// MAPPING FUNCTIONS         ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T, typename IndexT>
+inline const FVTFileArrayEntry* getFVTFileArrayEntries(const MemoryMappedFile &File, const std::string &FilePath) {
+
+	// Validates the header (and the array table) of the mapped file for the
+	// given T and IndexT, and returns the table. Only the header and table
+	// are read i.e. this is O(depth). The sizes are all checked by division
+	// so that no product of (corrupt) sizes can overflow.
+
+	size_t FileSize = File.size();
+	const FVTFileHeader* Header = reinterpret_cast<const FVTFileHeader*>(File.data());
+
+	if (FileSize < sizeof(FVTFileHeader) || std::memcmp(Header->Magic, FVTFileMagic, sizeof(FVTFileMagic)) != 0) {
+		WriteException(FV_ExCodes::FV_INVALID_FILE, "The file '%s' is not a FlatVectTree file", FilePath.c_str());
+	}
+	if (Header->Version > FVTFileVersion || Header->HeaderSize != sizeof(FVTFileHeader)) {
+		WriteException(FV_ExCodes::FV_INVALID_FILE, "The file '%s' has an unsupported version (%d)", FilePath.c_str(), Header->Version);
+	}
+	if (Header->ElemKind != getFVTFileElemKind<T>() || Header->ElemSize != sizeof(T)
+	    || (Header->ClassID != uint32_t(mxUNKNOWN_CLASS) && Header->ClassID != uint32_t(GetMexType<T>::typeVal))) {
+		WriteException(FV_ExCodes::FV_INVALID_FILE,
+		               "The data type in the file '%s' (kind %d, %d bytes) does not match the requested type (kind %d, %d bytes)",
+		               FilePath.c_str(), Header->ElemKind, Header->ElemSize, getFVTFileElemKind<T>(), int(sizeof(T)));
+	}
+	if (Header->Depth > 0 && Header->IndexSize != sizeof(IndexT)) {
+		WriteException(FV_ExCodes::FV_INVALID_FILE,
+		               "The PartitionIndex in the file '%s' has %d byte indices while %d byte indices were requested",
+		               FilePath.c_str(), Header->IndexSize, int(sizeof(IndexT)));
+	}
+	if (Header->FileSize != FileSize || Header->Kind > FVT_FILE_MATRIX
+	    || (FileSize - sizeof(FVTFileHeader)) / sizeof(FVTFileArrayEntry) < uint64_t(Header->Depth) + 1) {
+		WriteException(FV_ExCodes::FV_INVALID_FILE, "The file '%s' is truncated or corrupt", FilePath.c_str());
+	}
+
+	const FVTFileArrayEntry* ArrayEntries = reinterpret_cast<const FVTFileArrayEntry*>(File.data() + sizeof(FVTFileHeader));
+	for (uint32_t i = 0; i <= Header->Depth; ++i) {
+		uint64_t ElemSize = (i < Header->Depth) ? sizeof(IndexT) : sizeof(T);
+		uint64_t Offset = ArrayEntries[i].Offset;
+		uint64_t NElems = ArrayEntries[i].NElems;
+		if (Offset % FVTFileAlignment != 0 || Offset > FileSize || NElems > (FileSize - Offset) / ElemSize) {
+			WriteException(FV_ExCodes::FV_INVALID_FILE, "The file '%s' is truncated or corrupt", FilePath.c_str());
+		}
+	}
+	if (Header->Kind == FVT_FILE_MATRIX) {
+		uint64_t NElems = ArrayEntries[0].NElems;
+		bool isShapeValid = Header->Depth == 0 && (
+			(Header->NCols == 0) ? NElems == 0
+			                     : NElems % Header->NCols == 0 && NElems / Header->NCols == Header->NRows);
+		if (!isShapeValid) {
+			WriteException(FV_ExCodes::FV_INVALID_FILE, "The file '%s' is truncated or corrupt", FilePath.c_str());
+		}
+	}
+	return ArrayEntries;
+}
+
+template <typename T, typename IndexT = uint32_t>
+class MappedFlatVectTree {
+	/*
+	   MappedFlatVectTree opens a FlatVectTree file (see writeFlatVectTreeFile)
+	   by mapping it into memory. tree() is a FlatVectTree whose levels and
+	   Data alias the mapped file (as with assign(..., ActualCopy = false)),
+	   so all the read-only FlatVectTree functionality (views, getVectTree,
+	   copying into another tree etc.) works without loading the file.
+
+	   The tree must not be modified (the mapping is read-only). It is valid
+	   as long as this object is open. By default the tree is fully validated
+	   on opening i.e. the first and last entries of each level and their
+	   sortedness, which reads the entire PartitionIndex (but not Data). Pass
+	   isTrusted = true to only check the shape (first and last entries), so
+	   that opening is O(depth). This is only safe for files written by this
+	   library and not modified since, as an unsorted level leads to reads
+	   outside the mapping.
+	*/
+
+	MemoryMappedFile File;
+	FlatVectTree<T, CAllocator, IndexT> Tree;
+
+public:
+	inline MappedFlatVectTree() : File(), Tree() {}
+	inline explicit MappedFlatVectTree(const std::string &FilePath, bool isTrusted = false) : File(), Tree() {
+		open(FilePath, isTrusted);
+	}
+
+	inline void open(const std::string &FilePath, bool isTrusted = false) {
+		close();
+		MemoryMappedFile NewFile(FilePath);
+		const FVTFileArrayEntry* ArrayEntries = getFVTFileArrayEntries<T, IndexT>(NewFile, FilePath);
+		const FVTFileHeader* Header = reinterpret_cast<const FVTFileHeader*>(NewFile.data());
+		uint32_t Depth = Header->Depth;
+		char* FileBeg = const_cast<char*>(NewFile.data());
+
+		if (Header->Kind != FVT_FILE_TREE || (Depth == 0 && ArrayEntries[0].NElems > 0)) {
+			// (a truly empty tree is stored with depth 0 and no data)
+			WriteException(FV_ExCodes::FV_INVALID_FILE, "The file '%s' contains a MexVector or MexMatrix and not a FlatVectTree", FilePath.c_str());
+		}
+		MexVector<MexVector<IndexT, CAllocator>, CAllocator> Levels(Depth);
+		MexVector<T, CAllocator> DataIn;
+		for (uint32_t i = 0; i < Depth; ++i)
+			Levels[i].assign(ArrayEntries[i].NElems, reinterpret_cast<IndexT*>(FileBeg + ArrayEntries[i].Offset), false);
+		DataIn.assign(ArrayEntries[Depth].NElems, reinterpret_cast<T*>(FileBeg + ArrayEntries[Depth].Offset), false);
+
+		Tree.assign(Levels, DataIn, false, isTrusted);
+		File.swap(NewFile);
+	}
+	inline void close() {
+		// Dropping the aliases into the mapping before unmapping it
+		MexVector<MexVector<IndexT, CAllocator>, CAllocator> ReleasedPartInds;
+		MexVector<T, CAllocator> ReleasedData;
+		Tree.releaseMem(ReleasedPartInds, ReleasedData);
+		Tree.empty();
+		File.close();
+	}
+
+	inline bool isopen() const {
+		return File.isopen();
+	}
+	inline const FlatVectTree<T, CAllocator, IndexT> &tree() const {
+		return Tree;
+	}
+};
+
+template <typename T>
+class MappedMexVector {
+	/*
+	   MappedMexVector opens a MexVector file (see writeMexVectorFile) by
+	   mapping it into memory. vect() is a MexVector holding the mapped
+	   memory as external memory, valid as long as this object is open. The
+	   elements may only be modified through writableVect(), which requires
+	   the file to be opened MemoryMappedFile::COPY_ON_WRITE (the changes are
+	   private to this mapping, the file is unchanged).
+	*/
+
+	MemoryMappedFile File;
+	MexVector<T, CAllocator> Vect;
+
+public:
+	inline MappedMexVector() : File(), Vect() {}
+	inline explicit MappedMexVector(const std::string &FilePath, MemoryMappedFile::MapMode Mode = MemoryMappedFile::READ_ONLY) : File(), Vect() {
+		open(FilePath, Mode);
+	}
+
+	inline void open(const std::string &FilePath, MemoryMappedFile::MapMode Mode = MemoryMappedFile::READ_ONLY) {
+		close();
+		MemoryMappedFile NewFile(FilePath, Mode);
+		const FVTFileArrayEntry* ArrayEntries = getFVTFileArrayEntries<T, uint32_t>(NewFile, FilePath);
+		const FVTFileHeader* Header = reinterpret_cast<const FVTFileHeader*>(NewFile.data());
+		if (Header->Depth != 0 || Header->Kind != FVT_FILE_TREE) {
+			WriteException(FV_ExCodes::FV_INVALID_FILE, "The file '%s' contains a FlatVectTree or MexMatrix and not a MexVector", FilePath.c_str());
+		}
+		Vect.assign(ArrayEntries[0].NElems, reinterpret_cast<T*>(const_cast<char*>(NewFile.data()) + ArrayEntries[0].Offset), false);
+		File.swap(NewFile);
+	}
+	inline void close() {
+		Vect.assign(0, (T*)NULL, false);
+		File.close();
+	}
+
+	inline bool isopen() const {
+		return File.isopen();
+	}
+	inline const MexVector<T, CAllocator> &vect() const {
+		return Vect;
+	}
+	inline MexVector<T, CAllocator> &writableVect() {
+		if (File.mode() != MemoryMappedFile::COPY_ON_WRITE) {
+			WriteException(FV_ExCodes::FV_INVALID_FILE, "The mapped MexVector can only be modified if it is opened COPY_ON_WRITE");
+		}
+		return Vect;
+	}
+	inline MexVectorView<T> view() const {
+		return MexVectorView<T>(Vect);
+	}
+};
+
+template <typename T>
+class MappedMexMatrix {
+	/*
+	   MappedMexMatrix opens a MexMatrix file (see writeMexMatrixFile) by
+	   mapping it into memory. matrix() / writableMatrix() are as vect() /
+	   writableVect() of MappedMexVector.
+	*/
+
+	MemoryMappedFile File;
+	MexMatrix<T, CAllocator> Matrix;
+
+public:
+	inline MappedMexMatrix() : File(), Matrix() {}
+	inline explicit MappedMexMatrix(const std::string &FilePath, MemoryMappedFile::MapMode Mode = MemoryMappedFile::READ_ONLY) : File(), Matrix() {
+		open(FilePath, Mode);
+	}
+
+	inline void open(const std::string &FilePath, MemoryMappedFile::MapMode Mode = MemoryMappedFile::READ_ONLY) {
+		close();
+		MemoryMappedFile NewFile(FilePath, Mode);
+		const FVTFileArrayEntry* ArrayEntries = getFVTFileArrayEntries<T, uint32_t>(NewFile, FilePath);
+		const FVTFileHeader* Header = reinterpret_cast<const FVTFileHeader*>(NewFile.data());
+		if (Header->Kind != FVT_FILE_MATRIX) {
+			WriteException(FV_ExCodes::FV_INVALID_FILE, "The file '%s' does not contain a MexMatrix", FilePath.c_str());
+		}
+		Matrix.assign(size_t(Header->NRows), size_t(Header->NCols),
+		              reinterpret_cast<T*>(const_cast<char*>(NewFile.data()) + ArrayEntries[0].Offset), false);
+		File.swap(NewFile);
+	}
+	inline void close() {
+		Matrix.assign(0, 0, (T*)NULL, false);
+		File.close();
+	}
+
+	inline bool isopen() const {
+		return File.isopen();
+	}
+	inline const MexMatrix<T, CAllocator> &matrix() const {
+		return Matrix;
+	}
+	inline MexMatrix<T, CAllocator> &writableMatrix() {
+		if (File.mode() != MemoryMappedFile::COPY_ON_WRITE) {
+			WriteException(FV_ExCodes::FV_INVALID_FILE, "The mapped MexMatrix can only be modified if it is opened COPY_ON_WRITE");
+		}
+		return Matrix;
+	}
+};
+
+#endif
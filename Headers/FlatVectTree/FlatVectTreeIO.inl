@@ -15,14 +15,16 @@ inline bool VECT_TREE_FIELD_INFO_(T) CheckType(const mxArray* InputmxArray) {
 				// Extract elements from PartitionIndex and Data and confirm if 
 				// they represent a valid FlatVectTree / FlatCellArray
 				typedef typename isFlatVectTree<T>::type TypeofData;
+				typedef typename isFlatVectTree<T>::indexType TypeofIndex;
 				
-				MexVector<MexVector<uint32_t> > PartitionIndex;
+				MexVector<MexVector<TypeofIndex> > PartitionIndex;
 				MexVector<TypeofData> Data;
 
 				moveIntoVectors(InputmxArray, PartitionIndex, Data);
 
-				// Validate FlatVectTree
-				isValid = FlatVectTree<TypeofData>::isValidFVT(PartitionIndex, Data);
+				// Validate FlatVectTree (always in full, the ValidationToken
+				// can be forged and is not trusted here)
+				isValid = FlatVectTree<TypeofData, mxAllocator, TypeofIndex>::isValidFVT(PartitionIndex, Data);
 			}
 			else
 				isValid = false;
@@ -81,10 +83,112 @@ inline uint32_t VECT_TREE_FIELD_INFO_(T) getDepth(const mxArray* InputmxArray)
 	return TreeDepth;
 }
 
+inline bool getPartitionIndexClass(const mxArray* PartitionIndexmxArr, mxClassID &IndexClass) {
+
+	// Finds the class of the (non-empty) levels of the PartitionIndex cell
+	// array PartitionIndexmxArr. Returns false if the levels are not all
+	// uint32 vectors or all uint64 vectors. IndexClass is mxUNKNOWN_CLASS if
+	// there are no non-empty levels.
+
+	IndexClass = mxUNKNOWN_CLASS;
+	if (PartitionIndexmxArr == nullptr || mxIsEmpty(PartitionIndexmxArr))
+		return true;
+	if (!mxIsCell(PartitionIndexmxArr))
+		return false;
+
+	size_t TreeDepth = mxGetNumberOfElements(PartitionIndexmxArr);
+	const mxArray* const* PartitionIndexLevelsmxArr = reinterpret_cast<const mxArray* const*>(mxGetData(PartitionIndexmxArr));
+	for (size_t i = 0; i < TreeDepth; ++i) {
+		const mxArray* CurrLevel = PartitionIndexLevelsmxArr[i];
+		if (CurrLevel == nullptr || mxIsEmpty(CurrLevel))
+			continue;
+
+		mxClassID CurrClass = mxGetClassID(CurrLevel);
+		if ((CurrClass != mxUINT32_CLASS && CurrClass != mxUINT64_CLASS)
+			|| (!FieldInfo<MexVector<uint32_t> >::CheckType(CurrLevel) && !FieldInfo<MexVector<uint64_t> >::CheckType(CurrLevel))
+			|| (IndexClass != mxUNKNOWN_CLASS && IndexClass != CurrClass))
+			return false;
+		IndexClass = CurrClass;
+	}
+	return true;
+}
+
+inline bool hasMatchingValidationToken(const mxArray* InputmxArray) {
+
+	// The ValidationToken field of a FlatCellArray struct (as given by
+	// FlatCellArray.Convert2Struct or assignmxArray) is the uint64 vector of
+	// the number of elements in each level of PartitionIndex followed by
+	// that of Data. It is NOT a certificate of validity: anyone can
+	// recompute it, and editing an index in place keeps it matching. It is
+	// only a sanity check for callers that explicitly trust the struct
+	// (e.g. the 'Trusted' option of FlatCellArrayMex, used by the methods
+	// of FlatCellArray on their own private arrays). Such callers skip the
+	// O(size) validation if the token matches.
+
+	if (InputmxArray == nullptr || !mxIsStruct(InputmxArray) || mxIsEmpty(InputmxArray))
+		return false;
+
+	const mxArray* TokenmxArr = mxGetField(InputmxArray, 0, "ValidationToken");
+	const mxArray* PartitionIndexmxArr = mxGetField(InputmxArray, 0, "PartitionIndex");
+	const mxArray* DatamxArr = mxGetField(InputmxArray, 0, "Data");
+	if (TokenmxArr == nullptr || mxGetClassID(TokenmxArr) != mxUINT64_CLASS
+		|| PartitionIndexmxArr == nullptr || !mxIsCell(PartitionIndexmxArr) || DatamxArr == nullptr)
+		return false;
+
+	size_t TreeDepth = mxGetNumberOfElements(PartitionIndexmxArr);
+	if (mxGetNumberOfElements(TokenmxArr) != TreeDepth + 1)
+		return false;
+
+	const uint64_t* TokenVals = reinterpret_cast<const uint64_t*>(mxGetData(TokenmxArr));
+	for (size_t i = 0; i < TreeDepth; ++i) {
+		const mxArray* CurrLevel = mxGetCell(PartitionIndexmxArr, i);
+		if (CurrLevel == nullptr || mxGetNumberOfElements(CurrLevel) != TokenVals[i])
+			return false;
+	}
+	return mxGetNumberOfElements(DatamxArr) == TokenVals[TreeDepth];
+}
+
+template <typename T, class Al, typename IndexT>
+inline mxArrayPtr createValidationToken(const FlatVectTree<T, Al, IndexT> &FlatVectTreeIn) {
+	// Returns the ValidationToken (see hasMatchingValidationToken) of the
+	// (necessarily valid) FlatVectTreeIn
+	uint32_t TreeDepth = FlatVectTreeIn.depth();
+	mxArrayPtr TokenmxArr = mxCreateNumericMatrix(TreeDepth + 1, 1, mxUINT64_CLASS, mxREAL);
+	uint64_t* TokenVals = reinterpret_cast<uint64_t*>(mxGetData(TokenmxArr));
+	for (uint32_t i = 0; i < TreeDepth; ++i)
+		TokenVals[i] = uint64_t(FlatVectTreeIn.LevelSize(i)) + 1;
+	TokenVals[TreeDepth] = FlatVectTreeIn.getData().size();
+	return TokenmxArr;
+}
+
+template <typename IndexTIn, typename IndexT>
+inline void copyPartitionIndexLevel(const mxArray* LevelmxArr, MexVector<IndexT> &LevelOut) {
+
+	// Copies (with conversion) the PartitionIndex level LevelmxArr of type
+	// IndexTIn into LevelOut, raising an exception if a value does not fit
+	// into IndexT.
+
+	size_t LevelNElems = mxGetNumberOfElements(LevelmxArr);
+	const IndexTIn* LevelIn = reinterpret_cast<const IndexTIn*>(mxGetData(LevelmxArr));
+
+	// The whole level is checked as the input is not validated at this point
+	bool isOverflow = false;
+	for (size_t j = 0; j < LevelNElems; ++j)
+		isOverflow |= (LevelIn[j] > std::numeric_limits<IndexT>::max());
+	if (isOverflow) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+		               "The PartitionIndex contains values that exceed the range of the index type of the FlatVectTree\n");
+	}
+
+	LevelOut.resize(LevelNElems);
+	for (size_t j = 0; j < LevelNElems; ++j)
+		LevelOut[j] = static_cast<IndexT>(LevelIn[j]);
+}
+
 template<typename T>
 inline void VECT_TREE_FIELD_INFO_(T) moveIntoVectors(
 	const mxArray* InputmxArray, 
-	MexVector<MexVector<uint32_t> >& PartitionIndexIn, 
+	MexVector<MexVector<typename isFlatVectTree<T>::indexType> >& PartitionIndexIn, 
 	MexVector<typename isFlatVectTree<T>::type>& DataIn)
 {
 	// This function moves the data in InputmxArray (interpreted as a FlatCellArray)
@@ -92,12 +196,23 @@ inline void VECT_TREE_FIELD_INFO_(T) moveIntoVectors(
 	// fields are of invalid type then it raises an exception. If they are empty, then
 	// he corresponding vector is empty. The function makes no attempt to verify
 	// the correctness of the data.
+	//
+	// The PartitionIndex may be either uint32 or uint64. If it matches the index
+	// type of the FlatVectTree, the levels are moved as is, else they are copied
+	// (converting the width).
 
 	// Getting and type validating the fields "PartitionIndexIn" and "Data"
 	typedef typename isFlatVectTree<T>::type TypeofData;
-	const mxArray* PartitionIndexmxArr = getValidStructField<MexVector<MexVector<uint32_t> > >(InputmxArray, "PartitionIndex");
+	typedef typename isFlatVectTree<T>::indexType TypeofIndex;
+	const mxArray* PartitionIndexmxArr = getValidStructField<void>(InputmxArray, "PartitionIndex");
 	const mxArray* DatamxArr = getValidStructField<TypeofData>(InputmxArray, "Data");
 
+	mxClassID IndexClass;
+	if (!getPartitionIndexClass(PartitionIndexmxArr, IndexClass)) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+		               "The PartitionIndex must be a cell array of vectors of type uint32 or uint64\n");
+	}
+
 	// Calculating TreeDepth
 	uint32_t TreeDepth = 0;
 	if (PartitionIndexmxArr)
@@ -109,13 +224,18 @@ inline void VECT_TREE_FIELD_INFO_(T) moveIntoVectors(
 
 	// Filling PartitionIndexIn
 	if (TreeDepth > 0) {
-		PartitionIndexIn.resize(TreeDepth, MexVector<uint32_t>());
+		PartitionIndexIn.resize(TreeDepth, MexVector<TypeofIndex>());
 		mxArrayPtr * PartitionIndexLevelsmxArr = (mxArrayPtr *)mxGetData(PartitionIndexmxArr);
 		for (int i = 0; i < TreeDepth; ++i) {
-			int LevelNElems = FieldInfo<MexVector<uint32_t> >::getSize(PartitionIndexLevelsmxArr[i]);
-			if (LevelNElems > 0) {
-				PartitionIndexIn[i].assign(LevelNElems, (uint32_t *)mxGetData(PartitionIndexLevelsmxArr[i]), false);
-			}
+			size_t LevelNElems = FieldInfo<void>::getSize(PartitionIndexLevelsmxArr[i]);
+			if (LevelNElems == 0)
+				continue;
+			else if (IndexClass == GetMexType<TypeofIndex>::typeVal)
+				PartitionIndexIn[i].assign(LevelNElems, (TypeofIndex *)mxGetData(PartitionIndexLevelsmxArr[i]), false);
+			else if (IndexClass == mxUINT32_CLASS)
+				copyPartitionIndexLevel<uint32_t>(PartitionIndexLevelsmxArr[i], PartitionIndexIn[i]);
+			else
+				copyPartitionIndexLevel<uint64_t>(PartitionIndexLevelsmxArr[i], PartitionIndexIn[i]);
 		}
 	}
 
@@ -124,52 +244,112 @@ inline void VECT_TREE_FIELD_INFO_(T) moveIntoVectors(
 		DataIn.assign(mxGetNumberOfElements(DatamxArr), (TypeofData *)mxGetData(DatamxArr), false);
 }
 
-template<typename T> inline mxArrayPtr assignmxArray(FlatVectTree<T> &FlatVectTreeOut) {
+template <typename IndexTOut, typename IndexT>
+inline mxArrayPtr assignmxPartitionIndex(MexVector<MexVector<IndexT> > &PartitionIndex) {
+
+	// Returns the cell array of PartitionIndex with elements of type
+	// IndexTOut. If IndexTOut is IndexT, the memory of each level is released
+	// to MATLAB, else the levels are converted into new arrays (and freed).
+
+	if (std::is_same<IndexTOut, IndexT>::value)
+		return assignmxArray(PartitionIndex);
+
+	size_t TreeDepth = PartitionIndex.size();
+	mxArrayPtr ReturnPtr = mxCreateCellMatrix(TreeDepth, 1);
+	for (size_t i = 0; i < TreeDepth; ++i) {
+		size_t LevelNElems = PartitionIndex[i].size();
+		mxArrayPtr LevelmxArr = mxCreateUninitNumericMatrix(LevelNElems, 1, GetMexType<IndexTOut>::typeVal, mxREAL);
+		IndexTOut* LevelOut = reinterpret_cast<IndexTOut*>(mxGetData(LevelmxArr));
+		for (size_t j = 0; j < LevelNElems; ++j)
+			LevelOut[j] = static_cast<IndexTOut>(PartitionIndex[i][j]);
+		mxSetCell(ReturnPtr, i, LevelmxArr);
+
+		PartitionIndex[i].clear();
+		PartitionIndex[i].trim();
+	}
+	return ReturnPtr;
+}
+
+template<typename T, typename IndexT> inline mxArrayPtr assignmxArray(FlatVectTree<T, mxAllocator, IndexT> &FlatVectTreeOut, mxClassID IndexClassOut) {
+
+	// IndexClassOut (mxUINT32_CLASS or mxUINT64_CLASS) is the class of the
+	// output PartitionIndex. mxUNKNOWN_CLASS selects uint32 if all the
+	// indices fit into it, and uint64 otherwise. Only if IndexClassOut
+	// corresponds to IndexT is the memory of FlatVectTreeOut released to
+	// MATLAB without copying.
 
 	const char* FieldNames[] = {
 		"ClassName",
 		"PartitionIndex",
-		"Data"
+		"Data",
+		"ValidationToken"
 	};
-	size_t NFields = 3;
+	size_t NFields = 4;
 	mwSize ArraySize[] = { 1, 1 };
 
-	mxArrayPtr ReturnPtr = mxCreateStructArray(2, ArraySize, 3, FieldNames);
+	// The largest index value of a level is its BTE element, i.e. the size
+	// of the next level (or Data).
+	size_t MaxIndexVal = FlatVectTreeOut.getData().size();
+	for (uint32_t i = 0; i < FlatVectTreeOut.depth(); ++i)
+		MaxIndexVal = std::max<size_t>(MaxIndexVal, FlatVectTreeOut.LevelSize(i));
+
+	if (IndexClassOut == mxUNKNOWN_CLASS)
+		IndexClassOut = (MaxIndexVal <= std::numeric_limits<uint32_t>::max()) ? mxUINT32_CLASS : mxUINT64_CLASS;
+	if (IndexClassOut != mxUINT32_CLASS && IndexClassOut != mxUINT64_CLASS) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The PartitionIndex can only be output as uint32 or uint64\n");
+	}
+	if (IndexClassOut == mxUINT32_CLASS && MaxIndexVal > std::numeric_limits<uint32_t>::max()) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The FlatVectTree is too large for a uint32 PartitionIndex\n");
+	}
+
+	mxArrayPtr ReturnPtr = mxCreateStructArray(2, ArraySize, NFields, FieldNames);
+	mxArrayPtr ValidationTokenmxArr = createValidationToken(FlatVectTreeOut);
 	
 	// Releasing Memory of FlatVectTreeOut
-	MexVector<MexVector<uint32_t> > PartitionIndex;
+	MexVector<MexVector<IndexT> > PartitionIndex;
 	MexVector<T> Data;
 	FlatVectTreeOut.releaseMem(PartitionIndex, Data);
 
+	mxArrayPtr PartitionIndexmxArr = (IndexClassOut == mxUINT32_CLASS)
+	                                 ? assignmxPartitionIndex<uint32_t>(PartitionIndex)
+	                                 : assignmxPartitionIndex<uint64_t>(PartitionIndex);
+
 	mxSetField(ReturnPtr, 0, "ClassName"     , mxCreateString("FlatCellArray"));
-	mxSetField(ReturnPtr, 0, "PartitionIndex", assignmxArray(PartitionIndex));
+	mxSetField(ReturnPtr, 0, "PartitionIndex", PartitionIndexmxArr);
 	mxSetField(ReturnPtr, 0, "Data"          , assignmxArray(Data          ));
+	mxSetField(ReturnPtr, 0, "ValidationToken", ValidationTokenmxArr);
 
 	return ReturnPtr;
 }
 
-template <typename T, class Al> static void getInputfrommxArray(const mxArray* InputArray, FlatVectTree<T, Al> &FlatVectTreeIn) {
+template<typename T, typename IndexT> inline mxArrayPtr assignmxArray(FlatVectTree<T, mxAllocator, IndexT> &FlatVectTreeOut) {
+	return assignmxArray(FlatVectTreeOut, GetMexType<IndexT>::typeVal);
+}
+
+template <typename T, class Al, typename IndexT> static void getInputfrommxArray(const mxArray* InputArray, FlatVectTree<T, Al, IndexT> &FlatVectTreeIn, bool isValidated) {
 
 	// Note: in this function, it is assumed that InputArray is a Valid FlatVectTreeIn
-	// with non-zero depth.
+	// with non-zero depth. isValidated implies that it has already been
+	// validated (e.g. by FieldInfo::CheckType) and is not validated again.
+	// Otherwise it is validated in full (a ValidationToken is not trusted).
 
 	// Declared with mxAllocator as they are to be used to move the 
 	// input mex arrays
-	MexVector<MexVector<uint32_t> > PartitionIndex;
+	MexVector<MexVector<IndexT> > PartitionIndex;
 	MexVector<T> Data;
 
-	FieldInfo<FlatVectTree<T, Al> >::moveIntoVectors(InputArray, PartitionIndex, Data);
-	FlatVectTreeIn.assign(PartitionIndex, Data);
+	FieldInfo<FlatVectTree<T, Al, IndexT> >::moveIntoVectors(InputArray, PartitionIndex, Data);
+	FlatVectTreeIn.assign(PartitionIndex, Data, true, isValidated);
 }
 
-template <typename TSpec, typename T, typename B, class Al> static int getInputfromStruct(
+template <typename TSpec, typename T, typename B, class Al, typename IndexT> static int getInputfromStruct(
 	const mxArray* InputStruct, const char* FieldName, 
-	FlatVectTree<T, Al> &FlatVectTreeIn, uint32_t RequiredDepth,
+	FlatVectTree<T, Al, IndexT> &FlatVectTreeIn, uint32_t RequiredDepth,
 	MexMemInputOps InputOps) {
 
-	const mxArray* StructFieldPtr = getValidStructField<FlatVectTree<T,Al> >(InputStruct, FieldName, InputOps);
+	const mxArray* StructFieldPtr = getValidStructField<FlatVectTree<T, Al, IndexT> >(InputStruct, FieldName, InputOps);
 	if (StructFieldPtr != nullptr) {
-		uint32_t GivenTreeDepth = FieldInfo<FlatVectTree<T, Al> >::getDepth(StructFieldPtr);
+		uint32_t GivenTreeDepth = FieldInfo<FlatVectTree<T, Al, IndexT> >::getDepth(StructFieldPtr);
 		if (GivenTreeDepth > 0 && GivenTreeDepth != RequiredDepth) {
 			if (!InputOps.QUIET)
 				WriteOutput("The depth of the given FlatVectTree (%d), does not match the depth required (%d)\n", GivenTreeDepth, RequiredDepth);
@@ -177,7 +357,7 @@ template <typename TSpec, typename T, typename B, class Al> static int getInputf
 				throw ExOps::EXCEPTION_INVALID_INPUT;
 		}
 		else if (GivenTreeDepth > 0)
-			getInputfrommxArray(StructFieldPtr, FlatVectTreeIn);
+			getInputfrommxArray(StructFieldPtr, FlatVectTreeIn, true); // Validated by getValidStructField
 		else
 			return 1;
 		return 0;
@@ -185,4 +365,327 @@ template <typename TSpec, typename T, typename B, class Al> static int getInputf
 	else {
 		return 1;
 	}
-}
\ No newline at end of file
+}
+
+/////////////////////////////////////////////////
+// CELL ARRAY CONVERSION FUNCTIONS //////////////
+/////////////////////////////////////////////////
+
+struct CellArrayLevelInfo {
+	// Result of the sizing pass over a (nested) cell array. LevelSizes[i] is the
+	// total number of cells at level i (i.e. PartitionIndex{i} has
+	// LevelSizes[i]+1 elements). LeafClass is the class of the non-empty leaf
+	// vectors (mxUNKNOWN_CLASS if there are none), isUniformClass is false if
+	// the leaves are of more than one class.
+	std::vector<size_t> LevelSizes;
+	size_t DataSize;
+	uint32_t CellDepth;
+	uint32_t MinLeafLevel;
+	uint32_t MaxLeafLevel;
+	mxClassID LeafClass;
+	bool isUniformClass;
+
+	CellArrayLevelInfo() :
+		LevelSizes(), DataSize(0), CellDepth(0),
+		MinLeafLevel(uint32_t(-1)), MaxLeafLevel(0),
+		LeafClass(mxUNKNOWN_CLASS), isUniformClass(true) {}
+};
+
+inline bool isFlattenableLeafType(mxClassID ClassIDin) {
+	return isMexVectorType(ClassIDin) || ClassIDin == mxLOGICAL_CLASS || ClassIDin == mxCHAR_CLASS;
+}
+
+inline void getCellArrayLevelInfo(const mxArray* InputArray, uint32_t Level, CellArrayLevelInfo &LevelInfo) {
+
+	// Recursively accumulates the level sizes of InputArray, which is at
+	// the given Level of the cell array tree. Empty non-cell arrays (and
+	// unassigned cells) are treated as being of undecided type and depth.
+
+	if (InputArray != nullptr && mxIsCell(InputArray)) {
+		size_t NSubElems = mxGetNumberOfElements(InputArray);
+		const mxArray* const* SubElemArray = reinterpret_cast<const mxArray* const*>(mxGetData(InputArray));
+
+		if (LevelInfo.LevelSizes.size() <= Level)
+			LevelInfo.LevelSizes.resize(Level + 1, 0);
+		LevelInfo.LevelSizes[Level] += NSubElems;
+		if (LevelInfo.CellDepth < Level + 1)
+			LevelInfo.CellDepth = Level + 1;
+
+		for (size_t i = 0; i < NSubElems; ++i)
+			getCellArrayLevelInfo(SubElemArray[i], Level + 1, LevelInfo);
+	}
+	else if (InputArray != nullptr && !mxIsEmpty(InputArray)) {
+		mxClassID CurrClass = mxGetClassID(InputArray);
+		if (!isFlattenableLeafType(CurrClass)) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+			               "The cell array contains an element of unsupported class '%s' at level %d\n",
+			               mxGetClassName(InputArray), Level);
+		}
+		if (LevelInfo.LeafClass == mxUNKNOWN_CLASS)
+			LevelInfo.LeafClass = CurrClass;
+		else if (LevelInfo.LeafClass != CurrClass)
+			LevelInfo.isUniformClass = false;
+
+		LevelInfo.DataSize += mxGetNumberOfElements(InputArray);
+		if (LevelInfo.MinLeafLevel > Level) LevelInfo.MinLeafLevel = Level;
+		if (LevelInfo.MaxLeafLevel < Level) LevelInfo.MaxLeafLevel = Level;
+	}
+}
+
+template <typename TypeSrc, typename TypeDest>
+inline void castCopyLeaf(const void* SrcBeg, size_t NElems, TypeDest* DestBeg) {
+	if (std::is_same<TypeSrc, TypeDest>::value) {
+		std::memcpy(DestBeg, SrcBeg, NElems*sizeof(TypeDest));
+	}
+	else {
+		const TypeSrc* SrcArr = reinterpret_cast<const TypeSrc*>(SrcBeg);
+		for (size_t i = 0; i < NElems; ++i)
+			DestBeg[i] = static_cast<TypeDest>(SrcArr[i]);
+	}
+}
+
+template <typename TypeDest>
+inline void copyLeafData(const mxArray* LeafArray, TypeDest* DestBeg) {
+
+	// Copies the elements of the (numeric, logical or char) LeafArray into
+	// DestBeg converting them to TypeDest.
+
+	size_t NElems = mxGetNumberOfElements(LeafArray);
+	const void* SrcBeg = mxGetData(LeafArray);
+
+	switch (mxGetClassID(LeafArray)) {
+		case mxINT8_CLASS    : castCopyLeaf<int8_t  >(SrcBeg, NElems, DestBeg); break;
+		case mxUINT8_CLASS   : castCopyLeaf<uint8_t >(SrcBeg, NElems, DestBeg); break;
+		case mxINT16_CLASS   : castCopyLeaf<int16_t >(SrcBeg, NElems, DestBeg); break;
+		case mxUINT16_CLASS  : castCopyLeaf<uint16_t>(SrcBeg, NElems, DestBeg); break;
+		case mxINT32_CLASS   : castCopyLeaf<int32_t >(SrcBeg, NElems, DestBeg); break;
+		case mxUINT32_CLASS  : castCopyLeaf<uint32_t>(SrcBeg, NElems, DestBeg); break;
+		case mxINT64_CLASS   : castCopyLeaf<int64_t >(SrcBeg, NElems, DestBeg); break;
+		case mxUINT64_CLASS  : castCopyLeaf<uint64_t>(SrcBeg, NElems, DestBeg); break;
+		case mxSINGLE_CLASS  : castCopyLeaf<float   >(SrcBeg, NElems, DestBeg); break;
+		case mxDOUBLE_CLASS  : castCopyLeaf<double  >(SrcBeg, NElems, DestBeg); break;
+		case mxLOGICAL_CLASS : castCopyLeaf<mxLogical>(SrcBeg, NElems, DestBeg); break;
+		case mxCHAR_CLASS    : castCopyLeaf<mxChar  >(SrcBeg, NElems, DestBeg); break;
+		default:
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+			               "Cannot convert array of class '%s' into FlatVectTree data\n",
+			               mxGetClassName(LeafArray));
+	}
+}
+
+template <typename T, class Al, typename IndexT>
+inline void fillFVTfromCellArray(
+	const mxArray* InputArray, uint32_t Level, uint32_t TreeDepth,
+	MexVector<size_t, CAllocator> &LevelWritePos,
+	MexVector<MexVector<IndexT, Al>, Al> &PartitionIndex,
+	MexVector<T, Al> &Data) {
+
+	// Writes the cells of InputArray (at Level < TreeDepth) into the presized
+	// PartitionIndex and Data. LevelWritePos[i] is the position at which the
+	// next entry of level i is to be written (i = TreeDepth being Data). The
+	// Beyond-The-End elements are not written here.
+
+	if (InputArray == nullptr || !mxIsCell(InputArray))
+		return; // empty array of undecided depth
+
+	size_t NSubElems = mxGetNumberOfElements(InputArray);
+	const mxArray* const* SubElemArray = reinterpret_cast<const mxArray* const*>(mxGetData(InputArray));
+
+	IndexT* CurrLevelPartInds = PartitionIndex[Level].begin();
+	size_t &CurrLevelPos = LevelWritePos[Level];
+	size_t &NextLevelPos = LevelWritePos[Level + 1];
+
+	if (Level + 1 < TreeDepth) {
+		for (size_t i = 0; i < NSubElems; ++i) {
+			CurrLevelPartInds[CurrLevelPos++] = IndexT(NextLevelPos);
+			fillFVTfromCellArray(SubElemArray[i], Level + 1, TreeDepth, LevelWritePos, PartitionIndex, Data);
+		}
+	}
+	else {
+		T* DataBeg = Data.begin();
+		for (size_t i = 0; i < NSubElems; ++i) {
+			CurrLevelPartInds[CurrLevelPos++] = IndexT(NextLevelPos);
+			const mxArray* CurrLeaf = SubElemArray[i];
+			if (CurrLeaf != nullptr && !mxIsEmpty(CurrLeaf)) {
+				copyLeafData(CurrLeaf, DataBeg + NextLevelPos);
+				NextLevelPos += mxGetNumberOfElements(CurrLeaf);
+			}
+		}
+	}
+}
+
+inline uint32_t getFlattenedDepth(const mxArray* InputCellArray, const CellArrayLevelInfo &LevelInfo, uint32_t RequiredDepth) {
+
+	// Validates the structure of the cell array given its LevelInfo and
+	// returns the depth of the FlatVectTree that it is flattened into.
+	// RequiredDepth = uint32_t(-1) implies that the depth is to be calculated.
+
+	if (InputCellArray == nullptr || !mxIsCell(InputCellArray)) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The input to be flattened must be a cell array\n");
+	}
+
+	uint32_t CellDepth = LevelInfo.CellDepth;
+	bool isDepthUndecided = (LevelInfo.DataSize == 0);
+
+	// All non-empty leaves must be at the deepest level
+	if (!isDepthUndecided && (LevelInfo.MinLeafLevel != CellDepth || LevelInfo.MaxLeafLevel != CellDepth)) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+		               "The cell array is not uniform in depth (it contains vectors at depths %d through %d, while its depth is %d)\n",
+		               LevelInfo.MinLeafLevel, LevelInfo.MaxLeafLevel, CellDepth);
+	}
+
+	if (RequiredDepth == uint32_t(-1))
+		return CellDepth;
+	else if (RequiredDepth == CellDepth || (isDepthUndecided && RequiredDepth > CellDepth))
+		return RequiredDepth;
+	else {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+		               "The depth of the cell array (%d) does not match the required depth (%d)\n",
+		               CellDepth, RequiredDepth);
+		return 0;
+	}
+}
+
+template <typename T, class Al, typename IndexT>
+inline void FlattenCellArray(const mxArray* InputCellArray, const CellArrayLevelInfo &LevelInfo, FlatVectTree<T, Al, IndexT> &FlatVectTreeOut, uint32_t RequiredDepth = uint32_t(-1)) {
+
+	// Flattens the (nested) cell array InputCellArray into FlatVectTreeOut
+	// without building any intermediate MexVector<MexVector<...> >. LevelInfo
+	// must be the result of getCellArrayLevelInfo(InputCellArray, 0, ...). The
+	// PartitionIndex and Data are allocated once using the level sizes in
+	// LevelInfo and then filled in a single pass (with leaf data converted
+	// to T).
+	//
+	// Empty leaves may appear at any level (they are considered empty cells
+	// of undecided depth), all non-empty leaves must be at the same depth.
+	// If RequiredDepth is specified, it can exceed the calculated depth only
+	// if the cell array contains no data.
+
+	uint32_t TreeDepth = getFlattenedDepth(InputCellArray, LevelInfo, RequiredDepth);
+	size_t NCalcLevels = LevelInfo.LevelSizes.size();
+
+	for (uint32_t i = 0; i < NCalcLevels; ++i) {
+		if (LevelInfo.LevelSizes[i] > std::numeric_limits<IndexT>::max()) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+			               "The number of cells at level %d exceeds the range of the PartitionIndex type\n", i);
+		}
+	}
+	if (LevelInfo.DataSize > std::numeric_limits<IndexT>::max()) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+		               "The total number of data elements exceeds the range of the PartitionIndex type\n");
+	}
+
+	// Allocating all levels (BTE elements written here)
+	MexVector<MexVector<IndexT, Al>, Al> PartitionIndex(TreeDepth);
+	MexVector<T, Al> Data(LevelInfo.DataSize);
+	for (uint32_t i = 0; i < TreeDepth; ++i) {
+		size_t CurrLevelSize = (i     < NCalcLevels) ? LevelInfo.LevelSizes[i    ] : 0;
+		size_t NextLevelSize = (i + 1 < NCalcLevels) ? LevelInfo.LevelSizes[i + 1] : 0;
+		PartitionIndex[i].resize(CurrLevelSize + 1);
+		PartitionIndex[i].last() = IndexT((i + 1 < TreeDepth) ? NextLevelSize : LevelInfo.DataSize);
+	}
+
+	// Filling
+	MexVector<size_t, CAllocator> LevelWritePos(TreeDepth + 1, size_t(0));
+	fillFVTfromCellArray(InputCellArray, 0, TreeDepth, LevelWritePos, PartitionIndex, Data);
+
+	FlatVectTreeOut.assign(std::move(PartitionIndex), std::move(Data));
+}
+
+template <typename T, class Al, typename IndexT>
+inline void FlattenCellArray(const mxArray* InputCellArray, FlatVectTree<T, Al, IndexT> &FlatVectTreeOut, uint32_t RequiredDepth) {
+
+	// Flattens InputCellArray into FlatVectTreeOut in two passes over the
+	// cell array, one to calculate the level sizes, and one to fill the
+	// presized FlatVectTree (see above).
+
+	CellArrayLevelInfo LevelInfo;
+	getCellArrayLevelInfo(InputCellArray, 0, LevelInfo);
+	FlattenCellArray(InputCellArray, LevelInfo, FlatVectTreeOut, RequiredDepth);
+}
+
+template <typename T, class Al, typename IndexT>
+inline mxArrayPtr Convert2CellArray(const FlatVectTree<T, Al, IndexT> &FlatVectTreeIn, uint32_t Level, size_t BegIndex, size_t EndIndex) {
+
+	// Returns the nested cell array (of column vectors) corresponding to the
+	// elements [BegIndex, EndIndex) of the given Level of FlatVectTreeIn (the
+	// whole tree by default). EndIndex = size_t(-1) implies the end of the
+	// level.
+	//
+	// The cell array is built top-down one level at a time. As the
+	// descendants of a contiguous range of elements form a contiguous range
+	// at every lower level, each cell (and leaf vector) is created exactly
+	// once with its final size (read off PartitionIndex), and the leaves are
+	// memcpy'd directly out of Data.
+
+	uint32_t TreeDepth = FlatVectTreeIn.depth();
+	if (TreeDepth == 0)
+		return mxCreateCellMatrix(0, 1);
+
+	if (Level >= TreeDepth) {
+		WriteException(FV_ExCodes::FV_INVALID_FETCH,
+		               "The Level (%d) must be lesser than the depth of the FlatVectTree (%d)\n", Level, TreeDepth);
+	}
+	size_t LevelSize = FlatVectTreeIn.LevelSize(Level);
+	if (EndIndex == size_t(-1))
+		EndIndex = LevelSize;
+	if (BegIndex > EndIndex || EndIndex > LevelSize) {
+		WriteException(FV_ExCodes::FV_INVALID_FETCH,
+		               "The range [%llu, %llu) is invalid for level %d of size %llu\n",
+		               (unsigned long long)BegIndex, (unsigned long long)EndIndex, Level, (unsigned long long)LevelSize);
+	}
+
+	mxClassID ClassID = GetMexType<T>::typeVal;
+	mxArrayPtr ReturnPtr = mxCreateCellMatrix(EndIndex - BegIndex, 1);
+	MexVectorView<T> Data = FlatVectTreeIn.getData();
+
+	// ParentCells[k] is the cell array of the element (BegIndex + k) at the
+	// previous level. For the given Level, the only parent is ReturnPtr.
+	MexVector<mxArrayPtr, CAllocator> ParentCells(1, ReturnPtr);
+	MexVector<mxArrayPtr, CAllocator> CurrCells;
+	MexVector<size_t, CAllocator> ParentChildBeg(2);
+	ParentChildBeg[0] = BegIndex;
+	ParentChildBeg[1] = EndIndex;
+
+	for (uint32_t CurrLevel = Level; CurrLevel < TreeDepth; ++CurrLevel) {
+		MexVectorView<IndexT> CurrPartInds = FlatVectTreeIn.getPartitionIndex(CurrLevel);
+		bool isLeafLevel = (CurrLevel + 1 == TreeDepth);
+
+		size_t CurrBeg = ParentChildBeg[0];
+		size_t CurrEnd = ParentChildBeg.last();
+		if (!isLeafLevel)
+			CurrCells.resize(CurrEnd - CurrBeg);
+
+		size_t NParents = ParentCells.size();
+		for (size_t k = 0; k < NParents; ++k) {
+			size_t ChildBeg = ParentChildBeg[k];
+			size_t ChildEnd = ParentChildBeg[k + 1];
+			mxArrayPtr ParentCell = ParentCells[k];
+
+			for (size_t j = ChildBeg; j < ChildEnd; ++j) {
+				size_t NSubElems = CurrPartInds[j + 1] - CurrPartInds[j];
+				mxArrayPtr CurrElem;
+				if (isLeafLevel) {
+					CurrElem = mxCreateUninitNumericMatrix(NSubElems, 1, ClassID, mxREAL);
+					if (NSubElems)
+						std::memcpy(mxGetData(CurrElem), Data.begin() + CurrPartInds[j], NSubElems*sizeof(T));
+				}
+				else {
+					CurrElem = mxCreateCellMatrix(NSubElems, 1);
+					CurrCells[j - CurrBeg] = CurrElem;
+				}
+				mxSetCell(ParentCell, j - ChildBeg, CurrElem);
+			}
+		}
+
+		// The children of the elements [CurrBeg, CurrEnd) are given by the
+		// corresponding part of the current PartitionIndex
+		if (!isLeafLevel) {
+			ParentCells.swap(CurrCells);
+			ParentChildBeg.resize(CurrEnd - CurrBeg + 1);
+			std::copy(CurrPartInds.begin() + CurrBeg, CurrPartInds.begin() + CurrEnd + 1, ParentChildBeg.begin());
+		}
+	}
+
+	return ReturnPtr;
+}
@@ -0,0 +1,283 @@
+#ifndef FLAT_VECT_TREE_REDUCE_HPP
+#define FLAT_VECT_TREE_REDUCE_HPP
+
+#include <stdint.h>
+#include <limits>
+#include <algorithm>
+
+#include "FlatVectTree.hpp"
+
+/*
+   Segmented reductions and scans over the Data of a FlatVectTree i.e. the
+   equivalent of cellfun(@sum, ...) etc. without expanding the tree into
+   nested MexVectors / cell arrays.
+
+   The reductions at a Level produce one value per entry of
+   PartitionIndex[Level] (LevelSize(Level) values). The leaves (Level ==
+   depth-1) are reduced directly over Data, the higher levels are reduced
+   over the results of the level below using the index ranges in the
+   PartitionIndex (so the reduction at level l costs O(LevelSize(l+1)) over
+   that of level l+1). Thus the reduce operation must be associative.
+
+   The scans restart at the beginning of every node of the given Level and
+   produce one value per element of Data.
+
+   All the work is split across threads by segments (see
+   ParallelForSegments), each thread running contiguous loops over Data.
+   The order of the operations does not depend on the number of threads, so
+   floating point results are reproducible. The results are allocated on the
+   calling thread.
+*/
+
+// Segmented kernels over plain arrays. Bounds[0..NSegs] are absolute
+// indices into In (as the entries of a PartitionIndex level are)
+
+template <typename TIn, typename R, typename IndexT, typename ReduceFuncT>
+inline void segmentedReduce(const IndexT* Bounds, size_t NSegs, const TIn* In, const R &Init, const ReduceFuncT &ReduceFunc, R* Out) {
+	// Out[i] = ReduceFunc(...ReduceFunc(ReduceFunc(Init, In[Bounds[i]]), In[Bounds[i]+1])..., In[Bounds[i+1]-1])
+	ParallelForSegments(Bounds, NSegs, 1 << 14, [&](size_t SegBeg, size_t SegEnd) {
+		for (size_t i = SegBeg; i < SegEnd; ++i) {
+			R Acc = Init;
+			const TIn* SegDataEnd = In + Bounds[i + 1];
+			for (const TIn* Curr = In + Bounds[i]; Curr < SegDataEnd; ++Curr)
+				Acc = ReduceFunc(Acc, *Curr);
+			Out[i] = Acc;
+		}
+	});
+}
+
+template <typename TIn, typename R, typename IndexT, typename ScanFuncT>
+inline void segmentedScan(const IndexT* Bounds, size_t NSegs, const TIn* In, const R &Init, const ScanFuncT &ScanFunc, bool isInclusive, R* Out) {
+	/*
+	   Scans each segment [Bounds[i], Bounds[i+1]) of In into the same
+	   positions of Out, starting from Init. For the exclusive scan, Out[j]
+	   excludes In[j]. In and Out may point to the same array. Elements of
+	   Out outside all segments are left unchanged.
+	*/
+	ParallelForSegments(Bounds, NSegs, 1 << 14, [&](size_t SegBeg, size_t SegEnd) {
+		for (size_t i = SegBeg; i < SegEnd; ++i) {
+			R Acc = Init;
+			size_t SegDataEnd = Bounds[i + 1];
+			if (isInclusive) {
+				for (size_t j = Bounds[i]; j < SegDataEnd; ++j) {
+					Acc = ScanFunc(Acc, In[j]);
+					Out[j] = Acc;
+				}
+			}
+			else {
+				for (size_t j = Bounds[i]; j < SegDataEnd; ++j) {
+					R Next = ScanFunc(Acc, In[j]);
+					Out[j] = Acc;
+					Acc = Next;
+				}
+			}
+		}
+	});
+}
+
+/////// LEVEL HELPERS ///////
+
+template <typename T, class FVT_Al, typename IndexT>
+inline void validateFVTReduceLevel(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level) {
+	if (Level >= TreeIn.depth()) {
+		WriteException(
+			FV_ExCodes::FV_INVALID_FETCH,
+			"The level (%d) to reduce over must be less than the depth of the tree (%d)",
+			Level, TreeIn.depth()
+		);
+	}
+}
+
+template <typename T, class FVT_Al, typename IndexT, class Al>
+inline void getFVTDataBounds(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level, MexVector<IndexT, Al> &BoundsOut) {
+	/*
+	   BoundsOut[i] is the position in Data of the beginning of node i of
+	   Level (BoundsOut has LevelSize(Level)+1 entries, the last being
+	   Data.size()). For the leaves, this is PartitionIndex[depth-1] itself.
+	*/
+	validateFVTReduceLevel(TreeIn, Level);
+	uint32_t TreeDepth = TreeIn.depth();
+	auto LevelInds = TreeIn.getPartitionIndex(Level);
+
+	MexVector<IndexT, Al> Bounds(LevelInds.size());
+	ParallelFor(0, LevelInds.size(), 1 << 14, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t i = ChunkBeg; i < ChunkEnd; ++i) {
+			IndexT CurrBound = LevelInds[i];
+			for (uint32_t l = Level + 1; l < TreeDepth; ++l)
+				CurrBound = TreeIn.getPartitionIndex(l)[CurrBound];
+			Bounds[i] = CurrBound;
+		}
+	});
+	BoundsOut.swap(Bounds);
+}
+
+/////// REDUCTIONS ///////
+
+template <typename T, class FVT_Al, typename IndexT, typename R, class Al, typename ReduceFuncT, typename CombineFuncT>
+inline void FVTReduce(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level, const R &Init,
+                      const ReduceFuncT &ReduceFunc, const CombineFuncT &CombineFunc, MexVector<R, Al> &ReducedOut) {
+	/*
+	   ReducedOut[i] is the reduction of all the Data under node i of Level.
+	   The leaves are reduced with ReduceFunc(R, T) starting from Init, and
+	   the results of each level are combined into those of the level above
+	   with CombineFunc(R, R) starting from Init. (e.g. for a count, ReduceFunc
+	   adds 1 and CombineFunc adds the counts)
+	*/
+	validateFVTReduceLevel(TreeIn, Level);
+	uint32_t TreeDepth = TreeIn.depth();
+
+	auto LeafInds = TreeIn.getPartitionIndex(TreeDepth - 1);
+	MexVector<R, Al> CurrReduced(LeafInds.size() - 1);
+	segmentedReduce(LeafInds.begin(), LeafInds.size() - 1, TreeIn.getData().begin(), Init, ReduceFunc, CurrReduced.begin());
+
+	for (uint32_t l = TreeDepth - 1; l-- > Level; ) {
+		auto LevelInds = TreeIn.getPartitionIndex(l);
+		MexVector<R, Al> LevelReduced(LevelInds.size() - 1);
+		segmentedReduce(LevelInds.begin(), LevelInds.size() - 1, CurrReduced.begin(), Init, CombineFunc, LevelReduced.begin());
+		CurrReduced.swap(LevelReduced);
+	}
+	ReducedOut.swap(CurrReduced);
+}
+
+template <typename T, class FVT_Al, typename IndexT, typename R, class Al, typename ReduceFuncT>
+inline void FVTReduce(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level, const R &Init,
+                      const ReduceFuncT &ReduceFunc, MexVector<R, Al> &ReducedOut) {
+	// For the reductions where the combination is the reduction itself
+	// (sum, min, max, product ...)
+	FVTReduce(TreeIn, Level, Init, ReduceFunc, ReduceFunc, ReducedOut);
+}
+
+// The result type R (e.g. double for sums of integers) is that of the output
+// vector. The empty nodes get 0 (sum), the largest value of R (min), the
+// least value of R (max) and NaN (mean).
+
+template <typename T, class FVT_Al, typename IndexT, typename R, class Al>
+inline void FVTSum(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level, MexVector<R, Al> &SumOut) {
+	FVTReduce(TreeIn, Level, R(0), [](const R &Acc, const R &Val) { return R(Acc + Val); }, SumOut);
+}
+
+template <typename T, class FVT_Al, typename IndexT, typename R, class Al>
+inline void FVTMin(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level, MexVector<R, Al> &MinOut) {
+	R Init = std::numeric_limits<R>::has_infinity ? std::numeric_limits<R>::infinity() : std::numeric_limits<R>::max();
+	FVTReduce(TreeIn, Level, Init, [](const R &Acc, const R &Val) { return (Val < Acc) ? Val : Acc; }, MinOut);
+}
+
+template <typename T, class FVT_Al, typename IndexT, typename R, class Al>
+inline void FVTMax(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level, MexVector<R, Al> &MaxOut) {
+	R Init = std::numeric_limits<R>::has_infinity ? -std::numeric_limits<R>::infinity() : std::numeric_limits<R>::lowest();
+	FVTReduce(TreeIn, Level, Init, [](const R &Acc, const R &Val) { return (Acc < Val) ? Val : Acc; }, MaxOut);
+}
+
+template <typename T, class FVT_Al, typename IndexT, typename R, class Al>
+inline void FVTCount(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level, MexVector<R, Al> &CountOut) {
+	// The number of Data elements under each node of Level (no reduction
+	// required, the counts are the differences of the data bounds)
+	MexVector<IndexT, CAllocator> Bounds;
+	getFVTDataBounds(TreeIn, Level, Bounds);
+	MexVector<R, Al> Counts(Bounds.size() - 1);
+	ParallelFor(0, Counts.size(), 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t i = ChunkBeg; i < ChunkEnd; ++i)
+			Counts[i] = R(Bounds[i + 1] - Bounds[i]);
+	});
+	CountOut.swap(Counts);
+}
+
+template <typename T, class FVT_Al, typename IndexT, typename R, class Al>
+inline void FVTMean(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level, MexVector<R, Al> &MeanOut) {
+	static_assert(std::is_floating_point<R>::value, "The mean must be computed into a floating point type");
+	MexVector<R, Al> Sums, Counts;
+	FVTSum(TreeIn, Level, Sums);
+	FVTCount(TreeIn, Level, Counts);
+	ParallelFor(0, Sums.size(), 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t i = ChunkBeg; i < ChunkEnd; ++i)
+			Sums[i] = (Counts[i] > 0) ? Sums[i] / Counts[i] : std::numeric_limits<R>::quiet_NaN();
+	});
+	MeanOut.swap(Sums);
+}
+
+template <typename T, class FVT_Al, typename IndexT, typename EdgeT, class AlEdges, typename R, class Al>
+inline void FVTHistogram(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level,
+                         const MexVector<EdgeT, AlEdges> &BinEdges, MexVector<R, Al> &HistOut) {
+	/*
+	   Counts the Data under each node of Level into NBins = BinEdges.size()-1
+	   bins, where bin b is [BinEdges[b], BinEdges[b+1]) except the last, which
+	   also includes BinEdges[NBins] (as histcounts). Values outside the edges
+	   and NaNs are not counted. BinEdges must be sorted in ascending order
+	   (and hence must not contain NaNs).
+
+	   HistOut[i*NBins + b] is the count of bin b for node i i.e. HistOut is an
+	   NBins x LevelSize(Level) column-major matrix.
+	*/
+	validateFVTReduceLevel(TreeIn, Level);
+	// (!(a <= b) rather than b < a so that NaN edges are rejected too)
+	auto isOutOfOrder = [](const EdgeT &a, const EdgeT &b) { return !(a <= b); };
+	if (BinEdges.size() < 2 || std::adjacent_find(BinEdges.begin(), BinEdges.end(), isOutOfOrder) != BinEdges.end()) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The histogram bin edges must be a sorted vector of at least 2 elements");
+	}
+	uint32_t TreeDepth = TreeIn.depth();
+	size_t NBins = BinEdges.size() - 1;
+	const EdgeT* EdgesBeg = BinEdges.begin();
+	const EdgeT* EdgesEnd = BinEdges.end();
+
+	// Histograms of the leaves
+	auto LeafInds = TreeIn.getPartitionIndex(TreeDepth - 1);
+	auto DataIn = TreeIn.getData();
+	MexVector<R, Al> CurrHist((LeafInds.size() - 1) * NBins, R(0));
+	ParallelForSegments(LeafInds.begin(), LeafInds.size() - 1, 1 << 14, [&](size_t SegBeg, size_t SegEnd) {
+		for (size_t i = SegBeg; i < SegEnd; ++i) {
+			R* SegHist = CurrHist.begin() + i * NBins;
+			for (size_t j = LeafInds[i]; j < LeafInds[i + 1]; ++j) {
+				EdgeT CurrVal = EdgeT(DataIn[j]);
+				// (written so that NaNs fail the test)
+				if (!(CurrVal >= *EdgesBeg && CurrVal <= *(EdgesEnd - 1)))
+					continue;
+				size_t Bin = std::upper_bound(EdgesBeg, EdgesEnd, CurrVal) - EdgesBeg - 1;
+				++SegHist[(Bin < NBins) ? Bin : NBins - 1];
+			}
+		}
+	});
+
+	// Summing the histograms of the children at the higher levels
+	for (uint32_t l = TreeDepth - 1; l-- > Level; ) {
+		auto LevelInds = TreeIn.getPartitionIndex(l);
+		MexVector<R, Al> LevelHist((LevelInds.size() - 1) * NBins, R(0));
+		ParallelForSegments(LevelInds.begin(), LevelInds.size() - 1, 1 << 14, [&](size_t SegBeg, size_t SegEnd) {
+			for (size_t i = SegBeg; i < SegEnd; ++i) {
+				R* SegHist = LevelHist.begin() + i * NBins;
+				for (size_t j = LevelInds[i]; j < LevelInds[i + 1]; ++j) {
+					const R* ChildHist = CurrHist.begin() + j * NBins;
+					for (size_t b = 0; b < NBins; ++b)
+						SegHist[b] += ChildHist[b];
+				}
+			}
+		});
+		CurrHist.swap(LevelHist);
+	}
+	HistOut.swap(CurrHist);
+}
+
+/////// SCANS ///////
+
+template <typename T, class FVT_Al, typename IndexT, typename R, class Al, typename ScanFuncT>
+inline void FVTScan(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level, const R &Init,
+                    const ScanFuncT &ScanFunc, bool isInclusive, MexVector<R, Al> &ScanOut) {
+	/*
+	   ScanOut (of the size of Data) is the scan of Data restarting at the
+	   beginning of every node of Level (every leaf for Level == depth-1).
+	   ScanOut can be used with the PartitionIndex of TreeIn as the Data of a
+	   tree of the same shape.
+	*/
+	MexVector<IndexT, CAllocator> Bounds;
+	getFVTDataBounds(TreeIn, Level, Bounds);
+	auto DataIn = TreeIn.getData();
+	MexVector<R, Al> Scanned(DataIn.size());
+	segmentedScan(Bounds.begin(), Bounds.size() - 1, DataIn.begin(), Init, ScanFunc, isInclusive, Scanned.begin());
+	ScanOut.swap(Scanned);
+}
+
+template <typename T, class FVT_Al, typename IndexT, typename R, class Al>
+inline void FVTCumSum(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn, uint32_t Level, MexVector<R, Al> &CumSumOut, bool isInclusive = true) {
+	FVTScan(TreeIn, Level, R(0), [](const R &Acc, const R &Val) { return R(Acc + Val); }, isInclusive, CumSumOut);
+}
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef FLAT_VECT_TREE_SORT_HPP
+#define FLAT_VECT_TREE_SORT_HPP
+
+#include <stdint.h>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+#include "FlatVectTree.hpp"
+
+/*
+   Sorting of the leaves of a FlatVectTree, and set operations between the
+   corresponding (sorted) leaves of two FlatVectTrees.
+
+   The segmented sort picks the algorithm by the size of each segment:
+   insertion sort for the small ones, std::sort for the medium ones and an
+   LSD radix sort (on the bit pattern of the elements mapped to an order
+   preserving unsigned key) for the large ones. The segments are split
+   across threads by their sizes (see ParallelForSegments), a segment is
+   always sorted by one thread.
+*/
+
+template <typename T>
+struct FVTRadixKey {
+	/*
+	   Maps T to an unsigned integer of the same size whose order is that of
+	   T. Signed integers have their sign bit flipped. Floating point numbers
+	   have their sign bit flipped if positive and all their bits flipped if
+	   negative (so -0 < +0 and the NaNs sort to the ends, by their sign).
+	*/
+	typedef typename FVTCodeWord<sizeof(T)>::type WordT;
+	static constexpr WordT SignBit = WordT(WordT(1) << (sizeof(T) * 8 - 1));
+
+	static inline WordT toKey(T Val) {
+		WordT Word;
+		std::memcpy(&Word, &Val, sizeof(T));
+		if (std::is_floating_point<T>::value)
+			return (Word & SignBit) ? WordT(~Word) : WordT(Word | SignBit);
+		else if (std::is_signed<T>::value)
+			return WordT(Word ^ SignBit);
+		else
+			return Word;
+	}
+	static inline T fromKey(WordT Key) {
+		WordT Word;
+		if (std::is_floating_point<T>::value)
+			Word = (Key & SignBit) ? WordT(Key ^ SignBit) : WordT(~Key);
+		else if (std::is_signed<T>::value)
+			Word = WordT(Key ^ SignBit);
+		else
+			Word = Key;
+		T Val;
+		std::memcpy(&Val, &Word, sizeof(T));
+		return Val;
+	}
+};
+
+template <typename T>
+inline void FVTInsertionSort(T* Beg, T* End) {
+	for (T* Curr = Beg + (Beg != End); Curr < End; ++Curr) {
+		T CurrVal = *Curr;
+		T* Pos = Curr;
+		for (; Pos > Beg && CurrVal < *(Pos - 1); --Pos)
+			*Pos = *(Pos - 1);
+		*Pos = CurrVal;
+	}
+}
+
+template <typename T, class Al>
+inline void FVTRadixSort(T* Beg, T* End, MexVector<typename FVTRadixKey<T>::WordT, Al> &KeyBuffer) {
+	/*
+	   Sorts [Beg, End) by 8 bit LSD radix passes over the keys. KeyBuffer is
+	   scratch space (grown to twice the size of the range as required) that
+	   may be reused across calls. Passes in which all the keys fall into the
+	   same bucket (e.g. the high bytes of small integers) are skipped.
+	*/
+	typedef typename FVTRadixKey<T>::WordT WordT;
+	size_t NElems = End - Beg;
+	if (KeyBuffer.size() < 2 * NElems)
+		KeyBuffer.resize(2 * NElems);
+
+	WordT* Keys = KeyBuffer.begin();
+	WordT* TempKeys = KeyBuffer.begin() + NElems;
+	for (size_t i = 0; i < NElems; ++i)
+		Keys[i] = FVTRadixKey<T>::toKey(Beg[i]);
+
+	for (uint32_t Shift = 0; Shift < sizeof(WordT) * 8; Shift += 8) {
+		size_t BucketCounts[256] = {0};
+		for (size_t i = 0; i < NElems; ++i)
+			++BucketCounts[(Keys[i] >> Shift) & 0xFF];
+		if (BucketCounts[(Keys[0] >> Shift) & 0xFF] == NElems)
+			continue;
+
+		size_t BucketBeg = 0;
+		for (uint32_t b = 0; b < 256; ++b) {
+			size_t CurrCount = BucketCounts[b];
+			BucketCounts[b] = BucketBeg;
+			BucketBeg += CurrCount;
+		}
+		for (size_t i = 0; i < NElems; ++i)
+			TempKeys[BucketCounts[(Keys[i] >> Shift) & 0xFF]++] = Keys[i];
+		std::swap(Keys, TempKeys);
+	}
+
+	for (size_t i = 0; i < NElems; ++i)
+		Beg[i] = FVTRadixKey<T>::fromKey(Keys[i]);
+}
+
+template <typename T, typename IndexT>
+inline void segmentedSort(const IndexT* Bounds, size_t NSegs, T* Data) {
+	// Sorts (in ascending order) each segment [Bounds[i], Bounds[i+1]) of Data
+
+	static const size_t InsertionSortMaxSize = 32;
+	static const size_t RadixSortMinSize = 2048;
+
+	ParallelForSegments(Bounds, NSegs, 1 << 14, [&](size_t SegBeg, size_t SegEnd) {
+		MexVector<typename FVTRadixKey<T>::WordT, CAllocator> KeyBuffer;
+		for (size_t i = SegBeg; i < SegEnd; ++i) {
+			T* DataBeg = Data + Bounds[i];
+			T* DataEnd = Data + Bounds[i + 1];
+			size_t SegSize = DataEnd - DataBeg;
+			if (SegSize <= InsertionSortMaxSize)
+				FVTInsertionSort(DataBeg, DataEnd);
+			else if (SegSize < RadixSortMinSize)
+				std::sort(DataBeg, DataEnd);
+			else
+				FVTRadixSort(DataBeg, DataEnd, KeyBuffer);
+		}
+	});
+}
+
+template <typename T, class Al, typename IndexT, class AlOut>
+inline void FVTSortLeaves(const FlatVectTree<T, Al, IndexT> &TreeIn, FlatVectTree<T, AlOut, IndexT> &TreeOut) {
+	// Assigns to TreeOut a copy of TreeIn with every leaf sorted in ascending
+	// order. TreeOut may be TreeIn.
+	uint32_t TreeDepth = TreeIn.depth();
+	MexVector<MexVector<IndexT, AlOut>, AlOut> PartitionIndexOut(TreeDepth);
+	for (uint32_t l = 0; l < TreeDepth; ++l) {
+		auto LevelIn = TreeIn.getPartitionIndex(l);
+		MexVector<IndexT, AlOut> LevelOut(LevelIn.size());
+		std::copy(LevelIn.begin(), LevelIn.end(), LevelOut.begin());
+		PartitionIndexOut[l].swap(LevelOut);
+	}
+	auto DataIn = TreeIn.getData();
+	MexVector<T, AlOut> DataOut(DataIn.size());
+	std::copy(DataIn.begin(), DataIn.end(), DataOut.begin());
+
+	if (TreeDepth > 0) {
+		auto &LeafInds = PartitionIndexOut[TreeDepth - 1];
+		segmentedSort(LeafInds.begin(), LeafInds.size() - 1, DataOut.begin());
+	}
+	TreeOut.assign(std::move(PartitionIndexOut), std::move(DataOut), true);
+}
+
+/////// LEAF-WISE SET OPERATIONS ///////
+
+enum FVTSetOp {
+	FVT_SET_INTERSECT,
+	FVT_SET_UNION,
+	FVT_SET_DIFFERENCE
+};
+
+template <FVTSetOp SetOp, typename T>
+inline size_t FVTSortedSetOp(const T* ABeg, const T* AEnd, const T* BBeg, const T* BEnd, T* Out) {
+	/*
+	   Merges the sorted ranges A and B as std::set_intersection /
+	   std::set_union / std::set_difference do (i.e. repeated elements are
+	   treated as a multiset) and returns the number of elements of the
+	   result. If Out is NULL, the elements are only counted.
+	*/
+	size_t NOut = 0;
+	auto emit = [&](const T &Val) {
+		if (Out != NULL)
+			Out[NOut] = Val;
+		++NOut;
+	};
+	while (ABeg < AEnd && BBeg < BEnd) {
+		if (*ABeg < *BBeg) {
+			if (SetOp != FVT_SET_INTERSECT)
+				emit(*ABeg);
+			++ABeg;
+		}
+		else if (*BBeg < *ABeg) {
+			if (SetOp == FVT_SET_UNION)
+				emit(*BBeg);
+			++BBeg;
+		}
+		else {
+			if (SetOp != FVT_SET_DIFFERENCE)
+				emit(*ABeg);
+			++ABeg;
+			++BBeg;
+		}
+	}
+	if (SetOp != FVT_SET_INTERSECT)
+		for (; ABeg < AEnd; ++ABeg)
+			emit(*ABeg);
+	if (SetOp == FVT_SET_UNION)
+		for (; BBeg < BEnd; ++BBeg)
+			emit(*BBeg);
+	return NOut;
+}
+
+template <FVTSetOp SetOp, typename T, class AlA, class AlB, typename IndexT, class AlOut>
+inline void FVTLeafSetOp(const FlatVectTree<T, AlA, IndexT> &TreeA, const FlatVectTree<T, AlB, IndexT> &TreeB,
+                         FlatVectTree<T, AlOut, IndexT> &TreeOut) {
+	/*
+	   Assigns to TreeOut the tree whose leaf i is SetOp(leaf i of TreeA, leaf
+	   i of TreeB). The leaves of both trees must be sorted (see
+	   FVTSortLeaves), and the trees must have the same depth and number of
+	   leaves. The levels above the leaves are copied from TreeA. TreeOut may
+	   be either of the input trees.
+
+	   The result is computed in two parallel passes over the leaves, the
+	   first counting the size of each result leaf and the second writing the
+	   leaves into the exactly sized Data.
+	*/
+	uint32_t TreeDepth = TreeA.depth();
+	if (TreeDepth == 0 || TreeB.depth() != TreeDepth || TreeA.LevelSize(TreeDepth - 1) != TreeB.LevelSize(TreeDepth - 1)) {
+		WriteException(
+			ExOps::EXCEPTION_INVALID_INPUT,
+			"The trees in a leaf-wise set operation must have the same (non-zero) depth and the same number of leaves"
+		);
+	}
+
+	auto LeafIndsA = TreeA.getPartitionIndex(TreeDepth - 1);
+	auto LeafIndsB = TreeB.getPartitionIndex(TreeDepth - 1);
+	auto DataA = TreeA.getData();
+	auto DataB = TreeB.getData();
+	size_t NLeaves = LeafIndsA.size() - 1;
+
+	// The work of a leaf is the sum of the sizes of the two leaves
+	MexVector<size_t, CAllocator> CombinedBounds(NLeaves + 1);
+	ParallelFor(0, NLeaves + 1, 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t i = ChunkBeg; i < ChunkEnd; ++i)
+			CombinedBounds[i] = size_t(LeafIndsA[i]) + size_t(LeafIndsB[i]);
+	});
+
+	// Counting the result leaves, and getting their offsets
+	MexVector<size_t, CAllocator> LeafOffsets(NLeaves + 1);
+	ParallelForSegments(CombinedBounds.begin(), NLeaves, 1 << 14, [&](size_t SegBeg, size_t SegEnd) {
+		for (size_t i = SegBeg; i < SegEnd; ++i)
+			LeafOffsets[i] = FVTSortedSetOp<SetOp, T>(
+				DataA.begin() + LeafIndsA[i], DataA.begin() + LeafIndsA[i + 1],
+				DataB.begin() + LeafIndsB[i], DataB.begin() + LeafIndsB[i + 1], NULL);
+	});
+	size_t NDataOut = ParallelExclusiveScan(LeafOffsets.begin(), NLeaves, LeafOffsets.begin(), size_t(0), 1 << 16);
+	LeafOffsets[NLeaves] = NDataOut;
+	if (NDataOut > size_t(std::numeric_limits<IndexT>::max())) {
+		WriteException(
+			FV_ExCodes::FV_INVALID_APPEND,
+			"The size of the result of the set operation (%llu) exceeds the range of the index type (max %llu)",
+			(unsigned long long)NDataOut, (unsigned long long)std::numeric_limits<IndexT>::max()
+		);
+	}
+
+	// Building the result tree
+	MexVector<MexVector<IndexT, AlOut>, AlOut> PartitionIndexOut(TreeDepth);
+	for (uint32_t l = 0; l + 1 < TreeDepth; ++l) {
+		auto LevelA = TreeA.getPartitionIndex(l);
+		MexVector<IndexT, AlOut> LevelOut(LevelA.size());
+		std::copy(LevelA.begin(), LevelA.end(), LevelOut.begin());
+		PartitionIndexOut[l].swap(LevelOut);
+	}
+	MexVector<IndexT, AlOut> LeafIndsOut(NLeaves + 1);
+	MexVector<T, AlOut> DataOut(NDataOut);
+	ParallelForSegments(CombinedBounds.begin(), NLeaves, 1 << 14, [&](size_t SegBeg, size_t SegEnd) {
+		for (size_t i = SegBeg; i < SegEnd; ++i) {
+			LeafIndsOut[i] = IndexT(LeafOffsets[i]);
+			FVTSortedSetOp<SetOp, T>(
+				DataA.begin() + LeafIndsA[i], DataA.begin() + LeafIndsA[i + 1],
+				DataB.begin() + LeafIndsB[i], DataB.begin() + LeafIndsB[i + 1], DataOut.begin() + LeafOffsets[i]);
+		}
+	});
+	LeafIndsOut[NLeaves] = IndexT(NDataOut);
+	PartitionIndexOut[TreeDepth - 1].swap(LeafIndsOut);
+
+	TreeOut.assign(std::move(PartitionIndexOut), std::move(DataOut), true);
+}
+
+template <typename T, class AlA, class AlB, typename IndexT, class AlOut>
+inline void FVTLeafIntersect(const FlatVectTree<T, AlA, IndexT> &TreeA, const FlatVectTree<T, AlB, IndexT> &TreeB, FlatVectTree<T, AlOut, IndexT> &TreeOut) {
+	FVTLeafSetOp<FVT_SET_INTERSECT>(TreeA, TreeB, TreeOut);
+}
+template <typename T, class AlA, class AlB, typename IndexT, class AlOut>
+inline void FVTLeafUnion(const FlatVectTree<T, AlA, IndexT> &TreeA, const FlatVectTree<T, AlB, IndexT> &TreeB, FlatVectTree<T, AlOut, IndexT> &TreeOut) {
+	FVTLeafSetOp<FVT_SET_UNION>(TreeA, TreeB, TreeOut);
+}
+template <typename T, class AlA, class AlB, typename IndexT, class AlOut>
+inline void FVTLeafDifference(const FlatVectTree<T, AlA, IndexT> &TreeA, const FlatVectTree<T, AlB, IndexT> &TreeB, FlatVectTree<T, AlOut, IndexT> &TreeOut) {
+	FVTLeafSetOp<FVT_SET_DIFFERENCE>(TreeA, TreeB, TreeOut);
+}
+
+#endif
@@ -0,0 +1,294 @@
+#ifndef PACKED_FLAT_VECT_TREE_HPP
+#define PACKED_FLAT_VECT_TREE_HPP
+
+#include <stdint.h>
+#include <limits>
+#include <algorithm>
+
+#include "FlatVectTree.hpp"
+
+template <typename IndexT = uint32_t, class Al = mxAllocator>
+class PackedPartitionIndex {
+	/*
+	   PackedPartitionIndex stores all the levels of a PartitionIndex in one
+	   contiguous Buffer. Level l occupies the region [LevelOffsets[l],
+	   LevelOffsets[l+1]) of Buffer, of which the first LevelSizes[l] entries
+	   (including the BTE entry) are in use and the rest is slack.
+
+	   The slack of every level is a multiple of SlackChunkSize entries (at
+	   least a quarter of the level), so that appending to the levels moves
+	   the Buffer only occasionally. When a level outgrows its region, the
+	   Buffer is rebuilt once with the level grown geometrically. Thus
+	   appends remain amortized linear.
+
+	   As compared to a MexVector of levels, traversing the levels does not
+	   hop between separate heap blocks, and the whole index can be copied,
+	   written or mapped as a single block (see data(), compact()).
+	*/
+
+	static const size_t SlackChunkSize = 256;
+
+	MexVector<IndexT, Al> Buffer;
+	MexVector<size_t, Al> LevelOffsets;
+	MexVector<size_t, Al> LevelSizes;
+
+	static inline size_t getSlackCapacity(size_t NEntries) {
+		size_t Capacity = NEntries + (NEntries >> 2);
+		return ((Capacity + SlackChunkSize - 1) / SlackChunkSize) * SlackChunkSize;
+	}
+
+	inline void rebuild(const MexVector<size_t, CAllocator> &NewCapacities) {
+		// Moves the levels into a new Buffer with the given level capacities
+		uint32_t NLevels = this->depth();
+		MexVector<size_t, Al> NewOffsets(NLevels + 1);
+		NewOffsets[0] = 0;
+		for (uint32_t l = 0; l < NLevels; ++l)
+			NewOffsets[l + 1] = NewOffsets[l] + NewCapacities[l];
+
+		MexVector<IndexT, Al> NewBuffer(NewOffsets[NLevels]);
+		for (uint32_t l = 0; l < NLevels; ++l) {
+			const IndexT* LevelBeg = Buffer.begin() + LevelOffsets[l];
+			std::copy(LevelBeg, LevelBeg + LevelSizes[l], NewBuffer.begin() + NewOffsets[l]);
+		}
+		Buffer.swap(NewBuffer);
+		LevelOffsets.swap(NewOffsets);
+	}
+
+public:
+	inline PackedPartitionIndex() : Buffer(), LevelOffsets(1, size_t(0)), LevelSizes() {}
+	inline explicit PackedPartitionIndex(uint32_t Depth) : Buffer(), LevelOffsets(Depth + 1), LevelSizes(Depth, size_t(1)) {
+		// Each level contains only its BTE entry (0)
+		for (uint32_t l = 0; l <= Depth; ++l)
+			LevelOffsets[l] = l * getSlackCapacity(1);
+		Buffer.resize(LevelOffsets[Depth], IndexT(0));
+	}
+	template <typename T, class FVT_Al>
+	inline explicit PackedPartitionIndex(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn) : PackedPartitionIndex() {
+		pack(TreeIn);
+	}
+
+	// Conversion from / to the levels of a FlatVectTree
+	template <typename T, class FVT_Al>
+	inline void pack(const FlatVectTree<T, FVT_Al, IndexT> &TreeIn) {
+		// The Buffer is sized once from the level sizes
+		uint32_t TreeDepth = TreeIn.depth();
+		MexVector<size_t, Al> NewOffsets(TreeDepth + 1), NewSizes(TreeDepth);
+		NewOffsets[0] = 0;
+		for (uint32_t l = 0; l < TreeDepth; ++l) {
+			NewSizes[l] = TreeIn.getPartitionIndex(l).size();
+			NewOffsets[l + 1] = NewOffsets[l] + getSlackCapacity(NewSizes[l]);
+		}
+		MexVector<IndexT, Al> NewBuffer(NewOffsets[TreeDepth]);
+		for (uint32_t l = 0; l < TreeDepth; ++l) {
+			auto LevelIn = TreeIn.getPartitionIndex(l);
+			std::copy(LevelIn.begin(), LevelIn.end(), NewBuffer.begin() + NewOffsets[l]);
+		}
+		Buffer.swap(NewBuffer);
+		LevelOffsets.swap(NewOffsets);
+		LevelSizes.swap(NewSizes);
+	}
+	template <class AlOut>
+	inline void unpack(MexVector<MexVector<IndexT, AlOut>, AlOut> &LevelsOut) const {
+		uint32_t NLevels = this->depth();
+		MexVector<MexVector<IndexT, AlOut>, AlOut> Levels(NLevels);
+		for (uint32_t l = 0; l < NLevels; ++l) {
+			MexVector<IndexT, AlOut> LevelOut(LevelSizes[l]);
+			std::copy(levelBegin(l), levelBegin(l) + LevelSizes[l], LevelOut.begin());
+			Levels[l].swap(LevelOut);
+		}
+		LevelsOut.swap(Levels);
+	}
+
+	// Growth Functions
+	inline void reserveLevel(uint32_t Level, size_t NExtraEntries) {
+		size_t Required = LevelSizes[Level] + NExtraEntries;
+		size_t Capacity = LevelOffsets[Level + 1] - LevelOffsets[Level];
+		if (Required > Capacity) {
+			MexVector<size_t, CAllocator> NewCapacities(this->depth());
+			for (uint32_t l = 0; l < this->depth(); ++l)
+				NewCapacities[l] = LevelOffsets[l + 1] - LevelOffsets[l];
+			NewCapacities[Level] = getSlackCapacity(std::max(Required, Capacity + (Capacity >> 1)));
+			rebuild(NewCapacities);
+		}
+	}
+	inline void appendLevel(uint32_t Level, const IndexT* Entries, size_t NEntries, IndexT Offset = IndexT(0)) {
+		// Appends Entries[i] + Offset to Level (after its current BTE entry).
+		// Entries must not point into this index
+		reserveLevel(Level, NEntries);
+		IndexT* LevelOut = Buffer.begin() + LevelOffsets[Level] + LevelSizes[Level];
+		for (size_t i = 0; i < NEntries; ++i)
+			LevelOut[i] = IndexT(Entries[i] + Offset);
+		LevelSizes[Level] += NEntries;
+	}
+	inline void popLevel(uint32_t Level) {
+		// Removes the last entry of Level (e.g. the BTE before an append)
+		--LevelSizes[Level];
+	}
+	inline void compact() {
+		// Removes all the slack so that data() is exactly the packed levels
+		MexVector<size_t, CAllocator> NewCapacities(this->depth());
+		for (uint32_t l = 0; l < this->depth(); ++l)
+			NewCapacities[l] = LevelSizes[l];
+		rebuild(NewCapacities);
+	}
+
+	// Property Access Functions
+	inline uint32_t depth() const {
+		return LevelSizes.size();
+	}
+	inline size_t LevelSize(uint32_t Level) const {
+		return LevelSizes[Level] - 1;
+	}
+	inline IndexT* levelBegin(uint32_t Level) {
+		return Buffer.begin() + LevelOffsets[Level];
+	}
+	inline const IndexT* levelBegin(uint32_t Level) const {
+		return Buffer.begin() + LevelOffsets[Level];
+	}
+	inline MexVectorView<IndexT> level(uint32_t Level) const {
+		return MexVectorView<IndexT>(LevelSizes[Level], levelBegin(Level));
+	}
+	inline IndexT last(uint32_t Level) const {
+		return levelBegin(Level)[LevelSizes[Level] - 1];
+	}
+	// The single block holding all the levels (with the slack between
+	// them), and the offset of each level in it
+	inline const IndexT* data() const {
+		return Buffer.begin();
+	}
+	inline size_t bufferSize() const {
+		return Buffer.size();
+	}
+	inline size_t levelOffset(uint32_t Level) const {
+		return LevelOffsets[Level];
+	}
+};
+
+template <typename T, class FVT_Al = mxAllocator, typename IndexT = uint32_t>
+class PackedFlatVectTree {
+	/*
+	   PackedFlatVectTree is a FlatVectTree whose PartitionIndex is stored as
+	   a PackedPartitionIndex. It supports packing / unpacking a FlatVectTree,
+	   appending FlatVectTrees of the same depth (i.e. concatenating their
+	   top levels) and a zero-copy view as a FlatVectTree, through which all
+	   the read-only FlatVectTree functionality is available.
+	*/
+
+	PackedPartitionIndex<IndexT, FVT_Al> PartitionIndex;
+	MexVector<T, FVT_Al> Data;
+
+public:
+	inline PackedFlatVectTree() : PartitionIndex(), Data() {}
+	inline explicit PackedFlatVectTree(uint32_t Depth) : PartitionIndex(Depth), Data() {}
+	template <class Al>
+	inline explicit PackedFlatVectTree(const FlatVectTree<T, Al, IndexT> &TreeIn) : PartitionIndex(), Data() {
+		pack(TreeIn);
+	}
+
+	// Conversion from / to the plain form
+	template <class Al>
+	inline void pack(const FlatVectTree<T, Al, IndexT> &TreeIn) {
+		auto DataIn = TreeIn.getData();
+		MexVector<T, FVT_Al> NewData(DataIn.size());
+		std::copy(DataIn.begin(), DataIn.end(), NewData.begin());
+		PartitionIndex.pack(TreeIn);
+		Data.swap(NewData);
+	}
+	template <class Al>
+	inline void unpack(FlatVectTree<T, Al, IndexT> &TreeOut) const {
+		MexVector<MexVector<IndexT, Al>, Al> PartitionIndexOut;
+		PartitionIndex.unpack(PartitionIndexOut);
+		MexVector<T, Al> DataOut(Data.size());
+		std::copy(Data.begin(), Data.end(), DataOut.begin());
+
+		// The packed tree is valid by construction
+		TreeOut.assign(std::move(PartitionIndexOut), std::move(DataOut), true);
+	}
+	inline void view(FlatVectTree<T, CAllocator, IndexT> &TreeOut) const {
+		/*
+		   Assigns to TreeOut a FlatVectTree aliasing the packed levels and
+		   Data (as with assign(..., ActualCopy = false)). The view is
+		   invalidated by any subsequent append / compact.
+		*/
+		uint32_t TreeDepth = this->depth();
+		MexVector<MexVector<IndexT, CAllocator>, CAllocator> Levels(TreeDepth);
+		MexVector<T, CAllocator> DataView;
+		for (uint32_t l = 0; l < TreeDepth; ++l) {
+			auto CurrLevel = PartitionIndex.level(l);
+			Levels[l].assign(CurrLevel.size(), const_cast<IndexT*>(CurrLevel.begin()), false);
+		}
+		DataView.assign(Data.size(), const_cast<T*>(Data.begin()), false);
+		TreeOut.assign(Levels, DataView, false, true);
+	}
+
+	// Appending Functions
+	template <class Al, typename IndexT2>
+	inline void append(const FlatVectTree<T, Al, IndexT2> &TreeIn) {
+		/*
+		   Appends the top level entries of TreeIn (of the same depth) after
+		   those of this tree. Each level is appended into its slack, shifting
+		   its entries by the current size of the level below (its BTE
+		   entry). TreeIn must not be a view of this tree.
+		*/
+		uint32_t TreeDepth = this->depth();
+		if (TreeIn.depth() != TreeDepth || TreeDepth == 0) {
+			WriteException(
+				FV_ExCodes::FV_INVALID_APPEND,
+				"The depth of the appended tree (%d) must equal the (non-zero) depth of the packed tree (%d)",
+				TreeIn.depth(), TreeDepth
+			);
+		}
+		auto DataIn = TreeIn.getData();
+		for (uint32_t l = 0; l <= TreeDepth; ++l) {
+			size_t NewSize = (l < TreeDepth) ? this->LevelSize(l) + size_t(TreeIn.LevelSize(l))
+			                                 : Data.size() + DataIn.size();
+			if (NewSize > size_t(std::numeric_limits<IndexT>::max())) {
+				WriteException(
+					FV_ExCodes::FV_INVALID_APPEND,
+					"The size of the packed tree exceeds the range of its index type (max %llu)",
+					(unsigned long long)std::numeric_limits<IndexT>::max()
+				);
+			}
+		}
+		for (uint32_t l = 0; l < TreeDepth; ++l) {
+			auto LevelIn = TreeIn.getPartitionIndex(l);
+			MexVector<IndexT, CAllocator> ConvertedLevel;
+			const IndexT* LevelInBeg = reinterpret_cast<const IndexT*>(LevelIn.begin());
+			if (!std::is_same<IndexT, IndexT2>::value) {
+				ConvertedLevel.resize(LevelIn.size());
+				std::copy(LevelIn.begin(), LevelIn.end(), ConvertedLevel.begin());
+				LevelInBeg = ConvertedLevel.begin();
+			}
+			IndexT Offset = PartitionIndex.last(l);
+			PartitionIndex.popLevel(l);
+			PartitionIndex.appendLevel(l, LevelInBeg, LevelIn.size(), Offset);
+		}
+		size_t OldDataSize = Data.size();
+		reserveFVTVector(Data, DataIn.size());
+		Data.push_size(DataIn.size());
+		std::copy(DataIn.begin(), DataIn.end(), Data.begin() + OldDataSize);
+	}
+
+	inline void compact() {
+		PartitionIndex.compact();
+	}
+
+	// Property Access Functions
+	inline uint32_t depth() const {
+		return PartitionIndex.depth();
+	}
+	inline size_t LevelSize(uint32_t Level) const {
+		return PartitionIndex.LevelSize(Level);
+	}
+	inline MexVectorView<IndexT> getPartitionIndex(uint32_t Level) const {
+		return PartitionIndex.level(Level);
+	}
+	inline MexVectorView<T> getData() const {
+		return MexVectorView<T>(Data);
+	}
+	inline const PackedPartitionIndex<IndexT, FVT_Al> &getPackedIndex() const {
+		return PartitionIndex;
+	}
+};
+
+#endif
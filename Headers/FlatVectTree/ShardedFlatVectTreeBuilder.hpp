@@ -0,0 +1,141 @@
+#ifndef SHARDED_FLAT_VECT_TREE_BUILDER_HPP
+#define SHARDED_FLAT_VECT_TREE_BUILDER_HPP
+
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
+
+#include "FlatVectTree.hpp"
+#include "FlatVectTreeBuilder.hpp"
+
+template <typename T, class FVT_Al = mxAllocator, typename IndexT = uint32_t>
+class ShardedFlatVectTreeBuilder {
+	/*
+	   ShardedFlatVectTreeBuilder builds a FlatVectTree from several threads.
+	   Each thread appends only to its own shard (a FlatVectTree of the same
+	   depth, filled using append / push_back or a FlatVectTreeBuilder on
+	   it, see builder(i)). merge() then concatenates the top level entries
+	   of all the shards in the order of the shard index.
+
+	   The result is identical to appending the shards one after the other
+	   to an empty tree, irrespective of the number of threads used to build
+	   or merge. The merge is a parallel copy: the offsets of each shard in
+	   every level are found by a prefix sum over the shards, following which
+	   the PartitionIndex entries are copied with the offsets added and the
+	   Data is copied as is, in parallel chunks of the output.
+
+	   The shards use CAllocator as the MATLAB allocator is not thread safe.
+	   Only merge() allocates with FVT_Al (on the calling thread).
+	*/
+
+	typedef FlatVectTree<T, CAllocator, IndexT> ShardType;
+
+	uint32_t TreeDepth;
+	MexVector<ShardType, CAllocator> Shards;
+
+	template <typename ElemT, typename GetShardArrayFunc>
+	static inline void concatShardArrays(const MexVector<size_t, CAllocator> &ShardBegs, const GetShardArrayFunc &getShardArray,
+	                                     const size_t* ShardValOffsets, ElemT* ArrayOut) {
+		/*
+		   Writes the arrays getShardArray(s) one after the other into ArrayOut
+		   where the array of shard s is ArrayOut[ShardBegs[s], ShardBegs[s+1]).
+		   If ShardValOffsets is not NULL, ShardValOffsets[s] is added to every
+		   element of the array of shard s. The output is split into chunks
+		   independent of the shard sizes, so that the copy is balanced.
+		*/
+		size_t NShards = ShardBegs.size() - 1;
+		ParallelFor(0, ShardBegs[NShards], 1 << 16, [&](size_t ChunkBeg, size_t ChunkEnd) {
+			size_t s = std::upper_bound(ShardBegs.begin(), ShardBegs.end(), ChunkBeg) - ShardBegs.begin() - 1;
+			for (size_t CurrPos = ChunkBeg; CurrPos < ChunkEnd; ++s) {
+				size_t SegEnd = std::min(ChunkEnd, ShardBegs[s + 1]);
+				const ElemT* ShardArray = getShardArray(s) + (CurrPos - ShardBegs[s]);
+				if (ShardValOffsets != NULL) {
+					ElemT ValOffset = ElemT(ShardValOffsets[s]);
+					for (size_t j = CurrPos; j < SegEnd; ++j)
+						ArrayOut[j] = ElemT(ShardArray[j - CurrPos] + ValOffset);
+				}
+				else {
+					std::copy(ShardArray, ShardArray + (SegEnd - CurrPos), ArrayOut + CurrPos);
+				}
+				CurrPos = SegEnd;
+			}
+		});
+	}
+
+public:
+	inline ShardedFlatVectTreeBuilder(uint32_t Depth, size_t NShards) : TreeDepth(Depth), Shards(NShards) {
+		if (Depth == 0) {
+			WriteException(FV_ExCodes::FV_INVALID_APPEND, "The FlatVectTree to be built must have a depth of at least 1");
+		}
+		for (auto &Shard : Shards)
+			Shard.setDepth(Depth);
+	}
+
+	// Shard Access. Shard i must be modified only by one thread at a time
+	inline ShardType &shard(size_t ShardIndex) {
+		return Shards[ShardIndex];
+	}
+	inline FlatVectTreeBuilder<T, CAllocator, IndexT> builder(size_t ShardIndex) {
+		return FlatVectTreeBuilder<T, CAllocator, IndexT>(Shards[ShardIndex]);
+	}
+	inline size_t nShards() const {
+		return Shards.size();
+	}
+	inline uint32_t depth() const {
+		return TreeDepth;
+	}
+
+	inline void clear() {
+		for (auto &Shard : Shards)
+			Shard.clear();
+	}
+
+	template <class Al>
+	inline void merge(FlatVectTree<T, Al, IndexT> &TreeOut) const {
+		/*
+		   Assigns to TreeOut the concatenation of the shards (in the order of
+		   the shard index). The shards are left unchanged.
+		*/
+
+		size_t NShards = Shards.size();
+
+		// ShardBegs[l][s] is the position of the entries of shard s in level
+		// l of the output (l == TreeDepth for Data)
+		MexVector<MexVector<size_t, CAllocator>, CAllocator> ShardBegs(TreeDepth + 1);
+		for (uint32_t l = 0; l <= TreeDepth; ++l) {
+			MexVector<size_t, CAllocator> LevelShardBegs(NShards + 1);
+			for (size_t s = 0; s < NShards; ++s)
+				LevelShardBegs[s] = (l < TreeDepth) ? size_t(Shards[s].LevelSize(l)) : Shards[s].getData().size();
+			size_t LevelSize = ParallelExclusiveScan(LevelShardBegs.begin(), NShards, LevelShardBegs.begin(), size_t(0), 1 << 16);
+			LevelShardBegs[NShards] = LevelSize;
+
+			if (LevelSize > size_t(std::numeric_limits<IndexT>::max())) {
+				WriteException(
+					FV_ExCodes::FV_INVALID_APPEND,
+					"The size of the merged FlatVectTree (%llu) exceeds the range of its index type (max %llu)",
+					(unsigned long long)LevelSize, (unsigned long long)std::numeric_limits<IndexT>::max()
+				);
+			}
+			ShardBegs[l].swap(LevelShardBegs);
+		}
+
+		// Copying the levels (the entries of level l of shard s are offset by
+		// the position of the shard in level l+1)
+		MexVector<MexVector<IndexT, Al>, Al> PartitionIndexOut(TreeDepth);
+		for (uint32_t l = 0; l < TreeDepth; ++l) {
+			MexVector<IndexT, Al> LevelOut(ShardBegs[l].last() + 1);
+			concatShardArrays<IndexT>(ShardBegs[l], [&](size_t s) { return Shards[s].getPartitionIndex(l).begin(); },
+			                          ShardBegs[l + 1].begin(), LevelOut.begin());
+			LevelOut.last() = IndexT(ShardBegs[l + 1].last());
+			PartitionIndexOut[l].swap(LevelOut);
+		}
+		MexVector<T, Al> DataOut(ShardBegs[TreeDepth].last());
+		concatShardArrays<T>(ShardBegs[TreeDepth], [&](size_t s) { return Shards[s].getData().begin(); },
+		                     NULL, DataOut.begin());
+
+		// The shards were valid, hence so is the concatenation
+		TreeOut.assign(std::move(PartitionIndexOut), std::move(DataOut), true);
+	}
+};
+
+#endif
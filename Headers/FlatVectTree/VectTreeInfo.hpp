@@ -14,9 +14,12 @@ template <typename T, class Al> struct getTreeInfoBasic<MexVector<T, Al> > {
 	typedef T type;
 };
 
-template <typename T, class Al> struct getTreeInfoBasic<MexVector<MexVector<T, Al> > > {
-	static constexpr uint32_t depth = getTreeInfoBasic<MexVector<T> >::depth + 1;
-	typedef typename getTreeInfoBasic<MexVector<T> >::type type;
+// Matches nested MexVectors with any allocator at any level (e.g.
+// MexVector<MexVector<T, CAllocator>, CAllocator> as used in MEX_EXE and
+// worker thread code)
+template <typename T, class AlSub, class Al> struct getTreeInfoBasic<MexVector<MexVector<T, AlSub>, Al> > {
+	static constexpr uint32_t depth = getTreeInfoBasic<MexVector<T, AlSub> >::depth + 1;
+	typedef typename getTreeInfoBasic<MexVector<T, AlSub> >::type type;
 };
 
 // This is a wrapper that removes const, volatile and references from types
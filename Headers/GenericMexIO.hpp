@@ -9,12 +9,15 @@
 #include <vector>
 #include <unordered_map>
 #include <functional>
+#include <tuple>
+#include <algorithm>
 #include <cstdio>
 #include <string.h>
 
 #include "MexMem.hpp"
 #include "LambdaToFunction.hpp"
 #include "MexTypeTraits.hpp"
+#include "ParallelHelpers.hpp"
 
 #ifdef _MSC_VER
 #  define STRCMPI_FUNC _strcmpi
@@ -489,6 +492,19 @@ inline void getInputfrommxArray(
 	}
 }
 
+template <typename TypeSrcDest>
+inline void getROInputfrommxArray(
+	const mxArray* InputArray,
+	MexVectorView<TypeSrcDest> &VectorIn) {
+
+	// No data is copied. VectorIn views the data of InputArray, it is
+	// assumed that InputArray is of type TypeSrcDest.
+	if (InputArray != nullptr && !mxIsEmpty(InputArray)) {
+		size_t NumElems = mxGetNumberOfElements(InputArray);
+		VectorIn.assign(NumElems, reinterpret_cast<const TypeSrcDest*>(mxGetData(InputArray)));
+	}
+}
+
 // -------- From Structure Field -------- //
 
 template <typename TypeSrc, typename TypeDest, class AlDest>
@@ -508,6 +524,23 @@ inline int getInputfromStruct(
 	}
 }
 
+template <typename TypeSrcDest>
+inline int getROInputfromStruct(
+	const mxArray* InputStruct, const char* FieldName,
+	MexVectorView<TypeSrcDest> &VectorIn,
+	MexMemInputOps InputOps = MexMemInputOps()) {
+
+	// Processing Data
+	const mxArray* StructFieldPtr = getValidStructField<MexVectorView<TypeSrcDest> >(InputStruct, FieldName, InputOps);
+	if (StructFieldPtr != nullptr) {
+		getROInputfrommxArray(StructFieldPtr, VectorIn);
+		return 0;
+	}
+	else {
+		return 1;
+	}
+}
+
 template <typename TypeSrc, typename TypeDest, class AlDest>
 inline int getInputfromStruct(
 	const mxArray* InputStruct, const char* FieldName,
@@ -713,6 +746,37 @@ inline void getInputfrommxArray(const mxArray* InputArray, MexVector<MexVector<T
 	}
 }
 
+// The read-only versions give a vector of views into the leaf vectors of
+// the cell array (to any depth) i.e. MexVector<MexVectorView<T> >,
+// MexVector<MexVector<MexVectorView<T> > > etc. Only the (small) arrays of
+// views are allocated, the leaf data is never copied.
+
+template <typename T, class Al>
+inline void getROInputfrommxArray(const mxArray* InputArray, MexVector<MexVectorView<T>, Al> &VectorIn){
+	if (InputArray != nullptr && !mxIsEmpty(InputArray) && mxGetClassID(InputArray) == mxCELL_CLASS){
+		size_t NumElems = mxGetNumberOfElements(InputArray);
+		mxArrayPtr* tempArrayPtr = reinterpret_cast<mxArrayPtr*>(mxGetData(InputArray));
+		VectorIn.resize(NumElems);
+		for (size_t i = 0; i < NumElems; ++i){
+			VectorIn[i] = MexVectorView<T>();
+			getROInputfrommxArray(tempArrayPtr[i], VectorIn[i]);
+		}
+	}
+}
+
+template <typename T, class AlSub, class Al>
+inline void getROInputfrommxArray(const mxArray* InputArray, MexVector<MexVector<T, AlSub>, Al> &VectorIn){
+	if (InputArray != nullptr && !mxIsEmpty(InputArray) && mxGetClassID(InputArray) == mxCELL_CLASS){
+		size_t NumElems = mxGetNumberOfElements(InputArray);
+		mxArrayPtr* tempArrayPtr = reinterpret_cast<mxArrayPtr*>(mxGetData(InputArray));
+		VectorIn.resize(NumElems);
+		for (size_t i = 0; i < NumElems; ++i){
+			VectorIn[i].clear();
+			getROInputfrommxArray(tempArrayPtr[i], VectorIn[i]);
+		}
+	}
+}
+
 // -------- From Structure Field -------- //
 
 template <typename T, class AlSub, class Al> 
@@ -732,6 +796,26 @@ inline int getInputfromStruct(
 	}
 }
 
+template <typename T, class Al>
+inline int getROInputfromStruct(
+	const mxArray* InputStruct, const char* FieldName,
+	MexVector<T, Al> &VectorIn,
+	MexMemInputOps InputOps = MexMemInputOps()) {
+
+	// T is either MexVectorView<...> or a (nested) MexVector of the same
+	static_assert(isMexVectVector<MexVector<T, Al> >::value, "getROInputfromStruct expects a (nested) MexVector of MexVectorView");
+
+	// Processing Data
+	const mxArray * StructFieldPtr = getValidStructField<MexVector<T, Al> >(InputStruct, FieldName, InputOps);
+	if (StructFieldPtr != nullptr) {
+		getROInputfrommxArray(StructFieldPtr, VectorIn);
+		return 0;
+	}
+	else {
+		return 1;
+	}
+}
+
 //////////////////////////////////////////////////////////////////
 ////////////////////////// STRUCT INPUT //////////////////////////
 //////////////////////////////////////////////////////////////////
@@ -888,4 +972,152 @@ inline int getInputfromStruct(
 	return 0;
 }
 
+//////////////////////////////////////////////////////////////////
+//////////////////// TYPED STRUCT FIELD BINDING //////////////////
+//////////////////////////////////////////////////////////////////
+
+// A StructFieldBinding binds the struct field FieldName (a vector of type
+// TypeSrc) to the member MemberPtr of StructT. A list of such bindings
+// (see makeStructBinding) is used to read a struct of arrays into a
+// MexVector<StructT> with full type checking and without any per-element
+// lookups.
+//
+// Example:
+//
+//     auto NeuronBinding = makeStructBinding(
+//         BindStructField<float   >("a"     , &Neuron::a ),
+//         BindStructField<float   >("b"     , &Neuron::b ),
+//         BindStructField<uint32_t>("Type"  , &Neuron::Type));
+//
+//     getInputfromStruct(InputStruct, NeuronVector, NeuronBinding, getInputOps(1, "IS_REQUIRED"));
+
+template <typename TypeSrc, typename StructT, typename MemberT>
+struct StructFieldBinding {
+	typedef TypeSrc SrcType;
+	typedef StructT StructType;
+	typedef MemberT MemberType;
+
+	const char* FieldName;
+	MemberT StructT::* MemberPtr;
+};
+
+template <typename TypeSrc, typename StructT, typename MemberT>
+inline StructFieldBinding<TypeSrc, StructT, MemberT> BindStructField(const char* FieldName, MemberT StructT::* MemberPtr) {
+	StructFieldBinding<TypeSrc, StructT, MemberT> Binding = { FieldName, MemberPtr };
+	return Binding;
+}
+
+template <typename... FieldBindings>
+struct StructBinding {
+	static constexpr size_t NFields = sizeof...(FieldBindings);
+	std::tuple<FieldBindings...> Fields;
+};
+
+template <typename... FieldBindings>
+inline StructBinding<FieldBindings...> makeStructBinding(const FieldBindings &... Fields) {
+	StructBinding<FieldBindings...> Binding = { std::tuple<FieldBindings...>(Fields...) };
+	return Binding;
+}
+
+template <size_t FieldIndex, size_t NFields>
+struct StructBindingOps {
+	template <typename BindingT>
+	static inline void getColumns(const mxArray* InputStruct, const BindingT &Binding,
+	                              const void* (&ColumnPtrs)[NFields], size_t &NumElems,
+	                              const MexMemInputOps &InputOps) {
+
+		typedef typename std::tuple_element<FieldIndex, decltype(Binding.Fields)>::type CurrBindingT;
+		typedef typename CurrBindingT::SrcType TypeSrc;
+		const CurrBindingT &CurrBinding = std::get<FieldIndex>(Binding.Fields);
+
+		// Size constraints are imposed as in the StructArgTable version,
+		// i.e. either the REQUIRED_SIZE or the size of the previous
+		// non-empty field
+		MexMemInputOps tempInputOps = InputOps;
+		if (InputOps.REQUIRED_SIZE == -1 && NumElems != 0)
+			tempInputOps.REQUIRED_SIZE = NumElems;
+
+		const mxArray* StructFieldPtr = getValidStructField<MexVector<TypeSrc> >(InputStruct, CurrBinding.FieldName, tempInputOps);
+		size_t CurrNumElems = FieldInfo<MexVector<TypeSrc> >::getSize(StructFieldPtr);
+
+		if (StructFieldPtr != nullptr && CurrNumElems > 0) {
+			ColumnPtrs[FieldIndex] = mxGetData(StructFieldPtr);
+			NumElems = CurrNumElems;
+		}
+		else {
+			ColumnPtrs[FieldIndex] = nullptr;
+		}
+
+		StructBindingOps<FieldIndex + 1, NFields>::getColumns(InputStruct, Binding, ColumnPtrs, NumElems, InputOps);
+	}
+
+	template <typename BindingT, typename StructT>
+	static inline void fillBlock(const BindingT &Binding, const void* const (&ColumnPtrs)[NFields],
+	                             StructT* DestBeg, size_t BlockBeg, size_t BlockEnd) {
+
+		typedef typename std::tuple_element<FieldIndex, decltype(Binding.Fields)>::type CurrBindingT;
+		typedef typename CurrBindingT::SrcType TypeSrc;
+		typedef typename CurrBindingT::MemberType MemberT;
+
+		const TypeSrc* SrcColumn = reinterpret_cast<const TypeSrc*>(ColumnPtrs[FieldIndex]);
+		if (SrcColumn != nullptr) {
+			MemberT StructT::* MemberPtr = std::get<FieldIndex>(Binding.Fields).MemberPtr;
+			for (size_t i = BlockBeg; i < BlockEnd; ++i) {
+				DestBeg[i].*MemberPtr = (MemberT)SrcColumn[i];
+			}
+		}
+
+		StructBindingOps<FieldIndex + 1, NFields>::fillBlock(Binding, ColumnPtrs, DestBeg, BlockBeg, BlockEnd);
+	}
+};
+
+template <size_t NFields>
+struct StructBindingOps<NFields, NFields> {
+	template <typename BindingT>
+	static inline void getColumns(const mxArray*, const BindingT &, const void* (&)[NFields], size_t &, const MexMemInputOps &) {}
+	template <typename BindingT, typename StructT>
+	static inline void fillBlock(const BindingT &, const void* const (&)[NFields], StructT*, size_t, size_t) {}
+};
+
+template <typename T, class Al, typename... FieldBindings>
+inline int getInputfromStruct(
+	const mxArray* InputStruct,
+	MexVector<T, Al> &VectorIn,
+	const StructBinding<FieldBindings...> &Binding,
+	MexMemInputOps InputOps = MexMemInputOps()) {
+
+	// This is the typed counterpart of the StructArgTable version above. All
+	// fields are located and type checked exactly once, following which
+	// VectorIn is filled column by column in blocks (so that the block of
+	// VectorIn being written remains in cache for all the fields). Fields that
+	// are empty / non-existant (and not required) leave the corresponding
+	// members untouched.
+
+	constexpr size_t NFields = StructBinding<FieldBindings...>::NFields;
+	static_assert(NFields > 0, "The StructBinding must contain at least one field");
+
+	const void* ColumnPtrs[NFields];
+	size_t NumElems = (InputOps.REQUIRED_SIZE != -1) ? InputOps.REQUIRED_SIZE : 0;
+	StructBindingOps<0, NFields>::getColumns(InputStruct, Binding, ColumnPtrs, NumElems, InputOps);
+
+	bool isAnyFieldPresent = false;
+	for (size_t i = 0; i < NFields; ++i)
+		isAnyFieldPresent = isAnyFieldPresent || ColumnPtrs[i] != nullptr;
+	if (!isAnyFieldPresent)
+		NumElems = 0;
+
+	VectorIn.resize(NumElems); // Does not Delete Previous Elements
+	T* DestBeg = VectorIn.begin();
+
+	const size_t BlockSize = 1024;
+	ParallelFor(0, NumElems, 16 * BlockSize, [&](size_t ChunkBeg, size_t ChunkEnd) {
+		for (size_t BlockBeg = ChunkBeg; BlockBeg < ChunkEnd; BlockBeg += BlockSize) {
+			size_t BlockEnd = std::min(BlockBeg + BlockSize, ChunkEnd);
+			StructBindingOps<0, NFields>::fillBlock(Binding, ColumnPtrs, DestBeg, BlockBeg, BlockEnd);
+		}
+	});
+
+	return 0;
+}
+
 #endif
\ No newline at end of file
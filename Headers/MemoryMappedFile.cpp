@@ -0,0 +1,159 @@
+#include <utility>
+#include "MemoryMappedFile.hpp"
+#include "GenericMexIO.hpp"
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+MemoryMappedFile::MemoryMappedFile() :
+	MapBeg(NULL), MapSize(0), Mode(READ_ONLY),
+#ifdef _WIN32
+	FileHandle(NULL), MappingHandle(NULL)
+#else
+	FileDesc(-1)
+#endif
+{}
+
+MemoryMappedFile::MemoryMappedFile(const std::string &FilePath, MapMode Mode_) : MemoryMappedFile() {
+	open(FilePath, Mode_);
+}
+
+MemoryMappedFile::MemoryMappedFile(MemoryMappedFile &&Other) : MemoryMappedFile() {
+	this->swap(Other);
+}
+
+MemoryMappedFile & MemoryMappedFile::operator = (MemoryMappedFile &&Other) {
+	MemoryMappedFile Temp(std::move(Other));
+	this->swap(Temp);
+	return *this;
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+	close();
+}
+
+void MemoryMappedFile::open(const std::string &FilePath, MapMode Mode_) {
+	if (!tryOpen(FilePath, Mode_)) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "Could not open the file '%s' for mapping", FilePath.c_str());
+	}
+}
+
+void MemoryMappedFile::swap(MemoryMappedFile &Other) {
+	std::swap(MapBeg, Other.MapBeg);
+	std::swap(MapSize, Other.MapSize);
+	std::swap(Mode, Other.Mode);
+#ifdef _WIN32
+	std::swap(FileHandle, Other.FileHandle);
+	std::swap(MappingHandle, Other.MappingHandle);
+#else
+	std::swap(FileDesc, Other.FileDesc);
+#endif
+}
+
+#ifdef _WIN32
+
+bool MemoryMappedFile::tryOpen(const std::string &FilePath, MapMode Mode_) {
+	close();
+
+	HANDLE File = CreateFileA(FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (File == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(File, &FileSize)) {
+		CloseHandle(File);
+		return false;
+	}
+	FileHandle = File;
+	MapSize = size_t(FileSize.QuadPart);
+	Mode = Mode_;
+
+	// Empty files cannot be mapped, they remain open with data() == NULL
+	if (MapSize > 0) {
+		bool isCopyOnWrite = (Mode_ == COPY_ON_WRITE);
+		HANDLE Mapping = CreateFileMappingA(File, NULL, isCopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+		const void* View = (Mapping != NULL) ? MapViewOfFile(Mapping, isCopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0) : NULL;
+		if (View == NULL) {
+			if (Mapping != NULL)
+				CloseHandle(Mapping);
+			close();
+			return false;
+		}
+		MappingHandle = Mapping;
+		MapBeg = static_cast<const char*>(View);
+	}
+	return true;
+}
+
+void MemoryMappedFile::close() {
+	if (MapBeg != NULL)
+		UnmapViewOfFile(MapBeg);
+	if (MappingHandle != NULL)
+		CloseHandle(MappingHandle);
+	if (FileHandle != NULL)
+		CloseHandle(FileHandle);
+	MapBeg = NULL;
+	MapSize = 0;
+	Mode = READ_ONLY;
+	FileHandle = NULL;
+	MappingHandle = NULL;
+}
+
+bool MemoryMappedFile::isopen() const {
+	return FileHandle != NULL;
+}
+
+#else
+
+bool MemoryMappedFile::tryOpen(const std::string &FilePath, MapMode Mode_) {
+	close();
+
+	int File = ::open(FilePath.c_str(), O_RDONLY);
+	if (File < 0)
+		return false;
+	struct stat FileStat;
+	if (fstat(File, &FileStat) != 0) {
+		::close(File);
+		return false;
+	}
+	FileDesc = File;
+	MapSize = size_t(FileStat.st_size);
+	Mode = Mode_;
+
+	// Empty files cannot be mapped, they remain open with data() == NULL
+	if (MapSize > 0) {
+		void* View = (Mode_ == COPY_ON_WRITE) ? mmap(NULL, MapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, File, 0)
+		                                      : mmap(NULL, MapSize, PROT_READ, MAP_SHARED, File, 0);
+		if (View == MAP_FAILED) {
+			close();
+			return false;
+		}
+		MapBeg = static_cast<const char*>(View);
+	}
+	return true;
+}
+
+void MemoryMappedFile::close() {
+	if (MapBeg != NULL)
+		munmap(const_cast<char*>(MapBeg), MapSize);
+	if (FileDesc >= 0)
+		::close(FileDesc);
+	MapBeg = NULL;
+	MapSize = 0;
+	Mode = READ_ONLY;
+	FileDesc = -1;
+}
+
+bool MemoryMappedFile::isopen() const {
+	return FileDesc >= 0;
+}
+
+#endif
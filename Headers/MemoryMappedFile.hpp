@@ -0,0 +1,63 @@
+#ifndef MEMORY_MAPPED_FILE_HPP
+#define MEMORY_MAPPED_FILE_HPP
+
+#include <stddef.h>
+#include <string>
+
+class MemoryMappedFile {
+	/*
+	   MemoryMappedFile maps a whole file read-only into memory. Opening is
+	   O(1) irrespective of the size of the file, the pages are read in on
+	   demand when accessed. The mapping is shared, so the pages are those of
+	   the OS page cache and are shared by all the processes (e.g. MATLAB and
+	   MEX_EXE workers) mapping the same file.
+
+	   Writing through data() is invalid (the pages are mapped read-only)
+	   unless the file is opened COPY_ON_WRITE, in which case the pages are
+	   private to this mapping and written pages are copied on the first
+	   write (the file itself is never modified). Errors throw
+	   ExOps::EXCEPTION_INVALID_INPUT after writing a message, except in
+	   tryOpen which returns false (leaving the file closed) instead.
+	*/
+
+public:
+	enum MapMode {
+		READ_ONLY,
+		COPY_ON_WRITE
+	};
+
+private:
+	const char* MapBeg;
+	size_t MapSize;
+	MapMode Mode;
+#ifdef _WIN32
+	void* FileHandle;
+	void* MappingHandle;
+#else
+	int FileDesc;
+#endif
+
+	MemoryMappedFile(const MemoryMappedFile &) = delete;
+	MemoryMappedFile & operator = (const MemoryMappedFile &) = delete;
+
+public:
+	MemoryMappedFile();
+	explicit MemoryMappedFile(const std::string &FilePath, MapMode Mode = READ_ONLY);
+	MemoryMappedFile(MemoryMappedFile &&Other);
+	MemoryMappedFile & operator = (MemoryMappedFile &&Other);
+	~MemoryMappedFile();
+
+	void open(const std::string &FilePath, MapMode Mode = READ_ONLY);
+	bool tryOpen(const std::string &FilePath, MapMode Mode = READ_ONLY);
+	void close();
+	void swap(MemoryMappedFile &Other);
+
+	bool isopen() const;
+	inline const char* data()   const { return MapBeg; }
+	inline size_t      size()   const { return MapSize; }
+	inline MapMode     mode()   const { return Mode; }
+	// The mapping as writable memory (NULL unless mapped COPY_ON_WRITE)
+	inline char*       writableData() const { return (Mode == COPY_ON_WRITE) ? const_cast<char*>(MapBeg) : NULL; }
+};
+
+#endif
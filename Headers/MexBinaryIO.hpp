@@ -0,0 +1,86 @@
+#ifndef MEX_BINARY_IO_HPP
+#define MEX_BINARY_IO_HPP
+
+#include <string>
+#include <stdint.h>
+
+#include "MexMem.hpp"
+#include "FlatVectTree/VectTreeInfo.hpp"
+#include "FlatVectTree/FlatVectTree.hpp"
+#include "FlatVectTree/FlatVectTreeFile.hpp"
+
+/*
+   Binary serialization of MexVector, MexMatrix and nested MexVectors
+   (vector trees) of any allocator.
+
+   All of them are stored in the FlatVectTree file format (see
+   FlatVectTreeFile.hpp), which tags the elements by their mxClassID
+   (GetMexType) and size:
+
+   MexVector            a tree of depth 0 (only Data)
+   MexMatrix            Data with Kind = FVT_FILE_MATRIX and the shape in
+                        the header
+   Vector tree          the FlatVectTree (with uint64 indices) of the tree,
+                        of depth getTreeInfo<...>::depth
+
+   So the files written here can be mapped in O(1) by MappedMexVector,
+   MappedMexMatrix and MappedFlatVectTree<T, uint64_t> (read-only or, for
+   the former two, copy-on-write), and the files of writeFlatVectTreeFile
+   with uint64 indices can be read as vector trees. readMexBinary maps the
+   file, copies it into the output and closes it.
+*/
+
+/////////////////////////////////////////////////
+// WRITING FUNCTIONS         ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T, class Al>
+inline typename std::enable_if<std::is_arithmetic<T>::value>::type
+writeMexBinary(const std::string &FilePath, const MexVector<T, Al> &VectIn) {
+	writeMexVectorFile(FilePath, VectIn);
+}
+
+template <typename T, class Al>
+inline void writeMexBinary(const std::string &FilePath, const MexMatrix<T, Al> &MatrixIn) {
+	writeMexMatrixFile(FilePath, MatrixIn);
+}
+
+template <typename SubElemT, class AlSub, class Al>
+inline void writeMexBinary(const std::string &FilePath, const MexVector<MexVector<SubElemT, AlSub>, Al> &VectTreeIn) {
+	typedef getTreeInfo<MexVector<MexVector<SubElemT, AlSub>, Al> > TreeInfo;
+	FlatVectTree<typename TreeInfo::type, CAllocator, uint64_t> Tree(TreeInfo::depth);
+	Tree.append(VectTreeIn);
+	writeFlatVectTreeFile(FilePath, Tree);
+}
+
+/////////////////////////////////////////////////
+// READING FUNCTIONS         ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T, class Al>
+inline typename std::enable_if<std::is_arithmetic<T>::value>::type
+readMexBinary(const std::string &FilePath, MexVector<T, Al> &VectOut) {
+	MappedMexVector<T> Mapped(FilePath);
+	MexVector<T, Al> NewVect(Mapped.vect().size());
+	std::copy(Mapped.vect().begin(), Mapped.vect().end(), NewVect.begin());
+	VectOut.swap(NewVect);
+}
+
+template <typename T, class Al>
+inline void readMexBinary(const std::string &FilePath, MexMatrix<T, Al> &MatrixOut) {
+	MappedMexMatrix<T> Mapped(FilePath);
+	MexMatrix<T, Al> NewMatrix(Mapped.matrix().nrows(), Mapped.matrix().ncols());
+	std::copy(Mapped.matrix().begin(), Mapped.matrix().end(), NewMatrix.begin());
+	MatrixOut.swap(NewMatrix);
+}
+
+template <typename SubElemT, class AlSub, class Al>
+inline void readMexBinary(const std::string &FilePath, MexVector<MexVector<SubElemT, AlSub>, Al> &VectTreeOut) {
+	typedef typename getTreeInfo<MexVector<MexVector<SubElemT, AlSub>, Al> >::type T;
+	MappedFlatVectTree<T, uint64_t> Mapped(FilePath);
+	MexVector<MexVector<SubElemT, AlSub>, Al> NewTree;
+	Mapped.tree().getVectTree(NewTree);
+	VectTreeOut.swap(NewTree);
+}
+
+#endif
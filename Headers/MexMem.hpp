@@ -5,6 +5,7 @@
 #include <type_traits>
 #include <chrono>
 #include <iterator>
+#include <atomic>
 
 typedef mxArray* mxArrayPtr;
 
@@ -12,6 +13,7 @@ class CAllocator;
 class mxAllocator;
 template<typename T, class Al = mxAllocator> class MexVector;
 template<typename T, class Al = mxAllocator> class MexMatrix;
+template<typename T> class MexVectorView;
 
 struct ExOps{
 	enum ExCodes{
@@ -23,7 +25,7 @@ struct ExOps{
 };
 
 class MemCounter{
-	static size_t MemUsageCount;
+	static std::atomic<size_t> MemUsageCount; // atomic as MexVectors may be allocated from worker threads (with CAllocator)
 	static size_t MemUsageLimitVal;
 	static size_t AccountOpeningKey;
 public:
@@ -59,6 +61,11 @@ public:
 			return 1;
 		}
 	}
+
+	// The number of bytes charged to the account so far (see MemUsageLimit)
+	static size_t getMemUsage(){
+		return MemUsageCount;
+	}
 };
 
 class CAllocator {
@@ -717,6 +724,61 @@ public:
 };
 
 
+template<typename T>
+class MexVectorView{
+	// MexVectorView is a non-owning, read-only view of a contiguous array
+	// (typically the data of an input mxArray or of a MexVector). Unlike a
+	// MexVector holding external memory (see assign(Size, Array_, false)),
+	// any attempt to resize or modify through the view fails at compile time
+	// rather than throwing EXCEPTION_EXTMEM_MOD at runtime. The viewed memory
+	// must outlive the view.
+
+	const T* Array_Beg;
+	const T* Array_Last;
+
+public:
+	typedef const T* iterator;
+
+	inline MexVectorView() : Array_Beg(NULL), Array_Last(NULL) {}
+	inline explicit MexVectorView(size_t Size, const T* Array_) :
+		Array_Beg(Size ? Array_ : NULL),
+		Array_Last(Size ? Array_ + Size : NULL) {}
+	template<class Al>
+	inline MexVectorView(const MexVector<T, Al> &M) :
+		Array_Beg(M.size() ? M.begin() : NULL),
+		Array_Last(M.size() ? M.end() : NULL) {}
+
+	inline MexVectorView & assign(size_t Size, const T* Array_){
+		Array_Beg = Size ? Array_ : NULL;
+		Array_Last = Size ? Array_ + Size : NULL;
+		return *this;
+	}
+	template<class Al>
+	inline MexVectorView & assign(const MexVector<T, Al> &M){
+		return assign(M.size(), M.begin());
+	}
+
+	inline const T& operator[] (size_t Index) const{
+		return Array_Beg[Index];
+	}
+	inline iterator begin() const{
+		return Array_Beg;
+	}
+	inline iterator end() const{
+		return Array_Last;
+	}
+	inline const T &last() const{
+		return *(Array_Last - 1);
+	}
+	inline size_t size() const{
+		return Array_Last - Array_Beg;
+	}
+	inline bool isempty() const{
+		return Array_Beg == Array_Last;
+	}
+};
+
+
 template<class T, class Al >
 class MexMatrix{
 	size_t NRows, NCols;
@@ -0,0 +1,193 @@
+#ifndef MEX_SOA_VECTOR_HPP
+#define MEX_SOA_VECTOR_HPP
+
+#include <tuple>
+#include <type_traits>
+#include <initializer_list>
+
+#include "MexMem.hpp"
+#include "GenericMexIO.hpp"
+
+// Index sequence helpers (std::index_sequence is C++14)
+template <size_t... Is> struct SoAIndices {};
+template <size_t N, size_t... Is> struct SoAMakeIndices : SoAMakeIndices<N - 1, N - 1, Is...> {};
+template <size_t... Is> struct SoAMakeIndices<0, Is...> { typedef SoAIndices<Is...> type; };
+
+// Used to expand a parameter pack of expressions in order
+struct SoASwallow {
+	template <typename... Ts> inline SoASwallow(Ts&&...) {}
+};
+
+template <typename... Fields>
+class MexSoAVector {
+	/*
+	   MexSoAVector<Fields...> is a vector of "structs" with the members of type
+	   Fields... stored in struct-of-arrays form i.e. each field is stored in its
+	   own MexVector<Field> and all of them have a common size. Element access
+	   is through the proxy ElemRef, while the field<I>() functions give each
+	   field as a contiguous array for use in vectorized kernels.
+
+	   The output to MATLAB (see assignmxArray below) is a struct of column
+	   vectors that takes over the memory of each field. This is without
+	   copying only for fields whose capacity equals their size, the others
+	   are shrunk to fit first (see assignmxArray).
+	*/
+
+	static_assert(sizeof...(Fields) > 0, "MexSoAVector must have at least one field");
+
+	typedef typename SoAMakeIndices<sizeof...(Fields)>::type FieldIndices;
+	std::tuple<MexVector<Fields, mxAllocator>...> FieldVects;
+
+	template <size_t... Is> inline void resizeFields(size_t NewSize, SoAIndices<Is...>) {
+		SoASwallow{ (std::get<Is>(FieldVects).resize(NewSize), 0)... };
+	}
+	template <size_t... Is> inline void reserveFields(size_t Cap, SoAIndices<Is...>) {
+		SoASwallow{ (std::get<Is>(FieldVects).reserve(Cap), 0)... };
+	}
+	template <size_t... Is> inline void clearFields(SoAIndices<Is...>) {
+		SoASwallow{ (std::get<Is>(FieldVects).clear(), 0)... };
+	}
+	template <size_t... Is> inline void trimFields(SoAIndices<Is...>) {
+		SoASwallow{ (std::get<Is>(FieldVects).trim(), 0)... };
+	}
+	template <size_t... Is> inline void pushFields(const std::tuple<Fields...> &Elem, SoAIndices<Is...>) {
+		SoASwallow{ (std::get<Is>(FieldVects).push_back(std::get<Is>(Elem)), 0)... };
+	}
+	template <size_t... Is> inline void swapFields(MexSoAVector &M, SoAIndices<Is...>) {
+		SoASwallow{ (std::get<Is>(FieldVects).swap(std::get<Is>(M.FieldVects)), 0)... };
+	}
+
+public:
+	template <size_t I>
+	using FieldType = typename std::tuple_element<I, std::tuple<Fields...> >::type;
+	static constexpr size_t NFields = sizeof...(Fields);
+
+	class ElemRef {
+		// Proxy reference to the element at Index. get<I>() returns a reference
+		// to the I'th field of the element
+		const MexSoAVector *Parent;
+		size_t Index;
+
+		template <size_t... Is> inline std::tuple<Fields...> getTuple(SoAIndices<Is...>) const {
+			return std::tuple<Fields...>(Parent->template field<Is>()[Index]...);
+		}
+		template <size_t... Is> inline void setTuple(const std::tuple<Fields...> &Elem, SoAIndices<Is...>) const {
+			SoASwallow{ (Parent->template field<Is>()[Index] = std::get<Is>(Elem), 0)... };
+		}
+
+	public:
+		inline ElemRef(const MexSoAVector *Parent_, size_t Index_) : Parent(Parent_), Index(Index_) {}
+
+		template <size_t I>
+		inline FieldType<I> &get() const {
+			return Parent->template field<I>()[Index];
+		}
+		inline operator std::tuple<Fields...>() const {
+			return getTuple(FieldIndices());
+		}
+		inline const ElemRef &operator = (const std::tuple<Fields...> &Elem) const {
+			setTuple(Elem, FieldIndices());
+			return *this;
+		}
+		inline const ElemRef &operator = (const ElemRef &Elem) const {
+			setTuple(std::tuple<Fields...>(Elem), FieldIndices());
+			return *this;
+		}
+	};
+
+	// Constructors
+	inline MexSoAVector() : FieldVects() {}
+	inline explicit MexSoAVector(size_t Size) : FieldVects() {
+		resize(Size);
+	}
+
+	// Element Access
+	inline ElemRef operator[] (size_t Index) const {
+		return ElemRef(this, Index);
+	}
+	inline ElemRef last() const {
+		return ElemRef(this, this->size() - 1);
+	}
+
+	// Field Access. The returned vectors are const in the sense used
+	// throughout MexMem i.e. their elements can be modified but they
+	// cannot be resized (which would break the common size)
+	template <size_t I>
+	inline const MexVector<FieldType<I>, mxAllocator> &field() const {
+		return std::get<I>(FieldVects);
+	}
+	template <size_t I>
+	inline FieldType<I> *fieldData() const {
+		return std::get<I>(FieldVects).begin();
+	}
+
+	// Size Modification
+	inline void resize(size_t NewSize) {
+		resizeFields(NewSize, FieldIndices());
+	}
+	inline void reserve(size_t Cap) {
+		reserveFields(Cap, FieldIndices());
+	}
+	inline void push_back(const Fields &... Vals) {
+		pushFields(std::tuple<Fields...>(Vals...), FieldIndices());
+	}
+	inline void push_back(const std::tuple<Fields...> &Elem) {
+		pushFields(Elem, FieldIndices());
+	}
+	inline void clear() {
+		clearFields(FieldIndices());
+	}
+	inline void trim() {
+		trimFields(FieldIndices());
+	}
+	inline void swap(MexSoAVector &M) {
+		swapFields(M, FieldIndices());
+	}
+
+	// Property Access
+	inline size_t size() const {
+		return std::get<0>(FieldVects).size();
+	}
+	inline size_t capacity() const {
+		return std::get<0>(FieldVects).capacity();
+	}
+	inline bool isempty() const {
+		return std::get<0>(FieldVects).isempty();
+	}
+
+	template <size_t... Is>
+	friend inline mxArrayPtr assignSoAFields(MexSoAVector &SoAVectorOut, const char* const* FieldNames, SoAIndices<Is...>) {
+		// mxArrays are created in order of the fields (and not left to the
+		// unspecified evaluation order of function arguments)
+		mxArrayPtr FieldmxArrays[] = { nullptr, assignmxArray(std::get<Is>(SoAVectorOut.FieldVects))... };
+
+		size_t Size[] = { 1, 1 };
+		mxArrayPtr ReturnStruct = mxCreateStructArray(2, Size, 0, nullptr);
+		for (size_t i = 0; i < sizeof...(Is); ++i) {
+			mxAddField(ReturnStruct, FieldNames[i]);
+			mxSetField(ReturnStruct, 0, FieldNames[i], FieldmxArrays[i + 1]);
+		}
+		return ReturnStruct;
+	}
+};
+
+template <typename... Fields>
+inline mxArrayPtr assignmxArray(MexSoAVector<Fields...> &SoAVectorOut, const std::initializer_list<const char*> &FieldNames) {
+
+	// Returns a 1x1 MATLAB struct with the given field names, each field
+	// being the column vector of the corresponding field of SoAVectorOut.
+	// The memory of each field is released to MATLAB and SoAVectorOut is
+	// empty after the call. A field whose capacity exceeds its size is
+	// trim()med first, which is a mxRealloc and may copy the field. Call
+	// trim() (or size the fields exactly) beforehand to keep this out of
+	// the output step.
+
+	if (FieldNames.size() != sizeof...(Fields)) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT,
+		               "The number of FieldNames (%d) must be equal to the number of fields in the MexSoAVector (%d)",
+		               FieldNames.size(), sizeof...(Fields));
+	}
+	return assignSoAFields(SoAVectorOut, FieldNames.begin(), typename SoAMakeIndices<sizeof...(Fields)>::type());
+}
+
+#endif
@@ -34,6 +34,9 @@ template <typename T, typename B = void>
 template <typename T, class Al> 
 	struct isMexVector<MexVector<T, Al>, typename std::enable_if<std::is_arithmetic<T>::value >::type > 
 		{ static constexpr bool value = true; typedef T type; };
+template <typename T> 
+	struct isMexVector<MexVectorView<T>, typename std::enable_if<std::is_arithmetic<T>::value >::type > 
+		{ static constexpr bool value = true; typedef T type; };
 
 // Type Traits extraction for Vector of Vectors
 template <typename T, class B = void>
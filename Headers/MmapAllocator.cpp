@@ -0,0 +1,157 @@
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include "MmapAllocator.hpp"
+
+#ifndef _WIN32
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <vector>
+#endif
+
+namespace {
+	std::mutex &getMmapAllocatorMutex() {
+		static std::mutex AllocatorMutex;
+		return AllocatorMutex;
+	}
+	std::string &getMmapAllocatorDirectory() {
+		static std::string Directory;
+		return Directory;
+	}
+}
+
+void MmapAllocator::setDirectory(const std::string &Directory) {
+	std::lock_guard<std::mutex> Lock(getMmapAllocatorMutex());
+	getMmapAllocatorDirectory() = Directory;
+}
+
+std::string MmapAllocator::getDirectory() {
+	std::lock_guard<std::mutex> Lock(getMmapAllocatorMutex());
+	std::string &Directory = getMmapAllocatorDirectory();
+	if (!Directory.empty())
+		return Directory;
+	const char* TempDir = std::getenv("TMPDIR");
+	return (TempDir != NULL && TempDir[0] != '\0') ? std::string(TempDir) : std::string("/tmp");
+}
+
+#ifdef _WIN32
+
+void * MmapAllocator::allocate(size_t Size) {
+	return std::malloc(Size);
+}
+
+void MmapAllocator::deallocate(void * Pointer) {
+	std::free(Pointer);
+}
+
+void * MmapAllocator::reallocate(void * PointerIn, size_t SizeNew) {
+	return std::realloc(PointerIn, SizeNew);
+}
+
+#else
+
+namespace {
+	struct MmapBlock {
+		int FileDesc;
+		size_t MapSize;
+	};
+	// The file and mapped size of each block (keyed by its address)
+	std::map<void*, MmapBlock> &getMmapBlocks() {
+		static std::map<void*, MmapBlock> Blocks;
+		return Blocks;
+	}
+	size_t getMapSize(size_t Size) {
+		size_t PageSize = size_t(sysconf(_SC_PAGESIZE));
+		Size = (Size > 0) ? Size : 1;
+		return (Size + PageSize - 1) / PageSize * PageSize;
+	}
+}
+
+void * MmapAllocator::allocate(size_t Size) {
+	// Returns NULL on failure (as malloc), which MexVector reports as
+	// EXCEPTION_MEM_FULL
+	std::string PathTemplate = getDirectory() + "/MexMmapXXXXXX";
+	std::vector<char> FilePath(PathTemplate.begin(), PathTemplate.end());
+	FilePath.push_back('\0');
+
+	int File = mkstemp(FilePath.data());
+	if (File < 0)
+		return NULL;
+	unlink(FilePath.data());
+
+	size_t MapSize = getMapSize(Size);
+	void* Block = (ftruncate(File, off_t(MapSize)) == 0)
+	            ? mmap(NULL, MapSize, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0)
+	            : MAP_FAILED;
+	if (Block == MAP_FAILED) {
+		close(File);
+		return NULL;
+	}
+
+	std::lock_guard<std::mutex> Lock(getMmapAllocatorMutex());
+	MmapBlock NewBlock = {File, MapSize};
+	getMmapBlocks()[Block] = NewBlock;
+	return Block;
+}
+
+void MmapAllocator::deallocate(void * Pointer) {
+	if (Pointer == NULL)
+		return;
+	MmapBlock Block;
+	{
+		std::lock_guard<std::mutex> Lock(getMmapAllocatorMutex());
+		auto BlockIter = getMmapBlocks().find(Pointer);
+		if (BlockIter == getMmapBlocks().end())
+			return;
+		Block = BlockIter->second;
+		getMmapBlocks().erase(BlockIter);
+	}
+	munmap(Pointer, Block.MapSize);
+	close(Block.FileDesc);
+}
+
+void * MmapAllocator::reallocate(void * PointerIn, size_t SizeNew) {
+	/*
+	   Extends (or shrinks) the file of the block and remaps it. The contents
+	   live in the file, so they are retained without copying even when the
+	   mapping moves. Returns NULL on failure, leaving the block unchanged.
+	*/
+	if (PointerIn == NULL)
+		return allocate(SizeNew);
+
+	MmapBlock Block;
+	{
+		std::lock_guard<std::mutex> Lock(getMmapAllocatorMutex());
+		auto BlockIter = getMmapBlocks().find(PointerIn);
+		if (BlockIter == getMmapBlocks().end())
+			return NULL;
+		Block = BlockIter->second;
+	}
+
+	size_t NewMapSize = getMapSize(SizeNew);
+	if (NewMapSize == Block.MapSize)
+		return PointerIn;
+	if (NewMapSize > Block.MapSize && ftruncate(Block.FileDesc, off_t(NewMapSize)) != 0)
+		return NULL;
+
+#ifdef __linux__
+	void* NewBlock = mremap(PointerIn, Block.MapSize, NewMapSize, MREMAP_MAYMOVE);
+#else
+	void* NewBlock = mmap(NULL, NewMapSize, PROT_READ | PROT_WRITE, MAP_SHARED, Block.FileDesc, 0);
+	if (NewBlock != MAP_FAILED)
+		munmap(PointerIn, Block.MapSize);
+#endif
+	if (NewBlock == MAP_FAILED)
+		return NULL;
+	if (NewMapSize < Block.MapSize)
+		(void)ftruncate(Block.FileDesc, off_t(NewMapSize));
+
+	std::lock_guard<std::mutex> Lock(getMmapAllocatorMutex());
+	getMmapBlocks().erase(PointerIn);
+	MmapBlock UpdatedBlock = {Block.FileDesc, NewMapSize};
+	getMmapBlocks()[NewBlock] = UpdatedBlock;
+	return NewBlock;
+}
+
+#endif
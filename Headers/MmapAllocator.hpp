@@ -0,0 +1,33 @@
+#ifndef MMAP_ALLOCATOR_HPP
+#define MMAP_ALLOCATOR_HPP
+
+#include <stddef.h>
+#include <string>
+
+class MmapAllocator {
+	/*
+	   MmapAllocator is an allocator policy (as CAllocator, mxAllocator) whose
+	   blocks are shared mappings of temporary files. The pages of a
+	   MexVector<T, MmapAllocator> are thus backed by the file system rather
+	   than by swap, so that MEX_EXE tools can build outputs larger than the
+	   physical memory. A block grows by extending its file (ftruncate) and
+	   remapping it, which never copies the contents.
+
+	   The files are created in getDirectory() (by default $TMPDIR, or /tmp)
+	   and are unlinked as soon as they are created, so they disappear when
+	   the blocks are deallocated or the process exits. Every block takes at
+	   least one page. The functions are thread safe.
+
+	   On Windows, MmapAllocator falls back to malloc / realloc / free.
+	*/
+
+public:
+	static void * allocate(size_t Size);
+	static void deallocate(void * Pointer);
+	static void * reallocate(void * PointerIn, size_t SizeNew);
+
+	static void setDirectory(const std::string &Directory);
+	static std::string getDirectory();
+};
+
+#endif
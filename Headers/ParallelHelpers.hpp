@@ -0,0 +1,183 @@
+#ifndef PARALLEL_HELPERS_HPP
+#define PARALLEL_HELPERS_HPP
+
+#include <stdint.h>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <algorithm>
+
+// These helpers split index ranges across std::threads. They are meant for
+// the number crunching parts of the library only, the bodies must NOT call
+// any mx* / mex* function as the MATLAB API is not thread safe.
+
+inline uint32_t &ParallelNumThreadsVal() {
+	static uint32_t NumThreads = (std::thread::hardware_concurrency() > 0) ? std::thread::hardware_concurrency() : 1;
+	return NumThreads;
+}
+
+inline uint32_t getParallelNumThreads() {
+	return ParallelNumThreadsVal();
+}
+
+inline void setParallelNumThreads(uint32_t NumThreads) {
+	ParallelNumThreadsVal() = (NumThreads > 0) ? NumThreads : 1;
+}
+
+inline size_t getParallelNumChunks(size_t NElems, size_t MinChunkSize) {
+	MinChunkSize = (MinChunkSize > 0) ? MinChunkSize : 1;
+	size_t NChunks = (NElems + MinChunkSize - 1) / MinChunkSize;
+	return std::max<size_t>(std::min<size_t>(NChunks, getParallelNumThreads()), 1);
+}
+
+template <typename BodyFuncT>
+inline void ParallelForChunks(size_t NChunks, const BodyFuncT &BodyFunc) {
+	/*
+	   Calls BodyFunc(ChunkIndex) for each ChunkIndex in [0, NChunks), each
+	   on a different thread (the last one runs on the calling thread). The
+	   first exception thrown by any chunk is rethrown after all threads have
+	   been joined.
+	*/
+
+	if (NChunks <= 1) {
+		if (NChunks == 1)
+			BodyFunc(size_t(0));
+		return;
+	}
+
+	std::vector<std::exception_ptr> ChunkExceptions(NChunks);
+	std::vector<std::thread> Workers;
+	Workers.reserve(NChunks - 1);
+
+	for (size_t i = 0; i < NChunks - 1; ++i) {
+		Workers.push_back(std::thread([&BodyFunc, &ChunkExceptions, i]() {
+			try {
+				BodyFunc(i);
+			}
+			catch (...) {
+				ChunkExceptions[i] = std::current_exception();
+			}
+		}));
+	}
+	try {
+		BodyFunc(NChunks - 1);
+	}
+	catch (...) {
+		ChunkExceptions[NChunks - 1] = std::current_exception();
+	}
+
+	for (auto &Worker : Workers)
+		Worker.join();
+	for (auto &ChunkException : ChunkExceptions)
+		if (ChunkException)
+			std::rethrow_exception(ChunkException);
+}
+
+template <typename BodyFuncT>
+inline void ParallelFor(size_t Beg, size_t End, size_t MinChunkSize, const BodyFuncT &BodyFunc) {
+	/*
+	   Splits [Beg, End) into at most getParallelNumThreads() contiguous chunks
+	   of at least MinChunkSize elements and calls BodyFunc(ChunkBeg, ChunkEnd)
+	   for each. Passing whole ranges (rather than single indices) to BodyFunc
+	   leaves the inner loop to the compiler to vectorize.
+	*/
+
+	if (End <= Beg)
+		return;
+
+	size_t NElems = End - Beg;
+	size_t NChunks = getParallelNumChunks(NElems, MinChunkSize);
+
+	ParallelForChunks(NChunks, [&](size_t ChunkIndex) {
+		size_t ChunkBeg = Beg + (NElems * ChunkIndex) / NChunks;
+		size_t ChunkEnd = Beg + (NElems * (ChunkIndex + 1)) / NChunks;
+		BodyFunc(ChunkBeg, ChunkEnd);
+	});
+}
+
+template <typename IndexT, typename BodyFuncT>
+inline void ParallelForSegments(const IndexT* Bounds, size_t NSegs, size_t MinChunkSize, const BodyFuncT &BodyFunc) {
+	/*
+	   Bounds[0..NSegs] are the boundaries of NSegs consecutive segments (e.g.
+	   a level of the PartitionIndex of a FlatVectTree). Splits the segments
+	   into at most getParallelNumThreads() contiguous chunks of roughly equal
+	   work, counting each segment as its size + 1, and calls
+	   BodyFunc(SegBeg, SegEnd) for each (non-empty) chunk. A segment is never
+	   split across chunks, so a single huge segment is handled by one thread.
+	*/
+
+	if (NSegs == 0)
+		return;
+
+	size_t TotalWork = size_t(Bounds[NSegs] - Bounds[0]) + NSegs;
+	size_t NChunks = getParallelNumChunks(TotalWork, MinChunkSize);
+
+	// The first segment beginning at or after the work position of the chunk
+	auto getChunkSegBeg = [&](size_t ChunkIndex) -> size_t {
+		size_t WorkPos = (TotalWork * ChunkIndex) / NChunks;
+		size_t Lo = 0, Hi = NSegs;
+		while (Lo < Hi) {
+			size_t Mid = Lo + (Hi - Lo) / 2;
+			if (size_t(Bounds[Mid] - Bounds[0]) + Mid < WorkPos)
+				Lo = Mid + 1;
+			else
+				Hi = Mid;
+		}
+		return Lo;
+	};
+
+	ParallelForChunks(NChunks, [&](size_t ChunkIndex) {
+		size_t SegBeg = getChunkSegBeg(ChunkIndex);
+		size_t SegEnd = getChunkSegBeg(ChunkIndex + 1);
+		if (SegBeg < SegEnd)
+			BodyFunc(SegBeg, SegEnd);
+	});
+}
+
+template <typename TypeIn, typename TypeOut>
+inline TypeOut ParallelExclusiveScan(const TypeIn* InBeg, size_t NElems, TypeOut* OutBeg, TypeOut InitVal = TypeOut(0), size_t MinChunkSize = 1 << 16) {
+	/*
+	   Computes OutBeg[i] = InitVal + InBeg[0] + ... + InBeg[i-1] for i in
+	   [0, NElems) and returns the total InitVal + sum(InBeg[0..NElems)).
+	   InBeg and OutBeg may point to the same array. The scan is done in two
+	   parallel passes (chunk sums, then chunk-local scans with offsets).
+
+	   The struct binding fill (getInputfromStruct) does not need it, it is
+	   used to compute the output offsets of the parallel FlatVectTree
+	   operations (filter, appendBatch, the builders, CSR transposes etc.).
+	*/
+
+	size_t NChunks = getParallelNumChunks(NElems, MinChunkSize);
+	std::vector<TypeOut> ChunkOffsets(NChunks + 1, TypeOut(0));
+
+	if (NChunks > 1) {
+		ParallelForChunks(NChunks, [&](size_t ChunkIndex) {
+			size_t ChunkBeg = (NElems * ChunkIndex) / NChunks;
+			size_t ChunkEnd = (NElems * (ChunkIndex + 1)) / NChunks;
+			TypeOut ChunkSum = TypeOut(0);
+			for (size_t i = ChunkBeg; i < ChunkEnd; ++i)
+				ChunkSum += (TypeOut)InBeg[i];
+			ChunkOffsets[ChunkIndex + 1] = ChunkSum;
+		});
+	}
+	ChunkOffsets[0] = InitVal;
+	for (size_t i = 0; i < NChunks; ++i)
+		ChunkOffsets[i + 1] += ChunkOffsets[i];
+
+	ParallelForChunks(NChunks, [&](size_t ChunkIndex) {
+		size_t ChunkBeg = (NElems * ChunkIndex) / NChunks;
+		size_t ChunkEnd = (NElems * (ChunkIndex + 1)) / NChunks;
+		TypeOut RunningSum = ChunkOffsets[ChunkIndex];
+		for (size_t i = ChunkBeg; i < ChunkEnd; ++i) {
+			TypeOut CurrElem = (TypeOut)InBeg[i];
+			OutBeg[i] = RunningSum;
+			RunningSum += CurrElem;
+		}
+		if (NChunks == 1)
+			ChunkOffsets[1] = RunningSum;
+	});
+
+	return ChunkOffsets[NChunks];
+}
+
+#endif
@@ -0,0 +1,465 @@
+/*
+   LocalMx - A stand-in for the subset of the MATLAB mx / mex C API used by
+   MexMemoryInterfacing, so that the MEX_EXE configuration (and the
+   benchmarks) can be built and run on machines without MATLAB. Build it
+   with the Makefile at the repository root (or the *_LocalExe
+   configurations of the Visual Studio project).
+
+   The costs follow those of MATLAB so that timings are representative:
+   numeric data is a single (column major) block from mxMalloc, zeroed by
+   the mxCreate* functions except mxCreateUninitNumericMatrix; cell and
+   struct arrays are blocks of mxArray pointers (struct fields interleaved
+   per element, as in MATLAB) and field lookup is a linear search over the
+   field names. mxSetData / mxSetCell / mxSetField do not free the previous
+   contents, as in MATLAB.
+
+   mexErrMsgIdAndTxt / mexErrMsgTxt print the message and throw a
+   std::runtime_error (MATLAB instead unwinds to the prompt).
+*/
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cstdarg>
+#include <csignal>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "matrix.h"
+#include "mex.h"
+
+struct mxArray_tag {
+	mxClassID ClassID;
+	std::vector<size_t> Dims;
+	void *Data;                          // numeric / char data, or mxArray* for cell / struct
+	std::vector<std::string> FieldNames; // only for struct arrays
+};
+
+namespace {
+
+size_t getClassElemSize(mxClassID ClassID) {
+	switch (ClassID) {
+		case mxCELL_CLASS    :
+		case mxSTRUCT_CLASS  : return sizeof(mxArray *);
+		case mxLOGICAL_CLASS : return sizeof(bool);
+		case mxCHAR_CLASS    : return sizeof(char16_t);
+		case mxDOUBLE_CLASS  : return sizeof(double);
+		case mxSINGLE_CLASS  : return sizeof(float);
+		case mxINT8_CLASS    :
+		case mxUINT8_CLASS   : return 1;
+		case mxINT16_CLASS   :
+		case mxUINT16_CLASS  : return 2;
+		case mxINT32_CLASS   :
+		case mxUINT32_CLASS  : return 4;
+		case mxINT64_CLASS   :
+		case mxUINT64_CLASS  : return 8;
+		default              : return 0;
+	}
+}
+
+size_t getNumElems(const std::vector<size_t> &Dims) {
+	size_t NumElems = 1;
+	for (auto Dim : Dims)
+		NumElems *= Dim;
+	return NumElems;
+}
+
+// Number of mxArray* slots held by cell / struct arrays
+size_t getNumSlots(const mxArray *pa) {
+	size_t NumElems = getNumElems(pa->Dims);
+	if (pa->ClassID == mxSTRUCT_CLASS)
+		return NumElems * pa->FieldNames.size();
+	else if (pa->ClassID == mxCELL_CLASS)
+		return NumElems;
+	else
+		return 0;
+}
+
+mxArray *createArray(mxClassID ClassID, size_t ndim, const size_t *dims, bool Initialize) {
+	mxArray *pa = new mxArray_tag;
+	pa->ClassID = ClassID;
+	pa->Dims.assign(dims, dims + ndim);
+	while (pa->Dims.size() < 2)
+		pa->Dims.push_back(pa->Dims.empty() ? 0 : 1);
+
+	size_t NBytes = getNumElems(pa->Dims) * getClassElemSize(ClassID);
+	if (NBytes)
+		pa->Data = Initialize ? mxCalloc(NBytes, 1) : mxMalloc(NBytes);
+	else
+		pa->Data = nullptr;
+	return pa;
+}
+
+void destroySlots(mxArray *pa) {
+	mxArray **Slots = reinterpret_cast<mxArray **>(pa->Data);
+	size_t NSlots = getNumSlots(pa);
+	for (size_t i = 0; i < NSlots; ++i)
+		mxDestroyArray(Slots[i]);
+}
+
+// The interrupt state (as set by Ctrl-C in MATLAB while enabled)
+volatile std::sig_atomic_t LocalMxInterruptPending = 0;
+bool LocalMxInterruptEnabled = false;
+
+void LocalMxInterruptHandler(int SIGNAL_TYPE) {
+	if (SIGNAL_TYPE == SIGINT)
+		LocalMxInterruptPending = 1;
+}
+
+}
+
+extern "C" {
+
+/////////////////////////////////////////////////
+// MEMORY FUNCTIONS          ////////////////////
+/////////////////////////////////////////////////
+
+void *mxMalloc(size_t n) {
+	return std::malloc(n);
+}
+void *mxCalloc(size_t n, size_t size) {
+	return std::calloc(n, size);
+}
+void *mxRealloc(void *ptr, size_t size) {
+	return std::realloc(ptr, size);
+}
+void mxFree(void *ptr) {
+	std::free(ptr);
+}
+
+/////////////////////////////////////////////////
+// CREATION / DESTRUCTION    ////////////////////
+/////////////////////////////////////////////////
+
+mxArray *mxCreateNumericMatrix(size_t m, size_t n, mxClassID classid, mxComplexity /* flag */) {
+	size_t Dims[] = { m, n };
+	return createArray(classid, 2, Dims, true);
+}
+mxArray *mxCreateNumericArray(size_t ndim, const size_t *dims, mxClassID classid, mxComplexity /* flag */) {
+	return createArray(classid, ndim, dims, true);
+}
+mxArray *mxCreateUninitNumericMatrix(size_t m, size_t n, mxClassID classid, mxComplexity /* flag */) {
+	size_t Dims[] = { m, n };
+	return createArray(classid, 2, Dims, false);
+}
+mxArray *mxCreateDoubleScalar(double value) {
+	mxArray *pa = mxCreateUninitNumericMatrix(1, 1, mxDOUBLE_CLASS, mxREAL);
+	*reinterpret_cast<double *>(pa->Data) = value;
+	return pa;
+}
+mxArray *mxCreateCellMatrix(size_t m, size_t n) {
+	size_t Dims[] = { m, n };
+	return createArray(mxCELL_CLASS, 2, Dims, true);
+}
+mxArray *mxCreateCellArray(size_t ndim, const size_t *dims) {
+	return createArray(mxCELL_CLASS, ndim, dims, true);
+}
+mxArray *mxCreateStructArray(size_t ndim, const size_t *dims, int nfields, const char **fieldnames) {
+	mxArray *pa = createArray(mxSTRUCT_CLASS, ndim, dims, false);
+	mxFree(pa->Data);
+	for (int i = 0; i < nfields; ++i)
+		pa->FieldNames.push_back(fieldnames[i]);
+	size_t NSlots = getNumSlots(pa);
+	pa->Data = NSlots ? mxCalloc(NSlots, sizeof(mxArray *)) : nullptr;
+	return pa;
+}
+mxArray *mxCreateStructMatrix(size_t m, size_t n, int nfields, const char **fieldnames) {
+	size_t Dims[] = { m, n };
+	return mxCreateStructArray(2, Dims, nfields, fieldnames);
+}
+mxArray *mxCreateString(const char *str) {
+	size_t Length = std::strlen(str);
+	mxArray *pa = mxCreateUninitNumericMatrix(Length ? 1 : 0, Length, mxCHAR_CLASS, mxREAL);
+	char16_t *Chars = reinterpret_cast<char16_t *>(pa->Data);
+	for (size_t i = 0; i < Length; ++i)
+		Chars[i] = (char16_t)(unsigned char)str[i];
+	return pa;
+}
+mxArray *mxDuplicateArray(const mxArray *in) {
+	if (in == nullptr)
+		return nullptr;
+	mxArray *pa = new mxArray_tag(*in);
+	if (in->ClassID == mxCELL_CLASS || in->ClassID == mxSTRUCT_CLASS) {
+		size_t NSlots = getNumSlots(in);
+		pa->Data = NSlots ? mxMalloc(NSlots * sizeof(mxArray *)) : nullptr;
+		for (size_t i = 0; i < NSlots; ++i)
+			reinterpret_cast<mxArray **>(pa->Data)[i] = mxDuplicateArray(reinterpret_cast<mxArray **>(in->Data)[i]);
+	}
+	else {
+		size_t NBytes = getNumElems(in->Dims) * getClassElemSize(in->ClassID);
+		pa->Data = NBytes ? mxMalloc(NBytes) : nullptr;
+		if (NBytes)
+			std::memcpy(pa->Data, in->Data, NBytes);
+	}
+	return pa;
+}
+void mxDestroyArray(mxArray *pa) {
+	if (pa == nullptr)
+		return;
+	if (pa->ClassID == mxCELL_CLASS || pa->ClassID == mxSTRUCT_CLASS)
+		destroySlots(pa);
+	mxFree(pa->Data);
+	delete pa;
+}
+
+/////////////////////////////////////////////////
+// PROPERTY ACCESS           ////////////////////
+/////////////////////////////////////////////////
+
+mxClassID mxGetClassID(const mxArray *pa) {
+	return pa->ClassID;
+}
+const char *mxGetClassName(const mxArray *pa) {
+	switch (pa->ClassID) {
+		case mxCELL_CLASS    : return "cell";
+		case mxSTRUCT_CLASS  : return "struct";
+		case mxLOGICAL_CLASS : return "logical";
+		case mxCHAR_CLASS    : return "char";
+		case mxDOUBLE_CLASS  : return "double";
+		case mxSINGLE_CLASS  : return "single";
+		case mxINT8_CLASS    : return "int8";
+		case mxUINT8_CLASS   : return "uint8";
+		case mxINT16_CLASS   : return "int16";
+		case mxUINT16_CLASS  : return "uint16";
+		case mxINT32_CLASS   : return "int32";
+		case mxUINT32_CLASS  : return "uint32";
+		case mxINT64_CLASS   : return "int64";
+		case mxUINT64_CLASS  : return "uint64";
+		default              : return "unknown";
+	}
+}
+void *mxGetData(const mxArray *pa) {
+	return pa->Data;
+}
+double *mxGetPr(const mxArray *pa) {
+	return reinterpret_cast<double *>(pa->Data);
+}
+double mxGetScalar(const mxArray *pa) {
+	if (pa->Data == nullptr)
+		return 0.0;
+	switch (pa->ClassID) {
+		case mxLOGICAL_CLASS : return *reinterpret_cast<bool     *>(pa->Data);
+		case mxCHAR_CLASS    : return *reinterpret_cast<char16_t *>(pa->Data);
+		case mxDOUBLE_CLASS  : return *reinterpret_cast<double   *>(pa->Data);
+		case mxSINGLE_CLASS  : return *reinterpret_cast<float    *>(pa->Data);
+		case mxINT8_CLASS    : return *reinterpret_cast<int8_t   *>(pa->Data);
+		case mxUINT8_CLASS   : return *reinterpret_cast<uint8_t  *>(pa->Data);
+		case mxINT16_CLASS   : return *reinterpret_cast<int16_t  *>(pa->Data);
+		case mxUINT16_CLASS  : return *reinterpret_cast<uint16_t *>(pa->Data);
+		case mxINT32_CLASS   : return *reinterpret_cast<int32_t  *>(pa->Data);
+		case mxUINT32_CLASS  : return *reinterpret_cast<uint32_t *>(pa->Data);
+		case mxINT64_CLASS   : return (double)*reinterpret_cast<int64_t  *>(pa->Data);
+		case mxUINT64_CLASS  : return (double)*reinterpret_cast<uint64_t *>(pa->Data);
+		default              : return 0.0;
+	}
+}
+void mxSetData(mxArray *pa, void *newdata) {
+	// As in MATLAB, the previous data is not freed
+	pa->Data = newdata;
+}
+size_t mxGetM(const mxArray *pa) {
+	return pa->Dims[0];
+}
+size_t mxGetN(const mxArray *pa) {
+	size_t N = 1;
+	for (size_t i = 1; i < pa->Dims.size(); ++i)
+		N *= pa->Dims[i];
+	return N;
+}
+void mxSetM(mxArray *pa, size_t m) {
+	pa->Dims[0] = m;
+}
+void mxSetN(mxArray *pa, size_t n) {
+	pa->Dims.resize(2);
+	pa->Dims[1] = n;
+}
+size_t mxGetNumberOfDimensions(const mxArray *pa) {
+	return pa->Dims.size();
+}
+const size_t *mxGetDimensions(const mxArray *pa) {
+	return pa->Dims.data();
+}
+int mxSetDimensions(mxArray *pa, const size_t *pdims, size_t ndims) {
+	pa->Dims.assign(pdims, pdims + ndims);
+	while (pa->Dims.size() < 2)
+		pa->Dims.push_back(1);
+	return 0;
+}
+size_t mxGetNumberOfElements(const mxArray *pa) {
+	return getNumElems(pa->Dims);
+}
+size_t mxGetElementSize(const mxArray *pa) {
+	return getClassElemSize(pa->ClassID);
+}
+bool mxIsEmpty(const mxArray *pa) {
+	return getNumElems(pa->Dims) == 0;
+}
+bool mxIsCell(const mxArray *pa) {
+	return pa->ClassID == mxCELL_CLASS;
+}
+bool mxIsStruct(const mxArray *pa) {
+	return pa->ClassID == mxSTRUCT_CLASS;
+}
+bool mxIsChar(const mxArray *pa) {
+	return pa->ClassID == mxCHAR_CLASS;
+}
+bool mxIsLogical(const mxArray *pa) {
+	return pa->ClassID == mxLOGICAL_CLASS;
+}
+mxLogical *mxGetLogicals(const mxArray *pa) {
+	return reinterpret_cast<mxLogical *>(pa->Data);
+}
+bool mxIsNumeric(const mxArray *pa) {
+	return pa->ClassID >= mxDOUBLE_CLASS && pa->ClassID <= mxUINT64_CLASS;
+}
+
+/////////////////////////////////////////////////
+// CELL ACCESS               ////////////////////
+/////////////////////////////////////////////////
+
+mxArray *mxGetCell(const mxArray *pa, size_t i) {
+	return reinterpret_cast<mxArray **>(pa->Data)[i];
+}
+void mxSetCell(mxArray *pa, size_t i, mxArray *value) {
+	// As in MATLAB, the previous cell content is not freed
+	reinterpret_cast<mxArray **>(pa->Data)[i] = value;
+}
+
+/////////////////////////////////////////////////
+// STRUCT ACCESS             ////////////////////
+/////////////////////////////////////////////////
+
+int mxGetNumberOfFields(const mxArray *pa) {
+	return (int)pa->FieldNames.size();
+}
+const char *mxGetFieldNameByNumber(const mxArray *pa, int n) {
+	if (n < 0 || n >= (int)pa->FieldNames.size())
+		return nullptr;
+	return pa->FieldNames[n].c_str();
+}
+int mxGetFieldNumber(const mxArray *pa, const char *name) {
+	if (pa == nullptr || pa->ClassID != mxSTRUCT_CLASS)
+		return -1;
+	for (size_t i = 0; i < pa->FieldNames.size(); ++i)
+		if (pa->FieldNames[i] == name)
+			return (int)i;
+	return -1;
+}
+int mxAddField(mxArray *pa, const char *fieldname) {
+	int FieldNum = mxGetFieldNumber(pa, fieldname);
+	if (FieldNum != -1)
+		return FieldNum;
+
+	size_t NElems = getNumElems(pa->Dims);
+	size_t NFieldsOld = pa->FieldNames.size();
+	mxArray **OldSlots = reinterpret_cast<mxArray **>(pa->Data);
+	mxArray **NewSlots = NElems ? reinterpret_cast<mxArray **>(mxCalloc(NElems * (NFieldsOld + 1), sizeof(mxArray *))) : nullptr;
+	for (size_t i = 0; i < NElems; ++i)
+		for (size_t j = 0; j < NFieldsOld; ++j)
+			NewSlots[i*(NFieldsOld + 1) + j] = OldSlots[i*NFieldsOld + j];
+	mxFree(OldSlots);
+
+	pa->Data = NewSlots;
+	pa->FieldNames.push_back(fieldname);
+	return (int)NFieldsOld;
+}
+mxArray *mxGetFieldByNumber(const mxArray *pa, size_t i, int fieldnum) {
+	size_t NFields = pa->FieldNames.size();
+	if (fieldnum < 0 || (size_t)fieldnum >= NFields || i >= getNumElems(pa->Dims))
+		return nullptr;
+	return reinterpret_cast<mxArray **>(pa->Data)[i*NFields + fieldnum];
+}
+mxArray *mxGetField(const mxArray *pa, size_t i, const char *fieldname) {
+	if (pa == nullptr || pa->ClassID != mxSTRUCT_CLASS)
+		return nullptr;
+	return mxGetFieldByNumber(pa, i, mxGetFieldNumber(pa, fieldname));
+}
+void mxSetFieldByNumber(mxArray *pa, size_t i, int fieldnum, mxArray *value) {
+	size_t NFields = pa->FieldNames.size();
+	reinterpret_cast<mxArray **>(pa->Data)[i*NFields + fieldnum] = value;
+}
+void mxSetField(mxArray *pa, size_t i, const char *fieldname, mxArray *value) {
+	int FieldNum = mxGetFieldNumber(pa, fieldname);
+	if (FieldNum != -1)
+		mxSetFieldByNumber(pa, i, FieldNum, value);
+}
+
+/////////////////////////////////////////////////
+// STRING FUNCTIONS          ////////////////////
+/////////////////////////////////////////////////
+
+char *mxArrayToString(const mxArray *pa) {
+	if (pa == nullptr || pa->ClassID != mxCHAR_CLASS)
+		return nullptr;
+	size_t Length = getNumElems(pa->Dims);
+	char *Str = reinterpret_cast<char *>(mxMalloc(Length + 1));
+	const char16_t *Chars = reinterpret_cast<const char16_t *>(pa->Data);
+	for (size_t i = 0; i < Length; ++i)
+		Str[i] = (char)Chars[i];
+	Str[Length] = 0;
+	return Str;
+}
+
+/////////////////////////////////////////////////
+// MEX FUNCTIONS             ////////////////////
+/////////////////////////////////////////////////
+
+int mexPrintf(const char *fmt, ...) {
+	std::va_list Args;
+	va_start(Args, fmt);
+	int NChars = std::vprintf(fmt, Args);
+	va_end(Args);
+	return NChars;
+}
+int mexEvalString(const char * /* str */) {
+	std::fflush(stdout);
+	return 0;
+}
+void mexErrMsgIdAndTxt(const char *identifier, const char *fmt, ...) {
+	std::va_list Args;
+	va_start(Args, fmt);
+	std::fprintf(stderr, "%s: ", identifier);
+	std::vfprintf(stderr, fmt, Args);
+	std::fprintf(stderr, "\n");
+	va_end(Args);
+	throw std::runtime_error(identifier);
+}
+void mexWarnMsgIdAndTxt(const char *identifier, const char *fmt, ...) {
+	std::va_list Args;
+	va_start(Args, fmt);
+	std::fprintf(stderr, "Warning (%s): ", identifier);
+	std::vfprintf(stderr, fmt, Args);
+	std::fprintf(stderr, "\n");
+	va_end(Args);
+}
+void mexWarnMsgTxt(const char *msg) {
+	std::fprintf(stderr, "Warning: %s\n", msg);
+}
+void mexErrMsgTxt(const char *msg) {
+	std::fprintf(stderr, "%s\n", msg);
+	throw std::runtime_error(msg);
+}
+
+/////////////////////////////////////////////////
+// INTERRUPT HOOKS           ////////////////////
+/////////////////////////////////////////////////
+
+bool utIsInterruptPending() {
+	return LocalMxInterruptPending != 0;
+}
+bool utSetInterruptPending(bool Pending) {
+	bool Prev = LocalMxInterruptPending != 0;
+	LocalMxInterruptPending = Pending ? 1 : 0;
+	return Prev;
+}
+bool utSetInterruptEnabled(bool Enabled) {
+	// Ctrl-C sets the pending interrupt only while enabled
+	bool Prev = LocalMxInterruptEnabled;
+	LocalMxInterruptEnabled = Enabled;
+	std::signal(SIGINT, Enabled ? LocalMxInterruptHandler : SIG_DFL);
+	return Prev;
+}
+
+}
@@ -0,0 +1,112 @@
+#ifndef LOCAL_MX_MATRIX_H
+#define LOCAL_MX_MATRIX_H
+
+// The mx API of LocalMx (see LocalMx.cpp), declared as in MATLAB's matrix.h
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef size_t mwSize;
+typedef size_t mwIndex;
+typedef ptrdiff_t mwSignedIndex;
+
+typedef bool mxLogical;
+#ifdef __cplusplus
+typedef char16_t mxChar;
+#else
+typedef unsigned short mxChar;
+#endif
+
+typedef enum {
+	mxUNKNOWN_CLASS = 0,
+	mxCELL_CLASS,
+	mxSTRUCT_CLASS,
+	mxLOGICAL_CLASS,
+	mxCHAR_CLASS,
+	mxVOID_CLASS,
+	mxDOUBLE_CLASS,
+	mxSINGLE_CLASS,
+	mxINT8_CLASS,
+	mxUINT8_CLASS,
+	mxINT16_CLASS,
+	mxUINT16_CLASS,
+	mxINT32_CLASS,
+	mxUINT32_CLASS,
+	mxINT64_CLASS,
+	mxUINT64_CLASS,
+	mxFUNCTION_CLASS
+} mxClassID;
+
+typedef enum {
+	mxREAL,
+	mxCOMPLEX
+} mxComplexity;
+
+typedef struct mxArray_tag mxArray;
+
+void *mxMalloc(size_t n);
+void *mxCalloc(size_t n, size_t size);
+void *mxRealloc(void *ptr, size_t size);
+void  mxFree(void *ptr);
+
+mxArray *mxCreateNumericMatrix(size_t m, size_t n, mxClassID classid, mxComplexity flag);
+mxArray *mxCreateNumericArray(size_t ndim, const size_t *dims, mxClassID classid, mxComplexity flag);
+mxArray *mxCreateUninitNumericMatrix(size_t m, size_t n, mxClassID classid, mxComplexity flag);
+mxArray *mxCreateDoubleScalar(double value);
+mxArray *mxCreateCellMatrix(size_t m, size_t n);
+mxArray *mxCreateCellArray(size_t ndim, const size_t *dims);
+mxArray *mxCreateStructArray(size_t ndim, const size_t *dims, int nfields, const char **fieldnames);
+mxArray *mxCreateStructMatrix(size_t m, size_t n, int nfields, const char **fieldnames);
+mxArray *mxCreateString(const char *str);
+mxArray *mxDuplicateArray(const mxArray *in);
+void     mxDestroyArray(mxArray *pa);
+
+#define mxCreateNumericMatrix_730 mxCreateNumericMatrix
+#define mxCreateCellMatrix_730 mxCreateCellMatrix
+
+mxClassID     mxGetClassID(const mxArray *pa);
+const char   *mxGetClassName(const mxArray *pa);
+void         *mxGetData(const mxArray *pa);
+double       *mxGetPr(const mxArray *pa);
+double        mxGetScalar(const mxArray *pa);
+void          mxSetData(mxArray *pa, void *newdata);
+size_t        mxGetM(const mxArray *pa);
+size_t        mxGetN(const mxArray *pa);
+void          mxSetM(mxArray *pa, size_t m);
+void          mxSetN(mxArray *pa, size_t n);
+size_t        mxGetNumberOfDimensions(const mxArray *pa);
+const size_t *mxGetDimensions(const mxArray *pa);
+int           mxSetDimensions(mxArray *pa, const size_t *pdims, size_t ndims);
+size_t        mxGetNumberOfElements(const mxArray *pa);
+size_t        mxGetElementSize(const mxArray *pa);
+bool          mxIsEmpty(const mxArray *pa);
+bool          mxIsCell(const mxArray *pa);
+bool          mxIsStruct(const mxArray *pa);
+bool          mxIsChar(const mxArray *pa);
+bool          mxIsLogical(const mxArray *pa);
+mxLogical    *mxGetLogicals(const mxArray *pa);
+bool          mxIsNumeric(const mxArray *pa);
+
+mxArray *mxGetCell(const mxArray *pa, size_t i);
+void     mxSetCell(mxArray *pa, size_t i, mxArray *value);
+
+int         mxGetNumberOfFields(const mxArray *pa);
+const char *mxGetFieldNameByNumber(const mxArray *pa, int n);
+int         mxGetFieldNumber(const mxArray *pa, const char *name);
+int         mxAddField(mxArray *pa, const char *fieldname);
+mxArray    *mxGetField(const mxArray *pa, size_t i, const char *fieldname);
+mxArray    *mxGetFieldByNumber(const mxArray *pa, size_t i, int fieldnum);
+void        mxSetField(mxArray *pa, size_t i, const char *fieldname, mxArray *value);
+void        mxSetFieldByNumber(mxArray *pa, size_t i, int fieldnum, mxArray *value);
+
+char *mxArrayToString(const mxArray *pa);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef LOCAL_MX_MEX_H
+#define LOCAL_MX_MEX_H
+
+#include "matrix.h"
+
+// The mex API of LocalMx (see LocalMx.cpp), declared as in MATLAB's mex.h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int  mexPrintf(const char *fmt, ...);
+int  mexEvalString(const char *str);
+void mexErrMsgIdAndTxt(const char *identifier, const char *fmt, ...);
+void mexErrMsgTxt(const char *msg);
+void mexWarnMsgIdAndTxt(const char *identifier, const char *fmt, ...);
+void mexWarnMsgTxt(const char *msg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -33,6 +33,13 @@ function CellArray = Convert2CellArrayPartial(obj, DepthStartInd, BegInds, EndIn
 %              to be a part of the partial Flat Cell Array which is to be 
 %              converted
 
+	% Using the native implementation if available (this converts the
+	% entire partial array in one call)
+	if exist('FlatCellArrayMex', 'file') == 3
+		CellArray = FlatCellArrayMex('Expand', obj.Convert2Struct(), DepthStartInd, BegInds(1), EndInds(1), 'Trusted');
+		return;
+	end
+
 	FullDepth = length(obj.PartitionIndex);
 	ActualDepth = FullDepth - DepthStartInd + 1;
 
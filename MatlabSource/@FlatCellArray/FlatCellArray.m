@@ -38,7 +38,8 @@ classdef FlatCellArray < hgsetget
 			% at max 2 elements). If the Depth is Zero, then it only
 			% initializes the depth. When Depth is increased, the given
 			% array is pushed deeper. When it is decreased, the deeper
-			% array is pulled to the top
+			% array is pulled to the top. The class of the PartitionIndex
+			% (uint32 by default) is retained.
 			
 			if obj.Depth == 0
 				obj.PartitionIndex = cell(Val,1);
@@ -48,7 +49,8 @@ classdef FlatCellArray < hgsetget
 			elseif obj.Depth < Val
 				% Push the existing array deeper
 				NewPartitionIndex = cell(Val, 1);
-				NewPartitionIndex(:) = {zeros(1,1, 'uint32')};
+				IndexClass = class(obj.PartitionIndex{1});
+				NewPartitionIndex(:) = {zeros(1,1, IndexClass)};
 				newDepth = length(NewPartitionIndex); % possibly different from Val if Val is not an integer
 				NewPartitionIndex(newDepth-obj.Depth+1:end) = obj.PartitionIndex;
 				
@@ -62,7 +64,7 @@ classdef FlatCellArray < hgsetget
 
 					% Notify all higher levels of the position of exactly one
 					% element below them
-					NewPartitionIndex(1:newDepth-obj.Depth-1) = {uint32([0; 1])};
+					NewPartitionIndex(1:newDepth-obj.Depth-1) = {cast([0; 1], IndexClass)};
 				end
 				
 				obj.PartitionIndex = NewPartitionIndex;
@@ -97,6 +99,7 @@ classdef FlatCellArray < hgsetget
 		TypeString = getCellType(CellArray, CheckConsistency)
 		CellArray = setCellDepth(CellArray, NewDepth)
 		[isValid, Ex] = ValidateFlatCellArray(PartitionIndexIn, DataIn)
+		Token = getValidationToken(PartitionIndexIn, DataIn)
 	end
 	
 	% Constructor List
@@ -119,11 +122,24 @@ classdef FlatCellArray < hgsetget
 				obj.PartitionIndex = cell(0,1);
 				obj.Data           = zeros(0,1);
 				obj.Depth = InitDepth;
-			elseif nargin == 2
+			elseif nargin == 2 || nargin == 3 && isstruct(PartitionIndex)
+				% FlatCellArray(InitDepth, InputStruct) or
+				% FlatCellArray(InitDepth, InputStruct, 'Trusted')
+				%
+				% The struct is validated in full unless 'Trusted' is given
+				% AND it carries a matching ValidationToken. 'Trusted' is
+				% only for structs known to be valid (e.g. returned by
+				% FlatCellArrayMex), as the token can be recomputed for
+				% an edited struct.
 				InputStruct = PartitionIndex;
+				isTrusted = nargin == 3 && ischar(Data) && strcmpi(Data, 'Trusted');
 				if isstruct(InputStruct) && isfield(InputStruct, 'ClassName') && strcmp(InputStruct.ClassName, 'FlatCellArray')
-					% Validate Given Vectors
-					[isValid, ME] = FlatCellArray.ValidateFlatCellArray(InputStruct.PartitionIndex, InputStruct.Data);
+					if isTrusted && isfield(InputStruct, 'ValidationToken') && ~isempty(InputStruct.ValidationToken) && ...
+					   isequal(InputStruct.ValidationToken, FlatCellArray.getValidationToken(InputStruct.PartitionIndex, InputStruct.Data))
+						isValid = true;
+					else
+						[isValid, ME] = FlatCellArray.ValidateFlatCellArray(InputStruct.PartitionIndex, InputStruct.Data);
+					end
 
 					if isValid
 						% reshape to row vector
@@ -177,6 +193,7 @@ classdef FlatCellArray < hgsetget
 			structOut.ClassName = 'FlatCellArray';
 			structOut.PartitionIndex = obj.PartitionIndex;
 			structOut.Data = obj.Data;
+			structOut.ValidationToken = FlatCellArray.getValidationToken(obj.PartitionIndex, obj.Data);
 		end
 	end
 end
@@ -7,6 +7,22 @@ function obj = FlattenCellArray(CellArray, InputArrayType, ActualDepth)
 %   the given Input Cell Array. It returns an error if the cell
 %   array is not a valid cell array. The depth of the array is
 %   automatically calculated using CellArrayDepth.
+%   
+%   If the MEX file FlatCellArrayMex (Source/FlatCellArrayMex.cpp) is on
+%   the path, the flattening is performed by it.
+
+	% Using the native implementation if available
+	if exist('FlatCellArrayMex', 'file') == 3
+		if nargin < 2
+			InputArrayType = '';
+		end
+		if nargin < 3
+			ActualDepth = [];
+		end
+		StructOut = FlatCellArrayMex('Flatten', CellArray, InputArrayType, ActualDepth);
+		obj = FlatCellArray(length(StructOut.PartitionIndex), StructOut, 'Trusted');
+		return;
+	end
 
 	obj = FlatCellArray();
 	
@@ -54,13 +70,17 @@ function obj = FlattenCellArray(CellArray, InputArrayType, ActualDepth)
 		ActualDepth = CellArrayDepth;
 	end
 	
-	% Initializing PartitionIndex
+	% Initializing PartitionIndex (uint64 only if uint32 is insufficient)
+	IndexClass = 'uint32';
+	if max(CellLevelSizes) > intmax('uint32')
+		IndexClass = 'uint64';
+	end
 	obj.PartitionIndex = cell(ActualDepth, 1);
 	for i = 1:CellArrayDepth
-		obj.PartitionIndex{i} = zeros(CellLevelSizes(i)+1, 1, 'uint32');
+		obj.PartitionIndex{i} = zeros(CellLevelSizes(i)+1, 1, IndexClass);
 	end
 	for i = CellArrayDepth+1:ActualDepth
-		obj.PartitionIndex{i} = zeros(1,1,'uint32');
+		obj.PartitionIndex{i} = zeros(1,1,IndexClass);
 	end
 	
 	% Initializing Data
@@ -158,8 +158,13 @@ function append(FlatCellArr, Cell2Push, DepthStartInd, InputType, ActualCell2Pus
 		CurrFlatArrayDepth = DepthStartInd + PushCellArrDepth - 1;
 		FlatCellArr.PartitionIndex = cell(CurrFlatArrayDepth, 1);
 		
-		FlatCellArr.PartitionIndex(1:DepthStartInd-1) = {zeros(2,1,'uint32')};
-		FlatCellArr.PartitionIndex(DepthStartInd:end) = {zeros(1,1,'uint32')};
+		% The PartitionIndex takes the class of that of Cell2Push
+		IndexClass = 'uint32';
+		if Cell2Push.Depth > 0
+			IndexClass = class(Cell2Push.PartitionIndex{1});
+		end
+		FlatCellArr.PartitionIndex(1:DepthStartInd-1) = {zeros(2,1,IndexClass)};
+		FlatCellArr.PartitionIndex(DepthStartInd:end) = {zeros(1,1,IndexClass)};
 		
 		FlatCellArr.Data = zeros(0,1, class(Cell2Push.Data));
 	end
@@ -183,7 +188,7 @@ function append(FlatCellArr, Cell2Push, DepthStartInd, InputType, ActualCell2Pus
 		FlatCellArr.PartitionIndex{i}(end+1:end+LevelExpandLength) = 0;
 		FlatCellArr.PartitionIndex{i}(LevelInsertIndex:LevelInsertIndex+LevelExpandLength-1) = ...
 			... 1:end-1 to exclude BTE Elem in Cell2Push + offset by prev Beyond-The-End Elem
-			Cell2Push.PartitionIndex{i+1-DepthStartInd}(1:end-1) + FlatCellArr.PartitionIndex{i}(LevelInsertIndex); 
+			cast(Cell2Push.PartitionIndex{i+1-DepthStartInd}(1:end-1), class(FlatCellArr.PartitionIndex{i})) + FlatCellArr.PartitionIndex{i}(LevelInsertIndex); 
 		
 		% Assigning Beyond-The-end Element and updating BegInds
 		FlatCellArr.PartitionIndex{i}(end) = BegInds(i+1-DepthStartInd+1);
@@ -12,6 +12,9 @@ function filter(FlatCellArr, FiltIndexVect, Depth)
 %       PartitionLevel{i} is filtered accordingly
 %   elseif Depth is unspecified or Depth == FlatCellArr.Depth + 1
 %       Data is filtered accordingly
+%
+%   If the MEX file FlatCellArrayMex (Source/FlatCellArrayMex.cpp) is on
+%   the path, the filtering is performed by it.
 
 % Default Assignment
 if nargin == 2
@@ -24,6 +27,14 @@ if Depth <= 0 || Depth > FlatCellArr.Depth + 1
     throw(ME);
 end
 
+% Using the native implementation if available
+if exist('FlatCellArrayMex', 'file') == 3
+    StructOut = FlatCellArrayMex('Filter', FlatCellArr.Convert2Struct(), FiltIndexVect, Depth, 'Trusted');
+    FlatCellArr.PartitionIndex(StructOut.FirstLevel:end) = StructOut.PartitionIndex;
+    FlatCellArr.Data = StructOut.Data;
+    return;
+end
+
 % Recursion Initialization Step
 if islogical(FiltIndexVect)
     FiltIndexVect = find(FiltIndexVect);
@@ -68,12 +79,13 @@ if Depth > 1
        ChildrenCount = zeros(length(FlatCellArr.PartitionIndex{Depth-1})-1, 1);
    end
    % calculate new parent vector y cumsumming no. of children
-   FlatCellArr.PartitionIndex{Depth-1} = uint32([0; cumsum(ChildrenCount)]);
+   FlatCellArr.PartitionIndex{Depth-1} = cast([0; cumsum(ChildrenCount)], class(FlatCellArr.PartitionIndex{Depth-1}));
 end
 
 % Filter relevant vector
 if Depth <= FlatCellArr.Depth
-    FlatCellArr.PartitionIndex{Depth} = FlatCellArr.PartitionIndex{Depth}(FiltIndexVect);
+    % (the Beyond-The-End element is retained)
+    FlatCellArr.PartitionIndex{Depth} = FlatCellArr.PartitionIndex{Depth}([FiltIndexVect(:); end]);
 else
     FlatCellArr.Data = FlatCellArr.Data(FiltIndexVect);
 end
@@ -17,7 +17,7 @@ function FlatCellArrOut = getSubFlatCellArr(FlatCellArrIn, Level, Indices )
 			% Calculating current level entries by performing cumsum over
 			% the sizes of the current level elements
 			CurrLevelElemSizes = [0; FlatCellArrIn.PartitionIndex{i+Level-1}(CurrLevelIndices+1) - FlatCellArrIn.PartitionIndex{i+Level-1}(CurrLevelIndices)];
-			CurrLevelEntries = uint32(cumsum(CurrLevelElemSizes));
+			CurrLevelEntries = cast(cumsum(CurrLevelElemSizes), class(FlatCellArrIn.PartitionIndex{i+Level-1}));
 			PartitionIndexOut{i} = CurrLevelEntries;
 			
 			% Getting the next level indices using the values stored in the
@@ -0,0 +1,23 @@
+function Token = getValidationToken(PartitionIndexIn, DataIn)
+% getValidationToken - Returns the validation token of the given
+% PartitionIndexIn and DataIn
+% 
+%     Token = getValidationToken(PartitionIndexIn, DataIn)
+% 
+%   The token is the uint64 column vector of the number of elements in
+%   each level of PartitionIndexIn followed by that of DataIn. It is
+%   stored in the ValidationToken field by Convert2Struct (and by the MEX
+%   functions returning FlatCellArray structs). The token does NOT prove
+%   that a struct is valid (an index edited in place keeps it matching).
+%   It is only checked when the caller explicitly trusts the struct (the
+%   'Trusted' option of the constructor and of FlatCellArrayMex, used for
+%   the private arrays of a FlatCellArray), in which case the validation
+%   is skipped. Token is empty if PartitionIndexIn is not a cell array.
+
+if iscell(PartitionIndexIn)
+	Token = uint64([cellfun(@numel, PartitionIndexIn(:)); numel(DataIn)]);
+else
+	Token = zeros(0, 1, 'uint64');
+end
+
+end
@@ -0,0 +1,355 @@
+#ifndef BENCHMARK_HELPERS_HPP
+#define BENCHMARK_HELPERS_HPP
+
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+
+#include "../../Headers/MexMem.hpp"
+
+/*
+   Helpers shared by the benchmark executables (Benchmark_*.cpp): option
+   parsing, a stopwatch that also samples the allocation counters, and the
+   reporting of results as a table, CSV or JSON.
+
+   Every benchmark case is run NReps times. A case times only the part
+   between Watch.start() and Watch.stop(), so that the setup (e.g. building
+   the input) is excluded. The reported times are the median and minimum
+   over the repetitions, divided by the amount of Work of the case (e.g.
+   the number of elements appended).
+*/
+
+/////////////////////////////////////////////////
+// ALLOCATION COUNTING       ////////////////////
+/////////////////////////////////////////////////
+
+struct BenchAllocCounts {
+	size_t NAllocs;
+	size_t NReallocs;
+	size_t NFrees;
+};
+
+inline std::atomic<size_t>* getBenchAllocCounters() {
+	static std::atomic<size_t> Counters[3];
+	return Counters;
+}
+
+inline BenchAllocCounts getBenchAllocCounts() {
+	std::atomic<size_t>* Counters = getBenchAllocCounters();
+	BenchAllocCounts Counts = { Counters[0], Counters[1], Counters[2] };
+	return Counts;
+}
+
+template <class Al = CAllocator>
+class BenchCountingAllocator {
+	// An allocator policy (as CAllocator) counting the calls to Al
+public:
+	static inline void * allocate(size_t Size) {
+		++getBenchAllocCounters()[0];
+		return Al::allocate(Size);
+	}
+	static inline void deallocate(void * Pointer) {
+		if (Pointer != NULL)
+			++getBenchAllocCounters()[2];
+		Al::deallocate(Pointer);
+	}
+	static inline void * reallocate(void * PointerIn, size_t SizeNew) {
+		++getBenchAllocCounters()[1];
+		return Al::reallocate(PointerIn, SizeNew);
+	}
+};
+
+template <typename T>
+class BenchCountingStdAllocator {
+	// The std::vector counterpart of BenchCountingAllocator (for the
+	// std::vector baselines)
+public:
+	typedef T value_type;
+
+	BenchCountingStdAllocator() {}
+	template <typename U> BenchCountingStdAllocator(const BenchCountingStdAllocator<U> &) {}
+
+	inline T* allocate(size_t NElems) {
+		++getBenchAllocCounters()[0];
+		return static_cast<T*>(::operator new(NElems * sizeof(T)));
+	}
+	inline void deallocate(T* Pointer, size_t) {
+		++getBenchAllocCounters()[2];
+		::operator delete(Pointer);
+	}
+};
+template <typename T, typename U>
+inline bool operator == (const BenchCountingStdAllocator<T> &, const BenchCountingStdAllocator<U> &) { return true; }
+template <typename T, typename U>
+inline bool operator != (const BenchCountingStdAllocator<T> &, const BenchCountingStdAllocator<U> &) { return false; }
+
+// Keeps the compiler from optimizing away the computation of Val
+template <typename T>
+inline void benchDoNotOptimize(const T &Val) {
+#if defined(__GNUC__)
+	asm volatile("" : : "r"(&Val) : "memory");
+#else
+	static const void* volatile Sink;
+	Sink = &Val;
+#endif
+}
+
+/////////////////////////////////////////////////
+// TIMING                    ////////////////////
+/////////////////////////////////////////////////
+
+class BenchStopwatch {
+	// Accumulates the time (and allocations) between start() and stop()
+	// calls. A case may start and stop it several times.
+	std::chrono::steady_clock::time_point StartTime;
+	BenchAllocCounts StartAllocs;
+	size_t StartMemUsage;
+
+public:
+	double Seconds;
+	BenchAllocCounts Allocs;
+	int64_t MemUsage; // Net change (negative if the case frees more than it allocates)
+
+	inline BenchStopwatch() : StartMemUsage(0), Seconds(0), MemUsage(0) {
+		std::memset(&StartAllocs, 0, sizeof(BenchAllocCounts));
+		std::memset(&Allocs, 0, sizeof(BenchAllocCounts));
+	}
+	inline void start() {
+		StartAllocs = getBenchAllocCounts();
+		StartMemUsage = MemCounter::getMemUsage();
+		StartTime = std::chrono::steady_clock::now();
+	}
+	inline void stop() {
+		std::chrono::steady_clock::time_point StopTime = std::chrono::steady_clock::now();
+		Seconds += std::chrono::duration<double>(StopTime - StartTime).count();
+		BenchAllocCounts StopAllocs = getBenchAllocCounts();
+		Allocs.NAllocs   += StopAllocs.NAllocs   - StartAllocs.NAllocs;
+		Allocs.NReallocs += StopAllocs.NReallocs - StartAllocs.NReallocs;
+		Allocs.NFrees    += StopAllocs.NFrees    - StartAllocs.NFrees;
+		MemUsage += int64_t(MemCounter::getMemUsage()) - int64_t(StartMemUsage);
+	}
+};
+
+/////////////////////////////////////////////////
+// OPTIONS AND REPORTING     ////////////////////
+/////////////////////////////////////////////////
+
+enum BenchFormat {
+	BENCH_TABLE,
+	BENCH_CSV,
+	BENCH_JSON
+};
+
+struct BenchOptions {
+	std::vector<size_t> Sizes;
+	std::vector<std::string> Types;
+	uint32_t NReps;
+	std::string Filter;  // Only the cases whose names contain Filter are run
+	BenchFormat Format;
+	std::string OutPath; // stdout if empty
+};
+
+struct BenchResult {
+	std::string Case;
+	std::string Variant; // e.g. MexVector / std::vector
+	std::string Type;
+	size_t N;            // The size parameter of the case
+	size_t Work;         // The number of elements processed per repetition
+	size_t WorkBytes;    // The number of bytes processed per repetition
+	uint32_t NReps;
+	double MedianSeconds;
+	double MinSeconds;
+	BenchAllocCounts Allocs; // Of the last repetition
+	int64_t MemUsage;        // Net MemCounter bytes charged in the last repetition
+};
+
+inline std::vector<std::string> splitBenchList(const std::string &List) {
+	std::vector<std::string> Items;
+	size_t Beg = 0;
+	while (Beg <= List.size()) {
+		size_t End = List.find(',', Beg);
+		End = (End == std::string::npos) ? List.size() : End;
+		if (End > Beg)
+			Items.push_back(List.substr(Beg, End - Beg));
+		Beg = End + 1;
+	}
+	return Items;
+}
+
+inline bool parseBenchOptions(int argc, char* argv[], BenchOptions &Options, const char* Usage) {
+	/*
+	   Parses the common options (the defaults being those already in
+	   Options):
+
+	     --sizes N1,N2,...    --types T1,T2,...    --reps R
+	     --filter Substring   --format table|csv|json    --out File
+
+	   Prints Usage and returns false on --help or an invalid option.
+	*/
+	bool isValid = true;
+	bool isHelp = false;
+	for (int i = 1; i < argc && isValid && !isHelp; ++i) {
+		std::string Option = argv[i];
+		bool hasValue = i + 1 < argc;
+		std::string Value = hasValue ? argv[i + 1] : "";
+		if (Option == "--help" || Option == "-h") {
+			isHelp = true;
+			continue;
+		}
+		else if (!hasValue) {
+			isValid = false;
+			continue;
+		}
+		++i;
+		if (Option == "--sizes") {
+			Options.Sizes.clear();
+			for (auto &Item : splitBenchList(Value))
+				Options.Sizes.push_back(size_t(std::strtoull(Item.c_str(), NULL, 10)));
+			isValid = !Options.Sizes.empty();
+		}
+		else if (Option == "--types") {
+			Options.Types = splitBenchList(Value);
+			isValid = !Options.Types.empty();
+		}
+		else if (Option == "--reps") {
+			Options.NReps = uint32_t(std::strtoul(Value.c_str(), NULL, 10));
+			isValid = Options.NReps > 0;
+		}
+		else if (Option == "--filter") {
+			Options.Filter = Value;
+		}
+		else if (Option == "--format") {
+			isValid = Value == "table" || Value == "csv" || Value == "json";
+			Options.Format = (Value == "csv") ? BENCH_CSV : (Value == "json") ? BENCH_JSON : BENCH_TABLE;
+		}
+		else if (Option == "--out") {
+			Options.OutPath = Value;
+		}
+		else {
+			isValid = false;
+		}
+	}
+	if (!isValid || isHelp) {
+		std::fprintf(isValid ? stdout : stderr, "%s", Usage);
+		return false;
+	}
+	return true;
+}
+
+class BenchReporter {
+	/*
+	   Writes the results as they come, either as an aligned table, as CSV
+	   (with a header line) or as a JSON array of objects. The columns /
+	   keys are case, variant, type, n, work, reps, ns_per_elem (median),
+	   ns_per_elem_min, bytes_per_s (median), allocs, reallocs, frees and
+	   memcounter_bytes.
+	*/
+	FILE* Out;
+	BenchFormat Format;
+	size_t NResults;
+
+	BenchReporter(const BenchReporter &) = delete;
+	BenchReporter & operator = (const BenchReporter &) = delete;
+
+public:
+	inline BenchReporter(const BenchOptions &Options) : Out(stdout), Format(Options.Format), NResults(0) {
+		if (!Options.OutPath.empty()) {
+			Out = std::fopen(Options.OutPath.c_str(), "w");
+			if (Out == NULL) {
+				std::fprintf(stderr, "Could not open '%s', writing to stdout\n", Options.OutPath.c_str());
+				Out = stdout;
+			}
+		}
+		if (Format == BENCH_TABLE)
+			std::fprintf(Out, "%-24s %-14s %-7s %10s %5s %12s %12s %12s %8s %8s %8s %12s\n",
+			             "case", "variant", "type", "n", "reps", "ns/elem", "ns/elem(min)", "MB/s",
+			             "allocs", "reallocs", "frees", "memcounter");
+		else if (Format == BENCH_CSV)
+			std::fprintf(Out, "case,variant,type,n,work,reps,ns_per_elem,ns_per_elem_min,bytes_per_s,allocs,reallocs,frees,memcounter_bytes\n");
+		else
+			std::fprintf(Out, "[");
+	}
+	inline ~BenchReporter() {
+		if (Format == BENCH_JSON)
+			std::fprintf(Out, "\n]\n");
+		if (Out != stdout)
+			std::fclose(Out);
+		else
+			std::fflush(Out);
+	}
+
+	inline void report(const BenchResult &Result) {
+		double Work = double(std::max<size_t>(Result.Work, 1));
+		double NsPerElem = Result.MedianSeconds * 1e9 / Work;
+		double NsPerElemMin = Result.MinSeconds * 1e9 / Work;
+		double BytesPerSec = (Result.MedianSeconds > 0) ? double(Result.WorkBytes) / Result.MedianSeconds : 0.0;
+
+		if (Format == BENCH_TABLE) {
+			std::fprintf(Out, "%-24s %-14s %-7s %10llu %5u %12.3f %12.3f %12.1f %8llu %8llu %8llu %12lld\n",
+			             Result.Case.c_str(), Result.Variant.c_str(), Result.Type.c_str(), (unsigned long long)Result.N,
+			             Result.NReps, NsPerElem, NsPerElemMin, BytesPerSec / 1e6,
+			             (unsigned long long)Result.Allocs.NAllocs, (unsigned long long)Result.Allocs.NReallocs,
+			             (unsigned long long)Result.Allocs.NFrees, (long long)Result.MemUsage);
+		}
+		else if (Format == BENCH_CSV) {
+			std::fprintf(Out, "%s,%s,%s,%llu,%llu,%u,%.6g,%.6g,%.6g,%llu,%llu,%llu,%lld\n",
+			             Result.Case.c_str(), Result.Variant.c_str(), Result.Type.c_str(), (unsigned long long)Result.N,
+			             (unsigned long long)Result.Work, Result.NReps, NsPerElem, NsPerElemMin, BytesPerSec,
+			             (unsigned long long)Result.Allocs.NAllocs, (unsigned long long)Result.Allocs.NReallocs,
+			             (unsigned long long)Result.Allocs.NFrees, (long long)Result.MemUsage);
+		}
+		else {
+			std::fprintf(Out, "%s\n  {\"case\": \"%s\", \"variant\": \"%s\", \"type\": \"%s\", \"n\": %llu, \"work\": %llu, "
+			             "\"reps\": %u, \"ns_per_elem\": %.6g, \"ns_per_elem_min\": %.6g, \"bytes_per_s\": %.6g, "
+			             "\"allocs\": %llu, \"reallocs\": %llu, \"frees\": %llu, \"memcounter_bytes\": %lld}",
+			             NResults ? "," : "", Result.Case.c_str(), Result.Variant.c_str(), Result.Type.c_str(),
+			             (unsigned long long)Result.N, (unsigned long long)Result.Work, Result.NReps,
+			             NsPerElem, NsPerElemMin, BytesPerSec,
+			             (unsigned long long)Result.Allocs.NAllocs, (unsigned long long)Result.Allocs.NReallocs,
+			             (unsigned long long)Result.Allocs.NFrees, (long long)Result.MemUsage);
+		}
+		++NResults;
+	}
+};
+
+template <typename CaseFuncT>
+inline void runBenchCase(const BenchOptions &Options, BenchReporter &Reporter,
+                         const char* Case, const char* Variant, const char* Type,
+                         size_t N, size_t Work, size_t WorkBytes, const CaseFuncT &CaseFunc) {
+	// Runs CaseFunc(Watch) Options.NReps times (if Case matches the filter)
+	// and reports the result
+	if (!Options.Filter.empty() && std::string(Case).find(Options.Filter) == std::string::npos)
+		return;
+
+	std::vector<double> RepSeconds(Options.NReps);
+	BenchStopwatch Watch;
+	for (uint32_t r = 0; r < Options.NReps; ++r) {
+		Watch = BenchStopwatch();
+		CaseFunc(Watch);
+		RepSeconds[r] = Watch.Seconds;
+	}
+	std::sort(RepSeconds.begin(), RepSeconds.end());
+
+	BenchResult Result;
+	Result.Case = Case;
+	Result.Variant = Variant;
+	Result.Type = Type;
+	Result.N = N;
+	Result.Work = Work;
+	Result.WorkBytes = WorkBytes;
+	Result.NReps = Options.NReps;
+	Result.MedianSeconds = RepSeconds[RepSeconds.size() / 2];
+	Result.MinSeconds = RepSeconds[0];
+	Result.Allocs = Watch.Allocs;
+	Result.MemUsage = Watch.MemUsage;
+	Reporter.report(Result);
+}
+
+#endif
@@ -0,0 +1,556 @@
+#include <mex.h>
+#include <matrix.h>
+#undef printf
+
+#include <stdint.h>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+#include "../../Headers/MexMem.hpp"
+#include "../../Headers/GenericMexIO.hpp"
+#include "../../Headers/FlatVectTree/FlatVectTree.hpp"
+#include "BenchmarkHelpers.hpp"
+
+/*
+   Benchmark_MexIO - End-to-end throughput of the GenericMexIO marshalling
+   (getValidStructField, getInputfrommxArray / getInputfromStruct and
+   assignmxArray) over a realistic input struct. For each size N and type,
+   the input struct contains
+
+     Params.GroupXX.ValueYY   200 scalars in 8 nested structs
+     Vectors.VX               4 vectors of N elements
+     Matrices.MX              2 matrices of N/16 x 16 elements
+     Cells.CX                 2 cell arrays of vectors (N elements in all,
+                              0-63 elements per vector)
+     DeepCells.DX             2 depth 3 cell arrays (N elements each), read
+                              using FlattenCellArray
+     Trees.TX                 2 depth 2 FlatCellArray structs (N elements)
+
+   and every field is taken through the phases
+
+     validate    getValidStructField (path lookup, type and size checks)
+     allocate    sizing the destination (vectors and matrices only, the
+                 cell / FlatVectTree inputs allocate as they convert)
+     convert     getInputfrommxArray (FlattenCellArray for DeepCells)
+     output      assignmxArray (Convert2CellArray for DeepCells)
+     end_to_end  getInputfromStruct followed by assignmxArray
+
+   The time of each phase is reported per field kind (and for all fields
+   together), with --per-field also per field path. The work of a row is
+   the number of elements in the fields it covers. --filter selects the
+   rows whose phase or field kind / path contains the given substring.
+
+   Build it with `make bench` and run
+
+     Benchmark_MexIO [--sizes N1,N2,...] [--types T1,T2,...] [--reps R]
+                     [--filter Str] [--format table|csv|json] [--out File]
+                     [--per-field]
+
+   Against MATLAB, build it as a MEX function using (from the repository
+   root)
+
+     mex -DMEX_LIB -outdir Source/Benchmarks Source/Benchmarks/Benchmark_MexIO.cpp Headers/MexMem.cpp
+
+   and give the same options as string arguments, using --out to write the
+   results to a file, e.g.
+
+     Benchmark_MexIO('--sizes', '1000,1000000', '--out', 'MexIO.csv', '--format', 'csv')
+*/
+
+static const char* BenchUsage =
+	"Usage: Benchmark_MexIO [--sizes N1,N2,...] [--types T1,T2,...] [--reps R]\n"
+	"                       [--filter Str] [--format table|csv|json] [--out File]\n"
+	"                       [--per-field]\n";
+
+enum BenchMexIOPhase {
+	PHASE_VALIDATE,
+	PHASE_ALLOCATE,
+	PHASE_CONVERT,
+	PHASE_OUTPUT,
+	PHASE_END_TO_END,
+	N_PHASES
+};
+
+static const char* BenchPhaseNames[N_PHASES] = {
+	"validate", "allocate", "convert", "output", "end_to_end"
+};
+
+static uint32_t benchRandLength(uint64_t &RandState, uint32_t Max) {
+	// Lengths in [0, Max) from a fixed LCG (Max <= 2^16)
+	RandState = RandState * 6364136223846793005ULL + 1442695040888963407ULL;
+	return uint32_t((RandState >> 48) % Max);
+}
+
+/////////////////////////////////////////////////
+// INPUT STRUCT CONSTRUCTION ////////////////////
+/////////////////////////////////////////////////
+
+static mxArrayPtr createBenchStruct() {
+	return mxCreateStructMatrix(1, 1, 0, nullptr);
+}
+
+static void setBenchStructField(mxArrayPtr Struct, const std::string &Name, mxArrayPtr Value) {
+	mxAddField(Struct, Name.c_str());
+	mxSetField(Struct, 0, Name.c_str(), Value);
+}
+
+template <typename T>
+static mxArrayPtr createBenchNumeric(size_t M, size_t N, size_t Offset) {
+	mxArrayPtr Array = mxCreateUninitNumericMatrix(M, N, GetMexType<T>::typeVal, mxREAL);
+	T* ArrayData = reinterpret_cast<T*>(mxGetData(Array));
+	for (size_t i = 0; i < M * N; ++i)
+		ArrayData[i] = T((Offset + i) & 0x7F);
+	return Array;
+}
+
+template <typename T>
+static mxArrayPtr createBenchCellArray(uint32_t Depth, size_t NElems, uint64_t &RandState) {
+	// A cell array of the given depth (Depth = 1 being a cell array of
+	// vectors) with NElems leaf elements in all, in leaf vectors of 0-63
+	// elements. The cells below the top level have about 8 sub-cells each
+	// (i.e. a depth d cell holds about 256 * 8^(d-1) elements).
+	std::vector<mxArrayPtr> Cells;
+	if (Depth == 1) {
+		for (size_t NAdded = 0; NAdded < NElems;) {
+			size_t Length = std::min<size_t>(benchRandLength(RandState, 64), NElems - NAdded);
+			Cells.push_back(createBenchNumeric<T>(Length, Length ? 1 : 0, NAdded));
+			NAdded += Length;
+		}
+	}
+	else {
+		size_t SubCellElems = 256;
+		for (uint32_t d = 2; d < Depth; ++d)
+			SubCellElems *= 8;
+		size_t NSubCells = std::max<size_t>(NElems / SubCellElems, 1);
+		for (size_t i = 0; i < NSubCells; ++i) {
+			size_t SubElems = NElems / NSubCells + (i < NElems % NSubCells);
+			Cells.push_back(createBenchCellArray<T>(Depth - 1, SubElems, RandState));
+		}
+	}
+
+	mxArrayPtr CellArray = mxCreateCellMatrix(Cells.size(), 1);
+	for (size_t i = 0; i < Cells.size(); ++i)
+		mxSetCell(CellArray, i, Cells[i]);
+	return CellArray;
+}
+
+/////////////////////////////////////////////////
+// FIELDS                    ////////////////////
+/////////////////////////////////////////////////
+
+class BenchMexIOField {
+	/*
+	   A field of the input struct along with the destination it is read
+	   into and the mxArray it is output as. The phases are called in order
+	   (validate, allocate, convert, output) on a reset field, endToEnd
+	   does all of them through the combined GenericMexIO calls.
+	*/
+public:
+	std::string Path;
+	const char* Kind;
+	size_t NElems;
+	bool hasAllocatePhase;
+
+	const mxArray* FieldPtr;
+	mxArrayPtr Output;
+
+	inline BenchMexIOField(const std::string &Path_, const char* Kind_, size_t NElems_, bool hasAllocatePhase_) :
+		Path(Path_), Kind(Kind_), NElems(NElems_), hasAllocatePhase(hasAllocatePhase_),
+		FieldPtr(nullptr), Output(nullptr) {}
+	virtual ~BenchMexIOField() {
+		if (Output != nullptr)
+			mxDestroyArray(Output);
+	}
+
+	virtual void validate(const mxArray* InputStruct) = 0;
+	virtual void allocate() {}
+	virtual void convert() = 0;
+	virtual void output() = 0;
+	virtual void endToEnd(const mxArray* InputStruct) = 0;
+
+	// Destroys the output and empties the destination (untimed)
+	virtual void reset() {
+		if (Output != nullptr)
+			mxDestroyArray(Output);
+		Output = nullptr;
+		FieldPtr = nullptr;
+	}
+};
+
+static const MexMemInputOps BenchInputOps(true, false, -1, false, true);
+
+template <typename T>
+class BenchScalarField : public BenchMexIOField {
+	T Dest;
+public:
+	BenchScalarField(const std::string &Path_) : BenchMexIOField(Path_, "scalar", 1, false), Dest(0) {}
+
+	void validate(const mxArray* InputStruct) { FieldPtr = getValidStructField<T>(InputStruct, Path.c_str(), BenchInputOps); }
+	void convert() { getInputfrommxArray<T>(FieldPtr, Dest); }
+	void output() { Output = assignmxArray<T>(Dest); }
+	void endToEnd(const mxArray* InputStruct) {
+		getInputfromStruct<T>(InputStruct, Path.c_str(), Dest, BenchInputOps);
+		Output = assignmxArray<T>(Dest);
+	}
+	void reset() { BenchMexIOField::reset(); Dest = T(0); }
+};
+
+template <typename T>
+class BenchVectorField : public BenchMexIOField {
+	MexVector<T> Dest;
+public:
+	BenchVectorField(const std::string &Path_, size_t NElems_) : BenchMexIOField(Path_, "vector", NElems_, true) {}
+
+	void validate(const mxArray* InputStruct) { FieldPtr = getValidStructField<MexVector<T> >(InputStruct, Path.c_str(), BenchInputOps); }
+	void allocate() { Dest.resize(FieldInfo<MexVector<T> >::getSize(FieldPtr)); }
+	void convert() { getInputfrommxArray<T>(FieldPtr, Dest); }
+	void output() { Output = assignmxArray(Dest); }
+	void endToEnd(const mxArray* InputStruct) {
+		getInputfromStruct<T>(InputStruct, Path.c_str(), Dest, BenchInputOps);
+		Output = assignmxArray(Dest);
+	}
+	void reset() { BenchMexIOField::reset(); Dest = MexVector<T>(); }
+};
+
+template <typename T>
+class BenchMatrixField : public BenchMexIOField {
+	MexMatrix<T> Dest;
+public:
+	BenchMatrixField(const std::string &Path_, size_t NElems_) : BenchMexIOField(Path_, "matrix", NElems_, true) {}
+
+	void validate(const mxArray* InputStruct) { FieldPtr = getValidStructField<MexMatrix<T> >(InputStruct, Path.c_str(), BenchInputOps); }
+	void allocate() {
+		Dest.resize(FieldInfo<MexMatrix<T> >::getSize(FieldPtr, 1), FieldInfo<MexMatrix<T> >::getSize(FieldPtr, 0));
+	}
+	void convert() { getInputfrommxArray<T>(FieldPtr, Dest); }
+	void output() { Output = assignmxArray(Dest); }
+	void endToEnd(const mxArray* InputStruct) {
+		getInputfromStruct<T>(InputStruct, Path.c_str(), Dest, BenchInputOps);
+		Output = assignmxArray(Dest);
+	}
+	void reset() { BenchMexIOField::reset(); Dest = MexMatrix<T>(); }
+};
+
+template <typename T>
+class BenchCellField : public BenchMexIOField {
+	MexVector<MexVector<T> > Dest;
+public:
+	BenchCellField(const std::string &Path_, size_t NElems_) : BenchMexIOField(Path_, "cell", NElems_, false) {}
+
+	void validate(const mxArray* InputStruct) { FieldPtr = getValidStructField<MexVector<MexVector<T> > >(InputStruct, Path.c_str(), BenchInputOps); }
+	void convert() { getInputfrommxArray<T>(FieldPtr, Dest); }
+	void output() { Output = assignmxArray(Dest); }
+	void endToEnd(const mxArray* InputStruct) {
+		getInputfromStruct<T>(InputStruct, Path.c_str(), Dest, BenchInputOps);
+		Output = assignmxArray(Dest);
+	}
+	void reset() { BenchMexIOField::reset(); Dest = MexVector<MexVector<T> >(); }
+};
+
+template <typename T>
+class BenchDeepCellField : public BenchMexIOField {
+	FlatVectTree<T> Dest;
+	uint32_t Depth;
+public:
+	BenchDeepCellField(const std::string &Path_, size_t NElems_, uint32_t Depth_) :
+		BenchMexIOField(Path_, "deep_cell", NElems_, false), Depth(Depth_) {}
+
+	void validate(const mxArray* InputStruct) { FieldPtr = getValidStructField<void>(InputStruct, Path.c_str(), BenchInputOps); }
+	void convert() { FlattenCellArray(FieldPtr, Dest, Depth); }
+	void output() { Output = Convert2CellArray(Dest); }
+	void endToEnd(const mxArray* InputStruct) {
+		validate(InputStruct);
+		convert();
+		output();
+	}
+	void reset() { BenchMexIOField::reset(); Dest = FlatVectTree<T>(); }
+};
+
+template <typename T>
+class BenchFlatCellArrayField : public BenchMexIOField {
+	FlatVectTree<T> Dest;
+	uint32_t Depth;
+public:
+	BenchFlatCellArrayField(const std::string &Path_, size_t NElems_, uint32_t Depth_) :
+		BenchMexIOField(Path_, "flatcellarray", NElems_, false), Depth(Depth_) {}
+
+	void validate(const mxArray* InputStruct) { FieldPtr = getValidStructField<FlatVectTree<T> >(InputStruct, Path.c_str(), BenchInputOps); }
+	void convert() { getInputfrommxArray(FieldPtr, Dest, true); }
+	void output() { Output = assignmxArray(Dest); }
+	void endToEnd(const mxArray* InputStruct) {
+		getInputfromStruct<T>(InputStruct, Path.c_str(), Dest, Depth, BenchInputOps);
+		Output = assignmxArray(Dest);
+	}
+	void reset() { BenchMexIOField::reset(); Dest = FlatVectTree<T>(); }
+};
+
+typedef std::vector<std::unique_ptr<BenchMexIOField> > BenchMexIOFieldList;
+
+template <typename T>
+static mxArrayPtr createBenchInput(size_t N, BenchMexIOFieldList &Fields) {
+
+	// Creates the input struct described at the top of this file along with
+	// the list of its fields
+
+	mxArrayPtr InputStruct = createBenchStruct();
+	uint64_t RandState = 1;
+	char Name[32];
+
+	mxArrayPtr Params = createBenchStruct();
+	for (int g = 0; g < 8; ++g) {
+		mxArrayPtr Group = createBenchStruct();
+		std::snprintf(Name, sizeof(Name), "Group%02d", g);
+		std::string GroupName = Name;
+		for (int k = 0; k < 25; ++k) {
+			std::snprintf(Name, sizeof(Name), "Value%02d", k);
+			setBenchStructField(Group, Name, createBenchNumeric<T>(1, 1, g * 25 + k));
+			Fields.emplace_back(new BenchScalarField<T>("Params." + GroupName + "." + Name));
+		}
+		setBenchStructField(Params, GroupName, Group);
+	}
+	setBenchStructField(InputStruct, "Params", Params);
+
+	mxArrayPtr Vectors = createBenchStruct();
+	for (int i = 0; i < 4; ++i) {
+		std::snprintf(Name, sizeof(Name), "V%d", i);
+		setBenchStructField(Vectors, Name, createBenchNumeric<T>(N, 1, i));
+		Fields.emplace_back(new BenchVectorField<T>(std::string("Vectors.") + Name, N));
+	}
+	setBenchStructField(InputStruct, "Vectors", Vectors);
+
+	size_t NRows = std::max<size_t>(N / 16, 1);
+	mxArrayPtr Matrices = createBenchStruct();
+	for (int i = 0; i < 2; ++i) {
+		std::snprintf(Name, sizeof(Name), "M%d", i);
+		setBenchStructField(Matrices, Name, createBenchNumeric<T>(NRows, 16, i));
+		Fields.emplace_back(new BenchMatrixField<T>(std::string("Matrices.") + Name, NRows * 16));
+	}
+	setBenchStructField(InputStruct, "Matrices", Matrices);
+
+	mxArrayPtr Cells = createBenchStruct();
+	for (int i = 0; i < 2; ++i) {
+		std::snprintf(Name, sizeof(Name), "C%d", i);
+		setBenchStructField(Cells, Name, createBenchCellArray<T>(1, N, RandState));
+		Fields.emplace_back(new BenchCellField<T>(std::string("Cells.") + Name, N));
+	}
+	setBenchStructField(InputStruct, "Cells", Cells);
+
+	mxArrayPtr DeepCells = createBenchStruct();
+	for (int i = 0; i < 2; ++i) {
+		std::snprintf(Name, sizeof(Name), "D%d", i);
+		setBenchStructField(DeepCells, Name, createBenchCellArray<T>(3, N, RandState));
+		Fields.emplace_back(new BenchDeepCellField<T>(std::string("DeepCells.") + Name, N, 3));
+	}
+	setBenchStructField(InputStruct, "DeepCells", DeepCells);
+
+	mxArrayPtr Trees = createBenchStruct();
+	for (int i = 0; i < 2; ++i) {
+		std::snprintf(Name, sizeof(Name), "T%d", i);
+		mxArrayPtr TreeCells = createBenchCellArray<T>(2, N, RandState);
+		FlatVectTree<T> Tree;
+		FlattenCellArray(TreeCells, Tree, 2);
+		mxDestroyArray(TreeCells);
+		setBenchStructField(Trees, Name, assignmxArray(Tree));
+		Fields.emplace_back(new BenchFlatCellArrayField<T>(std::string("Trees.") + Name, N, 2));
+	}
+	setBenchStructField(InputStruct, "Trees", Trees);
+
+	return InputStruct;
+}
+
+/////////////////////////////////////////////////
+// RUNNING AND REPORTING     ////////////////////
+/////////////////////////////////////////////////
+
+struct BenchMexIOTimes {
+	// The time of each phase in each repetition, and the allocations of
+	// the last repetition
+	std::vector<double> RepSeconds[N_PHASES];
+	BenchStopwatch LastWatch[N_PHASES];
+	size_t Work;
+	bool hasAllocatePhase;
+
+	BenchMexIOTimes() : Work(0), hasAllocatePhase(false) {}
+};
+
+static void reportMexIOTimes(const BenchOptions &Options, BenchReporter &Reporter,
+                             const std::string &Variant, const char* Type, size_t N, size_t ElemSize,
+                             BenchMexIOTimes &Times) {
+	for (int p = 0; p < N_PHASES; ++p) {
+		if (p == PHASE_ALLOCATE && !Times.hasAllocatePhase)
+			continue;
+		if (!Options.Filter.empty()
+		    && std::string(BenchPhaseNames[p]).find(Options.Filter) == std::string::npos
+		    && Variant.find(Options.Filter) == std::string::npos)
+			continue;
+
+		std::vector<double> &RepSeconds = Times.RepSeconds[p];
+		std::sort(RepSeconds.begin(), RepSeconds.end());
+
+		BenchResult Result;
+		Result.Case = BenchPhaseNames[p];
+		Result.Variant = Variant;
+		Result.Type = Type;
+		Result.N = N;
+		Result.Work = Times.Work;
+		Result.WorkBytes = Times.Work * ElemSize;
+		Result.NReps = Options.NReps;
+		Result.MedianSeconds = RepSeconds[RepSeconds.size() / 2];
+		Result.MinSeconds = RepSeconds[0];
+		Result.Allocs = Times.LastWatch[p].Allocs;
+		Result.MemUsage = Times.LastWatch[p].MemUsage;
+		Reporter.report(Result);
+	}
+}
+
+template <typename T>
+static void benchMexIO(const BenchOptions &Options, bool isPerField, BenchReporter &Reporter, const char* Type, size_t N) {
+
+	BenchMexIOFieldList Fields;
+	mxArrayPtr InputStruct = createBenchInput<T>(N, Fields);
+
+	// The kinds in order of first appearance, the last entry being all the
+	// fields together
+	std::vector<std::string> Kinds;
+	std::vector<size_t> FieldKind(Fields.size());
+	for (size_t f = 0; f < Fields.size(); ++f) {
+		auto KindIter = std::find(Kinds.begin(), Kinds.end(), Fields[f]->Kind);
+		FieldKind[f] = KindIter - Kinds.begin();
+		if (KindIter == Kinds.end())
+			Kinds.push_back(Fields[f]->Kind);
+	}
+	Kinds.push_back("all");
+
+	std::vector<BenchMexIOTimes> KindTimes(Kinds.size());
+	std::vector<BenchMexIOTimes> FieldTimes(isPerField ? Fields.size() : 0);
+	for (size_t f = 0; f < Fields.size(); ++f) {
+		for (size_t k : { FieldKind[f], Kinds.size() - 1 }) {
+			KindTimes[k].Work += Fields[f]->NElems;
+			KindTimes[k].hasAllocatePhase |= Fields[f]->hasAllocatePhase;
+		}
+		if (isPerField) {
+			FieldTimes[f].Work = Fields[f]->NElems;
+			FieldTimes[f].hasAllocatePhase = Fields[f]->hasAllocatePhase;
+		}
+	}
+
+	for (uint32_t r = 0; r < Options.NReps; ++r) {
+		std::vector<BenchStopwatch> KindWatches(Kinds.size() * N_PHASES);
+		for (size_t f = 0; f < Fields.size(); ++f) {
+			BenchMexIOField &Field = *Fields[f];
+			BenchStopwatch Watch[N_PHASES];
+
+			Field.reset();
+			Watch[PHASE_VALIDATE].start(); Field.validate(InputStruct); Watch[PHASE_VALIDATE].stop();
+			Watch[PHASE_ALLOCATE].start(); Field.allocate();            Watch[PHASE_ALLOCATE].stop();
+			Watch[PHASE_CONVERT ].start(); Field.convert();             Watch[PHASE_CONVERT ].stop();
+			Watch[PHASE_OUTPUT  ].start(); Field.output();              Watch[PHASE_OUTPUT  ].stop();
+			benchDoNotOptimize(Field.Output);
+
+			Field.reset();
+			Watch[PHASE_END_TO_END].start(); Field.endToEnd(InputStruct); Watch[PHASE_END_TO_END].stop();
+			benchDoNotOptimize(Field.Output);
+			Field.reset();
+
+			for (int p = 0; p < N_PHASES; ++p) {
+				for (size_t k : { FieldKind[f], Kinds.size() - 1 }) {
+					BenchStopwatch &KindWatch = KindWatches[k * N_PHASES + p];
+					KindWatch.Seconds          += Watch[p].Seconds;
+					KindWatch.Allocs.NAllocs   += Watch[p].Allocs.NAllocs;
+					KindWatch.Allocs.NReallocs += Watch[p].Allocs.NReallocs;
+					KindWatch.Allocs.NFrees    += Watch[p].Allocs.NFrees;
+					KindWatch.MemUsage         += Watch[p].MemUsage;
+				}
+				if (isPerField) {
+					FieldTimes[f].RepSeconds[p].push_back(Watch[p].Seconds);
+					FieldTimes[f].LastWatch[p] = Watch[p];
+				}
+			}
+		}
+		for (size_t k = 0; k < Kinds.size(); ++k) {
+			for (int p = 0; p < N_PHASES; ++p) {
+				KindTimes[k].RepSeconds[p].push_back(KindWatches[k * N_PHASES + p].Seconds);
+				KindTimes[k].LastWatch[p] = KindWatches[k * N_PHASES + p];
+			}
+		}
+	}
+
+	for (size_t k = 0; k < Kinds.size(); ++k)
+		reportMexIOTimes(Options, Reporter, Kinds[k], Type, N, sizeof(T), KindTimes[k]);
+	for (size_t f = 0; f < FieldTimes.size(); ++f)
+		reportMexIOTimes(Options, Reporter, Fields[f]->Path, Type, N, sizeof(T), FieldTimes[f]);
+
+	Fields.clear();
+	mxDestroyArray(InputStruct);
+}
+
+template <typename T>
+static void benchMexIOSizes(const BenchOptions &Options, bool isPerField, BenchReporter &Reporter, const char* Type) {
+	for (size_t N : Options.Sizes)
+		benchMexIO<T>(Options, isPerField, Reporter, Type, N);
+}
+
+static int runMexIOBenchmarks(int argc, char* argv[]) {
+
+	// --per-field is specific to this benchmark, the rest of the options are
+	// parsed by parseBenchOptions
+	bool isPerField = false;
+	std::vector<char*> CommonArgs;
+	for (int i = 0; i < argc; ++i) {
+		if (std::string(argv[i]) == "--per-field")
+			isPerField = true;
+		else
+			CommonArgs.push_back(argv[i]);
+	}
+
+	BenchOptions Options;
+	Options.Sizes = { 1000, 100000, 1000000 };
+	Options.Types = { "double", "uint32" };
+	Options.NReps = 5;
+	Options.Format = BENCH_TABLE;
+	if (!parseBenchOptions(int(CommonArgs.size()), CommonArgs.data(), Options, BenchUsage))
+		return 1;
+
+	BenchReporter Reporter(Options);
+	for (auto &Type : Options.Types) {
+		const char* TypeName = Type.c_str();
+		if      (Type == "double") benchMexIOSizes<double  >(Options, isPerField, Reporter, TypeName);
+		else if (Type == "single") benchMexIOSizes<float   >(Options, isPerField, Reporter, TypeName);
+		else if (Type == "int8"  ) benchMexIOSizes<int8_t  >(Options, isPerField, Reporter, TypeName);
+		else if (Type == "uint8" ) benchMexIOSizes<uint8_t >(Options, isPerField, Reporter, TypeName);
+		else if (Type == "int16" ) benchMexIOSizes<int16_t >(Options, isPerField, Reporter, TypeName);
+		else if (Type == "uint16") benchMexIOSizes<uint16_t>(Options, isPerField, Reporter, TypeName);
+		else if (Type == "int32" ) benchMexIOSizes<int32_t >(Options, isPerField, Reporter, TypeName);
+		else if (Type == "uint32") benchMexIOSizes<uint32_t>(Options, isPerField, Reporter, TypeName);
+		else if (Type == "int64" ) benchMexIOSizes<int64_t >(Options, isPerField, Reporter, TypeName);
+		else if (Type == "uint64") benchMexIOSizes<uint64_t>(Options, isPerField, Reporter, TypeName);
+		else
+			WriteOutput("Unknown type '%s' (skipped)\n", TypeName);
+	}
+	return 0;
+}
+
+#ifdef MEX_LIB
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]) {
+	std::vector<std::string> Args(1, "Benchmark_MexIO");
+	for (int i = 0; i < nrhs; ++i) {
+		char* Arg = mxArrayToString(prhs[i]);
+		if (Arg == nullptr) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "All the arguments of Benchmark_MexIO must be strings\n");
+		}
+		Args.push_back(Arg);
+		mxFree(Arg);
+	}
+	std::vector<char*> ArgPtrs;
+	for (auto &Arg : Args)
+		ArgPtrs.push_back(&Arg[0]);
+	runMexIOBenchmarks(int(ArgPtrs.size()), ArgPtrs.data());
+}
+#else
+int main(int argc, char* argv[]) {
+	return runMexIOBenchmarks(argc, argv);
+}
+#endif
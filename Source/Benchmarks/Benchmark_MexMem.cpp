@@ -0,0 +1,303 @@
+#include <stdint.h>
+#include <cstdio>
+#include <vector>
+#include <string>
+
+#include "../../Headers/MexMem.hpp"
+#include "../../Headers/FlatVectTree/FlatVectTree.hpp"
+#include "BenchmarkHelpers.hpp"
+
+/*
+   Benchmark_MexMem - Microbenchmarks of the hot paths of MexVector,
+   MexMatrix and FlatVectTree, each against a std::vector baseline doing the
+   same work. Build it with `make bench` (see the Makefile) and run
+
+     Benchmark_MexMem [--sizes N1,N2,...] [--types T1,T2,...] [--reps R]
+                      [--filter Case] [--format table|csv|json] [--out File]
+
+   The types are named as the MATLAB classes (double, single, int8, uint8,
+   int16, uint16, int32, uint32, int64, uint64). The cases, for each size N
+   and type, are
+
+     push_back           N push_backs into an empty vector
+     push_back_reserved  reserve(N) followed by N push_backs
+     insert_middle       64 single element inserts at the middle of an N
+                         element vector (the work being the elements moved)
+     erase_middle        64 single element erases at the middle of an N
+                         element vector (the work being the elements moved)
+     matrix_push_row     push_row of N/16 rows of 16 columns
+     fvt_append          FlatVectTree::append of a depth 1 tree of N elements
+                         (in rows of 0-31 elements)
+     fvt_get_vect_tree   FlatVectTree::getVectTree of the same tree
+     alloc_small         N/16 construction / destruction of 16 element vectors
+                         (the overhead per allocation, incl. MemCounter)
+
+   The MexVector / MexMatrix / FlatVectTree variants allocate through
+   BenchCountingAllocator<CAllocator> and the baselines through
+   BenchCountingStdAllocator so that the allocation counts are comparable.
+*/
+
+static const char* BenchUsage =
+	"Usage: Benchmark_MexMem [--sizes N1,N2,...] [--types T1,T2,...] [--reps R]\n"
+	"                        [--filter Case] [--format table|csv|json] [--out File]\n";
+
+typedef BenchCountingAllocator<CAllocator> BenchAl;
+
+template <typename T>
+using BenchStdVector = std::vector<T, BenchCountingStdAllocator<T> >;
+
+static const size_t BenchNMiddleOps = 64;
+static const size_t BenchMatrixNCols = 16;
+static const size_t BenchSmallAllocSize = 16;
+
+static uint32_t benchRowLength(uint64_t &RandState) {
+	// Row lengths in [0, 31] from a fixed LCG (so that all the variants and
+	// runs see the same tree)
+	RandState = RandState * 6364136223846793005ULL + 1442695040888963407ULL;
+	return uint32_t(RandState >> 59);
+}
+
+/////////////////////////////////////////////////
+// MEXVECTOR CASES           ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T>
+static void benchPushBack(const BenchOptions &Options, BenchReporter &Reporter, const char* Type, size_t N) {
+	runBenchCase(Options, Reporter, "push_back", "MexVector", Type, N, N, N * sizeof(T), [&](BenchStopwatch &Watch) {
+		MexVector<T, BenchAl> Vect;
+		Watch.start();
+		for (size_t i = 0; i < N; ++i)
+			Vect.push_back(T(i));
+		Watch.stop();
+		benchDoNotOptimize(Vect.begin());
+	});
+	runBenchCase(Options, Reporter, "push_back", "std::vector", Type, N, N, N * sizeof(T), [&](BenchStopwatch &Watch) {
+		BenchStdVector<T> Vect;
+		Watch.start();
+		for (size_t i = 0; i < N; ++i)
+			Vect.push_back(T(i));
+		Watch.stop();
+		benchDoNotOptimize(Vect.data());
+	});
+
+	runBenchCase(Options, Reporter, "push_back_reserved", "MexVector", Type, N, N, N * sizeof(T), [&](BenchStopwatch &Watch) {
+		MexVector<T, BenchAl> Vect;
+		Watch.start();
+		Vect.reserve(N);
+		for (size_t i = 0; i < N; ++i)
+			Vect.push_back(T(i));
+		Watch.stop();
+		benchDoNotOptimize(Vect.begin());
+	});
+	runBenchCase(Options, Reporter, "push_back_reserved", "std::vector", Type, N, N, N * sizeof(T), [&](BenchStopwatch &Watch) {
+		BenchStdVector<T> Vect;
+		Watch.start();
+		Vect.reserve(N);
+		for (size_t i = 0; i < N; ++i)
+			Vect.push_back(T(i));
+		Watch.stop();
+		benchDoNotOptimize(Vect.data());
+	});
+}
+
+template <typename T>
+static void benchInsertErase(const BenchOptions &Options, BenchReporter &Reporter, const char* Type, size_t N) {
+	size_t NMoved = BenchNMiddleOps * (N / 2);
+
+	runBenchCase(Options, Reporter, "insert_middle", "MexVector", Type, N, NMoved, NMoved * sizeof(T), [&](BenchStopwatch &Watch) {
+		MexVector<T, BenchAl> Vect(N);
+		Vect.reserve(N + BenchNMiddleOps);
+		Watch.start();
+		for (size_t i = 0; i < BenchNMiddleOps; ++i)
+			Vect.insert(Vect.size() / 2, T(i));
+		Watch.stop();
+		benchDoNotOptimize(Vect.begin());
+	});
+	runBenchCase(Options, Reporter, "insert_middle", "std::vector", Type, N, NMoved, NMoved * sizeof(T), [&](BenchStopwatch &Watch) {
+		BenchStdVector<T> Vect(N);
+		Vect.reserve(N + BenchNMiddleOps);
+		Watch.start();
+		for (size_t i = 0; i < BenchNMiddleOps; ++i)
+			Vect.insert(Vect.begin() + Vect.size() / 2, T(i));
+		Watch.stop();
+		benchDoNotOptimize(Vect.data());
+	});
+
+	size_t NErase = std::min(BenchNMiddleOps, N);
+	size_t NErased = NErase * (N / 2);
+	runBenchCase(Options, Reporter, "erase_middle", "MexVector", Type, N, NErased, NErased * sizeof(T), [&](BenchStopwatch &Watch) {
+		MexVector<T, BenchAl> Vect(N);
+		Watch.start();
+		for (size_t i = 0; i < NErase; ++i)
+			Vect.erase(Vect.size() / 2);
+		Watch.stop();
+		benchDoNotOptimize(Vect.begin());
+	});
+	runBenchCase(Options, Reporter, "erase_middle", "std::vector", Type, N, NErased, NErased * sizeof(T), [&](BenchStopwatch &Watch) {
+		BenchStdVector<T> Vect(N);
+		Watch.start();
+		for (size_t i = 0; i < NErase; ++i)
+			Vect.erase(Vect.begin() + Vect.size() / 2);
+		Watch.stop();
+		benchDoNotOptimize(Vect.data());
+	});
+}
+
+template <typename T>
+static void benchAllocSmall(const BenchOptions &Options, BenchReporter &Reporter, const char* Type, size_t N) {
+	size_t NAllocs = std::max<size_t>(N / BenchSmallAllocSize, 1);
+
+	runBenchCase(Options, Reporter, "alloc_small", "MexVector", Type, N, NAllocs, NAllocs * BenchSmallAllocSize * sizeof(T), [&](BenchStopwatch &Watch) {
+		Watch.start();
+		for (size_t i = 0; i < NAllocs; ++i) {
+			MexVector<T, BenchAl> Vect(BenchSmallAllocSize);
+			benchDoNotOptimize(Vect.begin());
+		}
+		Watch.stop();
+	});
+	runBenchCase(Options, Reporter, "alloc_small", "std::vector", Type, N, NAllocs, NAllocs * BenchSmallAllocSize * sizeof(T), [&](BenchStopwatch &Watch) {
+		Watch.start();
+		for (size_t i = 0; i < NAllocs; ++i) {
+			BenchStdVector<T> Vect(BenchSmallAllocSize);
+			benchDoNotOptimize(Vect.data());
+		}
+		Watch.stop();
+	});
+}
+
+/////////////////////////////////////////////////
+// MEXMATRIX CASES           ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T>
+static void benchMatrixPushRow(const BenchOptions &Options, BenchReporter &Reporter, const char* Type, size_t N) {
+	size_t NRows = std::max<size_t>(N / BenchMatrixNCols, 1);
+	size_t NElems = NRows * BenchMatrixNCols;
+
+	runBenchCase(Options, Reporter, "matrix_push_row", "MexMatrix", Type, N, NElems, NElems * sizeof(T), [&](BenchStopwatch &Watch) {
+		MexVector<T, BenchAl> Row(BenchMatrixNCols, T(1));
+		MexMatrix<T, BenchAl> Matrix(0, BenchMatrixNCols);
+		Watch.start();
+		for (size_t i = 0; i < NRows; ++i)
+			Matrix.push_row(Row);
+		Watch.stop();
+		benchDoNotOptimize(Matrix.begin());
+	});
+	runBenchCase(Options, Reporter, "matrix_push_row", "std::vector", Type, N, NElems, NElems * sizeof(T), [&](BenchStopwatch &Watch) {
+		BenchStdVector<T> Row(BenchMatrixNCols, T(1));
+		BenchStdVector<T> Matrix;
+		Watch.start();
+		for (size_t i = 0; i < NRows; ++i)
+			Matrix.insert(Matrix.end(), Row.begin(), Row.end());
+		Watch.stop();
+		benchDoNotOptimize(Matrix.data());
+	});
+}
+
+/////////////////////////////////////////////////
+// FLATVECTTREE CASES        ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T>
+static void benchFlatVectTree(const BenchOptions &Options, BenchReporter &Reporter, const char* Type, size_t N) {
+	// The input tree (N elements in rows of 0-31 elements), as nested
+	// MexVectors and as nested std::vectors
+	MexVector<MexVector<T> > TreeIn;
+	std::vector<std::vector<T> > StdTreeIn;
+	uint64_t RandState = 1;
+	for (size_t NAdded = 0; NAdded < N;) {
+		size_t RowLength = std::min<size_t>(benchRowLength(RandState), N - NAdded);
+		TreeIn.push_back(MexVector<T>(RowLength, T(NAdded)));
+		StdTreeIn.push_back(std::vector<T>(RowLength, T(NAdded)));
+		NAdded += RowLength;
+	}
+
+	runBenchCase(Options, Reporter, "fvt_append", "FlatVectTree", Type, N, N, N * sizeof(T), [&](BenchStopwatch &Watch) {
+		FlatVectTree<T, BenchAl> Tree(1);
+		Watch.start();
+		Tree.append(TreeIn);
+		Watch.stop();
+		benchDoNotOptimize(Tree.getData().begin());
+	});
+	runBenchCase(Options, Reporter, "fvt_append", "std::vector", Type, N, N, N * sizeof(T), [&](BenchStopwatch &Watch) {
+		// A hand written CSR build (offsets and data)
+		BenchStdVector<uint32_t> Offsets(1, 0);
+		BenchStdVector<T> Data;
+		Watch.start();
+		for (auto &Row : StdTreeIn) {
+			Data.insert(Data.end(), Row.begin(), Row.end());
+			Offsets.push_back(uint32_t(Data.size()));
+		}
+		Watch.stop();
+		benchDoNotOptimize(Data.data());
+	});
+
+	FlatVectTree<T, BenchAl> Tree(1);
+	Tree.append(TreeIn);
+	BenchStdVector<uint32_t> Offsets(1, 0);
+	BenchStdVector<T> Data;
+	for (auto &Row : StdTreeIn) {
+		Data.insert(Data.end(), Row.begin(), Row.end());
+		Offsets.push_back(uint32_t(Data.size()));
+	}
+
+	runBenchCase(Options, Reporter, "fvt_get_vect_tree", "FlatVectTree", Type, N, N, N * sizeof(T), [&](BenchStopwatch &Watch) {
+		MexVector<MexVector<T, BenchAl> > TreeOut;
+		Watch.start();
+		Tree.getVectTree(TreeOut);
+		Watch.stop();
+		benchDoNotOptimize(TreeOut.begin());
+	});
+	runBenchCase(Options, Reporter, "fvt_get_vect_tree", "std::vector", Type, N, N, N * sizeof(T), [&](BenchStopwatch &Watch) {
+		std::vector<BenchStdVector<T> > TreeOut;
+		Watch.start();
+		TreeOut.resize(Offsets.size() - 1);
+		for (size_t i = 0; i + 1 < Offsets.size(); ++i)
+			TreeOut[i].assign(Data.begin() + Offsets[i], Data.begin() + Offsets[i + 1]);
+		Watch.stop();
+		benchDoNotOptimize(TreeOut.data());
+	});
+}
+
+/////////////////////////////////////////////////
+// MAIN                      ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T>
+static void benchAllCases(const BenchOptions &Options, BenchReporter &Reporter, const char* Type) {
+	for (size_t N : Options.Sizes) {
+		benchPushBack<T>(Options, Reporter, Type, N);
+		benchInsertErase<T>(Options, Reporter, Type, N);
+		benchMatrixPushRow<T>(Options, Reporter, Type, N);
+		benchFlatVectTree<T>(Options, Reporter, Type, N);
+		benchAllocSmall<T>(Options, Reporter, Type, N);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	BenchOptions Options;
+	Options.Sizes = { 1000, 100000, 10000000 };
+	Options.Types = { "double", "uint32" };
+	Options.NReps = 5;
+	Options.Format = BENCH_TABLE;
+	if (!parseBenchOptions(argc, argv, Options, BenchUsage))
+		return 1;
+
+	BenchReporter Reporter(Options);
+	for (auto &Type : Options.Types) {
+		const char* TypeName = Type.c_str();
+		if      (Type == "double") benchAllCases<double  >(Options, Reporter, TypeName);
+		else if (Type == "single") benchAllCases<float   >(Options, Reporter, TypeName);
+		else if (Type == "int8"  ) benchAllCases<int8_t  >(Options, Reporter, TypeName);
+		else if (Type == "uint8" ) benchAllCases<uint8_t >(Options, Reporter, TypeName);
+		else if (Type == "int16" ) benchAllCases<int16_t >(Options, Reporter, TypeName);
+		else if (Type == "uint16") benchAllCases<uint16_t>(Options, Reporter, TypeName);
+		else if (Type == "int32" ) benchAllCases<int32_t >(Options, Reporter, TypeName);
+		else if (Type == "uint32") benchAllCases<uint32_t>(Options, Reporter, TypeName);
+		else if (Type == "int64" ) benchAllCases<int64_t >(Options, Reporter, TypeName);
+		else if (Type == "uint64") benchAllCases<uint64_t>(Options, Reporter, TypeName);
+		else
+			std::fprintf(stderr, "Unknown type '%s' (skipped)\n", TypeName);
+	}
+	return 0;
+}
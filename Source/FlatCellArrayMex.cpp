@@ -0,0 +1,385 @@
+#include <mex.h>
+#include <matrix.h>
+#undef printf
+
+#include <utility>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+#include "../Headers/MexMem.hpp"
+#include "../Headers/GenericMexIO.hpp"
+#include "../Headers/FlatVectTree/FlatVectTree.hpp"
+
+/*
+   FlatCellArrayMex - Native implementations of the FlatCellArray operations
+   that are too slow in interpreted MATLAB. This is called by the methods of
+   the MATLAB class @FlatCellArray when it exists on the path, i.e. build it
+   using (from the repository root)
+
+     mex -DMEX_LIB -outdir MatlabSource Source/FlatCellArrayMex.cpp Headers/MexMem.cpp
+
+   Commands:
+
+     StructOut = FlatCellArrayMex('Flatten', CellArray, ArrayType, ActualDepth, IndexType)
+
+       Returns the struct (with fields ClassName, PartitionIndex, Data and
+       ValidationToken) of the flattened CellArray. ArrayType and ActualDepth
+       are optional and have the same meaning as in
+       FlatCellArray.FlattenCellArray. IndexType ('uint32' or 'uint64') is
+       the class of the PartitionIndex. By default, uint64 is used only if
+       the array is too large for uint32.
+
+     CellArray = FlatCellArrayMex('Expand', StructIn, Level, BegIndex, EndIndex, 'Trusted')
+
+       Returns the cell array represented by the struct StructIn (as returned
+       by FlatCellArray.Convert2Struct). If specified, only the elements
+       (BegIndex:EndIndex-1) (0-start) of the Level'th level (1-start) are
+       converted (see FlatCellArray.Convert2CellArrayPartial).
+
+     StructOut = FlatCellArrayMex('Filter', StructIn, FiltIndexVect, Depth, 'Trusted')
+
+       Filters the Depth'th level (Depth = Depth of StructIn + 1, the
+       default, filters the Data) of StructIn as in FlatCellArray.filter.
+       FiltIndexVect is either a logical mask or a vector of indices
+       (1-start). As only the levels from Depth-1 onwards change, StructOut
+       contains the fields FirstLevel (1-start), PartitionIndex (the levels
+       FirstLevel:end) and Data.
+
+   StructIn is validated in full (O(size)) unless the optional last
+   argument 'Trusted' is given AND StructIn carries a matching
+   ValidationToken. 'Trusted' is meant only for the methods of
+   FlatCellArray, which pass the struct of their own (private, hence
+   valid) arrays. A struct from anywhere else must not be trusted: the
+   ValidationToken can be recomputed, and an invalid index that escapes
+   validation leads to out of bounds reads.
+*/
+
+struct ClassNameEntry {
+	const char* ClassName;
+	mxClassID ClassID;
+};
+
+static mxClassID getClassIDfromName(const char* ClassName) {
+	static const ClassNameEntry ClassTable[] = {
+		{ "int8"  , mxINT8_CLASS   }, { "uint8"  , mxUINT8_CLASS  },
+		{ "int16" , mxINT16_CLASS  }, { "uint16" , mxUINT16_CLASS },
+		{ "int32" , mxINT32_CLASS  }, { "uint32" , mxUINT32_CLASS },
+		{ "int64" , mxINT64_CLASS  }, { "uint64" , mxUINT64_CLASS },
+		{ "single", mxSINGLE_CLASS }, { "double" , mxDOUBLE_CLASS }
+	};
+	for (auto &Entry : ClassTable) {
+		if (!std::strcmp(Entry.ClassName, ClassName))
+			return Entry.ClassID;
+	}
+	return mxUNKNOWN_CLASS;
+}
+
+template <template <typename> class CommandT, typename... Args>
+static mxArrayPtr CallTypedCommand(mxClassID ClassID, Args&&... args) {
+
+	// Calls CommandT<T>::exec(args...) with T being the C++ type corresponding
+	// to ClassID.
+
+	switch (ClassID) {
+		case mxINT8_CLASS   : return CommandT<int8_t  >::exec(std::forward<Args>(args)...);
+		case mxUINT8_CLASS  : return CommandT<uint8_t >::exec(std::forward<Args>(args)...);
+		case mxINT16_CLASS  : return CommandT<int16_t >::exec(std::forward<Args>(args)...);
+		case mxUINT16_CLASS : return CommandT<uint16_t>::exec(std::forward<Args>(args)...);
+		case mxINT32_CLASS  : return CommandT<int32_t >::exec(std::forward<Args>(args)...);
+		case mxUINT32_CLASS : return CommandT<uint32_t>::exec(std::forward<Args>(args)...);
+		case mxINT64_CLASS  : return CommandT<int64_t >::exec(std::forward<Args>(args)...);
+		case mxUINT64_CLASS : return CommandT<uint64_t>::exec(std::forward<Args>(args)...);
+		case mxSINGLE_CLASS : return CommandT<float   >::exec(std::forward<Args>(args)...);
+		case mxDOUBLE_CLASS : return CommandT<double  >::exec(std::forward<Args>(args)...);
+		default:
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The FlatCellArray type must be a numeric class\n");
+			return nullptr;
+	}
+}
+
+//////////////////////////////////////////////////////////////////
+/////////////////////////// COMMANDS /////////////////////////////
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+struct FlattenCommand {
+	static mxArrayPtr exec(const mxArray* CellArray, const CellArrayLevelInfo &LevelInfo, uint32_t RequiredDepth, mxClassID IndexClass) {
+		// The tree is built with the index type that is output so that its
+		// memory is released to MATLAB without conversion
+		if (IndexClass == mxUINT32_CLASS) {
+			FlatVectTree<T, mxAllocator, uint32_t> FlatVectTreeOut;
+			FlattenCellArray(CellArray, LevelInfo, FlatVectTreeOut, RequiredDepth);
+			return assignmxArray(FlatVectTreeOut);
+		}
+		else {
+			FlatVectTree<T, mxAllocator, uint64_t> FlatVectTreeOut;
+			FlattenCellArray(CellArray, LevelInfo, FlatVectTreeOut, RequiredDepth);
+			return assignmxArray(FlatVectTreeOut);
+		}
+	}
+};
+
+static mxArrayPtr FlattenCellArrayMex(int nrhs, const mxArray* prhs[]) {
+
+	if (nrhs < 2) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "'Flatten' requires the cell array to be flattened as input\n");
+	}
+	const mxArray* CellArray = prhs[1];
+
+	CellArrayLevelInfo LevelInfo;
+	getCellArrayLevelInfo(CellArray, 0, LevelInfo);
+	bool isTypeUndecided = (LevelInfo.LeafClass == mxUNKNOWN_CLASS);
+
+	// Deciding Array Type
+	mxClassID ArrayClass = LevelInfo.LeafClass;
+	if (!LevelInfo.isUniformClass) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The input array given is not a cell array of uniform type\n");
+	}
+	if (nrhs >= 3 && !mxIsEmpty(prhs[2])) {
+		char* ClassName = mxArrayToString(prhs[2]);
+		ArrayClass = (ClassName != nullptr) ? getClassIDfromName(ClassName) : mxUNKNOWN_CLASS;
+		mxFree(ClassName);
+		if (ArrayClass == mxUNKNOWN_CLASS) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The ArrayType must be the name of a numeric class\n");
+		}
+	}
+	else if (isTypeUndecided) {
+		mexWarnMsgIdAndTxt("FlatCellArray:UndecidedType",
+			"The cell array does not seem to contain any vectors and thus, the type is taken to be double by default. "
+			"Specify type as additional argument if otherwise required");
+		ArrayClass = mxDOUBLE_CLASS;
+	}
+
+	// Deciding Depth (only an undecided depth can be overridden)
+	uint32_t RequiredDepth = uint32_t(-1);
+	if (nrhs >= 4 && !mxIsEmpty(prhs[3])) {
+		RequiredDepth = uint32_t(mxGetScalar(prhs[3]));
+		if (RequiredDepth < LevelInfo.CellDepth) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The Actual Cell Depth cannot be lesser than the Calculated Cell Depth\n");
+		}
+		else if (LevelInfo.DataSize > 0 && RequiredDepth != LevelInfo.CellDepth) {
+			mexWarnMsgIdAndTxt("FlatCellArray:RedundantDepthInput",
+				"The Depth for the cell array is NOT undecided. Ignoring given ActualDepth");
+			RequiredDepth = uint32_t(-1);
+		}
+	}
+	else if (LevelInfo.DataSize == 0) {
+		mexWarnMsgIdAndTxt("FlatCellArray:UndecidedDepth",
+			"The cell array does not seem to contain any vectors and thus, the Depth of the cell array may possibly be "
+			"incorrectly judged. Specify Actual Depth as additional argument if otherwise required");
+	}
+
+	// Deciding Index Type
+	mxClassID IndexClass = mxUNKNOWN_CLASS;
+	if (nrhs >= 5 && !mxIsEmpty(prhs[4])) {
+		char* IndexClassName = mxArrayToString(prhs[4]);
+		IndexClass = (IndexClassName != nullptr) ? getClassIDfromName(IndexClassName) : mxUNKNOWN_CLASS;
+		mxFree(IndexClassName);
+		if (IndexClass != mxUINT32_CLASS && IndexClass != mxUINT64_CLASS) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The IndexType must be either 'uint32' or 'uint64'\n");
+		}
+	}
+	else {
+		size_t MaxIndexVal = LevelInfo.DataSize;
+		for (size_t LevelSize : LevelInfo.LevelSizes)
+			MaxIndexVal = std::max(MaxIndexVal, LevelSize);
+		IndexClass = (MaxIndexVal <= std::numeric_limits<uint32_t>::max()) ? mxUINT32_CLASS : mxUINT64_CLASS;
+	}
+
+	return CallTypedCommand<FlattenCommand>(ArrayClass, CellArray, LevelInfo, RequiredDepth, IndexClass);
+}
+
+static bool isTrustedArg(int nrhs, const mxArray* prhs[], int ArgIndex) {
+	// True if the (optional) argument ArgIndex is the string 'Trusted'
+	if (nrhs <= ArgIndex || !mxIsChar(prhs[ArgIndex]))
+		return false;
+	char* ArgStr = mxArrayToString(prhs[ArgIndex]);
+	bool isTrusted = (ArgStr != nullptr && !STRCMPI_FUNC(ArgStr, "Trusted"));
+	mxFree(ArgStr);
+	return isTrusted;
+}
+
+template <typename T>
+struct ExpandCommand {
+	template <typename IndexT>
+	static mxArrayPtr execIndexed(const mxArray* StructIn, bool isTrusted, uint32_t Level, size_t BegIndex, size_t EndIndex) {
+
+		// The FlatVectTree is a (validated) read-only alias of the arrays
+		// in StructIn. The validation is skipped only for a trusted
+		// StructIn with a matching ValidationToken (see the top of this file)
+		MexVector<MexVector<IndexT> > PartitionIndex;
+		MexVector<T> Data;
+		FieldInfo<FlatVectTree<T, mxAllocator, IndexT> >::moveIntoVectors(StructIn, PartitionIndex, Data);
+
+		FlatVectTree<T, mxAllocator, IndexT> FlatVectTreeIn;
+		FlatVectTreeIn.assign(PartitionIndex, Data, false, isTrusted && hasMatchingValidationToken(StructIn));
+		return Convert2CellArray(FlatVectTreeIn, Level, BegIndex, EndIndex);
+	}
+	static mxArrayPtr exec(const mxArray* StructIn, bool isTrusted, mxClassID IndexClass, uint32_t Level, size_t BegIndex, size_t EndIndex) {
+		// The index type of the tree is that of the input so that the
+		// PartitionIndex is aliased (rather than converted)
+		if (IndexClass == mxUINT64_CLASS)
+			return execIndexed<uint64_t>(StructIn, isTrusted, Level, BegIndex, EndIndex);
+		else
+			return execIndexed<uint32_t>(StructIn, isTrusted, Level, BegIndex, EndIndex);
+	}
+};
+
+static mxArrayPtr ExpandFlatCellArrayMex(int nrhs, const mxArray* prhs[]) {
+
+	if (nrhs < 2 || !mxIsStruct(prhs[1])) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "'Expand' requires the struct of the FlatCellArray as input\n");
+	}
+	const mxArray* StructIn = prhs[1];
+	const mxArray* DatamxArr = mxGetField(StructIn, 0, "Data");
+	if (DatamxArr == nullptr) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The given struct does not have the field 'Data'\n");
+	}
+
+	mxClassID IndexClass;
+	if (!getPartitionIndexClass(mxGetField(StructIn, 0, "PartitionIndex"), IndexClass)) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The PartitionIndex must be a cell array of vectors of type uint32 or uint64\n");
+	}
+
+	uint32_t Level    = (nrhs >= 3 && !mxIsEmpty(prhs[2])) ? uint32_t(mxGetScalar(prhs[2])) - 1 : 0;
+	size_t   BegIndex = (nrhs >= 4 && !mxIsEmpty(prhs[3])) ? size_t(mxGetScalar(prhs[3]))       : 0;
+	size_t   EndIndex = (nrhs >= 5 && !mxIsEmpty(prhs[4])) ? size_t(mxGetScalar(prhs[4]))       : size_t(-1);
+
+	bool isTrusted = isTrustedArg(nrhs, prhs, 5);
+
+	return CallTypedCommand<ExpandCommand>(mxGetClassID(DatamxArr), StructIn, isTrusted, IndexClass, Level, BegIndex, EndIndex);
+}
+
+template <typename T>
+struct FilterCommand {
+	template <typename IndexT>
+	static mxArrayPtr execIndexed(const mxArray* StructIn, bool isTrusted, const mxArray* FiltIndexArr, uint32_t Level) {
+
+		// The FlatVectTree aliases the arrays in StructIn (validated as in
+		// 'Expand'). filter replaces (and does not write into) the levels
+		// that it changes, and these are the only ones that are returned.
+		MexVector<MexVector<IndexT> > PartitionIndex;
+		MexVector<T> Data;
+		FieldInfo<FlatVectTree<T, mxAllocator, IndexT> >::moveIntoVectors(StructIn, PartitionIndex, Data);
+
+		FlatVectTree<T, mxAllocator, IndexT> FlatVectTreeIn;
+		FlatVectTreeIn.assign(PartitionIndex, Data, false, isTrusted && hasMatchingValidationToken(StructIn));
+		if (Level == uint32_t(-1))
+			Level = FlatVectTreeIn.depth();
+
+		size_t NFiltElems = mxGetNumberOfElements(FiltIndexArr);
+		if (mxIsLogical(FiltIndexArr)) {
+			MexVector<bool> KeepMask;
+			KeepMask.assign(NFiltElems, reinterpret_cast<bool*>(mxGetLogicals(FiltIndexArr)), false);
+			FlatVectTreeIn.filter(Level, KeepMask);
+		}
+		else if (isMexVectorType(mxGetClassID(FiltIndexArr)) || NFiltElems == 0) {
+			MexVector<int64_t, CAllocator> KeepIndices(NFiltElems);
+			if (NFiltElems > 0)
+				copyLeafData(FiltIndexArr, KeepIndices.begin());
+			for (auto &KeepIndex : KeepIndices)
+				KeepIndex -= 1; // 1-start to 0-start
+			FlatVectTreeIn.filter(Level, KeepIndices);
+		}
+		else {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "FiltIndexVect must be either a logical or a numeric vector\n");
+		}
+
+		FlatVectTreeIn.releaseMem(PartitionIndex, Data);
+		uint32_t TreeDepth = PartitionIndex.size();
+		uint32_t FirstLevel = (Level > 0) ? Level - 1 : 0;
+		FirstLevel = (FirstLevel < TreeDepth) ? FirstLevel : TreeDepth;
+
+		mxArrayPtr PartitionIndexOut = mxCreateCellMatrix(TreeDepth - FirstLevel, 1);
+		for (uint32_t i = FirstLevel; i < TreeDepth; ++i)
+			mxSetCell(PartitionIndexOut, i - FirstLevel, assignmxArray(PartitionIndex[i]));
+
+		const char* FieldNames[] = { "FirstLevel", "PartitionIndex", "Data" };
+		mwSize ArraySize[] = { 1, 1 };
+		mxArrayPtr ReturnPtr = mxCreateStructArray(2, ArraySize, 3, FieldNames);
+		mxSetField(ReturnPtr, 0, "FirstLevel"    , mxCreateDoubleScalar(FirstLevel + 1));
+		mxSetField(ReturnPtr, 0, "PartitionIndex", PartitionIndexOut);
+		mxSetField(ReturnPtr, 0, "Data"          , assignmxArray(Data));
+		return ReturnPtr;
+	}
+	static mxArrayPtr exec(const mxArray* StructIn, bool isTrusted, mxClassID IndexClass, const mxArray* FiltIndexArr, uint32_t Level) {
+		if (IndexClass == mxUINT64_CLASS)
+			return execIndexed<uint64_t>(StructIn, isTrusted, FiltIndexArr, Level);
+		else
+			return execIndexed<uint32_t>(StructIn, isTrusted, FiltIndexArr, Level);
+	}
+};
+
+static mxArrayPtr FilterFlatCellArrayMex(int nrhs, const mxArray* prhs[]) {
+
+	if (nrhs < 3 || !mxIsStruct(prhs[1])) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "'Filter' requires the struct of the FlatCellArray and FiltIndexVect as input\n");
+	}
+	const mxArray* StructIn = prhs[1];
+	const mxArray* DatamxArr = mxGetField(StructIn, 0, "Data");
+	if (DatamxArr == nullptr) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The given struct does not have the field 'Data'\n");
+	}
+
+	mxClassID IndexClass;
+	if (!getPartitionIndexClass(mxGetField(StructIn, 0, "PartitionIndex"), IndexClass)) {
+		WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The PartitionIndex must be a cell array of vectors of type uint32 or uint64\n");
+	}
+
+	// Level is 0-start, uint32_t(-1) implies the Data
+	uint32_t Level = uint32_t(-1);
+	if (nrhs >= 4 && !mxIsEmpty(prhs[3])) {
+		double Depth = mxGetScalar(prhs[3]);
+		if (Depth < 1) {
+			WriteException(ExOps::EXCEPTION_INVALID_INPUT, "The Depth to filter must be at least 1\n");
+		}
+		Level = uint32_t(Depth) - 1;
+	}
+
+	bool isTrusted = isTrustedArg(nrhs, prhs, 4);
+
+	return CallTypedCommand<FilterCommand>(mxGetClassID(DatamxArr), StructIn, isTrusted, IndexClass, prhs[2], Level);
+}
+
+//////////////////////////////////////////////////////////////////
+////////////////////////// ENTRY POINT ///////////////////////////
+//////////////////////////////////////////////////////////////////
+
+void mexFunction(int nlhs, mxArray* plhs[], int nrhs, const mxArray* prhs[]) {
+
+	if (nrhs < 1 || !mxIsChar(prhs[0])) {
+		mexErrMsgIdAndTxt("FlatCellArray:InvalidInput", "The first argument to FlatCellArrayMex must be a command string");
+	}
+
+	char* Command = mxArrayToString(prhs[0]);
+	bool isCommandValid = true;
+	bool isErrorRaised = false;
+
+	try {
+		if (!STRCMPI_FUNC(Command, "Flatten"))
+			plhs[0] = FlattenCellArrayMex(nrhs, prhs);
+		else if (!STRCMPI_FUNC(Command, "Expand"))
+			plhs[0] = ExpandFlatCellArrayMex(nrhs, prhs);
+		else if (!STRCMPI_FUNC(Command, "Filter"))
+			plhs[0] = FilterFlatCellArrayMex(nrhs, prhs);
+		else
+			isCommandValid = false;
+	}
+	catch (ExOps::ExCodes) {
+		isErrorRaised = true;
+	}
+	catch (FV_ExCodes) {
+		isErrorRaised = true;
+	}
+
+	// mexErrMsgIdAndTxt does not return, hence all the cleanup is done prior
+	// to calling it.
+	mxFree(Command);
+	if (!isCommandValid) {
+		mexErrMsgIdAndTxt("FlatCellArray:InvalidInput", "Invalid command given to FlatCellArrayMex");
+	}
+	else if (isErrorRaised) {
+		mexErrMsgIdAndTxt("FlatCellArray:InvalidInput", "FlatCellArrayMex failed (see the message above)");
+	}
+}
@@ -0,0 +1,355 @@
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include "../../Headers/MexMem.hpp"
+#include "../../Headers/FlatVectTree/FlatVectTree.hpp"
+#include "../../Headers/FlatVectTree/CompressedFlatVectTree.hpp"
+#include "../../Headers/FlatVectTree/FlatVectTreeSort.hpp"
+
+/*
+   Test_CompressedFlatVectTree - Round-trip checks of CompressedFVTArray /
+   CompressedFlatVectTree and of the order preserving key mapping of the
+   radix sort (FVTRadixKey). Build and run it with `make test` (see the
+   Makefile). It prints each failed check and exits with 1 if any failed.
+
+   The arrays are compared bitwise so that -0 and NaNs must round-trip
+   exactly. The sizes are chosen around the block size (127, 128, 129 and
+   multiples) so that partial last blocks and ranges crossing the block
+   boundaries are exercised, and the arrays of checkBitWidths are packed
+   with every bit width.
+*/
+
+static size_t NChecks = 0;
+static size_t NFailures = 0;
+
+#define TEST_CHECK(Cond, ...) do { \
+	++NChecks; \
+	if (!(Cond)) { \
+		++NFailures; \
+		std::printf("FAILED %s:%d: ", __FILE__, __LINE__); \
+		std::printf(__VA_ARGS__); \
+		std::printf("\n"); \
+	} \
+} while (0)
+
+template <typename T>
+static bool isBitwiseEqual(const T* A, const T* B, size_t NElems) {
+	return NElems == 0 || std::memcmp(A, B, NElems * sizeof(T)) == 0;
+}
+
+static uint64_t testRand(uint64_t &RandState) {
+	// A fixed LCG so that every run checks the same arrays
+	RandState = RandState * 6364136223846793005ULL + 1442695040888963407ULL;
+	return RandState >> 33;
+}
+
+/////////////////////////////////////////////////
+// TEST ARRAYS               ////////////////////
+/////////////////////////////////////////////////
+
+enum TestPattern {
+	TEST_MONOTONE,     // Non-decreasing, small steps (incl. repeats)
+	TEST_NON_MONOTONE, // Small steps up and down
+	TEST_EXTREMES,     // Alternating lowest / max (full width differences)
+	TEST_CONSTANT
+};
+static const char* TestPatternNames[] = { "monotone", "non-monotone", "extremes", "constant" };
+
+template <typename T>
+static std::vector<T> makeTestArray(size_t NElems, TestPattern Pattern, uint64_t &RandState) {
+	std::vector<T> Array(NElems);
+	T CurrVal = std::is_signed<T>::value ? T(-100) : T(0);
+	for (size_t i = 0; i < NElems; ++i) {
+		switch (Pattern) {
+			case TEST_MONOTONE:
+				CurrVal = T(CurrVal + T(testRand(RandState) % 4));
+				Array[i] = CurrVal;
+				break;
+			case TEST_NON_MONOTONE:
+				Array[i] = T(T(testRand(RandState) % 64) + (std::is_signed<T>::value ? T(-32) : T(0)));
+				break;
+			case TEST_EXTREMES:
+				Array[i] = (i % 2) ? std::numeric_limits<T>::max() : std::numeric_limits<T>::lowest();
+				break;
+			case TEST_CONSTANT:
+				Array[i] = T(42);
+				break;
+		}
+	}
+	return Array;
+}
+
+/////////////////////////////////////////////////
+// COMPRESSED ARRAY CHECKS   ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T>
+static void checkArrayRoundTrip(const char* TypeName, const std::vector<T> &ArrayIn, const char* PatternName) {
+	size_t NElems = ArrayIn.size();
+	CompressedFVTArray<T, CAllocator> Compressed;
+	Compressed.compress(ArrayIn.data(), NElems);
+	TEST_CHECK(Compressed.size() == NElems, "%s %s N=%zu: size() is %zu", TypeName, PatternName, NElems, Compressed.size());
+
+	MexVector<T, CAllocator> ArrayOut;
+	Compressed.decompress(ArrayOut);
+	TEST_CHECK(ArrayOut.size() == NElems && isBitwiseEqual(ArrayOut.begin(), ArrayIn.data(), NElems),
+	           "%s %s N=%zu: decompress differs from the input", TypeName, PatternName, NElems);
+
+	bool isElemAccessOK = true;
+	for (size_t i = 0; i < NElems && isElemAccessOK; ++i) {
+		T Elem = Compressed[i];
+		isElemAccessOK = isBitwiseEqual(&Elem, &ArrayIn[i], 1);
+	}
+	TEST_CHECK(isElemAccessOK, "%s %s N=%zu: operator[] differs from the input", TypeName, PatternName, NElems);
+
+	// Ranges starting and ending on, just before and just after the block
+	// boundaries (and the empty ranges)
+	const size_t BlockSize = CompressedFVTArray<T, CAllocator>::BlockSize;
+	const size_t Bounds[] = { 0, 1, BlockSize - 1, BlockSize, BlockSize + 1, 2 * BlockSize, 2 * BlockSize + 1, NElems / 2, NElems - 1, NElems };
+	std::vector<T> RangeOut(NElems + 1);
+	for (size_t Beg : Bounds) {
+		for (size_t End : Bounds) {
+			if (Beg > End || End > NElems)
+				continue;
+			// (a sentinel after the range checks that nothing more is written)
+			T Sentinel = T(7);
+			RangeOut[End - Beg] = Sentinel;
+			Compressed.decompressRange(Beg, End, RangeOut.data());
+			TEST_CHECK(isBitwiseEqual(RangeOut.data(), ArrayIn.data() + Beg, End - Beg) && isBitwiseEqual(&RangeOut[End - Beg], &Sentinel, 1),
+			           "%s %s N=%zu: decompressRange(%zu, %zu) differs from the input", TypeName, PatternName, NElems, Beg, End);
+		}
+	}
+}
+
+template <typename T>
+static void checkArrays(const char* TypeName) {
+	const size_t Sizes[] = { 0, 1, 2, 127, 128, 129, 255, 256, 257, 1000, 20000 };
+	uint64_t RandState = 1;
+	for (size_t NElems : Sizes) {
+		for (int Pattern = TEST_MONOTONE; Pattern <= TEST_CONSTANT; ++Pattern) {
+			std::vector<T> ArrayIn = makeTestArray<T>(NElems, TestPattern(Pattern), RandState);
+			checkArrayRoundTrip(TypeName, ArrayIn, TestPatternNames[Pattern]);
+		}
+	}
+}
+
+template <typename T>
+static void checkBitWidths(const char* TypeName) {
+	// Monotone arrays whose differences are random values of Bits bits, so
+	// that the blocks are packed with every bit width (each having its own
+	// unpacking kernel). The differences of Bits = 8*sizeof(T) wrap around,
+	// which gives full width zigzag encoded blocks.
+	const size_t NElems = 2 * CompressedFVTArray<T, CAllocator>::BlockSize + 45;
+	uint64_t RandState = 1;
+	for (uint32_t Bits = 0; Bits <= 8 * sizeof(T); ++Bits) {
+		uint64_t Mask = (Bits == 64) ? ~uint64_t(0) : ((uint64_t(1) << Bits) - 1);
+		std::vector<T> ArrayIn(NElems);
+		T CurrVal = T(0);
+		for (size_t i = 0; i < NElems; ++i) {
+			uint64_t RandVal = (testRand(RandState) << 62) ^ (testRand(RandState) << 31) ^ testRand(RandState);
+			CurrVal = T(CurrVal + T(RandVal & Mask));
+			ArrayIn[i] = CurrVal;
+		}
+		char PatternName[32];
+		std::snprintf(PatternName, sizeof(PatternName), "%u bit differences", Bits);
+		checkArrayRoundTrip(TypeName, ArrayIn, PatternName);
+	}
+}
+
+template <typename T>
+static void checkSpecialFloats(const char* TypeName) {
+	// -0, denormals, infinities and NaNs (of both signs) must be preserved
+	// bit for bit, in and across blocks
+	const T Specials[] = {
+		T(-0.0), T(0.0), std::numeric_limits<T>::denorm_min(), -std::numeric_limits<T>::denorm_min(),
+		std::numeric_limits<T>::infinity(), -std::numeric_limits<T>::infinity(),
+		std::numeric_limits<T>::quiet_NaN(), -std::numeric_limits<T>::quiet_NaN(),
+		std::numeric_limits<T>::max(), std::numeric_limits<T>::lowest(), T(1.5), T(-1.5)
+	};
+	const size_t NSpecials = sizeof(Specials) / sizeof(T);
+	std::vector<T> ArrayIn(300);
+	for (size_t i = 0; i < ArrayIn.size(); ++i)
+		ArrayIn[i] = Specials[(i * 7) % NSpecials];
+	checkArrayRoundTrip(TypeName, ArrayIn, "special values");
+}
+
+/////////////////////////////////////////////////
+// COMPRESSED TREE CHECKS    ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T>
+static void checkTreeRoundTrip(const char* TypeName, const char* TreeName, const FlatVectTree<T, CAllocator> &TreeIn) {
+	CompressedFlatVectTree<T, CAllocator> Compressed(TreeIn);
+	TEST_CHECK(Compressed.depth() == TreeIn.depth(), "%s %s: depth() is %u instead of %u", TypeName, TreeName, Compressed.depth(), TreeIn.depth());
+
+	FlatVectTree<T, CAllocator> TreeOut;
+	Compressed.decompress(TreeOut);
+	bool isTreeEqual = TreeOut.depth() == TreeIn.depth();
+	for (uint32_t l = 0; l < TreeIn.depth() && isTreeEqual; ++l) {
+		auto LevelIn = TreeIn.getPartitionIndex(l);
+		auto LevelOut = TreeOut.getPartitionIndex(l);
+		isTreeEqual = LevelOut.size() == LevelIn.size() && isBitwiseEqual(LevelOut.begin(), LevelIn.begin(), LevelIn.size());
+	}
+	isTreeEqual = isTreeEqual && TreeOut.getData().size() == TreeIn.getData().size()
+	              && isBitwiseEqual(TreeOut.getData().begin(), TreeIn.getData().begin(), TreeIn.getData().size());
+	TEST_CHECK(isTreeEqual, "%s %s: decompress differs from the input tree", TypeName, TreeName);
+
+	if (TreeIn.depth() == 0)
+		return;
+
+	// The leaves, one at a time and streamed in batches of several sizes
+	auto LeafInds = TreeIn.getPartitionIndex(TreeIn.depth() - 1);
+	const T* DataIn = TreeIn.getData().begin();
+	size_t NLeaves = LeafInds.size() - 1;
+	TEST_CHECK(Compressed.NLeaves() == NLeaves, "%s %s: NLeaves() is %zu instead of %zu", TypeName, TreeName, Compressed.NLeaves(), NLeaves);
+
+	bool isLeafOK = true;
+	for (size_t i = 0; i < NLeaves && isLeafOK; ++i) {
+		MexVector<T, CAllocator> Leaf;
+		Compressed.getLeaf(i, Leaf);
+		isLeafOK = Leaf.size() == LeafInds[i + 1] - LeafInds[i] && isBitwiseEqual(Leaf.begin(), DataIn + LeafInds[i], Leaf.size());
+	}
+	TEST_CHECK(isLeafOK, "%s %s: getLeaf differs from the input tree", TypeName, TreeName);
+
+	const size_t BatchSizes[] = { 1, 3, 128, 4096 };
+	for (size_t LeavesPerBatch : BatchSizes) {
+		size_t NextLeaf = 0;
+		bool isStreamOK = true;
+		Compressed.forEachLeaf([&](size_t LeafIndex, const MexVectorView<T> &Leaf) {
+			isStreamOK = isStreamOK && LeafIndex == NextLeaf++
+			             && Leaf.size() == LeafInds[LeafIndex + 1] - LeafInds[LeafIndex]
+			             && isBitwiseEqual(Leaf.begin(), DataIn + LeafInds[LeafIndex], Leaf.size());
+		}, LeavesPerBatch);
+		TEST_CHECK(isStreamOK && NextLeaf == NLeaves, "%s %s: forEachLeaf(%zu leaves per batch) differs from the input tree",
+		           TypeName, TreeName, LeavesPerBatch);
+	}
+}
+
+template <typename T>
+static void checkTrees(const char* TypeName) {
+	uint64_t RandState = 2;
+
+	// Depth 2 trees whose leaves have the sizes around the block size
+	// (including empty leaves and empty nodes), with monotone and
+	// non-monotone leaf data
+	const size_t LeafSizes[] = { 0, 127, 128, 129, 0, 0, 1, 255, 256, 257, 3 };
+	const size_t NLeafSizes = sizeof(LeafSizes) / sizeof(size_t);
+	for (int Pattern = TEST_MONOTONE; Pattern <= TEST_NON_MONOTONE; ++Pattern) {
+		MexVector<MexVector<MexVector<T, CAllocator>, CAllocator>, CAllocator> VectTree(40);
+		size_t LeafCount = 0;
+		for (size_t i = 0; i < VectTree.size(); ++i) {
+			size_t NChildren = (i % 5 == 4) ? 0 : testRand(RandState) % 4;
+			for (size_t j = 0; j < NChildren; ++j) {
+				std::vector<T> Leaf = makeTestArray<T>(LeafSizes[LeafCount++ % NLeafSizes], TestPattern(Pattern), RandState);
+				VectTree[i].push_back(MexVector<T, CAllocator>(Leaf.size()));
+				std::copy(Leaf.begin(), Leaf.end(), VectTree[i].last().begin());
+			}
+		}
+		FlatVectTree<T, CAllocator> TreeIn(2);
+		TreeIn.append(VectTree);
+		checkTreeRoundTrip(TypeName, (Pattern == TEST_MONOTONE) ? "depth 2 tree (monotone leaves)" : "depth 2 tree (non-monotone leaves)", TreeIn);
+	}
+
+	// A depth 1 tree of only empty leaves, and empty trees
+	MexVector<MexVector<T, CAllocator>, CAllocator> EmptyLeaves(300);
+	FlatVectTree<T, CAllocator> EmptyLeavesTree(1);
+	EmptyLeavesTree.append(EmptyLeaves);
+	checkTreeRoundTrip(TypeName, "tree of empty leaves", EmptyLeavesTree);
+	checkTreeRoundTrip(TypeName, "empty depth 1 tree", FlatVectTree<T, CAllocator>(1));
+	checkTreeRoundTrip(TypeName, "empty depth 3 tree", FlatVectTree<T, CAllocator>(3));
+}
+
+/////////////////////////////////////////////////
+// RADIX KEY CHECKS          ////////////////////
+/////////////////////////////////////////////////
+
+template <typename T>
+static void checkRadixKeys(const char* TypeName, const std::vector<T> &AscendingVals) {
+	// The keys of AscendingVals must be strictly ascending, and the mapping
+	// must be invertible
+	typedef typename FVTRadixKey<T>::WordT WordT;
+	for (size_t i = 0; i < AscendingVals.size(); ++i) {
+		WordT Key = FVTRadixKey<T>::toKey(AscendingVals[i]);
+		T Val = FVTRadixKey<T>::fromKey(Key);
+		TEST_CHECK(isBitwiseEqual(&Val, &AscendingVals[i], 1), "%s: fromKey(toKey(x)) != x for the value %zu", TypeName, i);
+		if (i > 0) {
+			TEST_CHECK(FVTRadixKey<T>::toKey(AscendingVals[i - 1]) < Key, "%s: the key of the value %zu is not above the previous", TypeName, i);
+		}
+	}
+
+	// The radix sort (the large segment path) must agree with std::sort
+	uint64_t RandState = 3;
+	std::vector<T> Array(5000);
+	for (size_t i = 0; i < Array.size(); ++i)
+		Array[i] = AscendingVals[testRand(RandState) % AscendingVals.size()];
+	std::vector<T> Expected(Array);
+	std::sort(Expected.begin(), Expected.end(), [](const T &A, const T &B) {
+		return FVTRadixKey<T>::toKey(A) < FVTRadixKey<T>::toKey(B);
+	});
+	MexVector<WordT, CAllocator> KeyBuffer;
+	FVTRadixSort(Array.data(), Array.data() + Array.size(), KeyBuffer);
+	TEST_CHECK(isBitwiseEqual(Array.data(), Expected.data(), Array.size()), "%s: FVTRadixSort differs from std::sort by key", TypeName);
+}
+
+template <typename T>
+static void checkIntegerRadixKeys(const char* TypeName) {
+	// (the small values wrap for the narrow / unsigned types, hence the
+	// sorting)
+	std::vector<T> Vals = {
+		std::numeric_limits<T>::lowest(), T(std::numeric_limits<T>::lowest() + 1), T(-2), T(-1), T(0), T(1),
+		T(127), T(128), T(255), T(256), T(std::numeric_limits<T>::max() - 1), std::numeric_limits<T>::max()
+	};
+	std::sort(Vals.begin(), Vals.end());
+	Vals.erase(std::unique(Vals.begin(), Vals.end()), Vals.end());
+	checkRadixKeys(TypeName, Vals);
+}
+
+template <typename T>
+static void checkFloatRadixKeys(const char* TypeName) {
+	// -0 sorts before +0 and the NaNs to the ends, by their sign
+	std::vector<T> Vals = {
+		-std::numeric_limits<T>::quiet_NaN(), -std::numeric_limits<T>::infinity(), std::numeric_limits<T>::lowest(),
+		T(-1.5), T(-1), -std::numeric_limits<T>::min(), -std::numeric_limits<T>::denorm_min(), T(-0.0),
+		T(0.0), std::numeric_limits<T>::denorm_min(), std::numeric_limits<T>::min(), T(1), T(1.5),
+		std::numeric_limits<T>::max(), std::numeric_limits<T>::infinity(), std::numeric_limits<T>::quiet_NaN()
+	};
+	checkRadixKeys(TypeName, Vals);
+}
+
+int main() {
+	checkArrays<uint8_t >("uint8");
+	checkArrays<int16_t >("int16");
+	checkArrays<uint32_t>("uint32");
+	checkArrays<int32_t >("int32");
+	checkArrays<uint64_t>("uint64");
+	checkArrays<int64_t >("int64");
+	checkArrays<float   >("single");
+	checkArrays<double  >("double");
+	checkBitWidths<uint8_t >("uint8");
+	checkBitWidths<uint16_t>("uint16");
+	checkBitWidths<uint32_t>("uint32");
+	checkBitWidths<uint64_t>("uint64");
+	checkSpecialFloats<float >("single");
+	checkSpecialFloats<double>("double");
+
+	checkTrees<uint32_t>("uint32");
+	checkTrees<int32_t >("int32");
+	checkTrees<double  >("double");
+
+	checkIntegerRadixKeys<uint8_t >("uint8");
+	checkIntegerRadixKeys<int8_t  >("int8");
+	checkIntegerRadixKeys<int16_t >("int16");
+	checkIntegerRadixKeys<uint32_t>("uint32");
+	checkIntegerRadixKeys<int32_t >("int32");
+	checkIntegerRadixKeys<int64_t >("int64");
+	checkIntegerRadixKeys<uint64_t>("uint64");
+	checkFloatRadixKeys<float >("single");
+	checkFloatRadixKeys<double>("double");
+
+	std::printf("Test_CompressedFlatVectTree: %zu checks, %zu failed\n", NChecks, NFailures);
+	return (NFailures == 0) ? 0 : 1;
+}
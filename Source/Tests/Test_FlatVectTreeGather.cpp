@@ -0,0 +1,134 @@
+#include <stdint.h>
+#include <cstdio>
+
+#include "../../Headers/MexMem.hpp"
+#include "../../Headers/FlatVectTree/FlatVectTree.hpp"
+
+/*
+   Test_FlatVectTreeGather - Checks of the batched path gather of
+   FlatVectTree (getVectTreeBatch, getDataSpans). Build and run it with
+   `make test` (see the Makefile). It prints each failed check and exits
+   with 1 if any failed.
+
+   Besides the gathered values, the invalid paths (out of range indices at
+   each level, paths through childless nodes and paths into empty trees)
+   must throw without reading outside the tree, which is what running this
+   under AddressSanitizer checks.
+*/
+
+static size_t NChecks = 0;
+static size_t NFailures = 0;
+
+#define TEST_CHECK(Cond, ...) do { \
+	++NChecks; \
+	if (!(Cond)) { \
+		++NFailures; \
+		std::printf("FAILED %s:%d: ", __FILE__, __LINE__); \
+		std::printf(__VA_ARGS__); \
+		std::printf("\n"); \
+	} \
+} while (0)
+
+typedef FlatVectTree<float, CAllocator> TestTree;
+
+static TestTree makeTestTree() {
+	// Depth 2 tree {{[0], [1 2]}, {}, {[], [3 4 5]}} (the second node is
+	// childless)
+	MexVector<MexVector<MexVector<float, CAllocator>, CAllocator>, CAllocator> VectTree(3);
+	VectTree[0].resize(2);
+	VectTree[0][0].push_back(0);
+	VectTree[0][1].push_back(1);
+	VectTree[0][1].push_back(2);
+	VectTree[2].resize(2);
+	for (float Val = 3; Val <= 5; ++Val)
+		VectTree[2][1].push_back(Val);
+	TestTree Tree(2);
+	Tree.append(VectTree);
+	return Tree;
+}
+
+static FlatVectTree<float, CAllocator> makeChildlessLastTree() {
+	// Depth 3 tree {{{[1]}}, {}} whose last node is childless
+	MexVector<MexVector<MexVector<MexVector<float, CAllocator>, CAllocator>, CAllocator>, CAllocator> VectTree(2);
+	VectTree[0].resize(1);
+	VectTree[0][0].resize(1);
+	VectTree[0][0][0].push_back(1);
+	FlatVectTree<float, CAllocator> Tree(3);
+	Tree.append(VectTree);
+	return Tree;
+}
+
+static MexMatrix<int32_t, CAllocator> makePaths(size_t NPaths, size_t PathLength, const int32_t* PathsIn) {
+	MexMatrix<int32_t, CAllocator> Paths(NPaths, PathLength);
+	for (size_t i = 0; i < NPaths * PathLength; ++i)
+		Paths.begin()[i] = PathsIn[i];
+	return Paths;
+}
+
+static void checkValidPaths() {
+	TestTree Tree = makeTestTree();
+	const int32_t PathsIn[] = { 2, 1,   0, 1,   2, 0 };
+	MexMatrix<int32_t, CAllocator> Paths = makePaths(3, 2, PathsIn);
+
+	MexVector<uint32_t, CAllocator> SpanBeg, SpanEnd;
+	Tree.getDataSpans(Paths, SpanBeg, SpanEnd);
+	TEST_CHECK(SpanBeg.size() == 3 && SpanBeg[0] == 3 && SpanEnd[0] == 6 && SpanBeg[1] == 1 && SpanEnd[1] == 3
+	           && SpanBeg[2] == 3 && SpanEnd[2] == 3, "getDataSpans of valid paths returned wrong spans");
+
+	FlatVectTree<float, CAllocator> Gathered;
+	Tree.getVectTreeBatch(Gathered, Paths);
+	auto Data = Gathered.getData();
+	TEST_CHECK(Gathered.depth() == 1 && Gathered.LevelSize(0) == 3 && Data.size() == 5 && Data[0] == 3 && Data[3] == 1,
+	           "getVectTreeBatch of valid paths returned a wrong tree");
+}
+
+static void checkInvalidPaths(const char* CaseName, const TestTree &Tree, size_t PathLength, const int32_t* PathsIn, size_t NPaths) {
+	MexMatrix<int32_t, CAllocator> Paths = makePaths(NPaths, PathLength, PathsIn);
+
+	bool hasThrown = false;
+	try {
+		MexVector<uint32_t, CAllocator> SpanBeg, SpanEnd;
+		Tree.getDataSpans(Paths, SpanBeg, SpanEnd);
+	}
+	catch (...) {
+		hasThrown = true;
+	}
+	TEST_CHECK(hasThrown, "getDataSpans did not throw for %s", CaseName);
+
+	hasThrown = false;
+	try {
+		FlatVectTree<float, CAllocator> Gathered;
+		Tree.getVectTreeBatch(Gathered, Paths);
+	}
+	catch (...) {
+		hasThrown = true;
+	}
+	TEST_CHECK(hasThrown, "getVectTreeBatch did not throw for %s", CaseName);
+}
+
+int main() {
+	checkValidPaths();
+
+	TestTree Tree = makeTestTree();
+	TestTree EmptyTree(2);
+
+	// (in the non-empty trees the invalid path follows a valid one, so that
+	// it is not the first row)
+	const int32_t TopOutOfRange[]     = { 0, 0,   3, 0 };
+	const int32_t TopNegative[]       = { 0, 0,   -1, 0 };
+	const int32_t ChildlessNode[]     = { 0, 0,   1, 0 };
+	const int32_t ChildOutOfRange[]   = { 0, 0,   2, 2 };
+	const int32_t LastNodeChildless[] = { 0, 0, 0,   1, 0, 0 };
+	const int32_t EmptyTreePath[]     = { 0, 0 };
+
+	checkInvalidPaths("an out of range top index", Tree, 2, TopOutOfRange, 2);
+	checkInvalidPaths("a negative top index", Tree, 2, TopNegative, 2);
+	checkInvalidPaths("a path through a childless node", Tree, 2, ChildlessNode, 2);
+	checkInvalidPaths("an out of range child index", Tree, 2, ChildOutOfRange, 2);
+	checkInvalidPaths("a path below the childless last node", makeChildlessLastTree(), 3, LastNodeChildless, 2);
+	checkInvalidPaths("an empty tree", EmptyTree, 2, EmptyTreePath, 1);
+	checkInvalidPaths("an empty tree (path of length 1)", EmptyTree, 1, EmptyTreePath, 1);
+
+	std::printf("Test_FlatVectTreeGather: %zu checks, %zu failed\n", NChecks, NFailures);
+	return (NFailures == 0) ? 0 : 1;
+}